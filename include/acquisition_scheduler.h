@@ -0,0 +1,48 @@
+#ifndef ACQUISITION_SCHEDULER_H
+#define ACQUISITION_SCHEDULER_H
+
+#include <Arduino.h>
+#include "load_cell_channel.h"
+
+// Conversions taken from one channel before moving on to the next
+#define SCHEDULER_BATCH_SAMPLES 4
+
+// Services the shelf channels from the weighing task. Every HX711 is clocked out by its own
+// data ready interrupt as soon as it has a conversion, so no chip ever waits for another one.
+// The scheduler drains their buffers round robin in small batches, starting with a different
+// channel on every pass, and measures what each channel costs.
+class AcquisitionScheduler
+{
+private:
+    struct ChannelStats
+    {
+        uint32_t samples = 0;
+        uint64_t processCycles = 0; // filters, stability and capture per conversion
+        uint64_t updateCycles = 0;  // bag state and publishing per pass
+        uint32_t maxBatchCycles = 0;
+        uint32_t passes = 0;
+    };
+
+    LoadCellChannel *channels[SCALE_MAX_CHANNELS - 1];
+    ChannelStats stats[SCALE_MAX_CHANNELS - 1];
+    uint8_t count = 0;
+    uint8_t first = 0;
+
+public:
+    bool add(LoadCellChannel *channel);
+    uint8_t size() { return count; }
+    LoadCellChannel *get(uint8_t position) { return position < count ? channels[position] : nullptr; }
+    // Shelf channel by its channel number, nullptr if there is none
+    LoadCellChannel *find(uint8_t channel);
+
+    // Process everything the channels have buffered, returns the number of conversions
+    uint32_t service();
+
+    // Wake `task` as soon as any calibrated channel moves by more than `motion`
+    void wakeOnChange(TaskHandle_t task, Weight motion);
+
+    void printStats();
+    void resetStats();
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef ADAPTIVE_SAMPLER_H
+#define ADAPTIVE_SAMPLER_H
+
+#include <Arduino.h>
+#include "weight.h"
+
+// Decides how long the weighing task sleeps between readings. Any change larger than
+// motionThreshold drops straight to the fastest interval, every stable reading doubles it
+// until the slowest interval is reached.
+class AdaptiveSampler
+{
+private:
+    uint32_t minIntervalMs;
+    uint32_t maxIntervalMs;
+    uint32_t intervalMs;
+    const Weight motionThreshold;
+
+    Weight lastWeight;
+    bool hasLastWeight = false;
+
+    // Measured time between readings, used to report the rate we actually achieve
+    unsigned long lastUpdateTime = 0;
+    float averageIntervalMs = 0.0f;
+
+public:
+    AdaptiveSampler(uint32_t minIntervalMs, uint32_t maxIntervalMs, Weight motionThreshold);
+
+    // Change floor and ceiling (e.g. when switching modes) and start again at the fastest rate
+    void setLimits(uint32_t minIntervalMs, uint32_t maxIntervalMs);
+
+    // Feed the latest reading, returns how long to wait for the next one
+    uint32_t update(Weight weight);
+
+    uint32_t getInterval() { return intervalMs; }
+    Weight getMotionThreshold() { return motionThreshold; }
+    float getEffectiveRate();
+};
+
+#endif
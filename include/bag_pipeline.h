@@ -0,0 +1,55 @@
+#ifndef BAG_PIPELINE_H
+#define BAG_PIPELINE_H
+
+#include <stdint.h>
+#include "weight.h"
+#include "sample_filter.h"
+#include "stability_detector.h"
+#include "calibration_curve.h"
+#include "pipeline_tuning.h"
+
+// Bag tracking stages of a load cell: median and Kalman filters, the calibration curve and the
+// settle detector, tuned like the plate's bag mode. Shelf channels run every conversion through
+// one, the host tools run synthetic and recorded streams through it. Plain C++ like PeerNode.
+class BagPipeline
+{
+private:
+    MedianFilter median{BAG_FILTER_MEDIAN_WINDOW};
+    KalmanFilter kalman{BAG_FILTER_PROCESS_NOISE, FILTER_MEASUREMENT_NOISE};
+    FilterChain filters;
+    StabilityDetector stability{Weight::grams(STABLE_ENTER_STDDEV), Weight::grams(STABLE_EXIT_STDDEV),
+                                Weight::grams(STABLE_ENTER_DRIFT), Weight::grams(STABLE_EXIT_DRIFT)};
+
+    CalibrationCurve curve;
+    int32_t offset = 0;
+
+    bool started = false;
+    int32_t filteredCounts = 0;
+    Weight reading;
+    Weight stableReading;
+    bool hasStableReading = false;
+
+public:
+    BagPipeline() { filters.add(&median).add(&kalman); }
+
+    // Run the next conversion through the stages, `tare` comes off the calibrated weight (the
+    // empty bag). True if the stable value changed
+    bool process(int32_t counts, Weight tare = Weight());
+    // Forget the settled value, readings from before a new offset or curve are on the old scale
+    void restart();
+
+    void setOffset(int32_t counts) { offset = counts; }
+    int32_t getOffset() const { return offset; }
+    CalibrationCurve &getCurve() { return curve; }
+    Weight toWeight(int32_t counts, Weight tare = Weight()) const { return curve.toWeight(counts - offset) - tare; }
+
+    bool hasSamples() const { return started; }
+    int32_t getFilteredCounts() const { return filteredCounts; }
+    Weight getReading() const { return reading; }
+    bool isStable() { return stability.isStable(); }
+    bool hasStableValue() const { return hasStableReading; }
+    Weight getStableValue() const { return stableReading; }
+    FilterChain &getFilters() { return filters; }
+};
+
+#endif
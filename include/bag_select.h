@@ -22,19 +22,20 @@ private:
     std::vector<String> bags;
 
     uint selectedBagIndex = 0;
-    bool needsRedraw = false;
 
+    // The neighbouring bags next to the menu, the selected one in the middle
+    TextWidget previousBag{SMALL_FONT, PREVIEW_COLOR};
+    TextWidget nextBag{SMALL_FONT, PREVIEW_COLOR, 0, 0, TextAlign::RIGHT};
+    TextWidget selectedBag{MAIN_FONT, SELECTED_COLOR};
+    TextWidget bagSize{MAIN_FONT, TEXT_COLOR};
+
+    void showSelectedBag();
     void drawProgress();
 
 public:
     BagSelect(TFT_eSPI &tftDisplay, UI &uiInstance, LedStrip &ledStrip);
-    void begin(Scale *scaleManagerInstance)
-    {
-        scaleManager = scaleManagerInstance;
-    };
-    void setBags(const std::vector<String> &bagList) { bags = bagList; };
-    void taint() { needsRedraw = true; };
-    void draw();
+    void begin(Scale *scaleManagerInstance);
+    void setBags(const std::vector<String> &bagList);
     void selectBag(uint index);
     bool selectNextBag();
     bool selectPreviousBag();
@@ -0,0 +1,30 @@
+#ifndef BAG_TRACKER_H
+#define BAG_TRACKER_H
+
+#include <stdint.h>
+#include "weight.h"
+#include "scale_event.h"
+#include "pipeline_tuning.h"
+
+typedef void (*BagEventHandler)(void *arg, ScaleEventType type, Weight weight);
+
+// Bag state of one channel, from its settled weight: lifted off the channel, below the reorder
+// threshold and below the prompt threshold. Every transition is reported once, through the
+// handler passed to update(). The plate, the shelf channels and the host replay all share it.
+class BagTracker
+{
+private:
+    bool removed = false;
+    bool belowThreshold = false;
+    bool belowPromptThreshold = false;
+
+public:
+    // Feed the settled weight and the current thresholds
+    void update(Weight stable, Weight reorder, Weight prompt, BagEventHandler handler, void *arg);
+
+    bool isRemoved() const { return removed; }
+    bool isBelowThreshold() const { return belowThreshold; }
+    bool isBelowPromptThreshold() const { return belowPromptThreshold; }
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef CALIBRATION_CURVE_H
+#define CALIBRATION_CURVE_H
+
+#include <stdint.h>
+#include "weight.h"
+
+#define CALIBRATION_MAX_POINTS 6
+
+// Known mass and the HX711 counts it produced, counts are relative to the zero offset
+struct CalibrationPoint
+{
+    int32_t counts;
+    float grams;
+};
+
+// Piecewise-linear mapping from counts to grams through the origin and up to
+// CALIBRATION_MAX_POINTS reference masses. Outside the measured range the nearest segment
+// is extrapolated, so a single point behaves like the classic scale factor.
+class CalibrationCurve
+{
+private:
+    CalibrationPoint points[CALIBRATION_MAX_POINTS];
+    uint8_t count = 0;
+
+    // Integer form of the curve used per conversion: milligrams at each point and the slope of the
+    // segment ending there in 16.16 fixed point milligrams per count
+    int32_t pointMilligrams[CALIBRATION_MAX_POINTS];
+    int32_t segmentSlopes[CALIBRATION_MAX_POINTS];
+
+    bool isMonotonic() const;
+    void updateSegments();
+
+public:
+    void clear() { count = 0; }
+
+    // Add a reference mass, replacing an existing point of the same mass. Returns false if the
+    // curve is full or the point would make the mapping non-monotonic
+    bool addPoint(int32_t counts, float grams);
+    // Replace all points, returns false (and leaves the curve empty) if they are not usable
+    bool setPoints(const CalibrationPoint *newPoints, uint8_t newCount);
+    // Single segment with the given counts per gram
+    void setLinear(float countsPerGram);
+
+    // Integer only, an uncalibrated curve reads counts as grams
+    Weight toWeight(int32_t counts) const;
+    // Average counts per gram across the whole calibrated range
+    float getFactor() const;
+
+    uint8_t size() const { return count; }
+    const CalibrationPoint *getPoints() const { return points; }
+
+#ifdef ARDUINO
+    void print() const;
+#endif
+};
+
+#endif
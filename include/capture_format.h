@@ -0,0 +1,36 @@
+#ifndef CAPTURE_FORMAT_H
+#define CAPTURE_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "sample_ring_buffer.h"
+
+// Layout of a raw capture file, written by the scale (SampleCapture) and tools/capture.py and
+// read by the scale (CaptureReplay) and the host replay (tools/replay_host.cpp). Plain C++
+
+#define CAPTURE_MAGIC 0x50435848 // "HXCP"
+#define CAPTURE_VERSION 1
+// ~6.8 minutes at 80 SPS, 224KB on flash
+#define CAPTURE_MAX_SAMPLES 32768
+// 24-bit counts + 32-bit timestamp, little endian, no padding
+#define CAPTURE_RECORD_SIZE 7
+
+struct CaptureHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t capacity;
+    uint32_t head;  // index the next record is written to
+    uint32_t count; // valid records, the oldest one is at (head - count) mod capacity
+};
+
+void encodeCaptureRecord(const RawSample &sample, uint8_t *record);
+void decodeCaptureRecord(const uint8_t *record, RawSample &sample);
+// File offset of the `index`th oldest record
+size_t captureRecordOffset(const CaptureHeader &header, uint32_t index);
+// Records of a capture file held in memory, oldest first. False if it isn't a capture
+bool parseCapture(const uint8_t *data, size_t size, std::vector<RawSample> &samples);
+
+#endif
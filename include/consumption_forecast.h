@@ -0,0 +1,74 @@
+#ifndef CONSUMPTION_FORECAST_H
+#define CONSUMPTION_FORECAST_H
+
+#include <Arduino.h>
+#include "weight.h"
+
+// Older withdrawals count half as much after this many days
+#define FORECAST_HALF_LIFE_DAYS 14.0f
+// The forecast replaces the fixed thresholds once it has seen this many withdrawals over this span
+#define FORECAST_MIN_DOSES 5
+#define FORECAST_MIN_SPAN_DAYS 3.0f
+// Withdrawals larger than this are never a dose (emptying the bag into a canister, a swap)
+#define FORECAST_MAX_DOSE 60.0f
+// Once the dose statistics have settled, reject withdrawals this many mean deviations above the mean
+#define FORECAST_OUTLIER_DEVIATIONS 4.0f
+// Weight of the latest dose in the running dose mean and deviation
+#define FORECAST_DOSE_ALPHA 0.1f
+// Shipping lead time used until a cart reports one
+#define FORECAST_DEFAULT_LEAD_DAYS 7.0f
+// Coffee that should be left when the new bag arrives
+#define FORECAST_SAFETY_DAYS 2.0f
+// The reorder button shows up this much earlier than the prompt
+#define FORECAST_BUTTON_EXTRA_DAYS 4.0f
+// Forecast thresholds never go below this, so a slow month doesn't leave nothing for the last days
+#define FORECAST_MIN_THRESHOLD 20.0f
+// Withdrawals before the clock was set have no usable time
+#define FORECAST_MIN_VALID_TIME 1704067200 // 2024-01-01
+
+// Everything the forecast knows, persisted after every withdrawal
+struct ForecastState
+{
+    float decayedGrams = 0.0f;   // exponentially decayed sum of accepted withdrawals
+    float decayedSeconds = 0.0f; // the same decay applied to the time they were taken over
+    uint32_t firstTime = 0;      // unix seconds
+    uint32_t lastTime = 0;
+    float doseMean = 0.0f;
+    float doseDeviation = 0.0f;
+    uint16_t accepted = 0;
+    uint16_t rejected = 0;
+};
+
+// Online estimate of grams consumed per day from the withdrawals the ConsumptionTracker logs.
+// Both the consumed grams and the elapsed time decay with the same half life, so their ratio
+// is a recency weighted rate that needs no history. Runs on the main task.
+class ConsumptionForecast
+{
+private:
+    ForecastState state;
+
+public:
+    void restore(const ForecastState &saved) { state = saved; }
+    const ForecastState &getState() { return state; }
+    void reset() { state = ForecastState(); }
+
+    // A finished withdrawal (positive) or refill (negative) at unix time `now`.
+    // Returns true if the state changed and should be persisted
+    bool record(Weight amount, uint32_t now);
+
+    bool isConfident();
+    // Grams per day, 0 until there is a rate
+    float getRate();
+    // Days until `remaining` is used up at the current rate, negative without a rate
+    float daysUntilEmpty(Weight remaining);
+    // Weight at which a reorder placed now arrives `FORECAST_SAFETY_DAYS` before the bag is empty
+    Weight reorderPoint(float leadDays, float extraDays = 0.0f);
+
+    void print(Weight remaining, float leadDays);
+};
+
+// Longest number of days in a shipping timeframe like "3-5 business days", 0 if there is none.
+// Business days are stretched to calendar days
+float parseLeadTimeDays(const String &timeframe);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef CONSUMPTION_TRACKER_H
+#define CONSUMPTION_TRACKER_H
+
+#include <Arduino.h>
+#include "weight.h"
+
+#define CONSUMPTION_LOG_SIZE 32
+
+// CUSUM tuning in grams. A change is detected once the deviations from the reference weight,
+// minus CUSUM_DRIFT per conversion, add up to more than CUSUM_THRESHOLD
+#define CUSUM_DRIFT 0.5f
+#define CUSUM_THRESHOLD 8.0f
+// Net changes smaller than this are treated as the bag being moved, not coffee being taken
+#define CONSUMPTION_MIN_DOSE 1.0f
+
+enum class WithdrawalKind : uint8_t
+{
+    NONE,    // weight settled back where it was
+    LIFTED,  // bag was lifted off the plate and put back lighter
+    SCOOPED, // coffee was taken while the bag stayed on the plate
+    REFILL,  // weight went up
+};
+
+struct ConsumptionEvent
+{
+    Weight amount; // net weight removed, negative for refills
+    uint32_t timestampMs;
+    uint32_t durationMs; // from the start of the change until the weight settled again
+    WithdrawalKind kind;
+};
+
+// Detects withdrawals from the bag sample by sample. A two-sided CUSUM on the live weight
+// finds the start of a change, the stability detector's settled value closes it. Memory use is
+// constant, finished cycles go into a fixed size ring of ConsumptionEvents.
+class ConsumptionTracker
+{
+private:
+    enum State : uint8_t
+    {
+        WAITING_FOR_REFERENCE,
+        ON_SURFACE,
+        CHANGING,
+    };
+
+    State state = WAITING_FOR_REFERENCE;
+    Weight reference;
+    Weight positiveSum;
+    Weight negativeSum;
+
+    // Current change
+    Weight weightBefore;
+    uint32_t changeStartMs = 0;
+    bool lifted = false;
+    bool settling = false;
+
+    ConsumptionEvent log[CONSUMPTION_LOG_SIZE];
+    uint8_t logHead = 0;
+    uint8_t logCount = 0;
+    Weight totalConsumed;
+
+    void record(const ConsumptionEvent &event);
+
+public:
+    // Feed every conversion along with the stability detector state. `removedBelow` is the
+    // weight under which the bag counts as lifted off. Returns true when a cycle finished and was logged
+    bool update(Weight weight, bool stable, Weight stableValue, Weight removedBelow, uint32_t nowMs);
+    // Drop the current reference, e.g. after a tare or mode change
+    void reset();
+
+    bool hasLast() { return logCount > 0; }
+    const ConsumptionEvent &last() { return log[(logHead + CONSUMPTION_LOG_SIZE - 1) % CONSUMPTION_LOG_SIZE]; }
+    Weight getTotalConsumed() { return totalConsumed; }
+
+    void printLog();
+};
+
+const char *withdrawalKindName(WithdrawalKind kind);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef DIGIT_ATLAS_H
+#define DIGIT_ATLAS_H
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <vector>
+
+// Everything a weight is written with
+#define DIGIT_ATLAS_CHARS "0123456789.-g/ "
+
+// Glyphs of one GFX font rasterised once into the 4 bit layout of the readout sprites. Drawing a
+// glyph is a masked copy of its rows of bytes into the sprite, where the font would be unpacked
+// a bit at a time and every run of pixels clipped and drawn on its own.
+class DigitAtlas
+{
+private:
+    struct Glyph
+    {
+        int8_t xOffset;
+        int8_t yOffset;
+        uint8_t width;
+        uint8_t height;
+        // Bytes per row, two pixels each with the left one in the high nibble
+        uint8_t stride;
+        // 0xF where the glyph is set, 0 elsewhere
+        uint8_t *pixels;
+    };
+
+    const GFXfont *font = nullptr;
+    std::vector<Glyph> glyphs;
+    // Index into glyphs by character, -1 when it isn't in the atlas
+    int8_t lookup[128];
+
+    void blit(uint8_t *image, int16_t imageWidth, int16_t imageHeight, const Glyph &glyph, int16_t x, int16_t y, uint8_t color);
+
+public:
+    DigitAtlas() { memset(lookup, -1, sizeof(lookup)); }
+
+    bool begin(const GFXfont *font, const char *chars = DIGIT_ATLAS_CHARS);
+
+    // Every character of `text` is in the atlas
+    bool covers(const char *text);
+    // Same as textWidth() with the font
+    int16_t textWidth(const char *text);
+    // Like print() with the font and the cursor at `x`, `baseline` into a 4 bit sprite, text the
+    // atlas doesn't cover is printed. Returns the cursor's x after the text
+    int16_t draw(TFT_eSprite &canvas, const char *text, int16_t x, int16_t baseline, uint8_t color);
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef DISPLAY_PIPELINE_H
+#define DISPLAY_PIPELINE_H
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+
+// Pixels in each of the two transfer buffers, 8 lines of the panel, 5 KB
+#define DISPLAY_BUFFER_PIXELS (320 * 8)
+
+struct DisplayStats
+{
+    uint32_t batches = 0;
+    uint32_t transfers = 0;
+    uint64_t pixels = 0;
+    uint64_t micros = 0;
+    // Part of `micros` spent waiting for the panel instead of preparing pixels
+    uint64_t waitMicros = 0;
+};
+
+// Sends pixels to the panel with DMA. Two buffers take turns: while one is on its way to the
+// panel the CPU fills the other, so decoding, palette lookups and fills overlap the SPI transfer
+// instead of following it. Falls back to blocking pushes when DMA isn't available.
+//
+// Transfers happen between start() and end(), which hold the panel for one task at a time and
+// can be nested. Drawing anything with TFT_eSPI directly inside a batch needs a wait() first.
+class DisplayPipeline
+{
+private:
+    TFT_eSPI &tft;
+    uint16_t *buffers[2] = {nullptr, nullptr};
+    uint8_t current = 0;
+    bool dma = false;
+
+    SemaphoreHandle_t lock = nullptr;
+    uint8_t depth = 0;
+    bool swapBytes = false;
+    uint32_t batchStarted = 0;
+    DisplayStats stats;
+
+public:
+    DisplayPipeline(TFT_eSPI &tft) : tft(tft) {}
+
+    // After tft.init()
+    bool begin();
+    bool isReady() { return buffers[1] != nullptr; }
+    bool usesDMA() { return dma; }
+
+    void start();
+    void end();
+    // Until the panel has everything that was pushed
+    void wait();
+
+    // The buffer that isn't being sent, holds DISPLAY_BUFFER_PIXELS in the panel's byte order
+    uint16_t *buffer() { return buffers[current]; }
+    // Sends the first width * height pixels of buffer() and hands out the other one, clipped to
+    // the viewport
+    void push(int16_t x, int16_t y, uint16_t width, uint16_t height);
+
+    // Like tft.fillRect, a band at a time
+    void fillRect(int16_t x, int16_t y, int16_t width, int16_t height, uint16_t color);
+
+    const DisplayStats &getStats() { return stats; }
+    void resetStats() { stats = DisplayStats(); }
+    void printStats();
+};
+
+#endif
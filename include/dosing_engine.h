@@ -0,0 +1,91 @@
+#ifndef DOSING_ENGINE_H
+#define DOSING_ENGINE_H
+
+#include <Arduino.h>
+
+// Conversions used to fit the flow rate, 200ms at 80 SPS
+#define DOSE_FLOW_WINDOW 16
+// A dose starts once this much has arrived and is still flowing faster than DOSE_START_FLOW g/s
+#define DOSE_START_WEIGHT 0.2f
+#define DOSE_START_FLOW 0.3f
+// Time between stopping and the last grounds landing, learned per dose starting from the default
+#define DOSE_DEFAULT_LEAD_MS 300.0f
+#define DOSE_MAX_LEAD_MS 2000.0f
+#define DOSE_LEARNING_RATE 0.3f
+// How often the weighing task checks the prediction while a dose is running
+#define DOSE_POLL_INTERVAL_MS 10
+
+// Spare GPIO that goes active when the dose should stop, e.g. for a grinder relay. -1 to disable
+#ifndef DOSE_STOP_PIN
+#define DOSE_STOP_PIN -1
+#endif
+#define DOSE_STOP_ACTIVE_LEVEL HIGH
+
+// What the engine learned from past doses, persisted by the main task after every dose
+struct DoseLearning
+{
+    float leadMs = DOSE_DEFAULT_LEAD_MS;
+    uint32_t doses = 0;
+};
+
+enum class DoseState : uint8_t
+{
+    IDLE,
+    DOSING,
+    STOPPED, // stop was signalled, waiting for the weight to settle
+    SETTLED,
+};
+
+// Predicts when a dose reaches its target. A least squares fit over the latest conversions gives
+// the current weight without filter lag and the flow rate. The stop output fires as soon as the
+// weight extrapolated over the measured pipeline latency plus the learned lead time reaches the
+// target. After every dose the lead time is corrected by what still arrived after the stop.
+class DosingEngine
+{
+private:
+    float target = 0.0f;
+    DoseState state = DoseState::IDLE;
+
+    float weights[DOSE_FLOW_WINDOW];
+    uint32_t timestamps[DOSE_FLOW_WINDOW];
+    uint8_t head = 0;
+    uint8_t count = 0;
+
+    float fittedWeight = 0.0f;
+    float flowRate = 0.0f;
+    // from the conversion to the decision, includes the time it waited in the ring buffer
+    float latencyMs = 0.0f;
+    float leadMs = DOSE_DEFAULT_LEAD_MS;
+
+    float weightAtStop = 0.0f;
+    float flowAtStop = 0.0f;
+    float lastOvershoot = 0.0f;
+    uint32_t doses = 0;
+    bool stopActive = false;
+
+    void fit();
+    void setStop(bool active);
+
+public:
+    void begin();
+    // Pick up the lead time learned before the last restart
+    void restore(const DoseLearning &saved);
+    DoseLearning getLearning();
+
+    void setTarget(float grams);
+    // Forget the current dose and release the stop output
+    void reset();
+
+    // Feed every conversion (unfiltered grams) along with the stability detector state.
+    // Returns true when the state changed
+    bool update(float weight, uint32_t timestampUs, bool stable, float stableValue);
+
+    DoseState getState() { return state; }
+    bool shouldStop() { return stopActive; }
+    float getFlowRate() { return flowRate; }
+    float getLastOvershoot() { return lastOvershoot; }
+
+    void printStats();
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef FLEET_REPORTER_H
+#define FLEET_REPORTER_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include "scale.h"
+#include "load_cell_channel.h"
+
+#define FLEET_MAGIC 0x5354 // "TS"
+#define FLEET_VERSION 1
+#define FLEET_DEFAULT_PORT 4210
+// Reporting is on once wifi.secret.h defines FLEET_COLLECTOR_HOST, the port is optional
+#ifndef FLEET_COLLECTOR_PORT
+#define FLEET_COLLECTOR_PORT FLEET_DEFAULT_PORT
+#endif
+#define FLEET_WEIGHT_INTERVAL_MS 1000
+#define FLEET_HEALTH_INTERVAL_MS 10000
+// Every event datagram repeats this many of the previous events, so a single lost datagram loses none
+#define FLEET_EVENT_REDUNDANCY 3
+#define FLEET_EVENT_QUEUE_LENGTH 16
+#define FLEET_TASK_PRIORITY 1
+#define FLEET_MAX_DATAGRAM 128
+
+// Every datagram starts with this header, little endian. `boot` is random per boot so the
+// collector can tell a restart (sequence back at 0) from reordering. See tools/fleet_collector.py
+//   magic u16, version u8, type u8, device u32, boot u16, sequence u32, uptime ms u32
+#define FLEET_HEADER_SIZE 18
+
+enum class FleetDatagramType : uint8_t
+{
+    WEIGHT = 1, // channel count u8, per channel: channel u8, flags u16, weight mg i32, stable weight mg i32
+    EVENT = 2,  // event count u8, per event, oldest first: event sequence u32, type u8, channel u8, weight mg i32, timestampUs u32
+    HEALTH = 3, // free heap u32, rssi i8, then the HealthCounters of the plate as u32 in declaration order
+};
+
+// Reports the weight of every channel, the scale events and the health counters as UDP datagrams
+// to a collector, for keeping an eye on several scales at once. Runs as a low priority task that
+// sleeps on the event queue, datagrams that get lost are not sent again.
+class FleetReporter
+{
+private:
+    Scale &scale;
+    WiFiUDP udp;
+    const char *host = nullptr;
+    uint16_t port = FLEET_DEFAULT_PORT;
+
+    uint32_t device = 0;
+    uint16_t boot = 0;
+    uint32_t sequence = 0;
+
+    QueueHandle_t events = NULL;
+    TaskHandle_t taskHandle = NULL;
+
+    // The latest events, resent with every new one
+    ScaleEvent recentEvents[FLEET_EVENT_REDUNDANCY];
+    uint32_t eventSequence = 0;
+
+    unsigned long lastWeightTime = 0;
+    unsigned long lastHealthTime = 0;
+
+    uint8_t *header(uint8_t *out, FleetDatagramType type);
+    void send(const uint8_t *datagram, size_t length);
+    void sendWeights();
+    void sendEvent(const ScaleEvent &event);
+    void sendHealth();
+    static void reportTask(void *parameter);
+
+public:
+    FleetReporter(Scale &scale) : scale(scale) {}
+
+    // Start reporting to `host`, call after the scale was started and WiFi is up
+    void begin(const char *host, uint16_t port = FLEET_DEFAULT_PORT);
+    bool isRunning() { return taskHandle != NULL; }
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <Arduino.h>
+
+// One bucket per power of two, covers the whole uint32_t range
+#define HISTOGRAM_BUCKETS 33
+
+// Power of two histogram. Adding a value is a count leading zeros and two stores, cheap enough
+// for the data ready interrupt. Readers on another core may see a value that is being added,
+// which is fine for statistics.
+class Histogram
+{
+private:
+    // bucket 0 holds zeros, bucket i holds [2^(i-1), 2^i)
+    volatile uint32_t buckets[HISTOGRAM_BUCKETS] = {};
+    volatile uint32_t count = 0;
+    volatile uint32_t minValue = UINT32_MAX;
+    volatile uint32_t maxValue = 0;
+    volatile uint64_t sum = 0;
+
+public:
+    inline void IRAM_ATTR add(uint32_t value)
+    {
+        buckets[value == 0 ? 0 : 32 - __builtin_clz(value)]++;
+        count++;
+        sum += value;
+        if (value < minValue)
+            minValue = value;
+        if (value > maxValue)
+            maxValue = value;
+    }
+
+    void reset();
+
+    uint32_t getCount() { return count; }
+    uint32_t getMin() { return count ? minValue : 0; }
+    uint32_t getMax() { return maxValue; }
+    uint32_t getAverage() { return count ? sum / count : 0; }
+    // Upper bound of the bucket holding the p-th percentile (0-100)
+    uint32_t percentile(float p);
+
+    // Print the summary and every non-empty bucket, values are divided by `scale` first
+    void print(const char *name, const char *unit, float scale = 1.0f);
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef HX711_DRIVER_H
+#define HX711_DRIVER_H
+
+#include <Arduino.h>
+#include <soc/gpio_reg.h>
+#include "histogram.h"
+
+// Minimum SCK high and low time is 0.2us, leave some margin for slow GPIO edges
+#define HX711_CLOCK_HALF_PERIOD_NS 250
+// Output rate with RATE high, the most conversions a consumer has to keep up with
+#define HX711_MAX_SPS 80
+// Conversions to discard after changing the channel or gain, the filter needs 4 periods to settle
+#define HX711_SETTLE_CONVERSIONS 4
+// Wire the RATE pin to a GPIO to pick 80 SPS from firmware, -1 if it is hard wired on the board
+#ifndef HX711_RATE_PIN
+#define HX711_RATE_PIN -1
+#endif
+
+// Number of extra SCK pulses after the 24 data bits selects input and gain of the next conversion
+enum Hx711Gain : uint8_t
+{
+    HX711_CHANNEL_A_128 = 1,
+    HX711_CHANNEL_B_32 = 2,
+    HX711_CHANNEL_A_64 = 3,
+};
+
+// Bit-banged HX711 interface. Pins are driven through the GPIO set/clear registers from IRAM,
+// which brings a full read down to ~15us, so it can run straight from the data ready interrupt
+// at 80 SPS without holding off Wi-Fi or the display. Every read is timed in CPU cycles.
+class Hx711Driver
+{
+private:
+    const int PIN_DT;
+    const int PIN_SCK;
+
+    // Register addresses and masks are resolved once so the read loop is just loads and stores
+    volatile uint32_t *sckSet = nullptr;
+    volatile uint32_t *sckClear = nullptr;
+    volatile uint32_t *dtIn = nullptr;
+    uint32_t sckMask = 0;
+    uint32_t dtMask = 0;
+    uint32_t halfPeriodCycles = 0;
+
+    volatile Hx711Gain gain = HX711_CHANNEL_A_128;
+
+    // Cycle counts of the reads
+    volatile uint32_t lastReadCycles = 0;
+    volatile uint32_t maxReadCycles = 0;
+    volatile uint64_t totalReadCycles = 0;
+    volatile uint32_t reads = 0;
+    Histogram readCycles;
+
+    portMUX_TYPE clockMux = portMUX_INITIALIZER_UNLOCKED;
+
+    inline void IRAM_ATTR waitCycles(uint32_t start, uint32_t cycles);
+
+public:
+    Hx711Driver(int dt_pin, int sck_pin);
+
+    void begin(bool highRate = true);
+
+    int getDataPin() { return PIN_DT; }
+
+    // DOUT is pulled low by the chip once a conversion is ready
+    bool IRAM_ATTR isReady() { return (*dtIn & dtMask) == 0; }
+
+    // Clock out one conversion as a sign extended 24-bit value. Only call when isReady()
+    int32_t IRAM_ATTR read();
+
+    // Takes effect for the conversion after the next read
+    void setGain(Hx711Gain newGain) { gain = newGain; }
+    Hx711Gain getGain() { return gain; }
+
+    // Holding SCK high for more than 60us powers the chip down
+    void powerDown();
+    void powerUp();
+
+    uint32_t getLastReadCycles() { return lastReadCycles; }
+    uint32_t getMaxReadCycles() { return maxReadCycles; }
+    uint32_t getAverageReadCycles() { return reads ? totalReadCycles / reads : 0; }
+    Histogram &getReadHistogram() { return readCycles; }
+    void resetStats();
+};
+
+#endif
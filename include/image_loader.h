@@ -6,6 +6,7 @@
 #include <PNGdec.h>
 #include <LittleFS.h>
 #include <FS.h>
+#include "display_pipeline.h"
 
 // Maximum image width constant
 #define MAX_IMAGE_WIDTH 320 // Adjust based on your display's maximum width
@@ -20,6 +21,9 @@ public:
 
     // Draw a PNG image from LittleFS at the specified coordinates
     bool drawPNG(const char *filename, int16_t x, int16_t y);
+    // Same, blended onto `background` instead of masked, and sent through the pipeline a band of
+    // lines at a time while the next lines are decoded
+    bool drawPNG(const char *filename, int16_t x, int16_t y, DisplayPipeline &pipeline, uint16_t background);
 
     // Get image dimensions without drawing
     bool getImageInfo(const char *filename, uint16_t &width, uint16_t &height);
@@ -40,6 +44,14 @@ private:
     // Draw coordinates for the image
     int16_t xPos, yPos;
 
+    // Set while drawing through a pipeline, lines collect in its buffer until it's full
+    DisplayPipeline *pipeline = nullptr;
+    uint32_t background = 0;
+    int16_t bandY = 0;
+    uint16_t bandLines = 0;
+    uint16_t bandWidth = 0;
+    void pushBand();
+
     // Helper method to check if required image files exist
     bool checkImageFiles();
 
@@ -0,0 +1,101 @@
+#ifndef LOAD_CELL_CHANNEL_H
+#define LOAD_CELL_CHANNEL_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "sample_acquisition.h"
+#include "bag_pipeline.h"
+#include "bag_tracker.h"
+#include "seqlock.h"
+#include "weight_sample.h"
+#include "scale_event.h"
+
+// The plate is channel 0, shelf positions are numbered from 1
+#define SCALE_MAX_CHANNELS 8
+
+enum CaptureState : uint8_t
+{
+    CAPTURE_IDLE,
+    CAPTURE_RUNNING,
+    CAPTURE_DONE,
+    CAPTURE_FAILED,
+};
+
+typedef void (*ChannelEventHandler)(void *arg, const ScaleEvent &event);
+
+// One bag position on the shelf: its own HX711, bag tracking pipeline, calibration and reorder
+// thresholds. Conversions arrive through the channel's data ready interrupt and are processed
+// by the weighing task through the AcquisitionScheduler. The plate keeps its own, richer
+// pipeline in Scale (barista mode, calibration session, replay).
+class LoadCellChannel
+{
+private:
+    const uint8_t index;
+    SampleAcquisition acquisition;
+
+    // Owned by the weighing task
+    BagPipeline pipeline;
+    BagTracker tracker;
+    uint32_t lastSampleUs = 0;
+
+    // Averaging for a tare (captureGrams == 0) or a calibration with a known mass
+    float captureGrams = 0.0f;
+    int captureRemaining = 0;
+    int64_t captureSum = 0;
+    int captureCount = 0;
+    unsigned long captureStartTime = 0;
+    std::atomic<uint8_t> captureState{CAPTURE_IDLE};
+
+    ChannelEventHandler eventHandler = nullptr;
+    void *eventArg = nullptr;
+
+    SeqLock<WeightSample> published;
+    uint32_t publishedSequence = 0;
+
+    // Milligrams, written by the main task and read by the weighing task
+    std::atomic<int32_t> reorderThreshold;
+    std::atomic<int32_t> promptThreshold;
+
+    Weight bagWeight();
+    void updateCapture(int32_t counts);
+    void updateBagState();
+    static void handleBagEvent(void *arg, ScaleEventType type, Weight weight);
+
+public:
+    LoadCellChannel(uint8_t index, int dt_pin, int sck_pin);
+
+    // Written by the main task, read by the weighing task
+    volatile bool hasBag = false;
+    // Only used on the main task
+    String bagName;
+
+    void begin(ChannelEventHandler handler, void *arg);
+    void setCalibration(long zeroOffset, float countsPerGram);
+    void setThresholds(Weight reorder, Weight prompt);
+    Weight getReorderThreshold() { return Weight::milligrams(reorderThreshold.load(std::memory_order_relaxed)); }
+    Weight getPromptThreshold() { return Weight::milligrams(promptThreshold.load(std::memory_order_relaxed)); }
+
+    // Weighing task: run the next buffered conversion through the filters, false if none was waiting
+    bool processNext();
+    // Weighing task: act on the conversions processed since the last call and publish the result
+    void update();
+    // Weighing task: average the next conversions into a new zero offset, or with `grams` on the
+    // plate into a new calibration factor
+    void startCapture(float grams);
+
+    uint8_t getCaptureState() { return captureState.load(std::memory_order_acquire); }
+    // Main task, before requesting a capture, so a previous result isn't mistaken for the new one
+    void clearCaptureState() { captureState.store(CAPTURE_IDLE, std::memory_order_release); }
+    // Only valid once the capture state is CAPTURE_DONE
+    long getOffset() { return pipeline.getOffset(); }
+    float getFactor() { return pipeline.getCurve().getFactor(); }
+    // The curve reports a factor of 1 without any points, check this first
+    bool isCalibrated() { return pipeline.getCurve().size() > 0; }
+
+    uint8_t getIndex() { return index; }
+    int32_t getFilteredCounts() { return pipeline.getFilteredCounts(); }
+    SampleAcquisition &getAcquisition() { return acquisition; }
+    WeightSample getSample() { return published.read(); }
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include <TFT_eSPI.h>
 
 #include "image_loader.h"
+#include "widget.h"
 #include "ui.h"
 #include "led.h"
 
@@ -27,6 +28,7 @@ enum MenuType
     STORE,
     STORE_ORDERS,
     STORE_BROWSE, // these choosing menus should really be the same thing
+    CALIBRATION,
 };
 
 enum MenuButton
@@ -52,13 +54,14 @@ private:
     ImageLoader &imageLoader;
     LedStrip &ledStrip;
 
-    bool tainted = false;
-
     MenuItem menuItems[3] = {
         {true, "TL", "/up.png", 0xBDD8},
         {true, "TM", "/dot.png", 0xBDD8},
         {true, "TR", "/down.png", 0xBDD8},
     };
+    // What the menu items look like on screen, updated from menuItems
+    ListItemWidget items[3];
+    void updateItems();
 
     void handlePressConfiguration(int buttonPin);
     void handlePressMainMenu(int buttonPin);
@@ -69,6 +72,7 @@ private:
     void handlePressStoreOrders(int buttonPin);
     void handlePressStoreBrowse(int buttonPin);
     void handlePressBarista(int buttonPin); // handle barista mode presses
+    void handlePressCalibration(int buttonPin);
 
 public:
     static const uint16_t menuClearance = 80;
@@ -84,13 +88,21 @@ public:
     void hideButton(MenuButton button) { menuItems[button].visible = false; };
     bool isButtonVisible(MenuButton button) { return menuItems[button].visible; };
 
+    // Paints the items that changed
     void draw();
+    // Something drew over the menu, paint all of it again
     void redraw()
     {
-        tainted = true;
+        taint();
         draw();
     };
-    void taint() { tainted = true; }
+    void taint()
+    {
+        for (auto &item : items)
+        {
+            item.invalidate();
+        }
+    }
     void selectMenu(MenuType menuType, bool shouldDraw = true);
 
     void IRAM_ATTR handlePress(int buttonPin);
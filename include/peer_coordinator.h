@@ -0,0 +1,59 @@
+#ifndef PEER_COORDINATOR_H
+#define PEER_COORDINATOR_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include <vector>
+#include "peer_node.h"
+#include "terminal_api.h"
+
+#define PEER_GROUP IPAddress(239, 255, 84, 83)
+#define PEER_PORT 4211
+#define PEER_POLL_INTERVAL_MS 20
+#define PEER_TASK_PRIORITY 1
+// A shared catalog older than this is fetched from the API again
+#define PEER_CATALOG_MAX_AGE_S 3600
+
+class PeerUdpTransport : public PeerTransport
+{
+private:
+    WiFiUDP &udp;
+
+public:
+    PeerUdpTransport(WiFiUDP &udp) : udp(udp) {}
+    void send(const uint8_t *data, size_t length) override;
+};
+
+// Coordinates the scales on the LAN over UDP multicast, see PeerNode. Scales share the product
+// catalog so only one of them fetches it, and hold a lease on a variant while ordering it so two
+// scales tracking the same bag don't both order. Enabled with PEER_COORDINATION in wifi.secret.h.
+// The node runs on its own task, the methods below are safe to call from the main task.
+class PeerCoordinator
+{
+private:
+    WiFiUDP udp;
+    PeerUdpTransport transport{udp};
+    PeerNode *node = nullptr;
+    SemaphoreHandle_t lock = NULL;
+    TaskHandle_t taskHandle = NULL;
+
+    static void peerTask(void *parameter);
+
+public:
+    // Join the group, call once WiFi is up
+    void begin();
+    bool isRunning() { return taskHandle != NULL; }
+
+    // A catalog another scale fetched within PEER_CATALOG_MAX_AGE_S, false if there is none
+    bool getCatalog(std::vector<Product> &products);
+    void shareCatalog(const std::vector<Product> &products);
+
+    // Blocks until the leader answers, at most PEER_DISCOVERY_MS + PEER_LEASE_TIMEOUT_MS.
+    // Only order on GRANTED, `holder` is the scale that holds or placed the order otherwise
+    LeaseStatus acquireOrderLease(const String &variantId, uint32_t &holder);
+    void releaseOrderLease(const String &variantId, bool ordered);
+
+    void printStatus();
+};
+
+#endif
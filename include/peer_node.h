@@ -0,0 +1,157 @@
+#ifndef PEER_NODE_H
+#define PEER_NODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Plain C++ so the protocol also runs on a host, see tools/peer_host.cpp
+
+#define PEER_MAGIC 0x5054 // "TP"
+#define PEER_VERSION 1
+#define PEER_HEARTBEAT_INTERVAL_MS 1000
+// A peer whose heartbeats stopped this long ago is gone
+#define PEER_TIMEOUT_MS 3500
+// A node only decides on leases once it had the time to hear every peer's heartbeat
+#define PEER_DISCOVERY_MS 2500
+// Long enough for clearing the cart, adding the bag and placing the order
+#define PEER_LEASE_TTL_MS 60000
+#define PEER_LEASE_RETRY_MS 300
+// Without an answer from the leader a scale orders anyway, a missing bag is worse than two
+#define PEER_LEASE_TIMEOUT_MS 1500
+// Other scales don't order a variant again this long after one of them did
+#define PEER_ORDER_COOLDOWN_MS (12UL * 60 * 60 * 1000)
+#define PEER_CATALOG_CHUNK 1024
+#define PEER_MAX_CATALOG (32 * PEER_CATALOG_CHUNK)
+#define PEER_CATALOG_RETRY_MS 2000
+#define PEER_CATALOG_RESEND_MS 1000
+#define PEER_MAX_DATAGRAM (PEER_CATALOG_CHUNK + 32)
+#define PEER_MAX_VARIANT 64
+
+// Every message is [magic u16][version u8][type u8][sender u32] and the fields below, little endian.
+// Strings are a u8 length and the bytes
+enum class PeerMessageType : uint8_t
+{
+    HEARTBEAT = 1,       // leader u32, catalog version u32, catalog size u32
+    CATALOG_REQUEST = 2, // catalog version u32
+    CATALOG_CHUNK = 3,   // catalog version u32, catalog size u32, offset u32, length u16, bytes
+    LEASE_REQUEST = 4,   // request u32, variant
+    LEASE_GRANT = 5,     // request u32, holder u32, remaining ms u32, variant
+    LEASE_DENY = 6,      // request u32, requester u32, holder u32, status u8, remaining ms u32, variant
+    LEASE_RELEASE = 7,   // ordered u8, variant
+};
+
+enum class LeaseStatus : uint8_t
+{
+    NONE,
+    PENDING,
+    GRANTED,
+    DENIED_HELD,    // another scale is ordering this variant right now
+    DENIED_ORDERED, // another scale ordered this variant recently
+};
+
+const char *leaseStatusName(LeaseStatus status);
+
+class PeerTransport
+{
+public:
+    virtual ~PeerTransport() {}
+    // Send to every node in the group, without waiting
+    virtual void send(const uint8_t *data, size_t length) = 0;
+};
+
+// One scale in the peer group. The live node with the lowest id is the leader, it decides on
+// order leases. Every node keeps the lease table from the multicast grants and releases, so a
+// new leader continues where the old one stopped. The product catalog is shared by whoever
+// fetched it last. Not thread safe, all calls carry the current time in milliseconds.
+class PeerNode
+{
+private:
+    struct Peer
+    {
+        uint32_t lastSeen = 0;
+        uint32_t catalogVersion = 0;
+    };
+
+    struct Lease
+    {
+        bool held = false;
+        uint32_t holder = 0;
+        uint32_t expires = 0;
+        bool ordered = false;
+        uint32_t orderedBy = 0;
+        uint32_t orderedUntil = 0;
+    };
+
+    struct OwnRequest
+    {
+        uint32_t request = 0;
+        uint32_t started = 0;
+        uint32_t lastSent = 0;
+        bool sent = false;
+        LeaseStatus status = LeaseStatus::NONE;
+        uint32_t holder = 0;
+    };
+
+    const uint32_t id;
+    PeerTransport &transport;
+    uint32_t startTime = 0;
+    uint32_t lastHeartbeat = 0;
+    bool heartbeatDue = true;
+
+    std::map<uint32_t, Peer> peers;
+    std::map<std::string, Lease> leases;
+    std::map<std::string, OwnRequest> requests;
+    uint32_t nextRequest = 1;
+
+    std::string catalog;
+    uint32_t catalogVersion = 0;
+    uint32_t lastCatalogSent = 0;
+    // Catalog being received in chunks
+    std::string pendingCatalog;
+    uint32_t pendingVersion = 0;
+    uint64_t pendingChunks = 0;
+    uint32_t pendingRequested = 0;
+
+    void log(const char *format, ...);
+    uint8_t *header(uint8_t *out, PeerMessageType type);
+    void sendHeartbeat(uint32_t now);
+    void sendCatalog(uint32_t now);
+    void requestCatalog(uint32_t version, uint32_t now);
+    void sendLeaseRequest(const std::string &variant, OwnRequest &request, uint32_t now);
+    void decideLease(const std::string &variant, uint32_t requester, uint32_t request, uint32_t now);
+    void applyGrant(const std::string &variant, uint32_t holder, uint32_t request, uint32_t remaining, uint32_t now);
+    bool isDiscovering(uint32_t now) { return now - startTime < PEER_DISCOVERY_MS; }
+
+public:
+    PeerNode(uint32_t id, PeerTransport &transport) : id(id), transport(transport) {}
+
+    void (*logger)(const char *message) = nullptr;
+
+    void start(uint32_t now);
+    // Heartbeats and retries, call at least every PEER_LEASE_RETRY_MS
+    void poll(uint32_t now);
+    void receive(const uint8_t *data, size_t length, uint32_t now);
+
+    uint32_t getId() { return id; }
+    uint32_t getLeader(uint32_t now);
+    bool isLeader(uint32_t now) { return getLeader(now) == id; }
+    size_t livePeers(uint32_t now);
+
+    // Share a catalog fetched from the API. `version` is its unix fetch time, the newest one wins
+    void setCatalog(const std::string &catalog, uint32_t version, uint32_t now);
+    const std::string &getCatalog() { return catalog; }
+    uint32_t getCatalogVersion() { return catalogVersion; }
+
+    // Ask for the right to order `variant`, then poll leaseStatus until it is no longer PENDING
+    void requestLease(const std::string &variant, uint32_t now);
+    LeaseStatus leaseStatus(const std::string &variant, uint32_t &holder);
+    // After ordering, or giving up. An order keeps the other scales from ordering the variant again
+    void releaseLease(const std::string &variant, bool ordered, uint32_t now);
+
+    void printStatus(uint32_t now);
+};
+
+#endif
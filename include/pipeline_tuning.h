@@ -0,0 +1,35 @@
+#ifndef PIPELINE_TUNING_H
+#define PIPELINE_TUNING_H
+
+// Tuning of the filters, the settle detector and the bag thresholds, shared by the scale and the
+// host tools
+
+#define TERMINAL_COFFEE_BAG_EMPTY_WEIGHT 15.2f
+#define TERMINAL_COFFEE_WEIGHT 340.0f // 12oz
+#define TERMINAL_COFFEE_BAG_WEIGHT TERMINAL_COFFEE_WEIGHT + TERMINAL_COFFEE_BAG_EMPTY_WEIGHT
+// Plate thresholds until the consumption forecast is confident, see ConsumptionForecast
+#define REORDER_BUTTON_THRESHOLD 150.0f
+#define REORDER_BUTTON_PROMPT_THRESHOLD 80.0f
+
+// Filter tuning per mode, noise values are variances in HX711 counts^2
+#define FILTER_MEASUREMENT_NOISE 10000
+#define BAG_FILTER_MEDIAN_WINDOW 5
+#define BAG_FILTER_PROCESS_NOISE 25
+// 5 wide so two glitches close together can't reach the dosing engine, at 12.5ms more lag than 3
+#define BARISTA_FILTER_MEDIAN_WINDOW 5
+#define BARISTA_FILTER_EMA_ALPHA 0.5f
+
+// A reading is stable once the last STABILITY_WINDOW_SIZE conversions spread less than
+// STABLE_ENTER_STDDEV grams and drift less than STABLE_ENTER_DRIFT grams. It only becomes
+// unstable again once the larger EXIT thresholds are crossed
+#define STABLE_ENTER_STDDEV 0.08f
+#define STABLE_EXIT_STDDEV 0.2f
+#define STABLE_ENTER_DRIFT 0.15f
+#define STABLE_EXIT_DRIFT 0.4f
+
+// A threshold crossed downwards is only crossed back once the weight is this much above it again
+#define REORDER_THRESHOLD_HYSTERESIS 5.0f
+// The bag counts as removed below -BAG_PRESENCE_HYSTERESIS and as returned again at 0g
+#define BAG_PRESENCE_HYSTERESIS 2.0f
+
+#endif
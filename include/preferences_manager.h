@@ -3,6 +3,9 @@
 
 #include <Arduino.h>
 #include <Preferences.h> // Using angle brackets for Arduino ESP32 library
+#include "calibration_curve.h"
+#include "consumption_forecast.h"
+#include "dosing_engine.h"
 
 class PreferencesManager
 {
@@ -18,6 +21,9 @@ public:
     void setScaleCalibrationFactor(float calibrationFactor);
     void setScaleZeroOffset(long zeroOffset);
     void deleteCalibrationData();
+    void setCalibrationPoints(const CalibrationPoint *points, uint8_t count);
+    // Returns the number of stored points, 0 if the scale was calibrated with a single factor
+    uint8_t getCalibrationPoints(CalibrationPoint *points, uint8_t maxCount);
 
     bool isConfigured();
     bool shouldReorderAutomatically();
@@ -34,6 +40,27 @@ public:
 
     String getCoffeeBagName();
     void setCoffeeBagName(const String &name);
+
+    // Shelf channels, numbered from 1. The plate uses the keys above
+    bool getChannelCalibration(uint8_t channel, long &zeroOffset, float &factor);
+    void setChannelCalibration(uint8_t channel, long zeroOffset, float factor);
+    // Empty if the channel has no bag
+    String getChannelBagName(uint8_t channel);
+    void setChannelBagName(uint8_t channel, const String &name);
+    // Leaves the arguments untouched if the channel uses the default thresholds
+    void getChannelThresholds(uint8_t channel, float &reorder, float &prompt);
+    void setChannelThresholds(uint8_t channel, float reorder, float prompt);
+
+    // Leaves `state` untouched if nothing was saved yet
+    void getForecastState(ForecastState &state);
+    void setForecastState(const ForecastState &state);
+    // Shipping lead time of the last cart, 0 if none was seen yet
+    float getLeadDays();
+    void setLeadDays(float days);
+
+    // False if no dose was learned from yet
+    bool getDoseLearning(DoseLearning &learning);
+    void setDoseLearning(const DoseLearning &learning);
 };
 
 #endif
\ No newline at end of file
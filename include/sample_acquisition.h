@@ -0,0 +1,70 @@
+#ifndef SAMPLE_ACQUISITION_H
+#define SAMPLE_ACQUISITION_H
+
+#include <Arduino.h>
+#include "sample_ring_buffer.h"
+#include "sample_source.h"
+#include "hx711_driver.h"
+
+// 6.4s of conversions at 80 SPS (4KB per channel)
+#define SAMPLE_BUFFER_SIZE 512
+// Longest the consumer may leave the buffer alone, the weighing task never sleeps longer
+#define SAMPLE_MAX_DRAIN_INTERVAL_MS 4000
+// The weighing task clamps every sleep to SAMPLE_MAX_DRAIN_INTERVAL_MS, plus the conversion in flight when it wakes
+static_assert(SAMPLE_MAX_DRAIN_INTERVAL_MS * HX711_MAX_SPS / 1000 + 1 < SAMPLE_BUFFER_SIZE,
+              "conversions would be dropped during the longest sleep of the weighing task");
+
+// Interrupt-driven HX711 acquisition. The falling edge on DOUT signals that a conversion
+// is ready; the ISR clocks it out and pushes it into a ring buffer that the weighing task drains.
+class SampleAcquisition : public SampleSource
+{
+private:
+    Hx711Driver hx711;
+
+    SampleRingBuffer<RawSample, SAMPLE_BUFFER_SIZE> samples;
+    volatile uint32_t totalSamples = 0;
+    volatile bool running = false;
+    volatile uint8_t settleRemaining = 0;
+    volatile uint32_t discardedSamples = 0;
+    // Data ready edges without a conversion, DOUT glitches or edges from our own clocking
+    volatile uint32_t notReadyEdges = 0;
+
+    // Task to wake as soon as a conversion leaves the band around wakeReference
+    TaskHandle_t wakeTask = NULL;
+    volatile int32_t wakeReference = 0;
+    volatile int32_t wakeBand = 0;
+
+    portMUX_TYPE readMux = portMUX_INITIALIZER_UNLOCKED;
+
+    bool IRAM_ATTR readSample(RawSample &sample);
+    static void IRAM_ATTR handleDataReady(void *arg);
+
+public:
+    SampleAcquisition(int dt_pin, int sck_pin);
+
+    // Configure pins and start listening for data ready edges
+    void begin();
+    void stop();
+    bool isRunning() override { return running; }
+    const char *name() override { return "hx711"; }
+
+    // Switch input and gain. Conversions are discarded until the chip has settled on the new setting
+    void setGain(Hx711Gain gain);
+    Hx711Driver &driver() { return hx711; }
+
+    // Consumer side, only one task may drain the buffer at a time
+    bool read(RawSample &sample) override { return samples.pop(sample); }
+    void clear() override { samples.clear(); }
+    size_t available() { return samples.size(); }
+
+    // Notify `task` from the ISR when a conversion differs from `reference` by more than `band` counts.
+    // Lets the consumer sleep for long periods without missing the start of a change. Pass NULL to disable
+    void wakeOnChange(TaskHandle_t task, int32_t reference, int32_t band);
+
+    uint32_t total() { return totalSamples; }
+    uint32_t dropped() { return samples.dropped(); }
+    uint32_t discarded() { return discardedSamples; }
+    uint32_t notReady() { return notReadyEdges; }
+};
+
+#endif
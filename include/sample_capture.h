@@ -0,0 +1,70 @@
+#ifndef SAMPLE_CAPTURE_H
+#define SAMPLE_CAPTURE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "sample_source.h"
+#include "capture_format.h"
+
+#define CAPTURE_FILE "/capture.bin"
+// Records are collected in RAM and written in blocks to keep flash writes out of the per-sample path
+#define CAPTURE_BLOCK_SAMPLES 64
+
+// Records raw conversions into a fixed size ring file on LittleFS so field behaviour can be
+// dumped and replayed later. Only the weighing task may append, start and stop.
+class SampleCapture
+{
+private:
+    File file;
+    CaptureHeader header;
+    bool capturing = false;
+
+    uint8_t block[CAPTURE_BLOCK_SAMPLES * CAPTURE_RECORD_SIZE];
+    uint16_t blockCount = 0;
+
+    void flush();
+    void writeHeader();
+
+public:
+    // Resume the existing capture, or start over with `reset`
+    bool start(bool reset = false);
+    void stop();
+    void append(const RawSample &sample);
+
+    bool isCapturing() { return capturing; }
+
+    // Print the capture as `counts,timestampUs` lines, oldest first. Only while not capturing
+    void dump(Print &out);
+};
+
+// Plays a capture file back through the weighing pipeline. Timestamps are replayed `speed` times
+// faster than they were recorded (0 delivers everything at once) and restamped to the current time.
+class CaptureReplay : public SampleSource
+{
+private:
+    File file;
+    CaptureHeader header;
+    uint32_t index = 0;
+    float speed = 1.0f;
+
+    bool hasPending = false;
+    RawSample pending;
+    uint32_t firstTimestampUs = 0;
+    uint32_t startUs = 0;
+
+    bool readNext(RawSample &sample);
+
+public:
+    bool begin(const char *path, float speed);
+    void end();
+
+    const char *name() override { return "replay"; }
+    bool read(RawSample &sample) override;
+    void clear() override {}
+    bool isRunning() override { return (bool)file; }
+
+    uint32_t getPosition() { return index; }
+    uint32_t getLength() { return header.count; }
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef SAMPLE_FILTER_H
+#define SAMPLE_FILTER_H
+
+#include <stdint.h>
+
+#define MEDIAN_FILTER_MAX_WINDOW 9
+#define FILTER_CHAIN_MAX_STAGES 4
+// Innovations larger than this many standard deviations are treated as a real load change
+#define KALMAN_STEP_SIGMA 4
+
+// A single stage of the per-sample filter chain. Stages work on raw HX711 counts in integer
+// or fixed-point math only, so nothing in the sampling path needs the FPU.
+class SampleFilter
+{
+private:
+    uint64_t totalCycles = 0;
+    uint32_t totalSamples = 0;
+
+    friend class FilterChain;
+
+public:
+    virtual ~SampleFilter() {}
+
+    virtual const char *name() const = 0;
+    virtual int32_t process(int32_t counts) = 0;
+    // Forget all history and continue as if every previous sample had been `counts`
+    virtual void reset(int32_t counts) = 0;
+
+    uint32_t samples() const { return totalSamples; }
+    uint32_t cyclesPerSample() const { return totalSamples ? totalCycles / totalSamples : 0; }
+    void resetStats()
+    {
+        totalCycles = 0;
+        totalSamples = 0;
+    }
+};
+
+// Median of the last N samples, rejects single spikes (e.g. a cup being set down)
+class MedianFilter : public SampleFilter
+{
+private:
+    const uint8_t windowSize;
+    int32_t history[MEDIAN_FILTER_MAX_WINDOW];
+    uint8_t head = 0;
+
+public:
+    MedianFilter(uint8_t windowSize);
+
+    const char *name() const override { return "median"; }
+    int32_t process(int32_t counts) override;
+    void reset(int32_t counts) override;
+};
+
+// Exponential moving average, alpha is stored as Q16 and the state as Q8 counts
+class EmaFilter : public SampleFilter
+{
+private:
+    const uint32_t alphaQ16;
+    int64_t stateQ8 = 0;
+
+public:
+    EmaFilter(float alpha);
+
+    const char *name() const override { return "ema"; }
+    int32_t process(int32_t counts) override;
+    void reset(int32_t counts) override;
+};
+
+// 1-D Kalman filter for a constant weight. processNoise and measurementNoise are variances in counts^2,
+// a larger process noise follows changes faster at the cost of letting more noise through.
+class KalmanFilter : public SampleFilter
+{
+private:
+    const int64_t processNoise;
+    const int64_t measurementNoise;
+    int64_t estimateQ8 = 0;
+    int64_t errorCovariance;
+
+public:
+    KalmanFilter(uint32_t processNoise, uint32_t measurementNoise);
+
+    const char *name() const override { return "kalman"; }
+    int32_t process(int32_t counts) override;
+    void reset(int32_t counts) override;
+};
+
+// Runs samples through a fixed list of stages and measures the cost of each one, in CPU cycles
+// on the ESP32 and nanoseconds on a host
+class FilterChain
+{
+private:
+    SampleFilter *stages[FILTER_CHAIN_MAX_STAGES];
+    uint8_t stageCount = 0;
+
+public:
+    FilterChain &add(SampleFilter *stage);
+
+    int32_t process(int32_t counts);
+    void reset(int32_t counts);
+
+    uint8_t size() const { return stageCount; }
+    SampleFilter *stage(uint8_t index) const { return stages[index]; }
+
+#ifdef ARDUINO
+    void printStats(const char *label);
+#endif
+    void resetStats();
+};
+
+#endif
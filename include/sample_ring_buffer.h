@@ -0,0 +1,79 @@
+#ifndef SAMPLE_RING_BUFFER_H
+#define SAMPLE_RING_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#define IRAM_ATTR
+#endif
+
+// A single conversion clocked out of the HX711, stamped when DOUT signalled data ready
+struct RawSample
+{
+    int32_t counts;
+    uint32_t timestampUs;
+};
+
+// Lock-free single-producer/single-consumer ring buffer.
+// The producer (DRDY interrupt) only writes head, the consumer (weighing task) only writes tail,
+// so neither side ever has to block or disable interrupts.
+template <typename T, size_t N>
+class SampleRingBuffer
+{
+    static_assert((N & (N - 1)) == 0, "SampleRingBuffer size must be a power of two");
+
+private:
+    T items[N];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    std::atomic<uint32_t> droppedCount{0};
+
+public:
+    // Producer side. Returns false (and counts a drop) if the consumer has fallen N samples behind
+    bool IRAM_ATTR push(const T &item)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N)
+        {
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        items[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T &item)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = items[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: throw away everything that is currently buffered
+    void clear()
+    {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return N; }
+    uint32_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef SAMPLE_SOURCE_H
+#define SAMPLE_SOURCE_H
+
+#include "sample_ring_buffer.h"
+
+// Where the weighing task takes its conversions from. Normally the HX711, but a recorded
+// capture or a synthetic signal can stand in for it to exercise the same filters and thresholds.
+class SampleSource
+{
+public:
+    virtual ~SampleSource() {}
+
+    virtual const char *name() = 0;
+    // Next conversion that is due, false if there is none yet
+    virtual bool read(RawSample &sample) = 0;
+    // Drop everything that is already due
+    virtual void clear() = 0;
+    // False once the source has nothing more to deliver
+    virtual bool isRunning() = 0;
+};
+
+#endif
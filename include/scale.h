@@ -2,30 +2,112 @@
 #define SCALE_H
 
 #include <Arduino.h>
-#include <HX711.h>
 #include <TFT_eSPI.h>
+#include <atomic>
 
 class UI;
 #include "preferences_manager.h"
 #include "terminal_api.h"
 #include "led.h"
-
-#define TERMINAL_COFFEE_BAG_EMPTY_WEIGHT 15.2f
-#define TERMINAL_COFFEE_WEIGHT 340.0f // 12oz
-#define TERMINAL_COFFEE_BAG_WEIGHT TERMINAL_COFFEE_WEIGHT + TERMINAL_COFFEE_BAG_EMPTY_WEIGHT
-#define REORDER_BUTTON_THRESHOLD 150.0f
-#define REORDER_BUTTON_PROMPT_THRESHOLD 80.0f
+#include "sample_acquisition.h"
+#include "sample_filter.h"
+#include "adaptive_sampler.h"
+#include "stability_detector.h"
+#include "pipeline_tuning.h"
+#include "bag_tracker.h"
+#include "seqlock.h"
+#include "weight_sample.h"
+#include "scale_event.h"
+#include "consumption_tracker.h"
+#include "consumption_forecast.h"
+#include "calibration_curve.h"
+#include "sample_capture.h"
+#include "synthetic_source.h"
+#include "dosing_engine.h"
+#include "sensor_health.h"
+#include "acquisition_scheduler.h"
+#include "telemetry.h"
+#include "weight_history.h"
 
 #define SINGLE_DOSE_WEIGHT 8.0f
 #define DOUBLE_DOSE_WEIGHT 16.0f
 
+// Bounds for the time between readings. Sampling speeds up as soon as the weight changes by more
+// than SAMPLING_MOTION_THRESHOLD grams and backs off exponentially while it is stable
+#define BAG_SAMPLING_MIN_INTERVAL_MS 100
+#define BAG_SAMPLING_MAX_INTERVAL_MS 4000
+static_assert(BAG_SAMPLING_MAX_INTERVAL_MS <= SAMPLE_MAX_DRAIN_INTERVAL_MS, "the drain limit would cut the back-off short");
+#define BARISTA_SAMPLING_MIN_INTERVAL_MS 50
+#define BARISTA_SAMPLING_MAX_INTERVAL_MS 200
+#define SAMPLING_MOTION_THRESHOLD 0.3f
+
+// Readings are considered invalid if the HX711 has not delivered a conversion for this long
+#define SAMPLE_STALE_TIMEOUT_US 1000000
+
+// Conversions averaged for a tare, a bag being loaded and each calibration point. Calibration
+// points are only collected while the reading is stable
+#define TARE_CAPTURE_SAMPLES 10
+#define LOAD_BAG_CAPTURE_SAMPLES 10
+#define CALIBRATION_CAPTURE_SAMPLES 40
+#define CAPTURE_TIMEOUT_MS 5000
+// How long the calibration result stays on screen before returning to the main menu
+#define CALIBRATION_DONE_DISPLAY_MS 2000
+
+#define SCALE_COMMAND_QUEUE_LENGTH 8
+#define SCALE_EVENT_QUEUE_LENGTH 16
+// Per second history readings waiting for the main task, two minutes of it being busy
+#define SCALE_HISTORY_QUEUE_LENGTH 120
+// Consumers of the events besides the UI, see addEventListener
+#define SCALE_EVENT_LISTENERS 4
+
 #define TEXT_COLOR_RED 0xD165
 #define TEXT_COLOR_GREEN 0x6E24
 
+// Changes to the weighing pipeline, applied by the weighing task between two readings
+enum class ScaleCommand : uint8_t
+{
+    TARE,
+    ENTER_BARISTA,
+    LEAVE_BARISTA,
+    BEGIN_CALIBRATION,      // stop bag tracking while reference weights are on the plate
+    CAPTURE_CALIBRATION,    // average the next stable conversions for a calibration point
+    APPLY_CALIBRATION,      // switch to the curve and zero offset of the finished session
+    END_CALIBRATION,
+    START_RAW_CAPTURE,
+    STOP_RAW_CAPTURE,
+    START_REPLAY,    // feed the pipeline from the raw capture file instead of the HX711
+    START_SYNTHETIC, // feed the pipeline from the load cell simulator
+    STOP_REPLAY,     // back to the HX711 from a replay or simulation
+    SET_DOSE_TARGET,
+    RESET_HEALTH,
+    SHELF_CAPTURE, // tare or calibrate a shelf channel
+    SET_TELEMETRY,
+    RESTORE_DOSE_LEARNING, // lead time of the dosing engine saved before the last restart
+    LOAD_BAG_CAPTURE, // average the next conversions into the weight of the bag being loaded
+};
+
+// What the weighing task is averaging conversions for
+enum class CaptureKind : uint8_t
+{
+    TARE,
+    CALIBRATION,
+    LOAD_BAG,
+};
+
+enum class CalibrationStep : uint8_t
+{
+    IDLE,
+    EMPTY_PLATE,
+    CAPTURING_ZERO,
+    PLACE_WEIGHT,
+    CAPTURING_POINT,
+    ENTER_MASS,
+    DONE,
+};
+
 class Scale
 {
 private:
-    HX711 &scale;
     TFT_eSPI &tft;
     UI &ui;
     PreferencesManager &preferences;
@@ -36,43 +118,181 @@ private:
     const int PIN_DT;
     const int PIN_SCK;
 
+    SampleAcquisition acquisition;
+    // Where the weighing task reads conversions from, owned by the weighing task
+    SampleSource *source = &acquisition;
+    SampleCapture rawCapture;
+    CaptureReplay replay;
+    SyntheticSource synthetic;
+    // Arguments for START_RAW_CAPTURE, START_REPLAY and START_SYNTHETIC
+    bool rawCaptureReset = false;
+    float replaySpeed = 1.0f;
+    SyntheticConfig syntheticConfig;
+
+    // Bag tracking favours a quiet reading, barista mode favours a fast one
+    MedianFilter bagMedian{BAG_FILTER_MEDIAN_WINDOW};
+    KalmanFilter bagKalman{BAG_FILTER_PROCESS_NOISE, FILTER_MEASUREMENT_NOISE};
+    MedianFilter baristaMedian{BARISTA_FILTER_MEDIAN_WINDOW};
+    EmaFilter baristaEma{BARISTA_FILTER_EMA_ALPHA};
+    FilterChain bagFilters;
+    FilterChain baristaFilters;
+    FilterChain *activeFilters = &bagFilters;
+
+    // Output of the active filter chain for the latest conversion
+    int32_t filteredCounts = 0;
+    int32_t lastRawCounts = 0;
+    bool hasSamples = false;
+    uint32_t lastSampleUs = 0;
+
+    StabilityDetector stability{Weight::grams(STABLE_ENTER_STDDEV), Weight::grams(STABLE_EXIT_STDDEV),
+                                Weight::grams(STABLE_ENTER_DRIFT), Weight::grams(STABLE_EXIT_DRIFT)};
+
+    ConsumptionTracker consumption;
+
+    // Owned by the main task, turns withdrawals and the shipping lead time into the plate thresholds
+    ConsumptionForecast forecast;
+    float leadDays = FORECAST_DEFAULT_LEAD_DAYS;
+    // Milligrams, written by the main task and read by the weighing task
+    std::atomic<int32_t> reorderThreshold{Weight::grams(REORDER_BUTTON_THRESHOLD).toMilligrams()};
+    std::atomic<int32_t> promptThreshold{Weight::grams(REORDER_BUTTON_PROMPT_THRESHOLD).toMilligrams()};
+
+    // Barista dose prediction and the grinder stop output
+    DosingEngine dosing;
+    // Argument for SET_DOSE_TARGET
+    float doseTarget = SINGLE_DOSE_WEIGHT;
+    // Argument for RESTORE_DOSE_LEARNING
+    DoseLearning savedDoseLearning;
+    // Written by the weighing task before every DOSE_DONE event, for the main task to persist
+    SeqLock<DoseLearning> doseLearning;
+
+    SensorHealth health;
+
+    // Binary stream of every conversion and event, replaces the text log of the weighing task while on
+    TelemetryStream telemetry;
+    // Argument for SET_TELEMETRY
+    bool telemetryEnabled = false;
+
+    // Extra load cells on the shelf, channels 1 and up
+    AcquisitionScheduler shelf;
+    // Arguments for SHELF_CAPTURE, 0 grams tares
+    uint8_t shelfCaptureChannel = 0;
+    float shelfCaptureGrams = 0.0f;
+
+    AdaptiveSampler sampler{BAG_SAMPLING_MIN_INTERVAL_MS, BAG_SAMPLING_MAX_INTERVAL_MS, Weight::grams(SAMPLING_MOTION_THRESHOLD)};
+
     // Calibration values
     float calibrationFactor;
     long zeroOffset;
+    CalibrationCurve curve;
+    // Counts of an empty plate (or the tared container in barista mode), owned by the weighing task
+    long offset = 0;
+    // The plate's offset while barista mode has the container tared, owned by the weighing task
+    long bagOffset = 0;
 
     // Flag for safely requesting calibration from any context
     volatile bool calibrationRequested;
 
+    // Calibration session, driven from the main loop
+    CalibrationStep calibrationStep = CalibrationStep::IDLE;
+    bool calibrationTainted = false;
+    long calibrationZeroCounts = 0;
+    long calibrationPointCounts = 0;
+    unsigned long calibrationDoneTime = 0;
+    CalibrationCurve pendingCurve;
+
+    // Background averaging of conversions, run by the weighing task
+    CaptureKind captureKind = CaptureKind::TARE;
+    int captureRemaining = 0;
+    int64_t captureSum = 0;
+    int captureCount = 0;
+    unsigned long captureStartTime = 0;
+    // Counts of a calibration point, or the weight on the plate for LOAD_BAG
+    long captureResult = 0;
+    Weight captureWeight;
+    std::atomic<uint8_t> captureState{CAPTURE_IDLE};
+
     // Weight measured before confirming load bag
-    float weightBeforeLoadBag = 0.0f;
+    Weight weightBeforeLoadBag;
 
-    float baristaLastDrawnReading = -99.0f;
-    int baristaLastProgress = -99;
-    bool baristaMode = false;
+    Weight baristaLastDrawnReading = Weight::grams(-99.0f);
+    bool baristaLastDrawnStop = false;
 
     TaskHandle_t backgroundWeighingTaskHandle = NULL;
+    QueueHandle_t commandQueue = NULL;
+    QueueHandle_t eventQueue = NULL;
+    QueueHandle_t historyQueue = NULL;
+    // Last second queued for the history and readings lost to a full queue
+    uint32_t lastHistoryTime = 0;
+    std::atomic<uint32_t> historyDropped{0};
+    // Further consumers of the events, empty slots are NULL
+    std::atomic<QueueHandle_t> eventListeners[SCALE_EVENT_LISTENERS] = {};
+
+    // State owned by the weighing task, other tasks only see it through `published`
+    bool baristaMode = false;
+    bool calibrating = false;
+    Weight lastReading;
+    Weight stableReading;
+    bool readingIsStable = false;
+    bool hasStableReading = false;
+    BagTracker bagTracker;
+
+    SeqLock<WeightSample> published;
+    uint32_t publishedSequence = 0;
+
+    // Run all buffered conversions through the active filter chain
+    void drainSamples();
+    void pushSample(const RawSample &sample);
+    void selectFilters(FilterChain &filters);
+    Weight countsToWeight(int32_t counts);
+    void startCapture(CaptureKind kind);
+    void updateCapture(const RawSample &sample);
+    void checkCaptureTimeout();
+    void loadCalibration();
+    void restoreLiveSource();
+    void drawCalibrationStep();
+
+    // Read the filtered weight from the latest conversions, false if the HX711 went quiet
+    bool readWeight(Weight &weight);
+    void updateBagState();
+    void publish();
+    void queueHistory();
+    uint16_t currentFlags();
+    void emit(ScaleEventType type, Weight weight);
+    void queueEvent(const ScaleEvent &event);
+    static void handleChannelEvent(void *arg, const ScaleEvent &event);
+    static void handleBagEvent(void *arg, ScaleEventType type, Weight weight);
+    bool captureShelf(uint8_t channel, float grams);
+    void updateReorderPoints();
+
+    void sendCommand(ScaleCommand command);
+    void applyCommand(ScaleCommand command);
+    void processCommands();
 
 public:
-    Scale(HX711 &scaleModule, TFT_eSPI &display, UI &uiSystem, PreferencesManager &prefs, TerminalApi &terminalApi, LedStrip &ledStrip, int dt_pin, int sck_pin);
+    Scale(TFT_eSPI &display, UI &uiSystem, PreferencesManager &prefs, TerminalApi &terminalApi, LedStrip &ledStrip, int dt_pin, int sck_pin);
 
-    bool hasBag = false;
+    // Written by the main task, read by the weighing task
+    std::atomic<bool> hasBag{false};
     bool loadingBag = false;
     String bagName = "Unknown";
-    volatile float lastReading = 0.0f;
-
-    volatile bool fastMeasuring = false;
-
-    bool bagRemovedFromSurface = false;
-    unsigned long bagRemovedTime = 0;
 
-    bool bagIsBelowThreshold = false;
-    bool bagIsBelowPromptThreshold = false;
+    // Attach another HX711 as the next shelf channel. Only before begin()
+    bool addShelfChannel(int dt_pin, int sck_pin);
 
     // Initialize the scale
     void begin();
 
-    // Calibrate the scale (should only be called from main loop, not interrupt context)
-    void calibrate();
+    // Calibration runs as a session on the main loop while the weighing task keeps sampling.
+    // Empty the plate and measure, then measure each reference weight and enter its mass.
+    // Finishing applies and stores the new curve without a restart
+    void startCalibration();
+    void measureCalibrationPoint();
+    void setCalibrationMass(long milligrams);
+    void finishCalibration();
+    void cancelCalibration();
+    bool isCalibrating() { return calibrationStep != CalibrationStep::IDLE; }
+    // Advance and draw the calibration session (call this from main loop)
+    void drawCalibration();
 
     // Request calibration (safe to call from any context including interrupts)
     void requestCalibration();
@@ -80,10 +300,46 @@ public:
     // Check and handle pending calibration request (call this from main loop)
     bool checkCalibrationRequest();
 
-    // Read weight from scale
-    float readWeight(int samples = 10);
+    // Latest reading and bag state published by the weighing task. Safe to call from any task
+    WeightSample getSample() { return published.read(); }
+    // Main task: next settled plate reading for the history, one per second the task saw
+    bool takeHistoryReading(HistoryPoint &point);
+    // Readings lost since the last call because the main task fell two minutes behind
+    uint32_t takeHistoryDropped() { return historyDropped.exchange(0); }
+    WeightSample getSample(uint8_t channel);
 
-    // Tare the scale (set to zero)
+    // The plate and every shelf channel
+    uint8_t getChannelCount() { return 1 + shelf.size(); }
+    bool hasBagOn(uint8_t channel);
+    String getBagName(uint8_t channel);
+
+    // Shelf channels are set up over serial. Taring and calibrating block until the weighing task
+    // has averaged the conversions and store the result
+    bool tareShelf(uint8_t channel);
+    bool calibrateShelf(uint8_t channel, float grams);
+    // Empty name to take the bag off the channel
+    bool setShelfBag(uint8_t channel, const String &name);
+    bool setShelfThresholds(uint8_t channel, float reorder, float prompt);
+    // Per channel acquisition and scheduling cost
+    void printShelfStats();
+
+    // Wait up to `timeout` for the next bag state transition. Meant for a single consumer (the UI)
+    bool waitForEvent(ScaleEvent &event, TickType_t timeout);
+    // Every event is also copied to `queue` without waiting, for consumers besides the UI.
+    // Safe to call from any task, false if all SCALE_EVENT_LISTENERS slots are taken
+    bool addEventListener(QueueHandle_t queue);
+    // Main task: feed a CONSUMPTION event to the forecast and move the reorder thresholds
+    void recordConsumption(const ScaleEvent &event);
+    // Thresholds the channel reports BELOW_THRESHOLD and BELOW_PROMPT_THRESHOLD at. Safe to call from any task
+    Weight getReorderThreshold(uint8_t channel);
+    Weight getPromptThreshold(uint8_t channel);
+    // Main task: persist what the dosing engine learned from a DOSE_DONE event's dose
+    void recordDose(const ScaleEvent &event);
+    // Main task: grams per day, 0 until the forecast is confident
+    float getConsumptionRate() { return forecast.isConfident() ? forecast.getRate() : 0.0f; }
+    float getLeadDays() { return leadDays; }
+
+    // Tare the scale (set to zero). The weighing task averages the next conversions in the background
     void tare();
 
     // Check if the scale is calibrated
@@ -105,9 +361,40 @@ public:
     // Draw UI for Barista mode
     void drawBaristaMode();
     void forceBaristaRedraw();
+    // Target of the barista dose, the stop signal fires ahead of it to make up for the lag
+    void setDoseTarget(float grams);
+
+    // Print the per-stage cost of the filter chains
+    void printFilterStats();
+    // Print the current and effective sampling rate
+    void printSamplingStats();
+    // Print sampling jitter, read times, sensor noise and error counters
+    void printHealth();
+    void resetHealth();
+    // Error counters of the plate for reporting. Safe to call from any task, they may be a reading apart
+    HealthCounters getHealthCounters();
+    // Stream every conversion and event as binary frames over serial, see TelemetryStream
+    void setTelemetry(bool enabled);
+    // Print the logged withdrawals from the bag
+    void printConsumptionLog();
+    // Print flow, latency and learned lead time of the dosing engine
+    void printDosingStats();
+    // Print the consumption rate, days until empty and the reorder points
+    void printForecast();
+
+    // Record raw conversions to CAPTURE_FILE, appending to the previous capture unless `reset`
+    void startRawCapture(bool reset);
+    void stopRawCapture();
+    // Print the capture over serial (stop it first)
+    void dumpRawCapture();
+    // Run the capture through the filters and thresholds `speed` times faster than recorded,
+    // 0 replays it all at once. Live conversions are ignored until the replay ends
+    void startReplay(float speed);
+    void stopReplay();
+    // Run the pipeline on simulated load cell data instead of the HX711, see `replay`
+    void startSynthetic(const SyntheticConfig &config);
 
     static void backgroundWeighingTask(void *parameter);
-    void stopBackgroundWeighingTask();
     void startBackgroundWeighingTask();
 };
 
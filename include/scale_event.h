@@ -0,0 +1,31 @@
+#ifndef SCALE_EVENT_H
+#define SCALE_EVENT_H
+
+#include <stdint.h>
+#include "weight.h"
+
+enum class ScaleEventType : uint8_t
+{
+    BAG_REMOVED,
+    BAG_RETURNED,
+    BELOW_THRESHOLD,
+    ABOVE_THRESHOLD,
+    BELOW_PROMPT_THRESHOLD,
+    ABOVE_PROMPT_THRESHOLD,
+    CONSUMPTION, // a withdrawal or refill finished, weight holds the net amount removed
+    DOSE_STOP,   // the predicted dose reached its target, weight holds the weight at the signal
+    DOSE_DONE,   // the dose settled after a stop, weight holds the overshoot
+};
+
+// Edge transition of the bag state, emitted once by the weighing task when it happens
+struct ScaleEvent
+{
+    ScaleEventType type;
+    Weight weight;        // settled weight that caused the transition
+    uint32_t timestampUs; // time of the conversion that caused the transition
+    uint8_t channel;      // 0 for the plate, shelf positions from 1
+};
+
+const char *scaleEventName(ScaleEventType type);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SCALE_SERVER_H
+#define SCALE_SERVER_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "scale.h"
+#include "load_cell_channel.h"
+
+#define SERVER_PORT 80
+// Further WebSocket clients push out the oldest ones
+#define SERVER_MAX_CLIENTS 8
+// New readings go out at most this often, a reading that didn't change is not sent again
+#define SERVER_PUSH_INTERVAL_MS 50
+// How often the main task copies the bag names and the forecast for the snapshot
+#define SERVER_STATE_REFRESH_MS 500
+#define SERVER_EVENT_QUEUE_LENGTH 16
+#define SERVER_TASK_PRIORITY 1
+
+// State only the main task may read, copied for the request handlers
+struct ServerState
+{
+    String bagNames[SCALE_MAX_CHANNELS];
+    bool hasBag[SCALE_MAX_CHANNELS] = {};
+    float consumptionRate = 0.0f; // grams per day, 0 until the forecast is confident
+    float leadDays = 0.0f;
+};
+
+// Serves the live weight and bag state on the LAN. GET /api/state returns a snapshot of every
+// channel, /ws pushes readings and events as they are produced. Requests are answered by the
+// AsyncTCP task and readings are pushed by a low priority task of its own, so neither can delay
+// the weighing task. Each client has a bounded send queue, a client that doesn't keep up misses
+// readings instead of holding back the others. See tools/webload.py
+class ScaleServer
+{
+private:
+    Scale &scale;
+    AsyncWebServer server{SERVER_PORT};
+    AsyncWebSocket socket{"/ws"};
+
+    QueueHandle_t events = NULL;
+    TaskHandle_t pushTaskHandle = NULL;
+
+    SemaphoreHandle_t stateLock = NULL;
+    ServerState state;
+    unsigned long lastStateRefresh = 0;
+
+    // Owned by the push task
+    uint32_t lastSequence[SCALE_MAX_CHANNELS] = {};
+    unsigned long lastPushTime = 0;
+
+    // Counters for /api/stats, written by the push task
+    uint32_t samplesSent = 0;
+    uint32_t eventsSent = 0;
+    // Messages at least one client's full queue had no room for
+    uint32_t partialSends = 0;
+
+    String snapshot();
+    String stats();
+    void pushSamples();
+    void pushEvent(const ScaleEvent &event);
+    void send(const char *message, size_t length);
+    void handleSocketEvent(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t length);
+    static void pushTask(void *parameter);
+
+public:
+    ScaleServer(Scale &scale) : scale(scale) {}
+
+    // Start listening, call after the scale was started and WiFi is up
+    void begin();
+    // Main task: refresh the state only it may read
+    void update();
+    bool isRunning() { return pushTaskHandle != NULL; }
+};
+
+#endif
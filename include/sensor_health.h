@@ -0,0 +1,76 @@
+#ifndef SENSOR_HEALTH_H
+#define SENSOR_HEALTH_H
+
+#include <Arduino.h>
+#include "histogram.h"
+#include "sample_ring_buffer.h"
+
+// Conversions the rolling noise estimate is taken over, 0.8s at 80 SPS
+#define HEALTH_NOISE_WINDOW 64
+// A conversion arriving this many nominal periods after the previous one means some went missing
+#define HEALTH_GAP_FACTOR 1.8f
+// This many identical conversions in a row point at a disconnected or dead load cell
+#define HEALTH_STUCK_SAMPLES 32
+
+// Error counters since the last reset, for reporting off the device
+struct HealthCounters
+{
+    uint32_t conversions = 0;
+    uint32_t conversionsDropped = 0; // overwritten in the ring buffer before the weighing task read them
+    uint32_t gaps = 0;
+    uint32_t missedConversions = 0;
+    uint32_t saturated = 0;
+    uint32_t stuckRuns = 0;
+    uint32_t staleReadings = 0;
+};
+
+// Timing and sensor statistics for triaging flaky units and planning higher sample rates.
+// Owned and fed by the weighing task, printing from another task may show a half updated state.
+class SensorHealth
+{
+private:
+    Histogram conversionInterval; // us between two conversions
+    Histogram wakeLateness;       // us a timed wakeup of the weighing task came late
+    Histogram drainBatch;         // conversions handled per wakeup
+
+    float nominalIntervalUs = 0.0f;
+    uint32_t gaps = 0;
+    uint32_t missedConversions = 0;
+    uint32_t saturated = 0;
+    uint32_t stuckRuns = 0;
+    uint32_t staleReadings = 0;
+    uint32_t earlyWakes = 0;
+
+    bool hasLast = false;
+    uint32_t lastTimestampUs = 0;
+    int32_t lastCounts = 0;
+    uint16_t repeatCount = 0;
+
+    // First differences cancel drift and slow load changes, their spread is sqrt(2) times the noise
+    int32_t diffs[HEALTH_NOISE_WINDOW];
+    uint8_t diffHead = 0;
+    uint8_t diffCount = 0;
+    int64_t diffSum = 0;
+    int64_t diffSumSquares = 0;
+    // Noise measured the last time the reading was stable, in counts
+    float stableNoise = -1.0f;
+
+public:
+    // Feed every conversion that came from the HX711
+    void update(const RawSample &sample, bool stable);
+    // How long the weighing task asked to sleep and how long it did. Notified wakeups are early on purpose
+    void recordWake(uint32_t requestedUs, uint32_t sleptUs, bool notified);
+    void recordDrain(uint32_t conversions) { drainBatch.add(conversions); }
+    // A reading was published without a fresh conversion behind it
+    void recordStale() { staleReadings++; }
+
+    // Rolling noise standard deviation in counts, -1 until the window is full
+    float getNoise();
+    // Everything but the conversion counts, those belong to the acquisition
+    HealthCounters getCounters();
+
+    void reset();
+    void print(float countsPerGram);
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Publishes a small value from one writer task to any number of readers without locks.
+// The sequence is odd while a write is in progress; readers retry until they copied the
+// value between two identical even sequence numbers. The write itself runs in a critical
+// section so a reader never has to wait for a preempted writer.
+template <typename T>
+class SeqLock
+{
+private:
+    std::atomic<uint32_t> sequence{0};
+    T value;
+    portMUX_TYPE writeMux = portMUX_INITIALIZER_UNLOCKED;
+
+public:
+    void write(const T &newValue)
+    {
+        portENTER_CRITICAL(&writeMux);
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        value = newValue;
+        sequence.store(seq + 2, std::memory_order_release);
+        portEXIT_CRITICAL(&writeMux);
+    }
+
+    T read() const
+    {
+        T copy;
+        uint32_t before, after;
+        do
+        {
+            before = sequence.load(std::memory_order_acquire);
+            copy = value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        return copy;
+    }
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SPRITE_READOUT_H
+#define SPRITE_READOUT_H
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include "display_pipeline.h"
+
+// Palette colours are 4 bit, 16 of them at most
+#define READOUT_COLORS 16
+
+struct ReadoutStats
+{
+    uint32_t frames = 0;
+    // Frames that differed from what is on the panel
+    uint32_t pushes = 0;
+    uint64_t bytesPushed = 0;
+    // What clearing and repainting the whole area would have sent, at least
+    uint64_t bytesFull = 0;
+    uint64_t micros = 0;
+};
+
+// Off-screen buffer for a part of the screen that changes often, like the weight. A frame is
+// drawn into canvas() with palette indices as colours, and push() compares it with the frame
+// on the panel and sends only the rectangle that changed, expanding the next band of rows while
+// the last one is sent. Nothing is cleared on the panel, so nothing flickers. Keeps two 4 bit
+// sprites, width * height bytes.
+class SpriteReadout
+{
+private:
+    TFT_eSPI &tft;
+    DisplayPipeline &pipeline;
+    TFT_eSprite first;
+    TFT_eSprite second;
+    TFT_eSprite *shown = &first;
+    TFT_eSprite *drawing = &second;
+
+    int16_t x = 0;
+    int16_t y = 0;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint16_t palette[READOUT_COLORS] = {};
+    // Palette in the byte order the panel expects, so rows go out without swapping
+    uint16_t wirePalette[READOUT_COLORS] = {};
+
+    bool ready = false;
+    bool invalid = true;
+    uint32_t frameStarted = 0;
+    ReadoutStats stats;
+
+public:
+    SpriteReadout(TFT_eSPI &tft, DisplayPipeline &pipeline) : tft(tft), pipeline(pipeline), first(&tft), second(&tft) {}
+
+    bool begin(int16_t x, int16_t y, uint16_t width, uint16_t height, const uint16_t *colors, uint8_t count);
+    bool isReady() { return ready; }
+
+    // Cleared to palette index 0, draw the whole frame
+    TFT_eSprite &canvas();
+    void push();
+    // The panel was drawn over, the next push sends the whole area
+    void invalidate() { invalid = true; }
+
+    const ReadoutStats &getStats() { return stats; }
+    void resetStats() { stats = ReadoutStats(); }
+    void printStats(const char *name);
+};
+
+#endif
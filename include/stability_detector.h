@@ -0,0 +1,44 @@
+#ifndef STABILITY_DETECTOR_H
+#define STABILITY_DETECTOR_H
+
+#include <stdint.h>
+#include "weight.h"
+
+#define STABILITY_WINDOW_SIZE 10
+
+// Marks a stream of readings as settling or stable based on the spread (standard deviation) and
+// drift (newest - oldest) over a short window. Leaving the stable state needs larger thresholds
+// than entering it, so noise around a single threshold doesn't make the state flap.
+// The spread is compared as a variance in mg^2, so no square root is needed.
+class StabilityDetector
+{
+private:
+    const int64_t enterVariance;
+    const int64_t exitVariance;
+    const Weight enterDrift;
+    const Weight exitDrift;
+
+    Weight window[STABILITY_WINDOW_SIZE];
+    uint8_t head = 0;
+    uint8_t count = 0;
+
+    bool stable = false;
+    bool hasStable = false;
+    Weight stableValue;
+    int64_t variance = 0;
+
+public:
+    StabilityDetector(Weight enterStdDev, Weight exitStdDev, Weight enterDrift, Weight exitDrift);
+
+    // Feed the next reading, returns true if the stable value changed
+    bool update(Weight weight);
+    void reset();
+
+    bool isStable() { return stable; }
+    bool hasStableValue() { return hasStable; }
+    Weight getStableValue() { return stableValue; }
+    // In mg^2
+    int64_t getVariance() { return variance; }
+};
+
+#endif
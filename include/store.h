@@ -31,10 +31,23 @@ private:
 
     void recalcMenuButtons(int index, int size);
 
+    TextWidget buyLetters[3] = {
+        {&GeistMono_VariableFont_wght14pt7b, ACCENT_COLOR, 0, 0, TextAlign::CENTER},
+        {&GeistMono_VariableFont_wght14pt7b, ACCENT_COLOR, 0, 0, TextAlign::CENTER},
+        {&GeistMono_VariableFont_wght14pt7b, ACCENT_COLOR, 0, 0, TextAlign::CENTER},
+    };
+    TextWidget productName{MAIN_FONT, ACCENT_COLOR};
+    TextWidget productVariant{MAIN_FONT, TEXT_COLOR};
+
+    TextWidget orderId{MAIN_FONT, ACCENT_COLOR};
+    TextWidget orderDate{MAIN_FONT, TEXT_COLOR};
+    TextWidget orderStatus{MAIN_FONT, TEXT_COLOR};
+
 public:
     Store(UI &uiInstance, TFT_eSPI &tftDisplay, Scale &scaleInstance, TerminalApi &terminalApi, LedStrip &ledStrip)
         : ui(uiInstance), tft(tftDisplay), scaleManager(scaleInstance), terminalApi(terminalApi), ledStrip(ledStrip) {}
 
+    void begin();
     void exit();
     void taint() { tainted = true; };
     void draw();
@@ -0,0 +1,83 @@
+#ifndef SYNTHETIC_SOURCE_H
+#define SYNTHETIC_SOURCE_H
+
+#include <stdint.h>
+#include <math.h>
+#include "sample_source.h"
+
+#define SYNTHETIC_FULL_BAG_GRAMS 355.2f
+#define SYNTHETIC_EMPTY_BAG_GRAMS 15.2f
+#define SYNTHETIC_MAINS_HZ 50.0f
+
+enum class SyntheticScenario : uint8_t
+{
+    CREEP,         // full bag sitting still while the load cell creeps and warms up
+    SCOOP,         // bag lifted off every 30s and put back 8g lighter
+    BAG_SWAP,      // empty bag replaced by a full one halfway through
+    ESPRESSO_POUR, // tared cup filling at ~2g/s after a short wait
+    MAINS_NOISE,   // full bag with 50Hz pickup aliased by the sample rate
+    SPIKES,        // full bag with occasional single-sample ADC glitches
+};
+
+struct SyntheticConfig
+{
+    SyntheticScenario scenario = SyntheticScenario::SCOOP;
+    uint32_t seed = 1;
+    uint32_t sampleRate = 80;
+    uint32_t samples = 80 * 600;
+    // 0 delivers every sample immediately, otherwise samples are paced at `speed` times real time
+    float speed = 0.0f;
+
+    // Conversion to counts, normally the live zero offset and calibration factor
+    int32_t zeroCounts = 0;
+    float countsPerGram = 1000.0f;
+
+    float noiseGrams = 0.05f;
+    float mainsGrams = 0.0f;
+    float spikeProbability = 0.0f;
+};
+
+// Config with the disturbances that belong to the scenario
+SyntheticConfig syntheticDefaults(SyntheticScenario scenario);
+
+// Deterministic load cell simulator, plain C++ so it also feeds the host tools (tools/pipeline_bench.cpp). The same config and seed always produce the same stream,
+// so filter and threshold changes can be compared sample by sample. Samples are generated on
+// the fly, the stream can be millions of samples long without using any memory.
+class SyntheticSource : public SampleSource
+{
+private:
+    SyntheticConfig config;
+    uint32_t index = 0;
+    uint32_t rngState = 1;
+    uint32_t startUs = 0;
+
+    float truthGrams = 0.0f;
+    bool truthSettled = true;
+
+    uint32_t nextRandom();
+    float uniform();
+    float gaussian();
+    // Weight on the plate without any noise, and whether it is currently holding still
+    float profile(float t, bool &settled);
+
+public:
+    void begin(const SyntheticConfig &newConfig);
+    void end() { index = config.samples; }
+
+    const char *name() override { return "synthetic"; }
+    bool read(RawSample &sample) override;
+    void clear() override {}
+    bool isRunning() override { return index < config.samples; }
+
+    // Truth for the sample that was read last
+    float getTruth() { return truthGrams; }
+    bool isTruthSettled() { return truthSettled; }
+    int32_t getTruthCounts() { return config.zeroCounts + lroundf(truthGrams * config.countsPerGram); }
+    uint32_t getIndex() { return index; }
+    const SyntheticConfig &getConfig() { return config; }
+};
+
+const char *syntheticScenarioName(SyntheticScenario scenario);
+bool parseSyntheticScenario(const char *name, SyntheticScenario &scenario);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include "weight.h"
+#include "scale_event.h"
+
+#define TELEMETRY_VERSION 1
+// Encoded frames waiting for the UART, ~1.5s of samples at 80 SPS
+#define TELEMETRY_BUFFER_SIZE 4096
+// Largest frame before encoding: type, sequence, payload and CRC
+#define TELEMETRY_MAX_FRAME 32
+// The weighing task drains the buffer at least this often while streaming
+#define TELEMETRY_MAX_INTERVAL_MS 20
+#define TELEMETRY_STATUS_INTERVAL_MS 1000
+
+// Every frame is [type u8][sequence u16][payload][CRC-16/CCITT-FALSE u16], little endian,
+// COBS encoded and terminated by a zero byte. The sequence counts every frame produced, also
+// the ones dropped because the UART fell behind, so the host sees gaps. See tools/telemetry.py
+enum class TelemetryFrameType : uint8_t
+{
+    SAMPLE = 1, // timestampUs u32, raw counts i32, filtered counts i32, weight mg i32, flags u16
+    EVENT = 2,  // timestampUs u32, event type u8, channel u8, weight mg i32
+    STATUS = 3, // uptime ms u32, frames dropped u32, conversions u32, conversions dropped u32, version u8
+};
+
+// Streams every conversion of the plate and every scale event over serial. Only used from
+// the weighing task, which both produces frames and hands them to the UART without blocking.
+class TelemetryStream
+{
+private:
+    uint8_t buffer[TELEMETRY_BUFFER_SIZE];
+    uint16_t head = 0; // next byte written
+    uint16_t tail = 0; // next byte sent
+
+    bool enabled = false;
+    uint16_t sequence = 0;
+    uint32_t framesQueued = 0;
+    uint32_t framesDropped = 0;
+    unsigned long lastStatusTime = 0;
+
+    void queueFrame(TelemetryFrameType type, const uint8_t *payload, uint8_t length);
+    uint16_t freeSpace() { return (tail + TELEMETRY_BUFFER_SIZE - head - 1) % TELEMETRY_BUFFER_SIZE; }
+
+public:
+    void start();
+    void stop();
+    bool isEnabled() { return enabled; }
+
+    void sample(uint32_t timestampUs, int32_t rawCounts, int32_t filteredCounts, Weight weight, uint16_t flags);
+    void event(const ScaleEvent &event);
+    // Queue a status frame when one is due and write as much as the UART takes without blocking
+    void service(HardwareSerial &out, uint32_t conversions, uint32_t conversionsDropped);
+
+    static uint16_t crc16(const uint8_t *data, size_t length);
+    // Returns the encoded length, `out` needs length + length / 254 + 1 bytes
+    static size_t cobsEncode(const uint8_t *data, size_t length, uint8_t *out);
+};
+
+#endif
@@ -3,8 +3,11 @@
 
 #include <Arduino.h>
 #include <vector>
+#include <ArduinoJson.h>
 #include "wifi_manager.h"
 
+class PeerCoordinator;
+
 template <typename T>
 struct ApiResponse
 {
@@ -110,13 +113,23 @@ class TerminalApi
 {
 private:
     WiFiManager *wifiManager;
+    PeerCoordinator *peers = nullptr;
 
     String tokenHeader;
 
+    // From the last cart that came back, 0 until then
+    float shippingLeadDays = 0.0f;
+
+    void parseCart(JsonObject data, Cart *cart);
+
 public:
     TerminalApi();
     void begin(WiFiManager *wifiManager, const char *pat);
 
+    // Take the catalog from other scales when one of them fetched it recently, and share ours
+    void setPeers(PeerCoordinator *peers) { this->peers = peers; }
+    PeerCoordinator *getPeers() { return peers; }
+
     std::vector<Product> getProducts();
     std::vector<ShippingAddress> getShippingAddresses();
     std::vector<Order> getOrders();
@@ -126,6 +139,9 @@ public:
     Cart *addItemToCart(const char *productVariantID, uint32_t quantity);
     bool clearCart();
     Order *convertCartToOrder();
+
+    // Calendar days the last cart's shipping timeframe promised, 0 if no cart was fetched yet
+    float getShippingLeadDays() { return shippingLeadDays; }
 };
 
 #endif
\ No newline at end of file
@@ -10,6 +10,12 @@
 #include "led.h"
 #include "terminal_api.h"
 #include "preferences_manager.h"
+#include "scale_event.h"
+#include "load_cell_channel.h"
+#include "display_pipeline.h"
+#include "sprite_readout.h"
+#include "digit_atlas.h"
+#include "widget.h"
 
 class Scale;
 
@@ -27,6 +33,25 @@ class Scale;
 #define MUTED_TEXT_COLOR 0x736C
 #define BAG_COLOR 0x736C
 
+// Weight readout above the bottom edge: the progress bar and the text right of it
+#define READOUT_HEIGHT 100
+#define READOUT_MARGIN 20
+#define READOUT_BAR_X 20
+#define READOUT_BAR_WIDTH 60
+#define READOUT_TEXT_X (READOUT_BAR_X + READOUT_BAR_WIDTH + 10)
+
+// Palette of the readout sprites
+#define READOUT_BACKGROUND 0
+#define READOUT_TEXT 1
+#define READOUT_ACCENT 2
+#define READOUT_MUTED 3
+#define READOUT_RED 4
+#define READOUT_GREEN 5
+#define READOUT_BAG 6
+
+// Longest time UI::loop blocks waiting for scale events before redrawing
+#define UI_EVENT_WAIT_MS 20
+
 #define MAIN_FONT &GeistMono_VariableFont_wght18pt7b
 #define SMALL_FONT &HelvetiPixel12pt7b
 
@@ -156,20 +181,47 @@ public:
     void drawMenu();
 
     void handleBagNotOnSurface();
+    // Apply queued scale events, blocking up to `timeout` for the first one
+    void processScaleEvents(TickType_t timeout);
     void drawAutoReorder();
     void drawReorderPrompt();
     void dismissReorderPrompt();
 
     void drawProgressIndicator(uint index, uint size);
 
-    void drawWeight(float weight);
+    // Fills, icons and readouts reach the panel through here, with DMA
+    DisplayPipeline display;
+    // Everything on screen that isn't typed or animated, repainted where it changed
+    Compositor compositor;
+    // Clear the panel, or everything under the menu, and repaint the widgets that were there
+    void clearScreen();
+    void clearContent();
+
+    void drawWeight(Weight weight);
+    // Weight text and progress bar, shared by the main screen and barista mode
+    SpriteReadout readoutText;
+    SpriteReadout readoutBar;
+    // Numbers in the readouts: the weight, the barista shot, the slash and the target after it
+    DigitAtlas weightDigits;
+    DigitAtlas baristaDigits;
+    DigitAtlas slashGlyph;
+    DigitAtlas targetDigits;
+    void drawReadoutBar(int fill, uint8_t color, bool notches);
+    void printDisplayStats();
+    // Weight of every shelf bag in a row above the plate's weight
+    void drawShelf();
+    // Bag that triggered the reorder prompt or button, the plate's bag if none did
+    String reorderBagName();
 
     void loop();
+    // Something drew over the screen, repaint what the UI shows on it
     void taint()
     {
-        lastDrawnReading = 0.0f;
-        lastProgressBarFill = 0;
+        taintReadouts();
+        compositor.damage(ScreenRect(0, 0, tft.width(), tft.height()));
     }
+    // The readouts were drawn over, push them in full with the next reading
+    void taintReadouts();
 
     bool reorderPromptDismissed = false;
 
@@ -181,13 +233,32 @@ private:
     TaskHandle_t cursorBlinkTaskHandle;
     BlinkState *blinkState;
     TextBounds lastCursorState;
-    Scale *scaleManager;
+    Scale *scaleManager = nullptr;
+
+    // Never a rounded reading, so the next one is drawn
+    Weight lastDrawnReading = Weight::milligrams(INT32_MIN);
+    // Where the readouts are, the compositor clearing any of it wipes them
+    ScreenRect readoutArea();
+    static void handleAreaCleared(void *arg, const ScreenRect &area);
+
+    // One label and bar per shelf channel, laid out for `shelfChannels`
+    TextWidget *shelfLabels[SCALE_MAX_CHANNELS] = {};
+    ProgressBarWidget *shelfBars[SCALE_MAX_CHANNELS] = {};
+    uint8_t shelfChannels = 0;
+    void layoutShelf(uint8_t channels);
+    void setShelfVisible(bool visible);
 
-    int lastProgressBarFill = 0;
-    float lastDrawnReading = 0.0f;
+    TextWidget pageIndicator{SMALL_FONT, MUTED_TEXT_COLOR, 0, 0, TextAlign::CENTER};
 
     bool drawnBagNotFound = false;
 
+    // Bag state as reported by scale events, one bit per channel for the thresholds
+    bool bagRemoved = false;
+    uint16_t channelsBelowThreshold = 0;
+    uint16_t channelsBelowPromptThreshold = 0;
+
+    void handleScaleEvent(const ScaleEvent &event);
+
     friend void cursorBlinkTaskWrapper(void *parameter);
 };
 
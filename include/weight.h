@@ -0,0 +1,75 @@
+#ifndef WEIGHT_H
+#define WEIGHT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+// Plain C++ outside of weightText(), so the weighing pipeline also runs on a host
+
+// Longest text formatWeight produces, "-2147483.647" plus the terminator
+#define WEIGHT_TEXT_SIZE 13
+
+// A weight in milligrams. Everything from the calibrated counts to the display works on these,
+// so comparisons are exact and no float (let alone double) math runs per conversion. Gram
+// values only come in through `grams()`, meant for compile-time constants, and go out through
+// `toGrams()` for the few estimators that need fractions.
+class Weight
+{
+private:
+    int32_t mg = 0;
+
+    constexpr explicit Weight(int32_t milligrams) : mg(milligrams) {}
+
+public:
+    constexpr Weight() {}
+
+    static constexpr Weight milligrams(int32_t value) { return Weight(value); }
+    static constexpr Weight grams(float value) { return Weight((int32_t)(value * 1000.0f + (value < 0.0f ? -0.5f : 0.5f))); }
+
+    constexpr int32_t toMilligrams() const { return mg; }
+    constexpr float toGrams() const { return mg / 1000.0f; }
+
+    // Nearest multiple of `step`, halves away from zero
+    constexpr Weight roundTo(Weight step) const
+    {
+        return Weight((int32_t)(((int64_t)mg + (mg >= 0 ? step.mg / 2 : -(step.mg / 2))) / step.mg * step.mg));
+    }
+
+    constexpr Weight operator-() const { return Weight(-mg); }
+    constexpr Weight operator+(Weight other) const { return Weight(mg + other.mg); }
+    constexpr Weight operator-(Weight other) const { return Weight(mg - other.mg); }
+    constexpr Weight operator*(int32_t factor) const { return Weight(mg * factor); }
+    constexpr Weight operator/(int32_t divisor) const { return Weight(mg / divisor); }
+    Weight &operator+=(Weight other)
+    {
+        mg += other.mg;
+        return *this;
+    }
+    Weight &operator-=(Weight other)
+    {
+        mg -= other.mg;
+        return *this;
+    }
+
+    constexpr bool operator==(Weight other) const { return mg == other.mg; }
+    constexpr bool operator!=(Weight other) const { return mg != other.mg; }
+    constexpr bool operator<(Weight other) const { return mg < other.mg; }
+    constexpr bool operator<=(Weight other) const { return mg <= other.mg; }
+    constexpr bool operator>(Weight other) const { return mg > other.mg; }
+    constexpr bool operator>=(Weight other) const { return mg >= other.mg; }
+};
+
+constexpr Weight abs(Weight weight) { return weight < Weight() ? -weight : weight; }
+
+// Write `weight` in grams with 0 to 3 decimals, rounded half away from zero. Returns the length.
+// `buffer` must hold WEIGHT_TEXT_SIZE characters
+size_t formatWeight(char *buffer, Weight weight, uint8_t decimals);
+#ifdef ARDUINO
+// Same with the unit appended, e.g. "12.3g"
+String weightText(Weight weight, uint8_t decimals, const char *unit = "g");
+#endif
+
+#endif
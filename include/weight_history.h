@@ -0,0 +1,165 @@
+#ifndef WEIGHT_HISTORY_H
+#define WEIGHT_HISTORY_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "weight.h"
+
+#define HISTORY_DIR "/history"
+#define HISTORY_MAGIC 0x54534857 // "WHST"
+#define HISTORY_VERSION 1
+// One LittleFS block per history block, a block is always rewritten as a whole file
+#define HISTORY_BLOCK_SIZE 4096
+// Weights are stored in steps of the display resolution, a bag sitting still then encodes in a bit
+#define HISTORY_RESOLUTION_MG 100
+// The raw tier keeps one reading per interval
+#define HISTORY_RAW_INTERVAL_MS 1000
+// Open blocks are written out this often, bounding both the data lost on a reset and the
+// number of rewrites a block sees before it fills
+#define HISTORY_CHECKPOINT_MS (10 * 60 * 1000UL)
+// Ring sizes in blocks. Raw holds at least the last hour even if every reading changes
+// (~47 bits each), minutes a month and hours several years at typical compression
+#define HISTORY_RAW_BLOCKS 8
+#define HISTORY_MINUTE_BLOCKS 40
+#define HISTORY_HOUR_BLOCKS 24
+// Readings are only recorded once NTP has set the clock
+#define HISTORY_MIN_VALID_TIME 1704067200 // 2024-01-01
+#define HISTORY_MAX_FIELDS 3
+
+enum class HistoryTierId : uint8_t
+{
+    RAW,
+    MINUTE,
+    HOUR,
+};
+
+struct HistoryPoint
+{
+    uint32_t time; // unix seconds, the start of the interval for aggregated tiers
+    Weight mean;   // raw points have mean, min and max all set to the reading
+    Weight min;
+    Weight max;
+};
+
+typedef void (*HistoryVisitor)(void *arg, const HistoryPoint &point);
+
+struct HistoryBlockHeader
+{
+    uint32_t magic;
+    uint32_t sequence; // increases with every block of the tier, the newest block is the open one
+    uint32_t firstTime;
+    uint32_t lastTime;
+    uint16_t count; // points in the block
+    uint16_t bits;  // encoded payload length
+    uint8_t tier;
+    uint8_t fields;
+    uint8_t version;
+    uint8_t reserved;
+};
+
+#define HISTORY_PAYLOAD_SIZE (HISTORY_BLOCK_SIZE - sizeof(HistoryBlockHeader))
+
+// Encoder and decoder state, both sides run the same steps so only the bits are stored
+struct HistoryCodecState
+{
+    uint16_t count = 0;
+    uint32_t time = 0;
+    int32_t delta = 0;
+    int32_t values[HISTORY_MAX_FIELDS];
+    uint8_t leading[HISTORY_MAX_FIELDS];
+    uint8_t trailing[HISTORY_MAX_FIELDS];
+};
+
+// One round robin tier. Every block is its own file, timestamps are stored as delta-of-delta
+// and each field as the XOR with its previous value (as in Gorilla), so steady readings cost
+// a bit or two. The open block lives in RAM and is written out when it fills or at a
+// checkpoint; since LittleFS is copy on write, each write costs one block plus a metadata commit.
+class HistoryTier
+{
+private:
+    const char *name;
+    const HistoryTierId id;
+    const uint8_t fields;
+    const uint16_t slots;
+
+    uint16_t slot = 0;
+    HistoryBlockHeader header;
+    uint8_t payload[HISTORY_PAYLOAD_SIZE];
+    HistoryCodecState state;
+    bool dirty = false;
+
+    // across blocks, so a clock stepping back can't interleave points
+    uint32_t lastTime = 0;
+    uint32_t blockWrites = 0;
+
+    String slotPath(uint16_t index);
+    bool readHeader(File &file, HistoryBlockHeader &blockHeader);
+    void startBlock(uint32_t sequence);
+    bool restoreOpenBlock();
+    bool writeOpenBlock();
+    void visitBlock(const HistoryBlockHeader &blockHeader, File *file, const uint8_t *data,
+                    uint32_t from, uint32_t to, HistoryVisitor visitor, void *arg, uint32_t &visited);
+
+public:
+    HistoryTier(const char *name, HistoryTierId id, uint8_t fields, uint16_t slots);
+
+    void begin();
+    // Points must come in with increasing time, false if the point was rejected
+    bool append(const HistoryPoint &point);
+    // Write the open block if it changed since the last write
+    void checkpoint();
+    // Stream every stored point with from <= time <= to to `visitor`, oldest first.
+    // Blocks are decoded straight from flash through a small buffer. Returns the number of points
+    uint32_t query(uint32_t from, uint32_t to, HistoryVisitor visitor, void *arg);
+
+    const char *getName() { return name; }
+    void printStats();
+};
+
+struct HistoryAggregate
+{
+    uint32_t start = 0;
+    int64_t sum = 0; // milligrams of all readings in the interval
+    uint32_t count = 0;
+    Weight min;
+    Weight max;
+
+    void add(Weight low, Weight high, int64_t total, uint32_t readings);
+    HistoryPoint point() const;
+};
+
+// Weight history of the plate: raw readings for the last hour, minute aggregates for a month
+// and hourly aggregates for years. Only used from the main task, the weighing task never
+// waits on flash.
+class WeightHistory
+{
+private:
+    HistoryTier raw{"raw", HistoryTierId::RAW, 1, HISTORY_RAW_BLOCKS};
+    HistoryTier minutes{"min", HistoryTierId::MINUTE, 3, HISTORY_MINUTE_BLOCKS};
+    HistoryTier hours{"hour", HistoryTierId::HOUR, 3, HISTORY_HOUR_BLOCKS};
+
+    // Intervals still being aggregated, lost on a reset
+    HistoryAggregate minute;
+    HistoryAggregate hour;
+
+    bool started = false;
+    unsigned long lastCheckpointTime = 0;
+
+    void closeMinute();
+    void closeHour();
+
+public:
+    bool begin();
+    // Main loop: write out the open blocks every HISTORY_CHECKPOINT_MS
+    void update();
+    // Main loop: one settled plate reading per HISTORY_RAW_INTERVAL_MS, queued by the weighing task
+    void record(uint32_t time, Weight weight);
+    void checkpoint();
+
+    HistoryTier &tier(HistoryTierId id);
+    // Print `time,mean,min,max` lines for the tier, grams with one decimal
+    void dump(Print &out, HistoryTierId id, uint32_t from, uint32_t to);
+    void printStats();
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef WEIGHT_SAMPLE_H
+#define WEIGHT_SAMPLE_H
+
+#include <Arduino.h>
+#include "weight.h"
+
+enum WeightSampleFlag : uint16_t
+{
+    WEIGHT_VALID = 1 << 0,          // the HX711 delivered a recent conversion
+    WEIGHT_STABLE = 1 << 1,         // value has settled
+    WEIGHT_HAS_STABLE = 1 << 2,     // stableValue holds a settled reading
+    WEIGHT_BARISTA = 1 << 3,        // measured in barista mode (tared, no bag subtracted)
+    WEIGHT_BAG_REMOVED = 1 << 4,    // a loaded bag was lifted off the plate
+    WEIGHT_BELOW_THRESHOLD = 1 << 5,
+    WEIGHT_BELOW_PROMPT_THRESHOLD = 1 << 6,
+    WEIGHT_DOSE_STOP = 1 << 7,      // barista dose is predicted to reach its target, stop now
+};
+
+// Consistent snapshot of the scale state, published by the weighing task after every reading
+struct WeightSample
+{
+    Weight value;       // live filtered weight
+    Weight stableValue; // last settled weight
+    int32_t rawCounts;  // latest unfiltered HX711 conversion
+    float flowRate;     // grams per second while a barista dose is running
+    uint32_t timestampUs;
+    uint32_t sequence;
+    uint16_t flags;
+
+    bool has(WeightSampleFlag flag) const { return (flags & flag) != 0; }
+};
+
+#endif
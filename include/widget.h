@@ -0,0 +1,239 @@
+#ifndef WIDGET_H
+#define WIDGET_H
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <vector>
+#include "image_loader.h"
+#include "display_pipeline.h"
+
+// Dirty rectangles kept per frame, another one is merged into the closest
+#define COMPOSITOR_MAX_DIRTY 8
+// Two dirty rectangles are painted as one when their union wastes at most this many pixels
+#define COMPOSITOR_MERGE_SLACK 512
+
+// Widgets are shown on the screens in their mask, screens are the MenuType values
+#define SCREEN(menuType) (1UL << (menuType))
+#define SCREENS_ALL 0xFFFFFFFFUL
+
+struct ScreenRect
+{
+    int16_t x = 0;
+    int16_t y = 0;
+    int16_t width = 0;
+    int16_t height = 0;
+
+    ScreenRect() {}
+    ScreenRect(int16_t x, int16_t y, int16_t width, int16_t height) : x(x), y(y), width(width), height(height) {}
+
+    bool isEmpty() const { return width <= 0 || height <= 0; }
+    int32_t area() const { return isEmpty() ? 0 : (int32_t)width * height; }
+    bool intersects(const ScreenRect &other) const;
+    ScreenRect united(const ScreenRect &other) const;
+    ScreenRect intersected(const ScreenRect &other) const;
+};
+
+class Compositor;
+
+// Something on the screen that remembers what it shows. Setters only mark the widget dirty when
+// the value changes, the compositor repaints the dirty areas once per frame.
+class Widget
+{
+    friend class Compositor;
+
+protected:
+    Compositor *compositor = nullptr;
+    // What paint() covers right now
+    ScreenRect area;
+    bool visible = true;
+    uint32_t screens = SCREENS_ALL;
+
+    // Where paint() will draw, with the current values
+    virtual ScreenRect measure(TFT_eSPI &tft) = 0;
+    // Remeasure after a change, repaints the old and the new area
+    void changed();
+
+public:
+    virtual ~Widget() {}
+
+    // Draws the widget over a cleared background, clipped to the area being repainted
+    virtual void paint(TFT_eSPI &tft) = 0;
+
+    // Something drew over the widget, paint it again
+    void invalidate();
+    void setVisible(bool visible);
+    bool isVisible() { return visible; }
+    void setScreens(uint32_t screens);
+    // Visible and on the current screen
+    bool isShown();
+    const ScreenRect &getArea() { return area; }
+};
+
+enum class TextAlign
+{
+    LEFT,
+    CENTER,
+    RIGHT,
+};
+
+class TextWidget : public Widget
+{
+private:
+    String text;
+    const GFXfont *font;
+    std::vector<const GFXfont *> fonts;
+    int16_t maxWidth = 0;
+    uint16_t color;
+    int16_t x;
+    int16_t baseline;
+    TextAlign align;
+    int16_t width = 0;
+
+protected:
+    ScreenRect measure(TFT_eSPI &tft) override;
+
+public:
+    TextWidget(const GFXfont *font, uint16_t color, int16_t x = 0, int16_t baseline = 0, TextAlign align = TextAlign::LEFT)
+        : font(font), color(color), x(x), baseline(baseline), align(align) {}
+
+    void paint(TFT_eSPI &tft) override;
+
+    void setText(const String &text);
+    const String &getText() { return text; }
+    void setColor(uint16_t color);
+    void setFont(const GFXfont *font);
+    const GFXfont *getFont() { return font; }
+    // `x` is the left edge, the center or the right edge depending on the alignment
+    void setPosition(int16_t x, int16_t baseline);
+    // Use the first of `fonts` the text is narrower than `maxWidth` in, the last one otherwise
+    void fitFonts(const std::vector<const GFXfont *> &fonts, int16_t maxWidth);
+    // Width of the text as drawn
+    int16_t getWidth() { return width; }
+
+    static const GFXfont *fit(TFT_eSPI &tft, const char *text, const std::vector<const GFXfont *> &fonts, int16_t maxWidth);
+};
+
+// A PNG from LittleFS, centered horizontally on `centerX`
+class IconWidget : public Widget
+{
+private:
+    ImageLoader &images;
+    const char *path = nullptr;
+    int16_t centerX;
+    int16_t y;
+
+protected:
+    ScreenRect measure(TFT_eSPI &tft) override;
+
+public:
+    IconWidget(ImageLoader &images, int16_t centerX = 0, int16_t y = 0) : images(images), centerX(centerX), y(y) {}
+
+    void paint(TFT_eSPI &tft) override;
+    void setImage(const char *path);
+    void setPosition(int16_t centerX, int16_t y);
+};
+
+// A frame with a bar growing from the left
+class ProgressBarWidget : public Widget
+{
+private:
+    ScreenRect bounds;
+    uint16_t frameColor;
+    uint16_t fillColor;
+    int16_t fillWidth = 0;
+    float progress = 0.0f;
+
+protected:
+    ScreenRect measure(TFT_eSPI &tft) override { return bounds; }
+
+public:
+    ProgressBarWidget(uint16_t frameColor, uint16_t fillColor) : frameColor(frameColor), fillColor(fillColor) {}
+
+    void paint(TFT_eSPI &tft) override;
+    void setBounds(const ScreenRect &bounds);
+    // 0 to 1
+    void setProgress(float progress);
+    void setFillColor(uint16_t color);
+};
+
+// An icon with a label under it, like the menu buttons. The two are separate widgets, so a
+// changed label doesn't decode the icon again
+class ListItemWidget
+{
+private:
+    IconWidget icon;
+    TextWidget label;
+
+public:
+    ListItemWidget(ImageLoader &images, const GFXfont *font, uint16_t color)
+        : icon(images), label(font, color, 0, 0, TextAlign::CENTER) {}
+
+    void attach(Compositor &compositor);
+    // Centered on `centerX`, the icon's top at `iconY`, the label's baseline at `labelBaseline`
+    void setPosition(int16_t centerX, int16_t iconY, int16_t labelBaseline);
+    void set(const char *imagePath, const String &text, uint16_t color);
+    void setVisible(bool visible);
+    bool isVisible() { return icon.isVisible(); }
+    void invalidate();
+};
+
+struct CompositorStats
+{
+    uint32_t frames = 0;
+    uint32_t regions = 0;
+    uint32_t widgetsPainted = 0;
+    uint64_t pixels = 0;
+    uint64_t micros = 0;
+};
+
+// Keeps the widgets on the screen up to date. Dirty areas are merged, and every merged area is
+// cleared and repainted once, clipped to it, with only the widgets that overlap it. Clears and
+// icons go through the display pipeline, everything else waits for it before painting.
+class Compositor
+{
+private:
+    TFT_eSPI &tft;
+    DisplayPipeline &pipeline;
+    uint16_t background;
+    std::vector<Widget *> widgets;
+    ScreenRect dirty[COMPOSITOR_MAX_DIRTY];
+    uint8_t dirtyCount = 0;
+    uint8_t screen = 0;
+    CompositorStats stats;
+    void (*clearedCallback)(void *arg, const ScreenRect &area) = nullptr;
+    void *clearedArg = nullptr;
+
+public:
+    Compositor(TFT_eSPI &tft, DisplayPipeline &pipeline, uint16_t background)
+        : tft(tft), pipeline(pipeline), background(background) {}
+
+    TFT_eSPI &getTft() { return tft; }
+    DisplayPipeline &getPipeline() { return pipeline; }
+    uint16_t getBackground() { return background; }
+
+    void add(Widget &widget);
+    void setScreen(uint8_t screen);
+    uint8_t getScreen() { return screen; }
+
+    // Repaint `area` on the next render
+    void invalidate(const ScreenRect &area);
+    // Something drew over `area`, repaint the widgets in it
+    void damage(const ScreenRect &area);
+
+    // `callback` hears about every area cleared to the background, for what is drawn there
+    // outside the widgets
+    void onCleared(void (*callback)(void *arg, const ScreenRect &area), void *arg)
+    {
+        clearedCallback = callback;
+        clearedArg = arg;
+    }
+
+    // Call once per frame
+    void render();
+
+    const CompositorStats &getStats() { return stats; }
+    void resetStats() { stats = CompositorStats(); }
+    void printStats();
+};
+
+#endif
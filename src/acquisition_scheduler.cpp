@@ -0,0 +1,122 @@
+#include "acquisition_scheduler.h"
+
+bool AcquisitionScheduler::add(LoadCellChannel *channel)
+{
+    if (count >= SCALE_MAX_CHANNELS - 1)
+    {
+        return false;
+    }
+
+    channels[count++] = channel;
+    return true;
+}
+
+LoadCellChannel *AcquisitionScheduler::find(uint8_t channel)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (channels[i]->getIndex() == channel)
+        {
+            return channels[i];
+        }
+    }
+
+    return nullptr;
+}
+
+uint32_t AcquisitionScheduler::service()
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    uint32_t total = 0;
+    bool more = true;
+    while (more)
+    {
+        more = false;
+        for (uint8_t n = 0; n < count; n++)
+        {
+            uint8_t i = (first + n) % count;
+
+            uint32_t start = ESP.getCycleCount();
+            uint8_t processed = 0;
+            while (processed < SCHEDULER_BATCH_SAMPLES && channels[i]->processNext())
+            {
+                processed++;
+            }
+            uint32_t cycles = ESP.getCycleCount() - start;
+
+            if (processed > 0)
+            {
+                stats[i].samples += processed;
+                stats[i].processCycles += cycles;
+                stats[i].maxBatchCycles = max(stats[i].maxBatchCycles, cycles);
+            }
+
+            // a full batch means there may be more waiting
+            more |= processed == SCHEDULER_BATCH_SAMPLES;
+            total += processed;
+        }
+    }
+    // the channel served first gets its conversions in with the least delay, rotate that privilege
+    first = (first + 1) % count;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint32_t start = ESP.getCycleCount();
+        channels[i]->update();
+        stats[i].updateCycles += ESP.getCycleCount() - start;
+        stats[i].passes++;
+    }
+
+    return total;
+}
+
+void AcquisitionScheduler::wakeOnChange(TaskHandle_t task, Weight motion)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!channels[i]->isCalibrated())
+        {
+            // without a factor the band is meaningless, the channel would wake on every conversion
+            channels[i]->getAcquisition().wakeOnChange(NULL, 0, 0);
+            continue;
+        }
+
+        int32_t band = motion.toGrams() * fabsf(channels[i]->getFactor());
+        channels[i]->getAcquisition().wakeOnChange(task, channels[i]->getFilteredCounts(), band);
+    }
+}
+
+void AcquisitionScheduler::printStats()
+{
+    uint32_t mhz = getCpuFrequencyMhz();
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        SampleAcquisition &acquisition = channels[i]->getAcquisition();
+        Hx711Driver &hx711 = acquisition.driver();
+        const ChannelStats &s = stats[i];
+
+        Serial.printf("channel %u: total=%lu dropped=%lu not ready=%lu processed=%lu\n",
+                      channels[i]->getIndex(), (unsigned long)acquisition.total(),
+                      (unsigned long)acquisition.dropped(), (unsigned long)acquisition.notReady(),
+                      (unsigned long)s.samples);
+        Serial.printf("  read avg=%.1fus max=%.1fus, process %lu cycles/sample, max batch %.1fus, update %lu cycles/pass\n",
+                      (float)hx711.getAverageReadCycles() / mhz, (float)hx711.getMaxReadCycles() / mhz,
+                      (unsigned long)(s.samples ? s.processCycles / s.samples : 0),
+                      (float)s.maxBatchCycles / mhz,
+                      (unsigned long)(s.passes ? s.updateCycles / s.passes : 0));
+    }
+}
+
+void AcquisitionScheduler::resetStats()
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        stats[i] = ChannelStats();
+        channels[i]->getAcquisition().driver().resetStats();
+    }
+}
@@ -0,0 +1,50 @@
+#include "adaptive_sampler.h"
+
+AdaptiveSampler::AdaptiveSampler(uint32_t minIntervalMs, uint32_t maxIntervalMs, Weight motionThreshold)
+    : motionThreshold(motionThreshold)
+{
+    setLimits(minIntervalMs, maxIntervalMs);
+}
+
+void AdaptiveSampler::setLimits(uint32_t minIntervalMs, uint32_t maxIntervalMs)
+{
+    this->minIntervalMs = max(minIntervalMs, (uint32_t)1);
+    this->maxIntervalMs = max(maxIntervalMs, this->minIntervalMs);
+    intervalMs = this->minIntervalMs;
+    hasLastWeight = false;
+}
+
+uint32_t AdaptiveSampler::update(Weight weight)
+{
+    unsigned long now = millis();
+    if (lastUpdateTime != 0)
+    {
+        float elapsed = now - lastUpdateTime;
+        averageIntervalMs = averageIntervalMs == 0.0f ? elapsed : averageIntervalMs + (elapsed - averageIntervalMs) * 0.1f;
+    }
+    lastUpdateTime = now;
+
+    if (!hasLastWeight || abs(weight - lastWeight) > motionThreshold)
+    {
+        intervalMs = minIntervalMs;
+    }
+    else
+    {
+        intervalMs = min(intervalMs * 2, maxIntervalMs);
+    }
+
+    lastWeight = weight;
+    hasLastWeight = true;
+
+    return intervalMs;
+}
+
+float AdaptiveSampler::getEffectiveRate()
+{
+    if (averageIntervalMs <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    return 1000.0f / averageIntervalMs;
+}
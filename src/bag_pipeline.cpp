@@ -0,0 +1,27 @@
+#include "bag_pipeline.h"
+
+bool BagPipeline::process(int32_t counts, Weight tare)
+{
+    if (!started)
+    {
+        filters.reset(counts);
+        started = true;
+    }
+
+    filteredCounts = filters.process(counts);
+    reading = toWeight(filteredCounts, tare);
+    if (!stability.update(reading))
+    {
+        return false;
+    }
+
+    stableReading = stability.getStableValue();
+    hasStableReading = true;
+    return true;
+}
+
+void BagPipeline::restart()
+{
+    stability.reset();
+    hasStableReading = false;
+}
@@ -6,56 +6,51 @@ BagSelect::BagSelect(TFT_eSPI &tftDisplay, UI &uiInstance, LedStrip &ledStrip)
 {
 }
 
-void BagSelect::draw()
+void BagSelect::begin(Scale *scaleManagerInstance)
 {
-    if (!needsRedraw)
-    {
-        return;
-    }
-    needsRedraw = false;
-
-    tft.fillRect(0, Menu::menuClearance - 24, tft.width(), tft.height() - Menu::menuClearance, BACKGROUND_COLOR);
-    ui.menu->redraw();
+    scaleManager = scaleManagerInstance;
 
-    tft.setFreeFont(SMALL_FONT);
-    tft.setTextColor(PREVIEW_COLOR);
+    const int16_t previewY = Menu::menuClearance - 26;
+    previousBag.setPosition(4, previewY);
+    nextBag.setPosition(tft.width() - 4, previewY);
+    selectedBag.setPosition(20, tft.height() / 2 + 20);
+    bagSize.setPosition(20, tft.height() / 2 + 20 + 40);
+    selectedBag.fitFonts(allFonts, tft.width() - 30);
 
-    const uint16_t yPos = Menu::menuClearance - 26;
-
-    if (selectedBagIndex > 0)
+    for (TextWidget *widget : {&previousBag, &nextBag, &selectedBag, &bagSize})
     {
-        tft.setCursor(4, yPos);
+        widget->setScreens(SCREEN(SELECT_BAG));
+        ui.compositor.add(*widget);
+    }
+}
 
-        String text = bags[selectedBagIndex - 1];
-        if (text.length() > 10)
-        {
-            text = text.substring(0, 6) + "..";
-        }
+void BagSelect::setBags(const std::vector<String> &bagList)
+{
+    bags = bagList;
+    showSelectedBag();
+}
 
-        tft.print(text);
-    }
-    if (selectedBagIndex < bags.size() - 1)
+void BagSelect::showSelectedBag()
+{
+    if (bags.empty())
     {
-        String text = bags[selectedBagIndex + 1];
-        if (text.length() > 10)
-        {
-            text = text.substring(0, 6) + "..";
-        }
-        tft.setCursor(tft.width() - tft.textWidth(text) - 4, yPos);
-
-        tft.print(text);
+        return;
     }
 
-    ui.setIdealFont(bags[selectedBagIndex].c_str(), 30);
+    auto preview = [](String text)
+    {
+        return text.length() > 10 ? text.substring(0, 6) + ".." : text;
+    };
+
+    previousBag.setText(selectedBagIndex > 0 ? preview(bags[selectedBagIndex - 1]) : "");
+    nextBag.setText(selectedBagIndex < bags.size() - 1 ? preview(bags[selectedBagIndex + 1]) : "");
 
-    tft.setTextColor(SELECTED_COLOR);
-    tft.setCursor(20, tft.height() / 2 + 20);
-    tft.print(bags[selectedBagIndex]);
+    const String &name = bags[selectedBagIndex];
+    selectedBag.setText(name);
 
-    tft.setTextColor(TEXT_COLOR);
-    ui.setIdealFont(bags[selectedBagIndex].c_str(), 30, nonTitleFonts);
-    tft.setCursor(20, tft.height() / 2 + 20 + 40);
-    tft.print("12oz bag");
+    // the size follows the name's font, one size smaller
+    bagSize.setFont(TextWidget::fit(tft, name.c_str(), nonTitleFonts, tft.width() - 30));
+    bagSize.setText("12oz bag");
 }
 
 void BagSelect::confirmBagSelection()
@@ -69,11 +64,9 @@ void BagSelect::confirmBagSelection()
 void BagSelect::cancelBagSelection()
 {
     ledStrip.turnOff();
-    tft.fillScreen(BACKGROUND_COLOR);
+    ui.clearScreen();
 
     ui.menu->selectMenu(MAIN_MENU);
-    ui.menu->taint();
-    ui.menu->draw();
 }
 
 bool BagSelect::selectNextBag()
@@ -81,7 +74,7 @@ bool BagSelect::selectNextBag()
     if (selectedBagIndex < bags.size() - 1)
     {
         selectedBagIndex++;
-        needsRedraw = true;
+        showSelectedBag();
 
         return true;
     }
@@ -93,7 +86,7 @@ bool BagSelect::selectPreviousBag()
     if (selectedBagIndex > 0)
     {
         selectedBagIndex--;
-        needsRedraw = true;
+        showSelectedBag();
         return true;
     }
     return false;
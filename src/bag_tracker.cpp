@@ -0,0 +1,34 @@
+#include "bag_tracker.h"
+
+void BagTracker::update(Weight stable, Weight reorder, Weight prompt, BagEventHandler handler, void *arg)
+{
+    if (!removed && stable < -Weight::grams(BAG_PRESENCE_HYSTERESIS))
+    {
+        removed = true;
+        handler(arg, ScaleEventType::BAG_REMOVED, stable);
+    }
+    else if (removed && stable >= Weight())
+    {
+        removed = false;
+        handler(arg, ScaleEventType::BAG_RETURNED, stable);
+    }
+
+    // thresholds keep their state while the bag is off the plate
+    if (removed)
+    {
+        return;
+    }
+
+    const Weight hysteresis = Weight::grams(REORDER_THRESHOLD_HYSTERESIS);
+    if ((stable < reorder + (belowThreshold ? hysteresis : Weight())) != belowThreshold)
+    {
+        belowThreshold = !belowThreshold;
+        handler(arg, belowThreshold ? ScaleEventType::BELOW_THRESHOLD : ScaleEventType::ABOVE_THRESHOLD, stable);
+    }
+
+    if ((stable < prompt + (belowPromptThreshold ? hysteresis : Weight())) != belowPromptThreshold)
+    {
+        belowPromptThreshold = !belowPromptThreshold;
+        handler(arg, belowPromptThreshold ? ScaleEventType::BELOW_PROMPT_THRESHOLD : ScaleEventType::ABOVE_PROMPT_THRESHOLD, stable);
+    }
+}
@@ -0,0 +1,160 @@
+#include "calibration_curve.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+bool CalibrationCurve::addPoint(int32_t counts, float grams)
+{
+    if (grams <= 0.0f || counts == 0)
+    {
+        return false;
+    }
+
+    CalibrationPoint previous[CALIBRATION_MAX_POINTS];
+    uint8_t previousCount = count;
+    memcpy(previous, points, sizeof(points));
+
+    // keep the points sorted by mass
+    uint8_t index = 0;
+    while (index < count && points[index].grams < grams - 0.01f)
+    {
+        index++;
+    }
+
+    if (index < count && fabsf(points[index].grams - grams) <= 0.01f)
+    {
+        points[index].counts = counts;
+    }
+    else
+    {
+        if (count == CALIBRATION_MAX_POINTS)
+        {
+            return false;
+        }
+
+        memmove(&points[index + 1], &points[index], (count - index) * sizeof(CalibrationPoint));
+        points[index] = {counts, grams};
+        count++;
+    }
+
+    if (!isMonotonic())
+    {
+        memcpy(points, previous, sizeof(points));
+        count = previousCount;
+        return false;
+    }
+
+    updateSegments();
+    return true;
+}
+
+bool CalibrationCurve::setPoints(const CalibrationPoint *newPoints, uint8_t newCount)
+{
+    clear();
+    for (uint8_t i = 0; i < newCount && i < CALIBRATION_MAX_POINTS; i++)
+    {
+        if (!addPoint(newPoints[i].counts, newPoints[i].grams))
+        {
+            clear();
+            return false;
+        }
+    }
+
+    return count > 0;
+}
+
+void CalibrationCurve::setLinear(float countsPerGram)
+{
+    // a single point at 1kg is the same as a plain scale factor
+    count = 1;
+    points[0] = {(int32_t)lroundf(countsPerGram * 1000.0f), 1000.0f};
+    updateSegments();
+}
+
+void CalibrationCurve::updateSegments()
+{
+    int32_t segmentCounts = 0;
+    int32_t segmentMilligrams = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        pointMilligrams[i] = lroundf(points[i].grams * 1000.0f);
+        segmentSlopes[i] = ((int64_t)(pointMilligrams[i] - segmentMilligrams) << 16) / (points[i].counts - segmentCounts);
+
+        segmentCounts = points[i].counts;
+        segmentMilligrams = pointMilligrams[i];
+    }
+}
+
+bool CalibrationCurve::isMonotonic() const
+{
+    if (count == 0)
+    {
+        return true;
+    }
+
+    // load cells can be wired either way round, counts only have to move in one direction
+    int32_t direction = points[count - 1].counts > 0 ? 1 : -1;
+    int32_t lastCounts = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if ((points[i].counts - lastCounts) * direction <= 0)
+        {
+            return false;
+        }
+        lastCounts = points[i].counts;
+    }
+
+    return true;
+}
+
+Weight CalibrationCurve::toWeight(int32_t counts) const
+{
+    if (count == 0)
+    {
+        return Weight::milligrams(std::min(std::max((int64_t)counts * 1000, (int64_t)INT32_MIN), (int64_t)INT32_MAX));
+    }
+
+    int32_t direction = points[count - 1].counts > 0 ? 1 : -1;
+    int32_t segmentCounts = 0;
+    int32_t segmentMilligrams = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if ((counts - points[i].counts) * direction <= 0 || i == count - 1)
+        {
+            // a 32x32 bit multiply and a shift, no division per conversion
+            int64_t offset = ((int64_t)(counts - segmentCounts) * segmentSlopes[i]) >> 16;
+            return Weight::milligrams(segmentMilligrams + offset);
+        }
+
+        segmentCounts = points[i].counts;
+        segmentMilligrams = pointMilligrams[i];
+    }
+
+    return Weight();
+}
+
+float CalibrationCurve::getFactor() const
+{
+    if (count == 0)
+    {
+        return 1.0f;
+    }
+
+    return points[count - 1].counts / points[count - 1].grams;
+}
+
+#ifdef ARDUINO
+void CalibrationCurve::print() const
+{
+    Serial.printf("calibration: %u points, factor=%.2f\n", count, getFactor());
+    for (uint8_t i = 0; i < count; i++)
+    {
+        Serial.printf("  %.3fg = %ld counts\n", points[i].grams, (long)points[i].counts);
+    }
+}
+#endif
@@ -0,0 +1,64 @@
+#include "capture_format.h"
+#include <string.h>
+
+void encodeCaptureRecord(const RawSample &sample, uint8_t *record)
+{
+    record[0] = sample.counts & 0xFF;
+    record[1] = (sample.counts >> 8) & 0xFF;
+    record[2] = (sample.counts >> 16) & 0xFF;
+    record[3] = sample.timestampUs & 0xFF;
+    record[4] = (sample.timestampUs >> 8) & 0xFF;
+    record[5] = (sample.timestampUs >> 16) & 0xFF;
+    record[6] = (sample.timestampUs >> 24) & 0xFF;
+}
+
+void decodeCaptureRecord(const uint8_t *record, RawSample &sample)
+{
+    uint32_t counts = record[0] | (record[1] << 8) | (record[2] << 16);
+    // sign extend from 24 to 32 bits
+    if (counts & 0x800000)
+    {
+        counts |= 0xFF000000;
+    }
+
+    sample.counts = (int32_t)counts;
+    sample.timestampUs = record[3] | (record[4] << 8) | (record[5] << 16) | ((uint32_t)record[6] << 24);
+}
+
+size_t captureRecordOffset(const CaptureHeader &header, uint32_t index)
+{
+    uint32_t oldest = (header.head + header.capacity - header.count) % header.capacity;
+    return sizeof(CaptureHeader) + (size_t)((oldest + index) % header.capacity) * CAPTURE_RECORD_SIZE;
+}
+
+bool parseCapture(const uint8_t *data, size_t size, std::vector<RawSample> &samples)
+{
+    CaptureHeader header;
+    if (size < sizeof(header))
+    {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != CAPTURE_MAGIC || header.recordSize != CAPTURE_RECORD_SIZE || header.capacity == 0 ||
+        header.count > header.capacity)
+    {
+        return false;
+    }
+
+    samples.clear();
+    samples.reserve(header.count);
+    for (uint32_t i = 0; i < header.count; i++)
+    {
+        size_t offset = captureRecordOffset(header, i);
+        if (offset + CAPTURE_RECORD_SIZE > size)
+        {
+            return false;
+        }
+
+        RawSample sample;
+        decodeCaptureRecord(data + offset, sample);
+        samples.push_back(sample);
+    }
+
+    return true;
+}
@@ -0,0 +1,135 @@
+#include "consumption_forecast.h"
+#include "scale.h"
+
+#define SECONDS_PER_DAY 86400.0f
+
+bool ConsumptionForecast::record(Weight amount, uint32_t now)
+{
+    if (now < FORECAST_MIN_VALID_TIME)
+    {
+        return false;
+    }
+
+    if (state.lastTime == 0 || now < state.lastTime)
+    {
+        // nothing to measure the first withdrawal against, it only starts the clock
+        state.firstTime = now;
+        state.lastTime = now;
+        return true;
+    }
+
+    float grams = amount.toGrams();
+    float elapsed = now - state.lastTime;
+    state.lastTime = now;
+
+    // refills and outliers still count as time the bag was in use, just not as consumption
+    bool outlier = grams > FORECAST_MAX_DOSE ||
+                   (state.accepted >= FORECAST_MIN_DOSES && state.doseDeviation > 0.0f &&
+                    grams > state.doseMean + FORECAST_OUTLIER_DEVIATIONS * state.doseDeviation);
+    if (grams <= 0.0f || outlier)
+    {
+        grams = 0.0f;
+        if (outlier)
+        {
+            state.rejected++;
+        }
+    }
+
+    float decay = exp2f(-elapsed / (FORECAST_HALF_LIFE_DAYS * SECONDS_PER_DAY));
+    state.decayedGrams = state.decayedGrams * decay + grams;
+    state.decayedSeconds = state.decayedSeconds * decay + elapsed;
+
+    if (grams > 0.0f)
+    {
+        if (state.accepted == 0)
+        {
+            state.doseMean = grams;
+        }
+        else
+        {
+            state.doseDeviation += (fabsf(grams - state.doseMean) - state.doseDeviation) * FORECAST_DOSE_ALPHA;
+            state.doseMean += (grams - state.doseMean) * FORECAST_DOSE_ALPHA;
+        }
+        state.accepted++;
+    }
+
+    return true;
+}
+
+bool ConsumptionForecast::isConfident()
+{
+    return state.accepted >= FORECAST_MIN_DOSES &&
+           state.lastTime - state.firstTime >= FORECAST_MIN_SPAN_DAYS * SECONDS_PER_DAY &&
+           getRate() > 0.0f;
+}
+
+float ConsumptionForecast::getRate()
+{
+    if (state.decayedSeconds <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    return state.decayedGrams / state.decayedSeconds * SECONDS_PER_DAY;
+}
+
+float ConsumptionForecast::daysUntilEmpty(Weight remaining)
+{
+    float rate = getRate();
+    if (rate <= 0.0f)
+    {
+        return -1.0f;
+    }
+
+    return max(remaining.toGrams(), 0.0f) / rate;
+}
+
+Weight ConsumptionForecast::reorderPoint(float leadDays, float extraDays)
+{
+    float grams = getRate() * (leadDays + FORECAST_SAFETY_DAYS + extraDays);
+    return Weight::grams(constrain(grams, FORECAST_MIN_THRESHOLD, TERMINAL_COFFEE_WEIGHT));
+}
+
+void ConsumptionForecast::print(Weight remaining, float leadDays)
+{
+    Serial.printf("forecast: %.1fg/day, %s, %u doses (%u rejected), dose %.1fg +/- %.1fg\n",
+                  getRate(), isConfident() ? "confident" : "learning", state.accepted, state.rejected,
+                  state.doseMean, state.doseDeviation);
+    Serial.printf("  %s left, %.1f days until empty, lead time %.1f days, reorder at %s, prompt at %s\n",
+                  weightText(remaining, 1).c_str(), daysUntilEmpty(remaining), leadDays,
+                  weightText(reorderPoint(leadDays, FORECAST_BUTTON_EXTRA_DAYS), 0).c_str(),
+                  weightText(reorderPoint(leadDays), 0).c_str());
+}
+
+float parseLeadTimeDays(const String &timeframe)
+{
+    long longest = 0;
+    long number = -1;
+    for (size_t i = 0; i <= timeframe.length(); i++)
+    {
+        char c = i < timeframe.length() ? timeframe[i] : '\0';
+        if (isDigit(c))
+        {
+            number = (number < 0 ? 0 : number * 10) + (c - '0');
+            continue;
+        }
+        if (number >= 0)
+        {
+            longest = max(longest, number);
+            number = -1;
+        }
+    }
+
+    String lower = timeframe;
+    lower.toLowerCase();
+    float days = longest;
+    if (lower.indexOf("week") >= 0)
+    {
+        days *= 7.0f;
+    }
+    else if (lower.indexOf("business") >= 0)
+    {
+        days *= 7.0f / 5.0f;
+    }
+    return days;
+}
@@ -0,0 +1,159 @@
+#include "consumption_tracker.h"
+
+// CUSUM tuning as weights, so the per-conversion update is integer only
+static constexpr Weight cusumDrift = Weight::grams(CUSUM_DRIFT);
+static constexpr Weight cusumThreshold = Weight::grams(CUSUM_THRESHOLD);
+static constexpr Weight minDose = Weight::grams(CONSUMPTION_MIN_DOSE);
+
+bool ConsumptionTracker::update(Weight weight, bool stable, Weight stableValue, Weight removedBelow, uint32_t nowMs)
+{
+    switch (state)
+    {
+    case WAITING_FOR_REFERENCE:
+        if (stable && stableValue >= removedBelow)
+        {
+            reference = stableValue;
+            positiveSum = Weight();
+            negativeSum = Weight();
+            state = ON_SURFACE;
+        }
+        return false;
+
+    case ON_SURFACE:
+    {
+        Weight deviation = weight - reference;
+        positiveSum = max(Weight(), positiveSum + deviation - cusumDrift);
+        negativeSum = max(Weight(), negativeSum - deviation - cusumDrift);
+
+        if (positiveSum > cusumThreshold || negativeSum > cusumThreshold)
+        {
+            weightBefore = reference;
+            changeStartMs = nowMs;
+            lifted = false;
+            settling = false;
+            state = CHANGING;
+            return false;
+        }
+
+        // follow slow creep so it never adds up to a change
+        if (stable)
+        {
+            reference = stableValue;
+        }
+        return false;
+    }
+
+    case CHANGING:
+        if (weight < removedBelow)
+        {
+            lifted = true;
+        }
+
+        // only a value that settled after the change started closes it
+        if (!stable)
+        {
+            settling = true;
+            return false;
+        }
+
+        if (!settling)
+        {
+            return false;
+        }
+
+        if (stableValue < removedBelow)
+        {
+            // settled with the bag off the plate, wait for it to come back
+            settling = false;
+            return false;
+        }
+
+        {
+            ConsumptionEvent event;
+            event.amount = weightBefore - stableValue;
+            event.timestampMs = nowMs;
+            event.durationMs = nowMs - changeStartMs;
+
+            if (event.amount >= minDose)
+            {
+                event.kind = lifted ? WithdrawalKind::LIFTED : WithdrawalKind::SCOOPED;
+            }
+            else if (event.amount <= -minDose)
+            {
+                event.kind = WithdrawalKind::REFILL;
+            }
+            else
+            {
+                event.kind = WithdrawalKind::NONE;
+            }
+
+            reference = stableValue;
+            positiveSum = Weight();
+            negativeSum = Weight();
+            state = ON_SURFACE;
+
+            if (event.kind == WithdrawalKind::NONE)
+            {
+                return false;
+            }
+
+            record(event);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ConsumptionTracker::record(const ConsumptionEvent &event)
+{
+    log[logHead] = event;
+    logHead = (logHead + 1) % CONSUMPTION_LOG_SIZE;
+    if (logCount < CONSUMPTION_LOG_SIZE)
+    {
+        logCount++;
+    }
+
+    if (event.amount > Weight())
+    {
+        totalConsumed += event.amount;
+    }
+}
+
+void ConsumptionTracker::reset()
+{
+    state = WAITING_FOR_REFERENCE;
+    positiveSum = Weight();
+    negativeSum = Weight();
+    lifted = false;
+    settling = false;
+}
+
+void ConsumptionTracker::printLog()
+{
+    Serial.printf("consumption: total=%s events=%u\n", weightText(totalConsumed, 1).c_str(), logCount);
+
+    uint8_t start = (logHead + CONSUMPTION_LOG_SIZE - logCount) % CONSUMPTION_LOG_SIZE;
+    for (uint8_t i = 0; i < logCount; i++)
+    {
+        const ConsumptionEvent &event = log[(start + i) % CONSUMPTION_LOG_SIZE];
+        Serial.printf("  t=%lums %s %s took=%lums\n",
+                      (unsigned long)event.timestampMs, withdrawalKindName(event.kind),
+                      weightText(event.amount, 1).c_str(), (unsigned long)event.durationMs);
+    }
+}
+
+const char *withdrawalKindName(WithdrawalKind kind)
+{
+    switch (kind)
+    {
+    case WithdrawalKind::LIFTED:
+        return "lifted";
+    case WithdrawalKind::SCOOPED:
+        return "scooped";
+    case WithdrawalKind::REFILL:
+        return "refill";
+    default:
+        return "none";
+    }
+}
@@ -7,5 +7,7 @@
 // #define WEIGHING_UI_DEBUG
 #define SERIAL_LISTEN
 // #define LED_SCROLL_INDICATOR_DEBUG
+// enables the `synthetic` serial command, tools/pipeline_bench.cpp benchmarks the pipeline on a host
+// #define SCALE_BENCHMARK
 
 #endif
\ No newline at end of file
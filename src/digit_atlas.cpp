@@ -0,0 +1,144 @@
+#include "digit_atlas.h"
+
+bool DigitAtlas::begin(const GFXfont *font, const char *chars)
+{
+    this->font = font;
+
+    for (const char *c = chars; *c; c++)
+    {
+        if ((uint8_t)*c >= 128 || (uint8_t)*c < font->first || (uint8_t)*c > font->last || lookup[(uint8_t)*c] >= 0)
+        {
+            continue;
+        }
+
+        const GFXglyph &source = font->glyph[*c - font->first];
+        Glyph glyph = {source.xOffset, source.yOffset, source.width, source.height,
+                       (uint8_t)((source.width + 1) / 2), nullptr};
+
+        // GFX bitmaps are one bit per pixel, packed across rows
+        if (glyph.width > 0 && glyph.height > 0)
+        {
+            glyph.pixels = new uint8_t[glyph.stride * glyph.height]();
+            const uint8_t *bits = font->bitmap + source.bitmapOffset;
+            uint32_t bit = 0;
+            for (uint8_t row = 0; row < glyph.height; row++)
+            {
+                for (uint8_t col = 0; col < glyph.width; col++, bit++)
+                {
+                    if (bits[bit >> 3] & (0x80 >> (bit & 7)))
+                    {
+                        glyph.pixels[row * glyph.stride + col / 2] |= (col & 1) ? 0x0F : 0xF0;
+                    }
+                }
+            }
+        }
+
+        lookup[(uint8_t)*c] = glyphs.size();
+        glyphs.push_back(glyph);
+    }
+
+    return !glyphs.empty();
+}
+
+bool DigitAtlas::covers(const char *text)
+{
+    for (const char *c = text; *c; c++)
+    {
+        if ((uint8_t)*c >= 128 || lookup[(uint8_t)*c] < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int16_t DigitAtlas::textWidth(const char *text)
+{
+    if (font == nullptr)
+    {
+        return 0;
+    }
+
+    int16_t width = 0;
+    for (const char *c = text; *c; c++)
+    {
+        if ((uint8_t)*c < font->first || (uint8_t)*c > font->last)
+        {
+            continue;
+        }
+
+        // the last glyph may reach past its advance
+        const GFXglyph &glyph = font->glyph[*c - font->first];
+        width += c[1] ? glyph.xAdvance : glyph.xOffset + glyph.width;
+    }
+    return width;
+}
+
+void DigitAtlas::blit(uint8_t *image, int16_t imageWidth, int16_t imageHeight, const Glyph &glyph, int16_t x, int16_t y, uint8_t color)
+{
+    const int16_t imageStride = imageWidth / 2;
+    const uint8_t colorByte = (color << 4) | (color & 0x0F);
+    const int16_t left = x + glyph.xOffset;
+    const int16_t top = y + glyph.yOffset;
+    // glyphs on an odd column straddle bytes, every byte takes a nibble from two of the glyph's
+    const bool odd = left & 1;
+    const int16_t firstByte = left >> 1;
+    const int16_t bytes = glyph.stride + (odd ? 1 : 0);
+
+    for (uint8_t row = 0; row < glyph.height; row++)
+    {
+        const int16_t imageRow = top + row;
+        if (imageRow < 0 || imageRow >= imageHeight)
+        {
+            continue;
+        }
+
+        uint8_t *out = image + imageRow * imageStride;
+        const uint8_t *in = glyph.pixels + row * glyph.stride;
+        for (int16_t i = 0; i < bytes; i++)
+        {
+            const int16_t column = firstByte + i;
+            if (column < 0 || column >= imageStride)
+            {
+                continue;
+            }
+
+            uint8_t mask = in[i];
+            if (odd)
+            {
+                mask = (i > 0 ? (uint8_t)(in[i - 1] << 4) : 0) | (i < glyph.stride ? in[i] >> 4 : 0);
+            }
+            out[column] = (out[column] & ~mask) | (colorByte & mask);
+        }
+    }
+}
+
+int16_t DigitAtlas::draw(TFT_eSprite &canvas, const char *text, int16_t x, int16_t baseline, uint8_t color)
+{
+    uint8_t *image = (uint8_t *)canvas.getPointer();
+    if (font == nullptr)
+    {
+        return x;
+    }
+    if (image == nullptr || canvas.getColorDepth() != 4 || !covers(text))
+    {
+        canvas.setFreeFont(font);
+        canvas.setTextColor(color);
+        canvas.setCursor(x, baseline);
+        canvas.print(text);
+        return canvas.getCursorX();
+    }
+
+    const int16_t width = canvas.width();
+    const int16_t height = canvas.height();
+    for (const char *c = text; *c; c++)
+    {
+        const Glyph &glyph = glyphs[lookup[(uint8_t)*c]];
+        if (glyph.pixels != nullptr)
+        {
+            blit(image, width, height, glyph, x, baseline, color);
+        }
+        x += font->glyph[*c - font->first].xAdvance;
+    }
+    return x;
+}
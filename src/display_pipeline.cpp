@@ -0,0 +1,147 @@
+#include "display_pipeline.h"
+#include <esp_heap_caps.h>
+
+bool DisplayPipeline::begin()
+{
+    lock = xSemaphoreCreateRecursiveMutex();
+
+    for (uint16_t *&buffer : buffers)
+    {
+        buffer = (uint16_t *)heap_caps_malloc(DISPLAY_BUFFER_PIXELS * sizeof(uint16_t), MALLOC_CAP_DMA);
+        if (buffer == nullptr)
+        {
+            Serial.println("Not enough DMA memory for the display buffers");
+            heap_caps_free(buffers[0]);
+            buffers[0] = nullptr;
+            return false;
+        }
+    }
+
+    dma = tft.initDMA();
+    if (!dma)
+    {
+        Serial.println("Display DMA unavailable, pushing pixels without it");
+    }
+    return true;
+}
+
+void DisplayPipeline::start()
+{
+    if (lock != nullptr)
+    {
+        xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    }
+
+    if (depth++ == 0)
+    {
+        batchStarted = micros();
+        // buffers are already in the panel's byte order
+        swapBytes = tft.getSwapBytes();
+        tft.setSwapBytes(false);
+        tft.startWrite();
+        stats.batches++;
+    }
+}
+
+void DisplayPipeline::end()
+{
+    if (depth == 0)
+    {
+        return;
+    }
+
+    if (--depth == 0)
+    {
+        wait();
+        tft.endWrite();
+        tft.setSwapBytes(swapBytes);
+        stats.micros += micros() - batchStarted;
+    }
+
+    if (lock != nullptr)
+    {
+        xSemaphoreGiveRecursive(lock);
+    }
+}
+
+void DisplayPipeline::wait()
+{
+    if (!dma)
+    {
+        return;
+    }
+
+    uint32_t started = micros();
+    tft.dmaWait();
+    stats.waitMicros += micros() - started;
+}
+
+void DisplayPipeline::push(int16_t x, int16_t y, uint16_t width, uint16_t height)
+{
+    if (!isReady() || width == 0 || height == 0)
+    {
+        return;
+    }
+
+    uint16_t *pixels = buffers[current];
+    if (dma)
+    {
+        // the other buffer has to be out before this one goes, pushImageDMA would wait anyway
+        wait();
+        tft.pushImageDMA(x, y, width, height, pixels);
+    }
+    else
+    {
+        tft.pushImage(x, y, width, height, pixels);
+    }
+    current ^= 1;
+
+    stats.transfers++;
+    stats.pixels += (uint32_t)width * height;
+}
+
+void DisplayPipeline::fillRect(int16_t x, int16_t y, int16_t width, int16_t height, uint16_t color)
+{
+    if (width <= 0 || height <= 0)
+    {
+        return;
+    }
+    if (!isReady() || width > DISPLAY_BUFFER_PIXELS)
+    {
+        tft.fillRect(x, y, width, height, color);
+        return;
+    }
+
+    const uint16_t wire = (color >> 8) | (color << 8);
+    const int16_t lines = DISPLAY_BUFFER_PIXELS / width;
+
+    start();
+    for (int16_t row = 0; row < height; row += lines)
+    {
+        const int16_t band = min(lines, (int16_t)(height - row));
+        uint16_t *pixels = buffer();
+        for (uint32_t i = 0; i < (uint32_t)width * band; i++)
+        {
+            pixels[i] = wire;
+        }
+        push(x, y + row, width, band);
+    }
+    end();
+}
+
+void DisplayPipeline::printStats()
+{
+    if (stats.batches == 0)
+    {
+        Serial.println("Display: nothing sent");
+        return;
+    }
+
+    Serial.printf("Display: %s, %u batches, %u transfers, %llu pixels per batch, %llu us per batch, %llu us of it waiting for the panel\n",
+                  dma ? "DMA" : "no DMA",
+                  stats.batches,
+                  stats.transfers,
+                  stats.pixels / stats.batches,
+                  stats.micros / stats.batches,
+                  stats.waitMicros / stats.batches);
+}
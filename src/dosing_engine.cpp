@@ -0,0 +1,178 @@
+#include "dosing_engine.h"
+
+void DosingEngine::begin()
+{
+    if (DOSE_STOP_PIN >= 0)
+    {
+        pinMode(DOSE_STOP_PIN, OUTPUT);
+    }
+    setStop(false);
+}
+
+void DosingEngine::restore(const DoseLearning &saved)
+{
+    leadMs = constrain(saved.leadMs, 0.0f, DOSE_MAX_LEAD_MS);
+    doses = saved.doses;
+}
+
+DoseLearning DosingEngine::getLearning()
+{
+    DoseLearning learning;
+    learning.leadMs = leadMs;
+    learning.doses = doses;
+    return learning;
+}
+
+void DosingEngine::setTarget(float grams)
+{
+    target = grams;
+    reset();
+}
+
+void DosingEngine::reset()
+{
+    state = DoseState::IDLE;
+    count = 0;
+    head = 0;
+    flowRate = 0.0f;
+    setStop(false);
+}
+
+void DosingEngine::setStop(bool active)
+{
+    stopActive = active;
+    if (DOSE_STOP_PIN >= 0)
+    {
+        digitalWrite(DOSE_STOP_PIN, active ? DOSE_STOP_ACTIVE_LEVEL : !DOSE_STOP_ACTIVE_LEVEL);
+    }
+}
+
+void DosingEngine::fit()
+{
+    // least squares line through the window, time relative to the newest conversion so the
+    // intercept is the current weight
+    uint8_t newest = (head + DOSE_FLOW_WINDOW - 1) % DOSE_FLOW_WINDOW;
+    float sumT = 0.0f, sumW = 0.0f, sumTT = 0.0f, sumTW = 0.0f;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t index = (newest + DOSE_FLOW_WINDOW - i) % DOSE_FLOW_WINDOW;
+        float t = -(float)(timestamps[newest] - timestamps[index]) / 1000000.0f;
+        float w = weights[index];
+
+        sumT += t;
+        sumW += w;
+        sumTT += t * t;
+        sumTW += t * w;
+    }
+
+    float denominator = count * sumTT - sumT * sumT;
+    if (denominator <= 0.0f)
+    {
+        flowRate = 0.0f;
+        fittedWeight = sumW / count;
+        return;
+    }
+
+    flowRate = (count * sumTW - sumT * sumW) / denominator;
+    fittedWeight = (sumW - flowRate * sumT) / count;
+}
+
+bool DosingEngine::update(float weight, uint32_t timestampUs, bool stable, float stableValue)
+{
+    weights[head] = weight;
+    timestamps[head] = timestampUs;
+    head = (head + 1) % DOSE_FLOW_WINDOW;
+    if (count < DOSE_FLOW_WINDOW)
+    {
+        count++;
+    }
+
+    if (count < 4 || target <= 0.0f)
+    {
+        return false;
+    }
+
+    fit();
+
+    float latency = (micros() - timestampUs) / 1000.0f;
+    latencyMs += (latency - latencyMs) * 0.1f;
+
+    switch (state)
+    {
+    case DoseState::IDLE:
+        if (fittedWeight > DOSE_START_WEIGHT && fittedWeight < target && flowRate > DOSE_START_FLOW)
+        {
+            state = DoseState::DOSING;
+            return true;
+        }
+        return false;
+
+    case DoseState::DOSING:
+    {
+        if (fittedWeight < DOSE_START_WEIGHT)
+        {
+            // cup removed or tared before reaching the target
+            state = DoseState::IDLE;
+            return true;
+        }
+
+        float predicted = fittedWeight + max(flowRate, 0.0f) * (leadMs + latencyMs) / 1000.0f;
+        if (predicted < target)
+        {
+            return false;
+        }
+
+        weightAtStop = fittedWeight;
+        flowAtStop = flowRate;
+        setStop(true);
+        state = DoseState::STOPPED;
+        return true;
+    }
+
+    case DoseState::STOPPED:
+        if (fittedWeight < DOSE_START_WEIGHT)
+        {
+            // taken away before it settled, nothing to learn from
+            reset();
+            return true;
+        }
+
+        if (!stable)
+        {
+            return false;
+        }
+
+        lastOvershoot = stableValue - target;
+        doses++;
+
+        // whatever landed after the stop took this long at the flow we stopped at
+        if (flowAtStop > DOSE_START_FLOW)
+        {
+            float observedLeadMs = (stableValue - weightAtStop) / flowAtStop * 1000.0f - latencyMs;
+            leadMs += (constrain(observedLeadMs, 0.0f, DOSE_MAX_LEAD_MS) - leadMs) * DOSE_LEARNING_RATE;
+        }
+
+        Serial.printf("Dose %lu: %.2fg (%+.2fg), lead now %.0fms\n", (unsigned long)doses, stableValue, lastOvershoot, leadMs);
+        state = DoseState::SETTLED;
+        return true;
+
+    case DoseState::SETTLED:
+        if (fittedWeight < DOSE_START_WEIGHT)
+        {
+            reset();
+            return true;
+        }
+        return false;
+    }
+
+    return false;
+}
+
+void DosingEngine::printStats()
+{
+    Serial.printf("dosing: target=%.1fg state=%d flow=%.2fg/s weight=%.2fg\n",
+                  target, (int)state, flowRate, fittedWeight);
+    Serial.printf("  latency=%.0fms lead=%.0fms doses=%lu last overshoot=%+.2fg\n",
+                  latencyMs, leadMs, (unsigned long)doses, lastOvershoot);
+}
@@ -0,0 +1,160 @@
+#include "fleet_reporter.h"
+
+static_assert(FLEET_HEADER_SIZE + 1 + SCALE_MAX_CHANNELS * 11 <= FLEET_MAX_DATAGRAM, "every channel fits into one datagram");
+
+static uint8_t *put(uint8_t *out, const void *value, size_t size)
+{
+    memcpy(out, value, size);
+    return out + size;
+}
+
+void FleetReporter::begin(const char *host, uint16_t port)
+{
+    if (isRunning())
+    {
+        return;
+    }
+
+    this->host = host;
+    this->port = port;
+    // the part of the MAC address that isn't the vendor prefix
+    device = (uint32_t)(ESP.getEfuseMac() >> 16);
+    boot = esp_random();
+
+    events = xQueueCreate(FLEET_EVENT_QUEUE_LENGTH, sizeof(ScaleEvent));
+    scale.addEventListener(events);
+    udp.begin(0);
+
+    xTaskCreate(
+        reportTask,
+        "FleetReporter",
+        4096,
+        this,
+        FLEET_TASK_PRIORITY,
+        &taskHandle);
+
+    Serial.printf("Reporting to %s:%u as device %08x\n", host, port, device);
+}
+
+uint8_t *FleetReporter::header(uint8_t *out, FleetDatagramType type)
+{
+    uint16_t magic = FLEET_MAGIC;
+    uint32_t uptime = millis();
+    out = put(out, &magic, sizeof(magic));
+    *out++ = FLEET_VERSION;
+    *out++ = (uint8_t)type;
+    out = put(out, &device, sizeof(device));
+    out = put(out, &boot, sizeof(boot));
+    out = put(out, &sequence, sizeof(sequence));
+    out = put(out, &uptime, sizeof(uptime));
+    sequence++;
+    return out;
+}
+
+void FleetReporter::send(const uint8_t *datagram, size_t length)
+{
+    if (!WiFi.isConnected())
+    {
+        return;
+    }
+
+    udp.beginPacket(host, port);
+    udp.write(datagram, length);
+    udp.endPacket();
+}
+
+void FleetReporter::sendWeights()
+{
+    uint8_t datagram[FLEET_MAX_DATAGRAM];
+    uint8_t *out = header(datagram, FleetDatagramType::WEIGHT);
+
+    uint8_t channels = scale.getChannelCount();
+    *out++ = channels;
+    for (uint8_t channel = 0; channel < channels; channel++)
+    {
+        WeightSample sample = scale.getSample(channel);
+        int32_t weight = sample.value.toMilligrams();
+        int32_t stable = sample.stableValue.toMilligrams();
+        *out++ = channel;
+        out = put(out, &sample.flags, sizeof(sample.flags));
+        out = put(out, &weight, sizeof(weight));
+        out = put(out, &stable, sizeof(stable));
+    }
+
+    send(datagram, out - datagram);
+}
+
+void FleetReporter::sendEvent(const ScaleEvent &event)
+{
+    memmove(&recentEvents[0], &recentEvents[1], sizeof(ScaleEvent) * (FLEET_EVENT_REDUNDANCY - 1));
+    recentEvents[FLEET_EVENT_REDUNDANCY - 1] = event;
+    eventSequence++;
+
+    uint8_t datagram[FLEET_MAX_DATAGRAM];
+    uint8_t *out = header(datagram, FleetDatagramType::EVENT);
+
+    uint8_t count = min(eventSequence, (uint32_t)FLEET_EVENT_REDUNDANCY);
+    *out++ = count;
+    for (uint8_t i = FLEET_EVENT_REDUNDANCY - count; i < FLEET_EVENT_REDUNDANCY; i++)
+    {
+        const ScaleEvent &recent = recentEvents[i];
+        uint32_t number = eventSequence - (FLEET_EVENT_REDUNDANCY - 1 - i);
+        int32_t weight = recent.weight.toMilligrams();
+        out = put(out, &number, sizeof(number));
+        *out++ = (uint8_t)recent.type;
+        *out++ = recent.channel;
+        out = put(out, &weight, sizeof(weight));
+        out = put(out, &recent.timestampUs, sizeof(recent.timestampUs));
+    }
+
+    send(datagram, out - datagram);
+}
+
+void FleetReporter::sendHealth()
+{
+    uint8_t datagram[FLEET_MAX_DATAGRAM];
+    uint8_t *out = header(datagram, FleetDatagramType::HEALTH);
+
+    uint32_t freeHeap = ESP.getFreeHeap();
+    int8_t rssi = WiFi.RSSI();
+    HealthCounters counters = scale.getHealthCounters();
+    out = put(out, &freeHeap, sizeof(freeHeap));
+    *out++ = (uint8_t)rssi;
+    out = put(out, &counters.conversions, sizeof(uint32_t));
+    out = put(out, &counters.conversionsDropped, sizeof(uint32_t));
+    out = put(out, &counters.gaps, sizeof(uint32_t));
+    out = put(out, &counters.missedConversions, sizeof(uint32_t));
+    out = put(out, &counters.saturated, sizeof(uint32_t));
+    out = put(out, &counters.stuckRuns, sizeof(uint32_t));
+    out = put(out, &counters.staleReadings, sizeof(uint32_t));
+
+    send(datagram, out - datagram);
+}
+
+void FleetReporter::reportTask(void *parameter)
+{
+    FleetReporter *reporter = static_cast<FleetReporter *>(parameter);
+
+    while (true)
+    {
+        unsigned long elapsed = millis() - reporter->lastWeightTime;
+        TickType_t wait = elapsed >= FLEET_WEIGHT_INTERVAL_MS ? 0 : pdMS_TO_TICKS(FLEET_WEIGHT_INTERVAL_MS - elapsed);
+
+        ScaleEvent event;
+        if (xQueueReceive(reporter->events, &event, wait) == pdTRUE)
+        {
+            reporter->sendEvent(event);
+            continue;
+        }
+
+        unsigned long now = millis();
+        reporter->lastWeightTime = now;
+        reporter->sendWeights();
+
+        if (reporter->lastHealthTime == 0 || now - reporter->lastHealthTime >= FLEET_HEALTH_INTERVAL_MS)
+        {
+            reporter->lastHealthTime = now;
+            reporter->sendHealth();
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#include "histogram.h"
+
+static uint32_t bucketUpperBound(uint8_t bucket)
+{
+    return bucket == 0 ? 0 : (bucket >= 32 ? UINT32_MAX : (1UL << bucket) - 1);
+}
+
+void Histogram::reset()
+{
+    for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        buckets[i] = 0;
+    }
+    count = 0;
+    minValue = UINT32_MAX;
+    maxValue = 0;
+    sum = 0;
+}
+
+uint32_t Histogram::percentile(float p)
+{
+    uint32_t total = count;
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint32_t rank = ceilf(total * p / 100.0f);
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            // no point reporting more than was actually seen
+            return min(bucketUpperBound(i), (uint32_t)maxValue);
+        }
+    }
+
+    return maxValue;
+}
+
+void Histogram::print(const char *name, const char *unit, float scale)
+{
+    Serial.printf("%s: n=%lu min=%.1f avg=%.1f p50<=%.1f p99<=%.1f max=%.1f %s\n", name,
+                  (unsigned long)count, getMin() / scale, getAverage() / scale,
+                  percentile(50) / scale, percentile(99) / scale, getMax() / scale, unit);
+
+    for (uint8_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        uint32_t n = buckets[i];
+        if (n == 0)
+        {
+            continue;
+        }
+
+        uint32_t low = i == 0 ? 0 : 1UL << (i - 1);
+        Serial.printf("  %10.1f - %10.1f %s: %lu\n", low / scale, bucketUpperBound(i) / scale, unit, (unsigned long)n);
+    }
+}
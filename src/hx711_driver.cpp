@@ -0,0 +1,113 @@
+#include "hx711_driver.h"
+
+Hx711Driver::Hx711Driver(int dt_pin, int sck_pin)
+    : PIN_DT(dt_pin),
+      PIN_SCK(sck_pin)
+{
+}
+
+void Hx711Driver::begin(bool highRate)
+{
+    pinMode(PIN_SCK, OUTPUT);
+    pinMode(PIN_DT, INPUT_PULLUP);
+
+    if (HX711_RATE_PIN >= 0)
+    {
+        pinMode(HX711_RATE_PIN, OUTPUT);
+        digitalWrite(HX711_RATE_PIN, highRate ? HIGH : LOW);
+    }
+
+    // GPIO 32 and up live in the second bank of registers
+    if (PIN_SCK < 32)
+    {
+        sckSet = (volatile uint32_t *)GPIO_OUT_W1TS_REG;
+        sckClear = (volatile uint32_t *)GPIO_OUT_W1TC_REG;
+        sckMask = 1UL << PIN_SCK;
+    }
+    else
+    {
+        sckSet = (volatile uint32_t *)GPIO_OUT1_W1TS_REG;
+        sckClear = (volatile uint32_t *)GPIO_OUT1_W1TC_REG;
+        sckMask = 1UL << (PIN_SCK - 32);
+    }
+
+    dtIn = (volatile uint32_t *)(PIN_DT < 32 ? GPIO_IN_REG : GPIO_IN1_REG);
+    dtMask = 1UL << (PIN_DT < 32 ? PIN_DT : PIN_DT - 32);
+
+    halfPeriodCycles = getCpuFrequencyMhz() * HX711_CLOCK_HALF_PERIOD_NS / 1000;
+
+    *sckClear = sckMask;
+}
+
+inline void IRAM_ATTR Hx711Driver::waitCycles(uint32_t start, uint32_t cycles)
+{
+    while (ESP.getCycleCount() - start < cycles)
+    {
+    }
+}
+
+int32_t IRAM_ATTR Hx711Driver::read()
+{
+    uint32_t start = ESP.getCycleCount();
+    uint32_t value = 0;
+    uint8_t pulses = 24 + gain;
+
+    for (uint8_t i = 0; i < pulses; i++)
+    {
+        // Only the high phase is timing critical: if anything stretches it past 60us the chip
+        // powers down. The low phase may be interrupted freely, so the lock covers one bit at a time
+        portENTER_CRITICAL_SAFE(&clockMux);
+        *sckSet = sckMask;
+        waitCycles(ESP.getCycleCount(), halfPeriodCycles);
+        bool bit = (*dtIn & dtMask) != 0;
+        *sckClear = sckMask;
+        portEXIT_CRITICAL_SAFE(&clockMux);
+
+        if (i < 24)
+        {
+            value = (value << 1) | bit;
+        }
+        waitCycles(ESP.getCycleCount(), halfPeriodCycles);
+    }
+
+    // sign extend from 24 to 32 bits
+    if (value & 0x800000)
+    {
+        value |= 0xFF000000;
+    }
+
+    uint32_t cycles = ESP.getCycleCount() - start;
+    lastReadCycles = cycles;
+    if (cycles > maxReadCycles)
+    {
+        maxReadCycles = cycles;
+    }
+    totalReadCycles += cycles;
+    reads++;
+    readCycles.add(cycles);
+
+    return (int32_t)value;
+}
+
+void Hx711Driver::powerDown()
+{
+    *sckClear = sckMask;
+    *sckSet = sckMask;
+    delayMicroseconds(70);
+}
+
+void Hx711Driver::powerUp()
+{
+    // the chip resets to channel A, gain 128 when it wakes up
+    *sckClear = sckMask;
+    gain = HX711_CHANNEL_A_128;
+}
+
+void Hx711Driver::resetStats()
+{
+    lastReadCycles = 0;
+    maxReadCycles = 0;
+    totalReadCycles = 0;
+    reads = 0;
+    readCycles.reset();
+}
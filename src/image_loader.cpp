@@ -121,6 +121,38 @@ bool ImageLoader::drawPNG(const char *filename, int16_t x, int16_t y)
     return true;
 }
 
+bool ImageLoader::drawPNG(const char *filename, int16_t x, int16_t y, DisplayPipeline &pipeline, uint16_t background)
+{
+    if (!pipeline.isReady())
+    {
+        return drawPNG(filename, x, y);
+    }
+
+    // PNGdec blends onto RGB888
+    this->background = ((background & 0xF800) << 8) | ((background & 0x07E0) << 5) | ((background & 0x001F) << 3);
+    this->pipeline = &pipeline;
+    bandLines = 0;
+
+    pipeline.start();
+    bool drawn = drawPNG(filename, x, y);
+    pushBand();
+    pipeline.end();
+
+    this->pipeline = nullptr;
+    return drawn;
+}
+
+void ImageLoader::pushBand()
+{
+    if (bandLines == 0)
+    {
+        return;
+    }
+
+    pipeline->push(xPos, yPos + bandY, bandWidth, bandLines);
+    bandLines = 0;
+}
+
 // Get image dimensions without drawing
 bool ImageLoader::getImageInfo(const char *filename, uint16_t &width, uint16_t &height)
 {
@@ -215,6 +247,25 @@ void ImageLoader::pngDrawCallback(PNGDRAW *pDraw)
 // Instance method to draw a line of the PNG image
 void ImageLoader::drawPNGLine(PNGDRAW *pDraw)
 {
+    if (pipeline != nullptr)
+    {
+        if (bandLines == 0)
+        {
+            bandY = pDraw->y;
+            bandWidth = pDraw->iWidth;
+        }
+
+        uint16_t *line = pipeline->buffer() + bandLines * bandWidth;
+        png.getLineAsRGB565(pDraw, line, PNG_RGB565_BIG_ENDIAN, background);
+        bandLines++;
+
+        if ((bandLines + 1) * bandWidth > DISPLAY_BUFFER_PIXELS)
+        {
+            pushBand();
+        }
+        return;
+    }
+
     // Allocate a line buffer for the image line
     uint16_t lineBuffer[MAX_IMAGE_WIDTH];
     uint8_t maskBuffer[1 + MAX_IMAGE_WIDTH / 8];
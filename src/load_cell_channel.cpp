@@ -0,0 +1,166 @@
+#include "load_cell_channel.h"
+#include "scale.h"
+
+LoadCellChannel::LoadCellChannel(uint8_t index, int dt_pin, int sck_pin)
+    : index(index),
+      acquisition(dt_pin, sck_pin),
+      reorderThreshold(Weight::grams(REORDER_BUTTON_THRESHOLD).toMilligrams()),
+      promptThreshold(Weight::grams(REORDER_BUTTON_PROMPT_THRESHOLD).toMilligrams())
+{
+}
+
+void LoadCellChannel::begin(ChannelEventHandler handler, void *arg)
+{
+    eventHandler = handler;
+    eventArg = arg;
+    acquisition.begin();
+}
+
+void LoadCellChannel::setCalibration(long zeroOffset, float countsPerGram)
+{
+    pipeline.setOffset(zeroOffset);
+    if (countsPerGram != 0.0f)
+    {
+        pipeline.getCurve().setLinear(countsPerGram);
+    }
+    else
+    {
+        pipeline.getCurve().clear();
+    }
+}
+
+void LoadCellChannel::setThresholds(Weight reorder, Weight prompt)
+{
+    reorderThreshold.store(reorder.toMilligrams(), std::memory_order_relaxed);
+    promptThreshold.store(prompt.toMilligrams(), std::memory_order_relaxed);
+}
+
+Weight LoadCellChannel::bagWeight()
+{
+    return hasBag ? Weight::grams(TERMINAL_COFFEE_BAG_EMPTY_WEIGHT) : Weight();
+}
+
+bool LoadCellChannel::processNext()
+{
+    RawSample sample;
+    if (!acquisition.read(sample))
+    {
+        return false;
+    }
+
+    pipeline.process(sample.counts, bagWeight());
+    lastSampleUs = sample.timestampUs;
+
+    updateCapture(sample.counts);
+    return true;
+}
+
+void LoadCellChannel::startCapture(float grams)
+{
+    captureGrams = grams;
+    captureRemaining = grams == 0.0f ? TARE_CAPTURE_SAMPLES : CALIBRATION_CAPTURE_SAMPLES;
+    captureSum = 0;
+    captureCount = 0;
+    captureStartTime = millis();
+    acquisition.clear();
+    captureState.store(CAPTURE_RUNNING, std::memory_order_release);
+}
+
+void LoadCellChannel::updateCapture(int32_t counts)
+{
+    if (captureRemaining == 0)
+    {
+        return;
+    }
+
+    captureSum += counts;
+    captureCount++;
+    if (--captureRemaining > 0)
+    {
+        return;
+    }
+
+    long average = captureSum / captureCount;
+    if (captureGrams == 0.0f)
+    {
+        pipeline.setOffset(average);
+    }
+    else
+    {
+        long moved = average - pipeline.getOffset();
+        float factor = moved / captureGrams;
+        if (fabsf(factor) < 1.0f)
+        {
+            Serial.printf("Channel %u: %.1fg only moved the reading by %ld counts\n", index, captureGrams, moved);
+            captureState.store(CAPTURE_FAILED, std::memory_order_release);
+            return;
+        }
+        pipeline.getCurve().setLinear(factor);
+    }
+
+    pipeline.restart();
+    captureState.store(CAPTURE_DONE, std::memory_order_release);
+}
+
+void LoadCellChannel::update()
+{
+    if (captureRemaining > 0 && millis() - captureStartTime >= CAPTURE_TIMEOUT_MS)
+    {
+        Serial.printf("Channel %u: capture timed out after %d conversions\n", index, captureCount);
+        captureRemaining = 0;
+        captureState.store(CAPTURE_FAILED, std::memory_order_release);
+    }
+
+    updateBagState();
+
+    WeightSample sample;
+    sample.value = pipeline.getReading();
+    sample.stableValue = pipeline.getStableValue();
+    sample.rawCounts = pipeline.getFilteredCounts();
+    sample.flowRate = 0.0f;
+    sample.timestampUs = lastSampleUs;
+    sample.sequence = ++publishedSequence;
+    sample.flags = 0;
+
+    if (pipeline.hasSamples() && micros() - lastSampleUs <= SAMPLE_STALE_TIMEOUT_US)
+        sample.flags |= WEIGHT_VALID;
+    if (pipeline.isStable())
+        sample.flags |= WEIGHT_STABLE;
+    if (pipeline.hasStableValue())
+        sample.flags |= WEIGHT_HAS_STABLE;
+    if (tracker.isRemoved())
+        sample.flags |= WEIGHT_BAG_REMOVED;
+    if (tracker.isBelowThreshold())
+        sample.flags |= WEIGHT_BELOW_THRESHOLD;
+    if (tracker.isBelowPromptThreshold())
+        sample.flags |= WEIGHT_BELOW_PROMPT_THRESHOLD;
+
+    published.write(sample);
+}
+
+void LoadCellChannel::updateBagState()
+{
+    // same rules as the plate, see Scale::updateBagState
+    if (!hasBag || !pipeline.hasStableValue() || captureRemaining > 0 || pipeline.getCurve().size() == 0)
+    {
+        return;
+    }
+
+    tracker.update(pipeline.getStableValue(), getReorderThreshold(), getPromptThreshold(), handleBagEvent, this);
+}
+
+void LoadCellChannel::handleBagEvent(void *arg, ScaleEventType type, Weight weight)
+{
+    LoadCellChannel *self = static_cast<LoadCellChannel *>(arg);
+    if (self->eventHandler == nullptr)
+    {
+        return;
+    }
+
+    ScaleEvent event;
+    event.type = type;
+    event.weight = weight;
+    event.timestampUs = self->lastSampleUs;
+    event.channel = self->index;
+    self->eventHandler(self->eventArg, event);
+}
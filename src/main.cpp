@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <HX711.h>
 #include <SPI.h>
 #include <TFT_eSPI.h>
 #include <LittleFS.h>
@@ -12,6 +11,10 @@
 #include "buttons.h"
 #include "scale.h"
 #include "store.h"
+#include "weight_history.h"
+#include "scale_server.h"
+#include "fleet_reporter.h"
+#include "peer_coordinator.h"
 #include "debug.h"
 
 #define PIN_DT 27
@@ -24,17 +27,26 @@
 #define PIN_RST 0
 #define PIN_BL 2
 
-HX711 scale;
-
 PreferencesManager preferences = PreferencesManager();
 TFT_eSPI tft = TFT_eSPI();
 LedStrip ledStrip = LedStrip();
 WiFiManager wifi = WiFiManager();
 TerminalApi terminalApi = TerminalApi();
 UI ui = UI(tft, ledStrip, terminalApi, preferences);
-Scale scaleManager(scale, tft, ui, preferences, terminalApi, ledStrip, PIN_DT, PIN_SCK);
+Scale scaleManager(tft, ui, preferences, terminalApi, ledStrip, PIN_DT, PIN_SCK);
+WeightHistory history;
+ScaleServer scaleServer(scaleManager);
+#ifdef FLEET_COLLECTOR_HOST
+FleetReporter fleet(scaleManager);
+#endif
+#ifdef PEER_COORDINATION
+PeerCoordinator peers;
+#endif
 
 void listFiles(const char *dirname);
+void handleCalibrationInput(String input);
+void handleShelfInput(String input);
+void handleHistoryInput(String input);
 
 void setup()
 {
@@ -68,8 +80,12 @@ void setup()
   // Initialize the UI system
   ui.begin(&scaleManager);
 
+  // Extra HX711 boards for a shelf of bags become channels 1, 2, ... in the order they are added
+  // scaleManager.addShelfChannel(32, 33);
+
   // Initialize the scale manager
   scaleManager.begin();
+  history.begin();
 
   auto bounds = ui.typeText("Connecting...", titleText);
   ui.startBlinking();
@@ -83,18 +99,20 @@ void setup()
   if (wifi.isConnected())
   {
     Serial.println("WiFi connected");
+    scaleServer.begin();
+#ifdef FLEET_COLLECTOR_HOST
+    fleet.begin(FLEET_COLLECTOR_HOST, FLEET_COLLECTOR_PORT);
+#endif
+#ifdef PEER_COORDINATION
+    peers.begin();
+    terminalApi.setPeers(&peers);
+#endif
   }
   else
   {
     Serial.println("Failed to connect to WiFi");
   }
 
-  if (!scaleManager.isCalibrated())
-  {
-    Serial.println("Scale not calibrated. Starting calibration mode...");
-    scaleManager.calibrate();
-  }
-
 #ifndef FAST_STARTUP
   ui.terminalAnimation();
 #endif
@@ -106,7 +124,15 @@ void setup()
   preferences.setShouldReorderAutomatically(false);
 
   Serial.println("Startup complete");
-  ui.menu->selectMenu(MAIN_MENU);
+  if (!scaleManager.isCalibrated())
+  {
+    Serial.println("Scale not calibrated. Starting calibration mode...");
+    scaleManager.startCalibration();
+  }
+  else
+  {
+    ui.menu->selectMenu(MAIN_MENU);
+  }
   ui.menu->taint();
   ui.store->taint();
   Serial.println("Startup complete - menu selected");
@@ -115,13 +141,32 @@ void setup()
 void loop()
 {
 #ifdef WEIGHING_UI_DEBUG
-  for (float f = 0; f < TERMINAL_COFFEE_WEIGHT; f += 1.0f)
+  for (Weight w; w < Weight::grams(TERMINAL_COFFEE_WEIGHT); w += Weight::grams(1))
   {
-    ui.drawWeight(f);
+    ui.drawWeight(w);
     delay(100);
   }
 #endif
 
+  // the weighing task queued every second, however long the last pass of the loop took
+  HistoryPoint reading;
+  while (scaleManager.takeHistoryReading(reading))
+  {
+    history.record(reading.time, reading.mean);
+  }
+  if (uint32_t dropped = scaleManager.takeHistoryDropped())
+  {
+    Serial.printf("History queue full, lost %lu readings\n", (unsigned long)dropped);
+  }
+  history.update();
+  scaleServer.update();
+
+  // calibration always listens on serial, the known mass can't be entered any other way
+  if (scaleManager.isCalibrating() && Serial.available())
+  {
+    handleCalibrationInput(Serial.readStringUntil('\n'));
+  }
+
 #ifdef SERIAL_LISTEN
   if (Serial.available())
   {
@@ -135,11 +180,144 @@ void loop()
       Serial.printf("Updated bag name to: %s\n", bagName.c_str());
     }
 
+    if (input.startsWith("filters"))
+    {
+      scaleManager.printFilterStats();
+    }
+
+    if (input.startsWith("sampling"))
+    {
+      scaleManager.printSamplingStats();
+    }
+
+    if (input.startsWith("consumption"))
+    {
+      scaleManager.printConsumptionLog();
+    }
+
+    if (input.startsWith("forecast"))
+    {
+      scaleManager.printForecast();
+    }
+
+    if (input.startsWith("dosing"))
+    {
+      scaleManager.printDosingStats();
+    }
+
+    if (input.startsWith("display"))
+    {
+      ui.printDisplayStats();
+    }
+
+    if (input.startsWith("telemetry "))
+    {
+      String argument = input.substring(10);
+      argument.trim();
+      scaleManager.setTelemetry(argument == "on");
+    }
+
+    if (input.startsWith("health reset"))
+    {
+      scaleManager.resetHealth();
+    }
+    else if (input.startsWith("health"))
+    {
+      scaleManager.printHealth();
+    }
+
+#ifdef PEER_COORDINATION
+    if (input.startsWith("peers"))
+    {
+      peers.printStatus();
+    }
+#endif
+
+    if (input.startsWith("capture "))
+    {
+      String argument = input.substring(8);
+      argument.trim();
+
+      if (argument == "start" || argument == "reset")
+      {
+        scaleManager.startRawCapture(argument == "reset");
+      }
+      else if (argument == "stop")
+      {
+        scaleManager.stopRawCapture();
+      }
+      else if (argument == "dump")
+      {
+        scaleManager.dumpRawCapture();
+      }
+    }
+
+    if (input.startsWith("replay"))
+    {
+      String argument = input.substring(6);
+      argument.trim();
+
+      if (argument == "stop")
+      {
+        scaleManager.stopReplay();
+      }
+      else
+      {
+        // replay speed, defaults to 10x real time
+        scaleManager.startReplay(argument.length() > 0 ? argument.toFloat() : 10.0f);
+      }
+    }
+
+#ifdef SCALE_BENCHMARK
+    // synthetic <scenario> [speed] [seed]
+    if (input.startsWith("synthetic "))
+    {
+      String arguments = input.substring(10);
+      arguments.trim();
+
+      int firstSpace = arguments.indexOf(' ');
+      String name = firstSpace < 0 ? arguments : arguments.substring(0, firstSpace);
+      String rest = firstSpace < 0 ? String("") : arguments.substring(firstSpace + 1);
+      int secondSpace = rest.indexOf(' ');
+      String speed = secondSpace < 0 ? rest : rest.substring(0, secondSpace);
+      String seed = secondSpace < 0 ? String("") : rest.substring(secondSpace + 1);
+
+      SyntheticScenario scenario;
+      if (!parseSyntheticScenario(name.c_str(), scenario))
+      {
+        Serial.println("Scenarios: creep, scoop, swap, pour, mains, spikes");
+      }
+      else
+      {
+        SyntheticConfig config = syntheticDefaults(scenario);
+        if (seed.length() > 0)
+        {
+          config.seed = seed.toInt();
+        }
+        config.speed = speed.length() > 0 ? speed.toFloat() : 1.0f;
+        scaleManager.startSynthetic(config);
+      }
+    }
+#endif
+
+    if (input.startsWith("shelf"))
+    {
+      handleShelfInput(input.substring(5));
+    }
+
+    if (input.startsWith("history"))
+    {
+      handleHistoryInput(input.substring(7));
+    }
+
     if (input.startsWith("calibrate"))
     {
-      Serial.println("Resetting calibration");
-      preferences.deleteCalibrationData();
-      esp_restart();
+      scaleManager.requestCalibration();
+    }
+
+    if (input.startsWith("tare"))
+    {
+      scaleManager.tare();
     }
   }
 #endif
@@ -153,3 +331,124 @@ void loop()
 
   ui.loop();
 }
+
+void handleCalibrationInput(String input)
+{
+  input.trim();
+  if (input.startsWith("cal "))
+  {
+    input = input.substring(4);
+    input.trim();
+  }
+
+  if (input == "measure")
+  {
+    scaleManager.measureCalibrationPoint();
+  }
+  else if (input == "done")
+  {
+    scaleManager.finishCalibration();
+  }
+  else if (input == "cancel")
+  {
+    scaleManager.cancelCalibration();
+  }
+  else if (input.length() > 0 && isDigit(input.charAt(0)))
+  {
+    // a plain number is the mass of the weight that was just measured, in mg
+    scaleManager.setCalibrationMass(input.toInt());
+  }
+  else
+  {
+    Serial.println("Calibration commands: measure, <mass in mg>, done, cancel");
+  }
+}
+
+void handleShelfInput(String input)
+{
+  input.trim();
+  if (input.length() == 0)
+  {
+    scaleManager.printShelfStats();
+    return;
+  }
+
+  int space = input.indexOf(' ');
+  uint8_t channel = input.substring(0, space).toInt();
+  String command = space < 0 ? String("") : input.substring(space + 1);
+  command.trim();
+
+  bool ok = false;
+  if (command == "tare")
+  {
+    ok = scaleManager.tareShelf(channel);
+  }
+  else if (command.startsWith("cal "))
+  {
+    // the mass on the channel in grams, after a tare with the channel empty
+    ok = scaleManager.calibrateShelf(channel, command.substring(4).toFloat());
+  }
+  else if (command.startsWith("bag "))
+  {
+    String name = command.substring(4);
+    name.trim();
+    ok = scaleManager.setShelfBag(channel, name == "none" ? String("") : name);
+  }
+  else if (command.startsWith("threshold "))
+  {
+    String values = command.substring(10);
+    values.trim();
+    int split = values.indexOf(' ');
+    ok = split > 0 && scaleManager.setShelfThresholds(channel, values.substring(0, split).toFloat(),
+                                                      values.substring(split + 1).toFloat());
+  }
+
+  if (!ok)
+  {
+    Serial.println("Shelf commands: shelf, shelf <n> tare, shelf <n> cal <grams>, shelf <n> bag <name|none>, shelf <n> threshold <reorder g> <prompt g>");
+  }
+}
+
+// history [raw|min|hour [seconds back]], history flush
+void handleHistoryInput(String input)
+{
+  input.trim();
+  if (input.length() == 0)
+  {
+    history.printStats();
+    return;
+  }
+
+  if (input == "flush")
+  {
+    history.checkpoint();
+    return;
+  }
+
+  int space = input.indexOf(' ');
+  String name = space < 0 ? input : input.substring(0, space);
+  uint32_t seconds = space < 0 ? 0 : input.substring(space + 1).toInt();
+
+  HistoryTierId tier;
+  if (name == "raw")
+  {
+    tier = HistoryTierId::RAW;
+  }
+  else if (name == "min")
+  {
+    tier = HistoryTierId::MINUTE;
+  }
+  else if (name == "hour")
+  {
+    tier = HistoryTierId::HOUR;
+  }
+  else
+  {
+    Serial.println("History commands: history, history flush, history <raw|min|hour> [seconds back]");
+    return;
+  }
+
+  uint32_t now = time(nullptr);
+  uint32_t from = seconds > 0 && seconds < now ? now - seconds : 0;
+  history.dump(Serial, tier, from, UINT32_MAX);
+}
@@ -56,7 +56,8 @@ void IRAM_ATTR Menu::handleButtonPress(void *arg)
 
 // Constructor
 Menu::Menu(TFT_eSPI &tftDisplay, UI &uiInstance, ImageLoader &imageLoader, LedStrip &ledStrip)
-    : tft(tftDisplay), ui(uiInstance), imageLoader(imageLoader), ledStrip(ledStrip)
+    : tft(tftDisplay), ui(uiInstance), imageLoader(imageLoader), ledStrip(ledStrip),
+      items{{imageLoader, SMALL_FONT, TEXT_COLOR}, {imageLoader, SMALL_FONT, TEXT_COLOR}, {imageLoader, SMALL_FONT, TEXT_COLOR}}
 {
 }
 
@@ -65,6 +66,15 @@ void Menu::begin()
     // Store instance pointer for interrupt handlers
     instance = this;
 
+    // an icon centered in each third of the width with its label under it
+    const int16_t width = tft.width() / 3;
+    for (int i = 0; i < 3; i++)
+    {
+        items[i].setVisible(false);
+        items[i].setPosition(i * width + width / 2, 4, 54);
+        items[i].attach(ui.compositor);
+    }
+
     pinMode(PIN_TOPLEFT, INPUT_PULLUP);
     pinMode(PIN_TOPMIDDLE, INPUT_PULLUP);
     pinMode(PIN_TOPRIGHT, INPUT_PULLUP);
@@ -149,6 +159,9 @@ void Menu::handlePress(int buttonPin)
     case BARISTA_DOUBLE:
         handlePressBarista(buttonPin);
         break;
+    case CALIBRATION:
+        handlePressCalibration(buttonPin);
+        break;
     default:
         Serial.println("Unknown menu type");
         break;
@@ -178,6 +191,10 @@ void Menu::selectMenu(MenuType menuType, bool shouldDraw)
     // Set the current menu type
     Serial.printf("Menu changed from %d to %d\n", current, menuType);
     current = menuType;
+    // widgets that belong to the old screen disappear, the new screen's appear
+    ui.compositor.setScreen(menuType);
+    // the new screen is drawn over the readouts, they have to be sent whole again
+    ui.taintReadouts();
 
     // Clear button data back to default
     for (int i = 0; i < 3; i++)
@@ -318,18 +335,31 @@ void Menu::selectMenu(MenuType menuType, bool shouldDraw)
         menuItems[2].imagePath = "/dot.png";
         menuItems[2].text = "Tare";
 
+        break;
+    case CALIBRATION:
+        menuItems[0].visible = true;
+        menuItems[0].imagePath = "/dot_accent.png";
+        menuItems[0].text = "Measure";
+        menuItems[0].color = ACCENT_COLOR;
+
+        menuItems[1].visible = true;
+        menuItems[1].imagePath = "/dot.png";
+        menuItems[1].text = "Cancel";
+
+        menuItems[2].visible = true;
+        menuItems[2].imagePath = "/dot.png";
+        menuItems[2].text = "Done";
         break;
     default:
         Serial.println("Unknown Menu Selected");
         break;
     }
 
+    updateItems();
     if (shouldDraw)
     {
-        tainted = true;
+        ui.drawMenu();
     }
-
-    draw();
 }
 
 void Menu::handlePressConfiguration(int buttonPin)
@@ -361,7 +391,7 @@ void Menu::handlePressMainMenu(int buttonPin)
     case PIN_TOPRIGHT:
         if (current == MAIN_MENU_REORDER)
         {
-            ui.store->openToReorder(scaleManager.bagName);
+            ui.store->openToReorder(ui.reorderBagName());
         }
         break;
     case PIN_TERMINAL_BUTTON:
@@ -380,7 +410,7 @@ void Menu::handlePressMainMenuPromptReorder(int buttonPin)
     {
     case PIN_TOPLEFT:
         ui.dismissReorderPrompt();
-        ui.store->openToReorder(scaleManager.bagName);
+        ui.store->openToReorder(ui.reorderBagName());
         break;
     case PIN_TOPRIGHT:
         ui.dismissReorderPrompt();
@@ -500,6 +530,7 @@ void Menu::handlePressBarista(int buttonPin)
     case PIN_TOPLEFT:
         // toggle between single and double shot
         selectMenu(current == BARISTA_SINGLE ? BARISTA_DOUBLE : BARISTA_SINGLE);
+        scaleManager.setDoseTarget(current == BARISTA_SINGLE ? SINGLE_DOSE_WEIGHT : DOUBLE_DOSE_WEIGHT);
         scaleManager.forceBaristaRedraw();
         break;
     case PIN_TOPMIDDLE:
@@ -516,65 +547,38 @@ void Menu::handlePressBarista(int buttonPin)
     }
 }
 
-void Menu::draw()
+void Menu::handlePressCalibration(int buttonPin)
 {
-
-    if (!tainted)
+    switch (buttonPin)
     {
-        return;
+    case PIN_TOPLEFT:
+        scaleManager.measureCalibrationPoint();
+        break;
+    case PIN_TOPMIDDLE:
+        scaleManager.cancelCalibration();
+        break;
+    case PIN_TOPRIGHT:
+        scaleManager.finishCalibration();
+        break;
+    default:
+        Serial.println("Unknown Button Pressed in Calibration");
+        break;
     }
+}
 
-    Serial.printf("drawing menu %d\n", current);
-
-    tainted = false;
-
-    // Clear the top menu area
-    tft.fillRect(0, 0, tft.width(), Menu::menuClearance, BACKGROUND_COLOR);
-
-    // Define positions for the menu icons
-    const int16_t iconWidth = 24;  // Estimated width of icons
-    const int16_t iconHeight = 24; // Estimated height of icons
-    const int16_t iconY = 20;      // Fixed Y position for all icons
+void Menu::draw()
+{
+    updateItems();
+    ui.drawMenu();
+}
 
+void Menu::updateItems()
+{
     for (int i = 0; i < 3; i++)
     {
         MenuItem &item = menuItems[i];
-
-        if (!item.visible)
-            continue;
-
-        // Load the image for the menu item
-        const char *imagePath = item.imagePath;
-
-        uint16_t imageWidth, imageHeight;
-        const int16_t width = tft.width() / 3;
-        const int16_t itemX = i * width;
-        const int16_t itemY = 4;
-        // default to center of the item
-        uint16_t centerX = itemX + (width - iconWidth) / 2;
-
-        if (imagePath)
-        {
-            if (!imageLoader.getImageInfo(imagePath, imageWidth, imageHeight))
-            {
-                Serial.printf("Image not found: %s\n", imagePath);
-                continue;
-            }
-
-            const int16_t centerX = itemX + (width - imageWidth) / 2;
-
-            // Draw the icon
-            imageLoader.drawPNG(imagePath, centerX, itemY);
-        }
-
-        // Draw the text below the icon
-        tft.setTextColor(menuItems[i].color);
-        tft.setTextSize(1);
-        tft.setFreeFont(SMALL_FONT);
-
-        Serial.printf("text=%s x=%d y=%d\n", item.text.c_str(), centerX, iconY + iconHeight + 10);
-        tft.setCursor(centerX + (imageWidth - tft.textWidth(item.text.c_str())) / 2, iconY + iconHeight + 10);
-        tft.print(item.text);
+        items[i].set(item.imagePath, item.text, item.color);
+        items[i].setVisible(item.visible);
     }
 }
 
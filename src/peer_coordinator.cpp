@@ -0,0 +1,207 @@
+#include "peer_coordinator.h"
+#include <ArduinoJson.h>
+
+void PeerUdpTransport::send(const uint8_t *data, size_t length)
+{
+    if (!WiFi.isConnected())
+    {
+        return;
+    }
+
+    udp.beginMulticastPacket();
+    udp.write(data, length);
+    udp.endPacket();
+}
+
+void PeerCoordinator::begin()
+{
+    if (isRunning())
+    {
+        return;
+    }
+
+    // the part of the MAC address that isn't the vendor prefix, the lowest one leads
+    node = new PeerNode((uint32_t)(ESP.getEfuseMac() >> 16), transport);
+    node->logger = [](const char *message)
+    { Serial.printf("Peers: %s\n", message); };
+
+    lock = xSemaphoreCreateMutex();
+    udp.beginMulticast(PEER_GROUP, PEER_PORT);
+    node->start(millis());
+
+    xTaskCreate(
+        peerTask,
+        "PeerCoordinator",
+        4096,
+        this,
+        PEER_TASK_PRIORITY,
+        &taskHandle);
+
+    Serial.printf("Peer coordination as %08x\n", node->getId());
+}
+
+void PeerCoordinator::peerTask(void *parameter)
+{
+    PeerCoordinator *peers = static_cast<PeerCoordinator *>(parameter);
+    uint8_t buffer[PEER_MAX_DATAGRAM];
+
+    while (true)
+    {
+        xSemaphoreTake(peers->lock, portMAX_DELAY);
+        while (peers->udp.parsePacket() > 0)
+        {
+            int length = peers->udp.read(buffer, sizeof(buffer));
+            if (length > 0)
+            {
+                peers->node->receive(buffer, length, millis());
+            }
+        }
+        peers->node->poll(millis());
+        xSemaphoreGive(peers->lock);
+
+        vTaskDelay(pdMS_TO_TICKS(PEER_POLL_INTERVAL_MS));
+    }
+}
+
+bool PeerCoordinator::getCatalog(std::vector<Product> &products)
+{
+    if (!isRunning())
+    {
+        return false;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    uint32_t version = node->getCatalogVersion();
+    std::string catalog = node->getCatalog();
+    xSemaphoreGive(lock);
+
+    uint32_t now = time(nullptr);
+    if (version == 0 || now < version || now - version > PEER_CATALOG_MAX_AGE_S)
+    {
+        return false;
+    }
+
+    JsonDocument doc;
+    if (deserializeJson(doc, catalog.c_str()))
+    {
+        return false;
+    }
+
+    products.clear();
+    for (JsonVariant productVariant : doc["p"].as<JsonArray>())
+    {
+        JsonObject productObj = productVariant.as<JsonObject>();
+        Product product;
+        product.id = productObj["i"].as<String>();
+        product.name = productObj["n"].as<String>();
+        product.description = productObj["d"].as<String>();
+        product.order = productObj["o"].as<uint16_t>();
+        product.subscription = productObj["s"].as<String>();
+
+        for (JsonVariant variantVariant : productObj["v"].as<JsonArray>())
+        {
+            JsonObject variantObj = variantVariant.as<JsonObject>();
+            Variant variant;
+            variant.id = variantObj["i"].as<String>();
+            variant.name = variantObj["n"].as<String>();
+            variant.price = variantObj["p"].as<uint32_t>();
+            product.variants.push_back(variant);
+        }
+
+        products.push_back(product);
+    }
+
+    Serial.printf("Using the catalog shared %us ago\n", now - version);
+    return true;
+}
+
+void PeerCoordinator::shareCatalog(const std::vector<Product> &products)
+{
+    if (!isRunning())
+    {
+        return;
+    }
+
+    JsonDocument doc;
+    JsonArray productsArray = doc["p"].to<JsonArray>();
+    for (const Product &product : products)
+    {
+        JsonObject productObj = productsArray.add<JsonObject>();
+        productObj["i"] = product.id;
+        productObj["n"] = product.name;
+        productObj["d"] = product.description;
+        productObj["o"] = product.order;
+        productObj["s"] = product.subscription;
+
+        JsonArray variants = productObj["v"].to<JsonArray>();
+        for (const Variant &variant : product.variants)
+        {
+            JsonObject variantObj = variants.add<JsonObject>();
+            variantObj["i"] = variant.id;
+            variantObj["n"] = variant.name;
+            variantObj["p"] = variant.price;
+        }
+    }
+
+    String catalog;
+    serializeJson(doc, catalog);
+    if (catalog.length() > PEER_MAX_CATALOG)
+    {
+        Serial.printf("Catalog of %u bytes is too large to share\n", catalog.length());
+        return;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    node->setCatalog(catalog.c_str(), time(nullptr), millis());
+    xSemaphoreGive(lock);
+}
+
+LeaseStatus PeerCoordinator::acquireOrderLease(const String &variantId, uint32_t &holder)
+{
+    if (!isRunning())
+    {
+        return LeaseStatus::GRANTED;
+    }
+
+    std::string variant = variantId.c_str();
+    xSemaphoreTake(lock, portMAX_DELAY);
+    node->requestLease(variant, millis());
+    xSemaphoreGive(lock);
+
+    // the node grants the lease itself once the leader stays quiet for too long
+    LeaseStatus status = LeaseStatus::PENDING;
+    while (status == LeaseStatus::PENDING)
+    {
+        vTaskDelay(pdMS_TO_TICKS(PEER_POLL_INTERVAL_MS));
+        xSemaphoreTake(lock, portMAX_DELAY);
+        status = node->leaseStatus(variant, holder);
+        xSemaphoreGive(lock);
+    }
+
+    return status;
+}
+
+void PeerCoordinator::releaseOrderLease(const String &variantId, bool ordered)
+{
+    if (!isRunning())
+    {
+        return;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    node->releaseLease(variantId.c_str(), ordered, millis());
+    xSemaphoreGive(lock);
+}
+
+void PeerCoordinator::printStatus()
+{
+    if (!isRunning())
+    {
+        Serial.println("Peer coordination is off");
+        return;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    node->printStatus(millis());
+    xSemaphoreGive(lock);
+}
@@ -0,0 +1,563 @@
+#include "peer_node.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PEER_HEADER_SIZE 8
+
+static uint8_t *put(uint8_t *out, const void *value, size_t size)
+{
+    memcpy(out, value, size);
+    return out + size;
+}
+
+static uint8_t *putString(uint8_t *out, const std::string &value)
+{
+    uint8_t length = value.size() < PEER_MAX_VARIANT ? value.size() : PEER_MAX_VARIANT;
+    *out++ = length;
+    return put(out, value.data(), length);
+}
+
+// Bounds checked reads of a received message, `ok` turns false on the first read past the end
+struct PeerReader
+{
+    const uint8_t *data;
+    size_t length;
+    size_t offset = 0;
+    bool ok = true;
+
+    PeerReader(const uint8_t *data, size_t length) : data(data), length(length) {}
+
+    void read(void *value, size_t size)
+    {
+        if (!ok || offset + size > length)
+        {
+            ok = false;
+            memset(value, 0, size);
+            return;
+        }
+        memcpy(value, data + offset, size);
+        offset += size;
+    }
+
+    template <typename T>
+    T get()
+    {
+        T value;
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    std::string string()
+    {
+        uint8_t size = get<uint8_t>();
+        if (!ok || offset + size > length)
+        {
+            ok = false;
+            return std::string();
+        }
+        std::string value((const char *)data + offset, size);
+        offset += size;
+        return value;
+    }
+};
+
+// Compares millisecond timestamps across the wrap
+static bool before(uint32_t now, uint32_t deadline)
+{
+    return (int32_t)(deadline - now) > 0;
+}
+
+const char *leaseStatusName(LeaseStatus status)
+{
+    switch (status)
+    {
+    case LeaseStatus::PENDING:
+        return "pending";
+    case LeaseStatus::GRANTED:
+        return "granted";
+    case LeaseStatus::DENIED_HELD:
+        return "held by another scale";
+    case LeaseStatus::DENIED_ORDERED:
+        return "ordered by another scale";
+    default:
+        return "none";
+    }
+}
+
+void PeerNode::log(const char *format, ...)
+{
+    if (logger == nullptr)
+    {
+        return;
+    }
+
+    char message[160];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    logger(message);
+}
+
+uint8_t *PeerNode::header(uint8_t *out, PeerMessageType type)
+{
+    uint16_t magic = PEER_MAGIC;
+    out = put(out, &magic, sizeof(magic));
+    *out++ = PEER_VERSION;
+    *out++ = (uint8_t)type;
+    return put(out, &id, sizeof(id));
+}
+
+void PeerNode::start(uint32_t now)
+{
+    startTime = now;
+    heartbeatDue = true;
+    poll(now);
+}
+
+uint32_t PeerNode::getLeader(uint32_t now)
+{
+    uint32_t leader = id;
+    for (auto &entry : peers)
+    {
+        if (now - entry.second.lastSeen < PEER_TIMEOUT_MS && entry.first < leader)
+        {
+            leader = entry.first;
+        }
+    }
+    return leader;
+}
+
+size_t PeerNode::livePeers(uint32_t now)
+{
+    size_t count = 0;
+    for (auto &entry : peers)
+    {
+        if (now - entry.second.lastSeen < PEER_TIMEOUT_MS)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+void PeerNode::sendHeartbeat(uint32_t now)
+{
+    uint8_t message[PEER_HEADER_SIZE + 12];
+    uint8_t *out = header(message, PeerMessageType::HEARTBEAT);
+    uint32_t leader = getLeader(now);
+    uint32_t size = catalog.size();
+    out = put(out, &leader, sizeof(leader));
+    out = put(out, &catalogVersion, sizeof(catalogVersion));
+    out = put(out, &size, sizeof(size));
+    transport.send(message, out - message);
+
+    lastHeartbeat = now;
+    heartbeatDue = false;
+}
+
+void PeerNode::poll(uint32_t now)
+{
+    if (heartbeatDue || now - lastHeartbeat >= PEER_HEARTBEAT_INTERVAL_MS)
+    {
+        sendHeartbeat(now);
+    }
+
+    if (pendingVersion != 0 && now - pendingRequested >= PEER_CATALOG_RETRY_MS)
+    {
+        requestCatalog(pendingVersion, now);
+    }
+
+    for (auto &entry : requests)
+    {
+        OwnRequest &request = entry.second;
+        if (request.status != LeaseStatus::PENDING)
+        {
+            continue;
+        }
+
+        if (isDiscovering(now))
+        {
+            // the timeout only starts once the leader is known
+            request.started = now;
+            continue;
+        }
+
+        if (!request.sent)
+        {
+            request.sent = true;
+            if (isLeader(now))
+            {
+                decideLease(entry.first, id, request.request, now);
+                continue;
+            }
+            sendLeaseRequest(entry.first, request, now);
+        }
+        else if (now - request.started >= PEER_LEASE_TIMEOUT_MS)
+        {
+            log("No answer from leader %08x about %s, ordering anyway", getLeader(now), entry.first.c_str());
+            applyGrant(entry.first, id, request.request, PEER_LEASE_TTL_MS, now);
+        }
+        else if (now - request.lastSent >= PEER_LEASE_RETRY_MS)
+        {
+            sendLeaseRequest(entry.first, request, now);
+        }
+    }
+}
+
+void PeerNode::receive(const uint8_t *data, size_t length, uint32_t now)
+{
+    PeerReader reader(data, length);
+    uint16_t magic = reader.get<uint16_t>();
+    uint8_t version = reader.get<uint8_t>();
+    PeerMessageType type = (PeerMessageType)reader.get<uint8_t>();
+    uint32_t sender = reader.get<uint32_t>();
+    // multicast loops back to the sender
+    if (!reader.ok || magic != PEER_MAGIC || version != PEER_VERSION || sender == id)
+    {
+        return;
+    }
+
+    bool known = peers.count(sender) > 0 && now - peers[sender].lastSeen < PEER_TIMEOUT_MS;
+    Peer &peer = peers[sender];
+    peer.lastSeen = now;
+    if (!known)
+    {
+        log("Peer %08x joined, leader is %08x", sender, getLeader(now));
+        // answer right away so the newcomer knows the group before its discovery ends
+        heartbeatDue = true;
+    }
+
+    switch (type)
+    {
+    case PeerMessageType::HEARTBEAT:
+    {
+        reader.get<uint32_t>(); // the sender's leader, only informational
+        uint32_t version = reader.get<uint32_t>();
+        uint32_t size = reader.get<uint32_t>();
+        if (!reader.ok)
+        {
+            return;
+        }
+        peer.catalogVersion = version;
+        if (version > catalogVersion && version != pendingVersion && size > 0 && size <= PEER_MAX_CATALOG)
+        {
+            pendingVersion = version;
+            pendingCatalog.assign(size, '\0');
+            pendingChunks = 0;
+            requestCatalog(version, now);
+        }
+        break;
+    }
+    case PeerMessageType::CATALOG_REQUEST:
+    {
+        uint32_t version = reader.get<uint32_t>();
+        if (!reader.ok || catalog.empty() || catalogVersion < version)
+        {
+            return;
+        }
+        // only the lowest id that has the catalog answers
+        for (auto &entry : peers)
+        {
+            if (entry.first < id && now - entry.second.lastSeen < PEER_TIMEOUT_MS &&
+                entry.second.catalogVersion >= version)
+            {
+                return;
+            }
+        }
+        if (now - lastCatalogSent >= PEER_CATALOG_RESEND_MS)
+        {
+            sendCatalog(now);
+        }
+        break;
+    }
+    case PeerMessageType::CATALOG_CHUNK:
+    {
+        uint32_t version = reader.get<uint32_t>();
+        uint32_t size = reader.get<uint32_t>();
+        uint32_t offset = reader.get<uint32_t>();
+        uint16_t chunkLength = reader.get<uint16_t>();
+        if (!reader.ok || version <= catalogVersion || size == 0 || size > PEER_MAX_CATALOG ||
+            offset % PEER_CATALOG_CHUNK != 0 || offset + chunkLength > size ||
+            reader.offset + chunkLength > length)
+        {
+            return;
+        }
+
+        if (version != pendingVersion || pendingCatalog.size() != size)
+        {
+            pendingVersion = version;
+            pendingCatalog.assign(size, '\0');
+            pendingChunks = 0;
+            pendingRequested = now;
+        }
+        memcpy(&pendingCatalog[offset], data + reader.offset, chunkLength);
+        pendingChunks |= 1ULL << (offset / PEER_CATALOG_CHUNK);
+
+        uint32_t chunks = (size + PEER_CATALOG_CHUNK - 1) / PEER_CATALOG_CHUNK;
+        if (pendingChunks == (chunks == 64 ? ~0ULL : (1ULL << chunks) - 1))
+        {
+            catalog.swap(pendingCatalog);
+            catalogVersion = version;
+            pendingCatalog.clear();
+            pendingVersion = 0;
+            log("Catalog version %u (%u bytes) from %08x", version, size, sender);
+        }
+        break;
+    }
+    case PeerMessageType::LEASE_REQUEST:
+    {
+        uint32_t request = reader.get<uint32_t>();
+        std::string variant = reader.string();
+        if (reader.ok && !isDiscovering(now) && isLeader(now))
+        {
+            decideLease(variant, sender, request, now);
+        }
+        break;
+    }
+    case PeerMessageType::LEASE_GRANT:
+    {
+        uint32_t request = reader.get<uint32_t>();
+        uint32_t holder = reader.get<uint32_t>();
+        uint32_t remaining = reader.get<uint32_t>();
+        std::string variant = reader.string();
+        if (reader.ok)
+        {
+            applyGrant(variant, holder, request, remaining, now);
+        }
+        break;
+    }
+    case PeerMessageType::LEASE_DENY:
+    {
+        uint32_t request = reader.get<uint32_t>();
+        uint32_t requester = reader.get<uint32_t>();
+        uint32_t holder = reader.get<uint32_t>();
+        LeaseStatus status = (LeaseStatus)reader.get<uint8_t>();
+        reader.get<uint32_t>(); // remaining ms, only informational
+        std::string variant = reader.string();
+        if (!reader.ok || requester != id || requests.count(variant) == 0)
+        {
+            return;
+        }
+
+        OwnRequest &own = requests[variant];
+        if (own.request == request && own.status == LeaseStatus::PENDING)
+        {
+            own.status = status;
+            own.holder = holder;
+            log("Lease for %s denied, %s %08x", variant.c_str(), leaseStatusName(status), holder);
+        }
+        break;
+    }
+    case PeerMessageType::LEASE_RELEASE:
+    {
+        bool ordered = reader.get<uint8_t>() != 0;
+        std::string variant = reader.string();
+        if (!reader.ok)
+        {
+            return;
+        }
+
+        Lease &lease = leases[variant];
+        if (lease.held && lease.holder == sender)
+        {
+            lease.held = false;
+        }
+        if (ordered)
+        {
+            lease.ordered = true;
+            lease.orderedBy = sender;
+            lease.orderedUntil = now + PEER_ORDER_COOLDOWN_MS;
+            log("%08x ordered %s", sender, variant.c_str());
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void PeerNode::setCatalog(const std::string &catalog, uint32_t version, uint32_t now)
+{
+    if (catalog.size() > PEER_MAX_CATALOG || version < catalogVersion)
+    {
+        return;
+    }
+
+    this->catalog = catalog;
+    catalogVersion = version;
+    pendingVersion = 0;
+    pendingCatalog.clear();
+    sendCatalog(now);
+    heartbeatDue = true;
+}
+
+void PeerNode::sendCatalog(uint32_t now)
+{
+    uint8_t message[PEER_MAX_DATAGRAM];
+    uint32_t size = catalog.size();
+    for (uint32_t offset = 0; offset < size; offset += PEER_CATALOG_CHUNK)
+    {
+        uint16_t chunkLength = size - offset < PEER_CATALOG_CHUNK ? size - offset : PEER_CATALOG_CHUNK;
+        uint8_t *out = header(message, PeerMessageType::CATALOG_CHUNK);
+        out = put(out, &catalogVersion, sizeof(catalogVersion));
+        out = put(out, &size, sizeof(size));
+        out = put(out, &offset, sizeof(offset));
+        out = put(out, &chunkLength, sizeof(chunkLength));
+        out = put(out, catalog.data() + offset, chunkLength);
+        transport.send(message, out - message);
+    }
+    lastCatalogSent = now;
+}
+
+void PeerNode::requestCatalog(uint32_t version, uint32_t now)
+{
+    uint8_t message[PEER_HEADER_SIZE + 4];
+    uint8_t *out = header(message, PeerMessageType::CATALOG_REQUEST);
+    out = put(out, &version, sizeof(version));
+    transport.send(message, out - message);
+    pendingRequested = now;
+}
+
+void PeerNode::requestLease(const std::string &variant, uint32_t now)
+{
+    OwnRequest request;
+    request.request = nextRequest++;
+    request.started = now;
+    request.status = LeaseStatus::PENDING;
+    requests[variant] = request;
+    poll(now);
+}
+
+LeaseStatus PeerNode::leaseStatus(const std::string &variant, uint32_t &holder)
+{
+    auto entry = requests.find(variant);
+    if (entry == requests.end())
+    {
+        return LeaseStatus::NONE;
+    }
+    holder = entry->second.holder;
+    return entry->second.status;
+}
+
+void PeerNode::releaseLease(const std::string &variant, bool ordered, uint32_t now)
+{
+    requests.erase(variant);
+
+    Lease &lease = leases[variant];
+    if (lease.held && lease.holder == id)
+    {
+        lease.held = false;
+    }
+    if (ordered)
+    {
+        lease.ordered = true;
+        lease.orderedBy = id;
+        lease.orderedUntil = now + PEER_ORDER_COOLDOWN_MS;
+    }
+
+    uint8_t message[PEER_HEADER_SIZE + 2 + PEER_MAX_VARIANT];
+    uint8_t *out = header(message, PeerMessageType::LEASE_RELEASE);
+    *out++ = ordered ? 1 : 0;
+    out = putString(out, variant);
+    transport.send(message, out - message);
+}
+
+void PeerNode::sendLeaseRequest(const std::string &variant, OwnRequest &request, uint32_t now)
+{
+    uint8_t message[PEER_HEADER_SIZE + 5 + PEER_MAX_VARIANT];
+    uint8_t *out = header(message, PeerMessageType::LEASE_REQUEST);
+    out = put(out, &request.request, sizeof(request.request));
+    out = putString(out, variant);
+    transport.send(message, out - message);
+    request.lastSent = now;
+}
+
+void PeerNode::decideLease(const std::string &variant, uint32_t requester, uint32_t request, uint32_t now)
+{
+    Lease &lease = leases[variant];
+    LeaseStatus status = LeaseStatus::GRANTED;
+    uint32_t holder = requester;
+    uint32_t remaining = PEER_LEASE_TTL_MS;
+
+    // retries of a granted request get the same answer
+    if (lease.held && lease.holder != requester && before(now, lease.expires))
+    {
+        status = LeaseStatus::DENIED_HELD;
+        holder = lease.holder;
+        remaining = lease.expires - now;
+    }
+    // a scale may order the same bag again on purpose, only the others are held back
+    else if (lease.ordered && lease.orderedBy != requester && before(now, lease.orderedUntil))
+    {
+        status = LeaseStatus::DENIED_ORDERED;
+        holder = lease.orderedBy;
+        remaining = lease.orderedUntil - now;
+    }
+
+    if (status == LeaseStatus::GRANTED)
+    {
+        uint8_t message[PEER_HEADER_SIZE + 13 + PEER_MAX_VARIANT];
+        uint8_t *out = header(message, PeerMessageType::LEASE_GRANT);
+        out = put(out, &request, sizeof(request));
+        out = put(out, &holder, sizeof(holder));
+        out = put(out, &remaining, sizeof(remaining));
+        out = putString(out, variant);
+        transport.send(message, out - message);
+        applyGrant(variant, holder, request, remaining, now);
+        return;
+    }
+
+    uint8_t message[PEER_HEADER_SIZE + 18 + PEER_MAX_VARIANT];
+    uint8_t *out = header(message, PeerMessageType::LEASE_DENY);
+    out = put(out, &request, sizeof(request));
+    out = put(out, &requester, sizeof(requester));
+    out = put(out, &holder, sizeof(holder));
+    *out++ = (uint8_t)status;
+    out = put(out, &remaining, sizeof(remaining));
+    out = putString(out, variant);
+    transport.send(message, out - message);
+
+    if (requester == id)
+    {
+        OwnRequest &own = requests[variant];
+        own.status = status;
+        own.holder = holder;
+        log("Lease for %s denied, %s %08x", variant.c_str(), leaseStatusName(status), holder);
+    }
+}
+
+void PeerNode::applyGrant(const std::string &variant, uint32_t holder, uint32_t request, uint32_t remaining, uint32_t now)
+{
+    Lease &lease = leases[variant];
+    lease.held = true;
+    lease.holder = holder;
+    lease.expires = now + remaining;
+
+    auto own = requests.find(variant);
+    if (holder == id && own != requests.end() && own->second.request == request &&
+        own->second.status == LeaseStatus::PENDING)
+    {
+        own->second.status = LeaseStatus::GRANTED;
+        own->second.holder = id;
+        log("Lease for %s granted", variant.c_str());
+    }
+}
+
+void PeerNode::printStatus(uint32_t now)
+{
+    log("Node %08x, leader %08x, %u live peers, catalog version %u (%u bytes)%s", id, getLeader(now),
+        (unsigned)livePeers(now), catalogVersion, (unsigned)catalog.size(), isDiscovering(now) ? ", discovering" : "");
+    for (auto &entry : leases)
+    {
+        const Lease &lease = entry.second;
+        bool held = lease.held && before(now, lease.expires);
+        bool ordered = lease.ordered && before(now, lease.orderedUntil);
+        if (held || ordered)
+        {
+            log("  %s: %s%08x", entry.first.c_str(), held ? "held by " : "ordered by ",
+                held ? lease.holder : lease.orderedBy);
+        }
+    }
+}
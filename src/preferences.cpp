@@ -19,9 +19,30 @@ void PreferencesManager::deleteCalibrationData()
     begin();
     preferences.remove("cf");
     preferences.remove("zo");
+    preferences.remove("cal_pts");
     end();
 }
 
+void PreferencesManager::setCalibrationPoints(const CalibrationPoint *points, uint8_t count)
+{
+    begin();
+    preferences.putBytes("cal_pts", points, count * sizeof(CalibrationPoint));
+    end();
+}
+
+uint8_t PreferencesManager::getCalibrationPoints(CalibrationPoint *points, uint8_t maxCount)
+{
+    begin(true);
+    size_t length = 0;
+    if (preferences.isKey("cal_pts"))
+    {
+        length = preferences.getBytes("cal_pts", points, maxCount * sizeof(CalibrationPoint));
+    }
+    end();
+
+    return length / sizeof(CalibrationPoint);
+}
+
 void PreferencesManager::setScaleCalibrationFactor(float factor)
 {
     begin();
@@ -130,3 +151,111 @@ void PreferencesManager::setCoffeeBagName(const String &name)
     preferences.putString("bag_name", name);
     end();
 }
+
+static String channelKey(uint8_t channel, const char *name)
+{
+    return "ch" + String(channel) + "_" + name;
+}
+
+bool PreferencesManager::getChannelCalibration(uint8_t channel, long &zeroOffset, float &factor)
+{
+    begin(true);
+    bool calibrated = preferences.isKey(channelKey(channel, "cf").c_str());
+    zeroOffset = preferences.getLong(channelKey(channel, "zo").c_str(), 0);
+    factor = preferences.getFloat(channelKey(channel, "cf").c_str(), 0.0f);
+    end();
+    return calibrated;
+}
+
+void PreferencesManager::setChannelCalibration(uint8_t channel, long zeroOffset, float factor)
+{
+    begin();
+    preferences.putLong(channelKey(channel, "zo").c_str(), zeroOffset);
+    if (factor != 0.0f)
+    {
+        preferences.putFloat(channelKey(channel, "cf").c_str(), factor);
+    }
+    end();
+}
+
+String PreferencesManager::getChannelBagName(uint8_t channel)
+{
+    begin(true);
+    String name = preferences.getString(channelKey(channel, "bag").c_str(), "");
+    end();
+    return name;
+}
+
+void PreferencesManager::setChannelBagName(uint8_t channel, const String &name)
+{
+    begin();
+    preferences.putString(channelKey(channel, "bag").c_str(), name);
+    end();
+}
+
+void PreferencesManager::getChannelThresholds(uint8_t channel, float &reorder, float &prompt)
+{
+    begin(true);
+    reorder = preferences.getFloat(channelKey(channel, "thr").c_str(), reorder);
+    prompt = preferences.getFloat(channelKey(channel, "prm").c_str(), prompt);
+    end();
+}
+
+void PreferencesManager::setChannelThresholds(uint8_t channel, float reorder, float prompt)
+{
+    begin();
+    preferences.putFloat(channelKey(channel, "thr").c_str(), reorder);
+    preferences.putFloat(channelKey(channel, "prm").c_str(), prompt);
+    end();
+}
+
+void PreferencesManager::getForecastState(ForecastState &state)
+{
+    begin(true);
+    if (preferences.isKey("fc") && preferences.getBytesLength("fc") == sizeof(ForecastState))
+    {
+        preferences.getBytes("fc", &state, sizeof(ForecastState));
+    }
+    end();
+}
+
+void PreferencesManager::setForecastState(const ForecastState &state)
+{
+    begin();
+    preferences.putBytes("fc", &state, sizeof(ForecastState));
+    end();
+}
+
+float PreferencesManager::getLeadDays()
+{
+    begin(true);
+    float days = preferences.getFloat("lead", 0.0f);
+    end();
+    return days;
+}
+
+void PreferencesManager::setLeadDays(float days)
+{
+    begin();
+    preferences.putFloat("lead", days);
+    end();
+}
+
+bool PreferencesManager::getDoseLearning(DoseLearning &learning)
+{
+    begin(true);
+    bool saved = preferences.isKey("dose") && preferences.getBytesLength("dose") == sizeof(DoseLearning);
+    if (saved)
+    {
+        preferences.getBytes("dose", &learning, sizeof(DoseLearning));
+    }
+    end();
+    return saved;
+}
+
+void PreferencesManager::setDoseLearning(const DoseLearning &learning)
+{
+    begin();
+    preferences.putBytes("dose", &learning, sizeof(DoseLearning));
+    end();
+}
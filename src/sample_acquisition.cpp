@@ -0,0 +1,106 @@
+#include "sample_acquisition.h"
+
+SampleAcquisition::SampleAcquisition(int dt_pin, int sck_pin)
+    : hx711(dt_pin, sck_pin)
+{
+}
+
+void SampleAcquisition::begin()
+{
+    if (running)
+    {
+        return;
+    }
+
+    hx711.begin();
+
+    running = true;
+    attachInterruptArg(hx711.getDataPin(), handleDataReady, this, FALLING);
+
+    // If a conversion was already waiting we never see its falling edge, so clock it out now.
+    // The HX711 only starts the next conversion once the current one has been read.
+    RawSample sample;
+    portENTER_CRITICAL(&readMux);
+    readSample(sample);
+    portEXIT_CRITICAL(&readMux);
+}
+
+void SampleAcquisition::wakeOnChange(TaskHandle_t task, int32_t reference, int32_t band)
+{
+    wakeReference = reference;
+    wakeBand = band;
+    wakeTask = task;
+}
+
+void SampleAcquisition::setGain(Hx711Gain gain)
+{
+    if (gain == hx711.getGain())
+    {
+        return;
+    }
+
+    hx711.setGain(gain);
+    // the conversion after the next read is the first one on the new setting
+    settleRemaining = HX711_SETTLE_CONVERSIONS + 1;
+}
+
+void SampleAcquisition::stop()
+{
+    if (!running)
+    {
+        return;
+    }
+
+    detachInterrupt(hx711.getDataPin());
+    running = false;
+}
+
+bool IRAM_ATTR SampleAcquisition::readSample(RawSample &sample)
+{
+    // DOUT toggles while the data bits are clocked out and those edges fire the ISR again
+    // once it returns. It only stays low when a new conversion is actually ready.
+    if (!running)
+    {
+        return false;
+    }
+    if (!hx711.isReady())
+    {
+        notReadyEdges++;
+        return false;
+    }
+
+    sample.timestampUs = micros();
+    sample.counts = hx711.read();
+
+    if (settleRemaining > 0)
+    {
+        settleRemaining--;
+        discardedSamples++;
+        return false;
+    }
+
+    samples.push(sample);
+    totalSamples++;
+    return true;
+}
+
+void IRAM_ATTR SampleAcquisition::handleDataReady(void *arg)
+{
+    SampleAcquisition *self = static_cast<SampleAcquisition *>(arg);
+
+    RawSample sample;
+    if (!self->readSample(sample))
+    {
+        return;
+    }
+
+    if (self->wakeTask != NULL && abs(sample.counts - self->wakeReference) > self->wakeBand)
+    {
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(self->wakeTask, &higherPriorityTaskWoken);
+        if (higherPriorityTaskWoken)
+        {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
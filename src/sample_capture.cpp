@@ -0,0 +1,220 @@
+#include "sample_capture.h"
+
+bool SampleCapture::start(bool reset)
+{
+    if (capturing)
+    {
+        return true;
+    }
+
+    // keep appending to an existing capture unless it is from an incompatible build
+    if (!reset && LittleFS.exists(CAPTURE_FILE))
+    {
+        file = LittleFS.open(CAPTURE_FILE, "r+");
+        if (file && file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+            header.magic == CAPTURE_MAGIC && header.version == CAPTURE_VERSION &&
+            header.recordSize == CAPTURE_RECORD_SIZE && header.capacity == CAPTURE_MAX_SAMPLES)
+        {
+            capturing = true;
+            blockCount = 0;
+            Serial.printf("Capture resumed with %lu samples\n", (unsigned long)header.count);
+            return true;
+        }
+
+        if (file)
+        {
+            file.close();
+        }
+    }
+
+    file = LittleFS.open(CAPTURE_FILE, "w+");
+    if (!file)
+    {
+        Serial.println("Failed to create capture file");
+        return false;
+    }
+
+    header.magic = CAPTURE_MAGIC;
+    header.version = CAPTURE_VERSION;
+    header.recordSize = CAPTURE_RECORD_SIZE;
+    header.capacity = CAPTURE_MAX_SAMPLES;
+    header.head = 0;
+    header.count = 0;
+    writeHeader();
+
+    capturing = true;
+    blockCount = 0;
+    Serial.println("Capture started");
+    return true;
+}
+
+void SampleCapture::stop()
+{
+    if (!capturing)
+    {
+        return;
+    }
+
+    flush();
+    file.close();
+    capturing = false;
+
+    Serial.printf("Capture stopped with %lu samples\n", (unsigned long)header.count);
+}
+
+void SampleCapture::append(const RawSample &sample)
+{
+    if (!capturing)
+    {
+        return;
+    }
+
+    encodeCaptureRecord(sample, &block[blockCount * CAPTURE_RECORD_SIZE]);
+    blockCount++;
+
+    if (blockCount == CAPTURE_BLOCK_SAMPLES)
+    {
+        flush();
+    }
+}
+
+void SampleCapture::flush()
+{
+    uint16_t written = 0;
+    while (written < blockCount)
+    {
+        // write up to the end of the ring in one go, then wrap
+        uint16_t run = min((uint32_t)(blockCount - written), header.capacity - header.head);
+        file.seek(sizeof(CaptureHeader) + header.head * CAPTURE_RECORD_SIZE);
+        file.write(&block[written * CAPTURE_RECORD_SIZE], run * CAPTURE_RECORD_SIZE);
+
+        written += run;
+        header.head = (header.head + run) % header.capacity;
+        header.count = min(header.count + run, header.capacity);
+    }
+
+    blockCount = 0;
+    writeHeader();
+}
+
+void SampleCapture::writeHeader()
+{
+    file.seek(0);
+    file.write((const uint8_t *)&header, sizeof(header));
+    file.flush();
+}
+
+void SampleCapture::dump(Print &out)
+{
+    if (capturing)
+    {
+        out.println("Stop the capture before dumping it");
+        return;
+    }
+
+    File in = LittleFS.open(CAPTURE_FILE, "r");
+    CaptureHeader dumpHeader;
+    if (!in || in.read((uint8_t *)&dumpHeader, sizeof(dumpHeader)) != sizeof(dumpHeader) ||
+        dumpHeader.magic != CAPTURE_MAGIC)
+    {
+        out.println("No capture");
+        return;
+    }
+
+    out.printf("CAPTURE BEGIN %lu\n", (unsigned long)dumpHeader.count);
+
+    uint8_t record[CAPTURE_RECORD_SIZE];
+    RawSample sample;
+    for (uint32_t i = 0; i < dumpHeader.count; i++)
+    {
+        in.seek(captureRecordOffset(dumpHeader, i));
+        in.read(record, CAPTURE_RECORD_SIZE);
+        decodeCaptureRecord(record, sample);
+        out.printf("%ld,%lu\n", (long)sample.counts, (unsigned long)sample.timestampUs);
+    }
+
+    out.println("CAPTURE END");
+    in.close();
+}
+
+bool CaptureReplay::begin(const char *path, float replaySpeed)
+{
+    file = LittleFS.open(path, "r");
+    if (!file || file.read((uint8_t *)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != CAPTURE_MAGIC || header.recordSize != CAPTURE_RECORD_SIZE || header.count == 0)
+    {
+        Serial.printf("No usable capture in %s\n", path);
+        end();
+        return false;
+    }
+
+    speed = replaySpeed;
+    index = 0;
+    hasPending = false;
+    startUs = micros();
+
+    if (!readNext(pending))
+    {
+        end();
+        return false;
+    }
+    hasPending = true;
+    firstTimestampUs = pending.timestampUs;
+
+    Serial.printf("Replaying %lu samples from %s at %.1fx\n", (unsigned long)header.count, path, speed);
+    return true;
+}
+
+void CaptureReplay::end()
+{
+    if (file)
+    {
+        file.close();
+    }
+    hasPending = false;
+}
+
+bool CaptureReplay::readNext(RawSample &sample)
+{
+    if (index >= header.count)
+    {
+        return false;
+    }
+
+    uint8_t record[CAPTURE_RECORD_SIZE];
+    file.seek(captureRecordOffset(header, index));
+    if (file.read(record, CAPTURE_RECORD_SIZE) != CAPTURE_RECORD_SIZE)
+    {
+        return false;
+    }
+
+    decodeCaptureRecord(record, sample);
+    index++;
+    return true;
+}
+
+bool CaptureReplay::read(RawSample &sample)
+{
+    if (!hasPending)
+    {
+        end();
+        return false;
+    }
+
+    // hold back samples that aren't due yet on the scaled clock
+    if (speed > 0.0f)
+    {
+        float elapsedUs = (micros() - startUs) * speed;
+        if (pending.timestampUs - firstTimestampUs > elapsedUs)
+        {
+            return false;
+        }
+    }
+
+    sample.counts = pending.counts;
+    // the rest of the pipeline treats old timestamps as a dead sensor
+    sample.timestampUs = micros();
+
+    hasPending = readNext(pending);
+    return true;
+}
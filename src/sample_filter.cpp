@@ -0,0 +1,168 @@
+#include "sample_filter.h"
+#include <algorithm>
+#ifdef ARDUINO
+#include <Arduino.h>
+
+static inline uint32_t filterTicks()
+{
+    return ESP.getCycleCount();
+}
+#else
+#include <chrono>
+
+static inline uint32_t filterTicks()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+MedianFilter::MedianFilter(uint8_t windowSize)
+    : windowSize(std::min(std::max(windowSize, (uint8_t)1), (uint8_t)MEDIAN_FILTER_MAX_WINDOW))
+{
+    reset(0);
+}
+
+int32_t MedianFilter::process(int32_t counts)
+{
+    history[head] = counts;
+    head = (head + 1) % windowSize;
+
+    // insertion sort is the cheapest option for a handful of samples
+    int32_t sorted[MEDIAN_FILTER_MAX_WINDOW];
+    for (uint8_t i = 0; i < windowSize; i++)
+    {
+        int32_t value = history[i];
+        int8_t j = i - 1;
+        while (j >= 0 && sorted[j] > value)
+        {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = value;
+    }
+
+    return sorted[windowSize / 2];
+}
+
+void MedianFilter::reset(int32_t counts)
+{
+    for (uint8_t i = 0; i < windowSize; i++)
+    {
+        history[i] = counts;
+    }
+    head = 0;
+}
+
+EmaFilter::EmaFilter(float alpha)
+    : alphaQ16((uint32_t)(std::min(std::max(alpha, 0.0f), 1.0f) * 65536.0f))
+{
+}
+
+int32_t EmaFilter::process(int32_t counts)
+{
+    int64_t inputQ8 = (int64_t)counts << 8;
+    stateQ8 += ((inputQ8 - stateQ8) * alphaQ16) >> 16;
+
+    return (int32_t)(stateQ8 >> 8);
+}
+
+void EmaFilter::reset(int32_t counts)
+{
+    stateQ8 = (int64_t)counts << 8;
+}
+
+KalmanFilter::KalmanFilter(uint32_t processNoise, uint32_t measurementNoise)
+    : processNoise(processNoise),
+      measurementNoise(std::max(measurementNoise, (uint32_t)1)),
+      errorCovariance(measurementNoise)
+{
+}
+
+int32_t KalmanFilter::process(int32_t counts)
+{
+    // predict: the weight is expected to stay the same, only our uncertainty grows
+    errorCovariance += processNoise;
+
+    // a step far outside the expected noise means the load actually changed, jump to it
+    // instead of slowly converging (spikes are expected to be removed by an earlier median stage)
+    int64_t innovation = counts - (estimateQ8 >> 8);
+    if (innovation * innovation > KALMAN_STEP_SIGMA * KALMAN_STEP_SIGMA * (errorCovariance + measurementNoise))
+    {
+        reset(counts);
+        return counts;
+    }
+
+    // update
+    int64_t gainQ16 = (errorCovariance << 16) / (errorCovariance + measurementNoise);
+    int64_t inputQ8 = (int64_t)counts << 8;
+    estimateQ8 += ((inputQ8 - estimateQ8) * gainQ16) >> 16;
+    errorCovariance = (errorCovariance * (65536 - gainQ16)) >> 16;
+
+    return (int32_t)(estimateQ8 >> 8);
+}
+
+void KalmanFilter::reset(int32_t counts)
+{
+    estimateQ8 = (int64_t)counts << 8;
+    errorCovariance = measurementNoise;
+}
+
+FilterChain &FilterChain::add(SampleFilter *stage)
+{
+    if (stageCount < FILTER_CHAIN_MAX_STAGES)
+    {
+        stages[stageCount++] = stage;
+    }
+#ifdef ARDUINO
+    else
+    {
+        Serial.printf("Filter chain is full, dropping stage %s\n", stage->name());
+    }
+#endif
+
+    return *this;
+}
+
+int32_t FilterChain::process(int32_t counts)
+{
+    for (uint8_t i = 0; i < stageCount; i++)
+    {
+        SampleFilter *stage = stages[i];
+
+        uint32_t start = filterTicks();
+        counts = stage->process(counts);
+        stage->totalCycles += filterTicks() - start;
+        stage->totalSamples++;
+    }
+
+    return counts;
+}
+
+void FilterChain::reset(int32_t counts)
+{
+    for (uint8_t i = 0; i < stageCount; i++)
+    {
+        stages[i]->reset(counts);
+    }
+}
+
+#ifdef ARDUINO
+void FilterChain::printStats(const char *label)
+{
+    Serial.printf("%s filters:\n", label);
+    for (uint8_t i = 0; i < stageCount; i++)
+    {
+        SampleFilter *stage = stages[i];
+        Serial.printf("  %-8s %6lu cycles/sample (%lu samples)\n",
+                      stage->name(), (unsigned long)stage->cyclesPerSample(), (unsigned long)stage->totalSamples);
+    }
+}
+#endif
+
+void FilterChain::resetStats()
+{
+    for (uint8_t i = 0; i < stageCount; i++)
+    {
+        stages[i]->resetStats();
+    }
+}
@@ -3,37 +3,95 @@
 #include "ui.h"
 #include "bag_select.h"
 
-Scale::Scale(HX711 &scaleModule, TFT_eSPI &display, UI &uiSystem, PreferencesManager &prefs, TerminalApi &terminalApi, LedStrip &ledStrip, int dt_pin, int sck_pin)
-    : scale(scaleModule),
-      tft(display),
+Scale::Scale(TFT_eSPI &display, UI &uiSystem, PreferencesManager &prefs, TerminalApi &terminalApi, LedStrip &ledStrip, int dt_pin, int sck_pin)
+    : tft(display),
       ui(uiSystem),
       preferences(prefs),
       terminalApi(terminalApi),
       PIN_DT(dt_pin),
       PIN_SCK(sck_pin),
+      acquisition(dt_pin, sck_pin),
       calibrationRequested(false),
       ledStrip(ledStrip)
 {
     calibrationFactor = 0.0;
     zeroOffset = 0;
+    commandQueue = xQueueCreate(SCALE_COMMAND_QUEUE_LENGTH, sizeof(ScaleCommand));
+    eventQueue = xQueueCreate(SCALE_EVENT_QUEUE_LENGTH, sizeof(ScaleEvent));
+    historyQueue = xQueueCreate(SCALE_HISTORY_QUEUE_LENGTH, sizeof(HistoryPoint));
+
+    bagFilters.add(&bagMedian).add(&bagKalman);
+    baristaFilters.add(&baristaMedian).add(&baristaEma);
+
     startBackgroundWeighingTask();
 }
 
+bool Scale::addShelfChannel(int dt_pin, int sck_pin)
+{
+    LoadCellChannel *channel = new LoadCellChannel(1 + shelf.size(), dt_pin, sck_pin);
+    if (!shelf.add(channel))
+    {
+        Serial.printf("No room for another shelf channel, at most %d channels\n", SCALE_MAX_CHANNELS);
+        delete channel;
+        return false;
+    }
+
+    return true;
+}
+
 void Scale::begin()
 {
-    scale.begin(PIN_DT, PIN_SCK);
+    acquisition.begin();
+    dosing.begin();
+
+    for (uint8_t i = 0; i < shelf.size(); i++)
+    {
+        LoadCellChannel *channel = shelf.get(i);
+        uint8_t index = channel->getIndex();
+
+        long channelOffset = 0;
+        float channelFactor = 0.0f;
+        if (!preferences.getChannelCalibration(index, channelOffset, channelFactor))
+        {
+            Serial.printf("Shelf channel %u not calibrated\n", index);
+        }
+        channel->setCalibration(channelOffset, channelFactor);
+
+        float reorder = channel->getReorderThreshold().toGrams();
+        float prompt = channel->getPromptThreshold().toGrams();
+        preferences.getChannelThresholds(index, reorder, prompt);
+        channel->setThresholds(Weight::grams(reorder), Weight::grams(prompt));
+
+        channel->bagName = preferences.getChannelBagName(index);
+        channel->hasBag = channel->bagName.length() > 0;
+
+        channel->begin(handleChannelEvent, this);
+    }
+
+    ForecastState forecastState;
+    preferences.getForecastState(forecastState);
+    forecast.restore(forecastState);
+    float savedLeadDays = preferences.getLeadDays();
+    if (savedLeadDays > 0.0f)
+    {
+        leadDays = savedLeadDays;
+    }
+    updateReorderPoints();
+
+    if (preferences.getDoseLearning(savedDoseLearning))
+    {
+        sendCommand(ScaleCommand::RESTORE_DOSE_LEARNING);
+    }
 
     // If calibration data exists, load it
     if (preferences.isScaleCalibrated())
     {
-        calibrationFactor = preferences.getScaleCalibrationFactor();
-        zeroOffset = preferences.getScaleZeroOffset();
+        loadCalibration();
 
         Serial.printf("Using saved calibration factor: %.2f\n", calibrationFactor);
         Serial.printf("Using saved zero offset: %ld\n", zeroOffset);
+        curve.print();
 
-        scale.set_scale(calibrationFactor);
-        scale.set_offset(zeroOffset);
         // not taring because the scale is expected to be constantly loaded and we want to
         // know the total weight placed on the scale, not relative to startup
 
@@ -51,6 +109,22 @@ void Scale::begin()
     }
 }
 
+void Scale::loadCalibration()
+{
+    calibrationFactor = preferences.getScaleCalibrationFactor();
+    zeroOffset = preferences.getScaleZeroOffset();
+
+    // scales calibrated before multi-point calibration only stored a single factor
+    CalibrationPoint points[CALIBRATION_MAX_POINTS];
+    uint8_t count = preferences.getCalibrationPoints(points, CALIBRATION_MAX_POINTS);
+    if (count == 0 || !curve.setPoints(points, count))
+    {
+        curve.setLinear(calibrationFactor);
+    }
+
+    offset = zeroOffset;
+}
+
 void Scale::requestCalibration()
 {
     calibrationRequested = true;
@@ -61,114 +135,209 @@ bool Scale::checkCalibrationRequest()
     if (calibrationRequested)
     {
         calibrationRequested = false;
-        calibrate();
+        startCalibration();
         return true;
     }
     return false;
 }
 
-void Scale::calibrate()
+void Scale::startCalibration()
 {
-    stopBackgroundWeighingTask();
-
-    tft.fillScreen(TFT_BLACK);
+    if (isCalibrating())
+    {
+        return;
+    }
 
-    TextConfig instructionConfig = ui.createTextConfig(MAIN_FONT);
-    instructionConfig.x = 20;
-    instructionConfig.y = 40;
-    instructionConfig.enableCursor = false;
-    instructionConfig.delay_ms = 20;
+    Serial.println("Calibration started");
 
-    auto bounds = ui.typeText("Calibration", titleText);
-    delay(1000);
+    pendingCurve.clear();
+    captureState = CAPTURE_IDLE;
+    calibrationStep = CalibrationStep::EMPTY_PLATE;
+    calibrationTainted = true;
+    sendCommand(ScaleCommand::BEGIN_CALIBRATION);
 
-    // reset current values
-    scale.set_scale();
-    scale.set_offset(0);
-    scale.tare();
-    preferences.setHasCoffeeBag(false);
+    ui.menu->selectMenu(CALIBRATION);
+}
 
-    ui.wipeText(bounds);
+void Scale::measureCalibrationPoint()
+{
+    if (calibrationStep != CalibrationStep::EMPTY_PLATE && calibrationStep != CalibrationStep::PLACE_WEIGHT)
+    {
+        return;
+    }
 
-    instructionConfig.font = ui.getIdealFont("Place known weight", nonTitleFonts);
-    ui.typeText("1. Place known weight", instructionConfig);
+    calibrationStep = calibrationStep == CalibrationStep::EMPTY_PLATE ? CalibrationStep::CAPTURING_ZERO : CalibrationStep::CAPTURING_POINT;
+    calibrationTainted = true;
 
-    instructionConfig.y = 80;
-    instructionConfig.font = ui.getIdealFont("2. Press any button", nonTitleFonts);
-    auto buttonBounds = ui.typeText("2. Press any button", instructionConfig);
+    captureState = CAPTURE_RUNNING;
+    sendCommand(ScaleCommand::CAPTURE_CALIBRATION);
+}
 
-    while (digitalRead(PIN_TOPLEFT) == HIGH &&
-           digitalRead(PIN_TOPMIDDLE) == HIGH &&
-           digitalRead(PIN_TOPRIGHT) == HIGH &&
-           digitalRead(PIN_TERMINAL_BUTTON) == HIGH)
+void Scale::setCalibrationMass(long milligrams)
+{
+    if (calibrationStep != CalibrationStep::ENTER_MASS)
     {
-        delay(100);
+        Serial.println("Not waiting for a calibration mass");
+        return;
     }
 
-    delay(200);
+    Serial.printf("Known weight: %ld mg\n", milligrams);
+
+    if (!pendingCurve.addPoint(calibrationPointCounts - calibrationZeroCounts, milligrams / 1000.0f))
+    {
+        Serial.println("Rejected calibration point, it doesn't fit the other points");
+    }
+    pendingCurve.print();
 
-    tft.fillScreen(TFT_BLACK);
+    calibrationStep = CalibrationStep::PLACE_WEIGHT;
+    calibrationTainted = true;
+}
 
-    instructionConfig.y = 80;
-    instructionConfig.font = ui.getIdealFont("Measuring...", nonTitleFonts);
-    auto measuringBounds = ui.typeText("Measuring...", instructionConfig);
+void Scale::finishCalibration()
+{
+    if (calibrationStep != CalibrationStep::PLACE_WEIGHT || pendingCurve.size() == 0)
+    {
+        Serial.println("Measure at least one known weight before finishing calibration");
+        return;
+    }
 
-    delay(2000);
+    calibrationFactor = pendingCurve.getFactor();
+    zeroOffset = calibrationZeroCounts;
 
-    long reading = scale.get_units(10);
-    long offset = scale.get_offset();
+    preferences.setScaleCalibrationFactor(calibrationFactor);
+    preferences.setScaleZeroOffset(zeroOffset);
+    preferences.setCalibrationPoints(pendingCurve.getPoints(), pendingCurve.size());
+    preferences.setHasCoffeeBag(false);
+    hasBag = false;
 
-    ui.wipeText(measuringBounds);
+    // the weighing task picks up the new curve between two readings, no restart needed
+    sendCommand(ScaleCommand::APPLY_CALIBRATION);
+    sendCommand(ScaleCommand::END_CALIBRATION);
 
-    char buf[32];
-    snprintf(buf, sizeof(buf), "Reading: %ld", reading);
-    instructionConfig.y = 80;
-    auto readingBounds = ui.typeText(buf, instructionConfig);
+    calibrationStep = CalibrationStep::DONE;
+    calibrationDoneTime = millis();
+    calibrationTainted = true;
+}
 
-    instructionConfig.y = 120;
-    instructionConfig.font = ui.getIdealFont("Enter weight in mg", nonTitleFonts);
-    ui.typeText("Enter weight in mg", instructionConfig);
-    instructionConfig.y = 160;
-    instructionConfig.font = ui.getIdealFont("via Serial Monitor", nonTitleFonts);
-    ui.typeText("via Serial Monitor", instructionConfig);
+void Scale::cancelCalibration()
+{
+    if (!isCalibrating())
+    {
+        return;
+    }
 
-    while (Serial.available() == 0)
+    if (!isCalibrated())
     {
-        delay(100);
+        Serial.println("Scale has never been calibrated, calibration can't be cancelled");
+        return;
     }
 
-    String input = Serial.readStringUntil('\n');
-    Serial.printf("received: '%s'\n", input.c_str());
-    long knownWeightMg = input.toInt();
-    Serial.printf("Known weight: %ld\n", knownWeightMg);
+    Serial.println("Calibration cancelled");
+    sendCommand(ScaleCommand::END_CALIBRATION);
+    calibrationStep = CalibrationStep::IDLE;
 
-    calibrationFactor = reading * 1000.0f / knownWeightMg;
-    zeroOffset = offset;
+    ui.clearScreen();
+    ui.menu->selectMenu(MAIN_MENU);
+}
 
-    preferences.setScaleCalibrationFactor(calibrationFactor);
-    preferences.setScaleZeroOffset(zeroOffset);
+void Scale::drawCalibration()
+{
+    if (calibrationStep == CalibrationStep::CAPTURING_ZERO || calibrationStep == CalibrationStep::CAPTURING_POINT)
+    {
+        uint8_t state = captureState.load(std::memory_order_acquire);
+        if (state == CAPTURE_FAILED)
+        {
+            Serial.println("Calibration measurement timed out");
+            calibrationStep = calibrationStep == CalibrationStep::CAPTURING_ZERO ? CalibrationStep::EMPTY_PLATE : CalibrationStep::PLACE_WEIGHT;
+            calibrationTainted = true;
+        }
+        else if (state == CAPTURE_DONE)
+        {
+            if (calibrationStep == CalibrationStep::CAPTURING_ZERO)
+            {
+                calibrationZeroCounts = captureResult;
+                calibrationStep = CalibrationStep::PLACE_WEIGHT;
+            }
+            else
+            {
+                calibrationPointCounts = captureResult;
+                calibrationStep = CalibrationStep::ENTER_MASS;
+            }
+            Serial.printf("Measured %ld counts\n", captureResult);
+            calibrationTainted = true;
+        }
+    }
+
+    if (calibrationStep == CalibrationStep::DONE && millis() - calibrationDoneTime > CALIBRATION_DONE_DISPLAY_MS)
+    {
+        calibrationStep = CalibrationStep::IDLE;
+        ui.clearScreen();
+        ui.menu->selectMenu(MAIN_MENU);
+        return;
+    }
+
+    if (calibrationTainted)
+    {
+        calibrationTainted = false;
+        drawCalibrationStep();
+    }
+}
 
-    tft.fillScreen(TFT_BLACK);
-    instructionConfig.y = 40;
-    bounds = ui.typeText("Calibrated", titleText);
+void Scale::drawCalibrationStep()
+{
+    ui.clearContent();
 
-    char factorBuf[32];
-    snprintf(factorBuf, sizeof(factorBuf), "cf=%.2f, zo=%ld", calibrationFactor, zeroOffset);
-    instructionConfig.y = 80;
-    ui.typeText(factorBuf, instructionConfig);
+    TextConfig instructionConfig = ui.createTextConfig(MAIN_FONT);
+    instructionConfig.x = 20;
+    instructionConfig.y = Menu::menuClearance + 30;
+    instructionConfig.enableCursor = false;
+    instructionConfig.delay_ms = 20;
 
-    instructionConfig.y = 120;
-    instructionConfig.font = ui.getIdealFont("Restarting...", nonTitleFonts);
-    auto restartBounds = ui.typeText("Restarting...", instructionConfig);
+    auto typeLine = [&](const char *text)
+    {
+        instructionConfig.font = ui.getIdealFont(text, nonTitleFonts);
+        ui.typeText(text, instructionConfig);
+        instructionConfig.y += 40;
+    };
 
-    esp_restart();
+    char buf[32];
+    switch (calibrationStep)
+    {
+    case CalibrationStep::EMPTY_PLATE:
+        typeLine("1. Empty the plate");
+        typeLine("2. Press Measure");
+        break;
+    case CalibrationStep::CAPTURING_ZERO:
+    case CalibrationStep::CAPTURING_POINT:
+        typeLine("Measuring...");
+        break;
+    case CalibrationStep::PLACE_WEIGHT:
+        snprintf(buf, sizeof(buf), "Points: %u", pendingCurve.size());
+        typeLine(buf);
+        typeLine("Place known weight");
+        typeLine(pendingCurve.size() > 0 ? "Measure or Done" : "and press Measure");
+        break;
+    case CalibrationStep::ENTER_MASS:
+        snprintf(buf, sizeof(buf), "Reading: %ld", calibrationPointCounts - calibrationZeroCounts);
+        typeLine(buf);
+        typeLine("Enter weight in mg");
+        typeLine("via Serial Monitor");
+        break;
+    case CalibrationStep::DONE:
+        typeLine("Calibrated");
+        snprintf(buf, sizeof(buf), "cf=%.2f, zo=%ld", calibrationFactor, zeroOffset);
+        typeLine(buf);
+        break;
+    default:
+        break;
+    }
 }
 
 void Scale::startLoadBag()
 {
     loadingBag = true;
 
-    tft.fillScreen(BACKGROUND_COLOR);
+    ui.clearScreen();
     auto bounds = ui.typeText("Loading...");
     ui.startBlinking();
 
@@ -190,16 +359,13 @@ void Scale::startLoadBag()
     ui.wipeText(bounds);
 
     ui.menu->selectMenu(SELECT_BAG);
-    ui.bagSelect->taint();
 }
 
 void Scale::loadBag(String name)
 {
     Serial.println("Loading bag");
 
-    stopBackgroundWeighingTask();
-
-    tft.fillScreen(BACKGROUND_COLOR);
+    ui.clearScreen();
 
     TextConfig instructionConfig = ui.createTextConfig(&GeistMono_VariableFont_wght14pt7b);
     instructionConfig.y = tft.height() / 2 - 20;
@@ -220,18 +386,39 @@ void Scale::loadBag(String name)
         delay(100);
     }
 
-    tft.fillScreen(BACKGROUND_COLOR);
+    ui.clearScreen();
     instructionConfig.font = &GeistMono_VariableFont_wght12pt7b;
     instructionConfig.y = tft.height() / 2;
     auto bounds = ui.typeText("Measuring...", instructionConfig);
 
-    float reading = scale.get_units(10);
+    // the weighing task averages the next conversions and keeps serving the shelf meanwhile
+    captureState = CAPTURE_RUNNING;
+    sendCommand(ScaleCommand::LOAD_BAG_CAPTURE);
+
+    unsigned long start = millis();
+    uint8_t state = captureState.load(std::memory_order_acquire);
+    while (state != CAPTURE_DONE && state != CAPTURE_FAILED && millis() - start < CAPTURE_TIMEOUT_MS * 2)
+    {
+        delay(20);
+        state = captureState.load(std::memory_order_acquire);
+    }
+
+    Weight reading = getSample().value;
+    if (state == CAPTURE_DONE)
+    {
+        reading = captureWeight;
+    }
+    else
+    {
+        Serial.println("Bag measurement failed, using the last reading");
+    }
+    captureState = CAPTURE_IDLE;
     weightBeforeLoadBag = reading;
 
     ui.wipeText(bounds);
 
     instructionConfig.font = &GeistMono_VariableFont_wght16pt7b;
-    bounds = ui.typeText((String(reading, 1) + " g").c_str(), instructionConfig);
+    bounds = ui.typeText(weightText(reading, 1, " g").c_str(), instructionConfig);
 
     instructionConfig.y += instructionConfig.font->yAdvance + 8;
     instructionConfig.textColor = ACCENT_COLOR;
@@ -245,7 +432,6 @@ void Scale::loadBag(String name)
     ui.menu->selectMenu(LOADING_BAG_CONFIRM);
 
     bagName = name;
-    startBackgroundWeighingTask();
 
     while (true)
     {
@@ -259,7 +445,7 @@ void Scale::loadBag(String name)
 
 void Scale::confirmLoadBag()
 {
-    tft.fillScreen(BACKGROUND_COLOR);
+    ui.clearScreen();
 
     auto bounds = ui.typeText("Bag loaded", titleText);
     delay(1000);
@@ -277,293 +463,1048 @@ void Scale::confirmLoadBag()
     ui.menu->selectMenu(MAIN_MENU);
 }
 
-float Scale::readWeight(int samples)
+void Scale::drainSamples()
 {
-    if (scale.wait_ready_retry(2, fastMeasuring ? 10 : 50))
+    RawSample sample;
+    uint32_t drained = 0;
+    while (source->read(sample))
     {
-        float reading = scale.get_units(fastMeasuring ? 5 : samples);
-
-        if (hasBag && !baristaMode)
+        if (source == &acquisition)
+        {
+            rawCapture.append(sample);
+        }
+        pushSample(sample);
+        if (source == &acquisition)
         {
-            reading -= TERMINAL_COFFEE_BAG_EMPTY_WEIGHT;
+            health.update(sample, readingIsStable);
         }
+        drained++;
+    }
+    health.recordDrain(drained);
 
-        lastReading = reading;
-        return reading;
+    if (source != &acquisition && !source->isRunning())
+    {
+        restoreLiveSource();
     }
-    return -1;
 }
 
-void Scale::tare()
+void Scale::pushSample(const RawSample &sample)
 {
-    if (backgroundWeighingTaskHandle != NULL)
+    if (!hasSamples)
     {
-        vTaskSuspend(backgroundWeighingTaskHandle);
+        activeFilters->reset(sample.counts);
+        hasSamples = true;
     }
 
-    if (scale.wait_ready_retry(3, 50))
+    filteredCounts = activeFilters->process(sample.counts);
+    lastRawCounts = sample.counts;
+    lastSampleUs = sample.timestampUs;
+
+    Weight weight = countsToWeight(filteredCounts);
+    if (stability.update(weight))
     {
-        scale.tare();
+        stableReading = stability.getStableValue();
+        hasStableReading = true;
     }
+    readingIsStable = stability.isStable();
 
-    if (backgroundWeighingTaskHandle != NULL)
+    telemetry.sample(sample.timestampUs, sample.counts, filteredCounts, weight, currentFlags());
+
+    updateCapture(sample);
+
+    if (hasBag && !baristaMode && !calibrating &&
+        consumption.update(weight, readingIsStable, stability.getStableValue(), -Weight::grams(BAG_PRESENCE_HYSTERESIS), millis()))
     {
-        vTaskResume(backgroundWeighingTaskHandle);
+        emit(ScaleEventType::CONSUMPTION, consumption.last().amount);
+    }
+
+    // the dosing engine fits its own line through the raw conversions, the filters only add lag
+    if (baristaMode && !calibrating && captureRemaining == 0 &&
+        dosing.update(countsToWeight(sample.counts).toGrams(), sample.timestampUs, readingIsStable, stability.getStableValue().toGrams()))
+    {
+        if (dosing.getState() == DoseState::STOPPED)
+        {
+            emit(ScaleEventType::DOSE_STOP, weight);
+        }
+        else if (dosing.getState() == DoseState::SETTLED)
+        {
+            doseLearning.write(dosing.getLearning());
+            emit(ScaleEventType::DOSE_DONE, Weight::grams(dosing.getLastOvershoot()));
+        }
     }
 }
 
-bool Scale::isCalibrated()
+Weight Scale::countsToWeight(int32_t counts)
 {
-    return preferences.isScaleCalibrated();
+    Weight weight = curve.toWeight(counts - offset);
+
+    if (hasBag && !baristaMode)
+    {
+        weight -= Weight::grams(TERMINAL_COFFEE_BAG_EMPTY_WEIGHT);
+    }
+
+    return weight;
 }
 
-float Scale::getCalibrationFactor()
+void Scale::selectFilters(FilterChain &filters)
 {
-    return calibrationFactor;
+    // start the new chain from the latest conversion so switching modes doesn't ramp
+    activeFilters = &filters;
+    stability.reset();
+    hasStableReading = false;
+    readingIsStable = false;
+    consumption.reset();
+    if (hasSamples)
+    {
+        filters.reset(lastRawCounts);
+        filteredCounts = lastRawCounts;
+    }
 }
 
-long Scale::getZeroOffset()
+void Scale::printFilterStats()
 {
-    return zeroOffset;
+    bagFilters.printStats("bag");
+    baristaFilters.printStats("barista");
 }
 
-void Scale::backgroundWeighingTask(void *parameter)
+void Scale::printHealth()
 {
-    Scale *scale = static_cast<Scale *>(parameter);
-
-    float minReading = 0.0f;
-    float maxReading = 0.0f;
-    float lastReading = 0.0f;
-
-    while (true)
-    {
-        float reading = scale->readWeight();
-        reading = round(reading * 10.0) / 10.0;
-
-        minReading = min(minReading, reading);
-        maxReading = max(maxReading, reading);
-
-        if (reading != lastReading)
-        {
-            Serial.printf("hasBag=%d, reading=%.1f min=%.1f max=%.1f\n", scale->hasBag, reading, minReading, maxReading);
-        }
-
-        lastReading = reading;
+    printSamplingStats();
+    health.print(curve.getFactor());
+    acquisition.driver().getReadHistogram().print("hx711 read", "us", getCpuFrequencyMhz());
+}
 
-        if (scale->hasBag && reading < 0)
-        {
-            // Bag was removed from the plate. Start a timer (2 minutes) to wait for the bag to be put back
-            // If the timer expires, we need to jump over to the re-ordering screen
+void Scale::resetHealth()
+{
+    sendCommand(ScaleCommand::RESET_HEALTH);
+}
 
-            scale->bagRemovedFromSurface = true;
-            scale->bagRemovedTime = millis();
-        }
-        else if (scale->hasBag && scale->bagRemovedFromSurface)
-        {
-            // Bag was put back on the plate
-            scale->bagRemovedFromSurface = false;
-            scale->bagRemovedTime = 0;
-        }
+HealthCounters Scale::getHealthCounters()
+{
+    HealthCounters counters = health.getCounters();
+    counters.conversions = acquisition.total();
+    counters.conversionsDropped = acquisition.dropped();
+    return counters;
+}
 
-        if (scale->hasBag && !scale->bagRemovedFromSurface)
-        {
-            if (reading < REORDER_BUTTON_THRESHOLD)
-            {
-                scale->bagIsBelowThreshold = true;
-            }
-            else
-            {
-                scale->bagIsBelowThreshold = false;
-            }
+void Scale::setTelemetry(bool enabled)
+{
+    telemetryEnabled = enabled;
+    sendCommand(ScaleCommand::SET_TELEMETRY);
+}
 
-            if (reading < REORDER_BUTTON_PROMPT_THRESHOLD)
-            {
-                scale->bagIsBelowPromptThreshold = true;
-            }
-            else
-            {
-                scale->bagIsBelowPromptThreshold = false;
-            }
-        }
+WeightSample Scale::getSample(uint8_t channel)
+{
+    if (channel == 0)
+    {
+        return getSample();
+    }
 
-        vTaskDelay((scale->fastMeasuring ? 100 : 1000) / portTICK_PERIOD_MS);
+    LoadCellChannel *shelfChannel = shelf.find(channel);
+    if (shelfChannel == nullptr)
+    {
+        WeightSample empty = {};
+        return empty;
     }
+
+    return shelfChannel->getSample();
 }
 
-void Scale::startBackgroundWeighingTask()
+bool Scale::hasBagOn(uint8_t channel)
 {
-    if (backgroundWeighingTaskHandle != NULL)
+    if (channel == 0)
     {
-        return;
+        return hasBag;
     }
 
-    xTaskCreate(
-        backgroundWeighingTask,
-        "BackgroundWeighing",
-        4096,
-        this,
-        4,
-        &backgroundWeighingTaskHandle);
+    LoadCellChannel *shelfChannel = shelf.find(channel);
+    return shelfChannel != nullptr && shelfChannel->hasBag;
 }
 
-void Scale::stopBackgroundWeighingTask()
+String Scale::getBagName(uint8_t channel)
 {
-    if (backgroundWeighingTaskHandle != NULL)
+    if (channel == 0)
     {
-        vTaskDelete(backgroundWeighingTaskHandle);
-        backgroundWeighingTaskHandle = NULL;
+        return bagName;
     }
+
+    LoadCellChannel *shelfChannel = shelf.find(channel);
+    return shelfChannel != nullptr ? shelfChannel->bagName : String("");
 }
 
-// Enter Barista mode: single shot by default
-void Scale::enterBaristaMode()
+bool Scale::captureShelf(uint8_t channel, float grams)
 {
-    // FIXME: use a mutex (i'm sorry for anyone reading this)
-    if (backgroundWeighingTaskHandle != NULL)
+    LoadCellChannel *shelfChannel = shelf.find(channel);
+    if (shelfChannel == nullptr)
     {
-        vTaskSuspend(backgroundWeighingTaskHandle);
+        Serial.printf("No shelf channel %u\n", channel);
+        return false;
     }
-    tft.fillScreen(BACKGROUND_COLOR);
 
-    delay(500);
-    baristaMode = true;
-    ui.menu->selectMenu(BARISTA_SINGLE);
-    ui.taint();
-    fastMeasuring = true;
-    tare();
+    shelfChannel->clearCaptureState();
+    shelfCaptureChannel = channel;
+    shelfCaptureGrams = grams;
+    sendCommand(ScaleCommand::SHELF_CAPTURE);
 
-    if (backgroundWeighingTaskHandle != NULL)
+    // the capture times out on the weighing task, this only guards against a stuck task
+    unsigned long start = millis();
+    uint8_t state = shelfChannel->getCaptureState();
+    while (millis() - start < CAPTURE_TIMEOUT_MS * 2)
     {
-        vTaskResume(backgroundWeighingTaskHandle);
+        state = shelfChannel->getCaptureState();
+        if (state == CAPTURE_DONE || state == CAPTURE_FAILED)
+        {
+            break;
+        }
+        delay(20);
     }
-}
 
-// Exit Barista mode: return to main menu
-void Scale::leaveBaristaMode()
-{
-    // FIXME: use a mutex
-    if (backgroundWeighingTaskHandle != NULL)
+    if (state != CAPTURE_DONE)
     {
-        vTaskSuspend(backgroundWeighingTaskHandle);
+        Serial.printf("Shelf channel %u: measurement failed\n", channel);
+        return false;
     }
-    delay(500);
-    scale.set_offset(preferences.getScaleZeroOffset());
-    fastMeasuring = false;
-    baristaMode = false;
-    baristaLastProgress = -99;
-    baristaLastDrawnReading = -99.0f;
-    ui.menu->selectMenu(MAIN_MENU);
-    ledStrip.turnOff();
-    ui.taint();
 
-    if (backgroundWeighingTaskHandle != NULL)
+    // 0 restores an uncalibrated channel, see LoadCellChannel::setCalibration
+    preferences.setChannelCalibration(channel, shelfChannel->getOffset(), shelfChannel->isCalibrated() ? shelfChannel->getFactor() : 0.0f);
+    if (shelfChannel->isCalibrated())
+    {
+        Serial.printf("Shelf channel %u: zero offset %ld, %.2f counts/g\n", channel, shelfChannel->getOffset(), shelfChannel->getFactor());
+    }
+    else
     {
-        vTaskResume(backgroundWeighingTaskHandle);
+        Serial.printf("Shelf channel %u: zero offset %ld, not calibrated yet\n", channel, shelfChannel->getOffset());
     }
+    return true;
 }
 
-// Draw Barista mode UI with progress towards target shot weight
-void Scale::drawBaristaMode()
+bool Scale::tareShelf(uint8_t channel)
 {
-    // get current weight reading
-    float weight = lastReading;
-    weight = round(weight * 10.0f) / 10.0f;
-    if (weight == -0.0f)
-    {
-        weight = 0.0f;
-    }
+    return captureShelf(channel, 0.0f);
+}
 
-    if (weight == baristaLastDrawnReading)
+bool Scale::calibrateShelf(uint8_t channel, float grams)
+{
+    if (grams <= 0.0f)
     {
-        return;
+        return false;
     }
-    baristaLastDrawnReading = weight;
 
-    // determine target based on mode
-    float target = (ui.menu->current == BARISTA_SINGLE) ? SINGLE_DOSE_WEIGHT : DOUBLE_DOSE_WEIGHT;
+    return captureShelf(channel, grams);
+}
 
-    // calculate progress 0.0 to 1.0
-    float progress = weight / target;
-    float constraintedProgress = constrain(progress, 0.0f, 1.0f);
+bool Scale::setShelfBag(uint8_t channel, const String &name)
+{
+    LoadCellChannel *shelfChannel = shelf.find(channel);
+    if (shelfChannel == nullptr)
+    {
+        return false;
+    }
 
-    auto textColor = TEXT_COLOR;
+    shelfChannel->bagName = name;
+    shelfChannel->hasBag = name.length() > 0;
+    preferences.setChannelBagName(channel, name);
+    return true;
+}
 
-    auto diff = abs(target - weight);
-    if (diff < 0.6f)
+bool Scale::setShelfThresholds(uint8_t channel, float reorder, float prompt)
+{
+    LoadCellChannel *shelfChannel = shelf.find(channel);
+    if (shelfChannel == nullptr || prompt > reorder)
     {
-        textColor = TEXT_COLOR_GREEN;
-        ledStrip.setColor(RgbColor(0, 32, 0));
+        return false;
     }
-    else if (progress > 1.0f)
+
+    shelfChannel->setThresholds(Weight::grams(reorder), Weight::grams(prompt));
+    preferences.setChannelThresholds(channel, reorder, prompt);
+    return true;
+}
+
+void Scale::printShelfStats()
+{
+    if (shelf.size() == 0)
     {
-        textColor = TEXT_COLOR_RED;
-        ledStrip.setColor(RgbColor(32, 0, 0));
+        Serial.println("No shelf channels");
+        return;
     }
-    else
+
+    for (uint8_t i = 0; i < shelf.size(); i++)
     {
-        ledStrip.progress(constraintedProgress, RgbColor(255 / 5, 94 / 5, 0));
+        LoadCellChannel *channel = shelf.get(i);
+        WeightSample sample = channel->getSample();
+        Serial.printf("shelf %u: bag=%s weight=%s stable=%s thresholds=%s/%s%s\n", channel->getIndex(),
+                      channel->hasBag ? channel->bagName.c_str() : "-", weightText(sample.value, 1).c_str(),
+                      weightText(sample.stableValue, 1).c_str(), weightText(channel->getReorderThreshold(), 0).c_str(),
+                      weightText(channel->getPromptThreshold(), 0).c_str(),
+                      sample.has(WEIGHT_VALID) ? "" : " (no data)");
     }
+    shelf.printStats();
+}
 
-    progress = constraintedProgress;
+void Scale::printConsumptionLog()
+{
+    consumption.printLog();
+}
 
-    const uint16_t progressX = 20;
-    const uint16_t progressHeight = 100;
-    const uint16_t progressY = tft.height() - progressHeight - 20;
-    const uint16_t progressWidth = 60;
-    int progressBarFill = constrain((int)(progress * progressHeight), 0, progressHeight);
+void Scale::printDosingStats()
+{
+    dosing.printStats();
+}
 
-    // clear text area
-    tft.fillRect(progressX + progressWidth + 10, progressY,
-                 tft.width(), progressHeight, BACKGROUND_COLOR);
+void Scale::setDoseTarget(float grams)
+{
+    doseTarget = grams;
+    sendCommand(ScaleCommand::SET_DOSE_TARGET);
+}
 
-    // show mode label
-    tft.setTextSize(1);
-    tft.setFreeFont(&GeistMono_VariableFont_wght12pt7b);
-    tft.setCursor(progressX + progressWidth + 10, progressY + GeistMono_VariableFont_wght12pt7b.yAdvance);
-    tft.setTextColor(TEXT_COLOR);
-    tft.print((ui.menu->current == BARISTA_SINGLE) ? "single-shot" : "double-shot");
+void Scale::startRawCapture(bool reset)
+{
+    rawCaptureReset = reset;
+    sendCommand(ScaleCommand::START_RAW_CAPTURE);
+}
 
-    // show weight vs target
-    tft.setFreeFont(&GeistMono_VariableFont_wght16pt7b);
+void Scale::stopRawCapture()
+{
+    sendCommand(ScaleCommand::STOP_RAW_CAPTURE);
+}
+
+void Scale::dumpRawCapture()
+{
+    rawCapture.dump(Serial);
+}
+
+void Scale::startReplay(float speed)
+{
+    replaySpeed = speed;
+    sendCommand(ScaleCommand::START_REPLAY);
+}
+
+void Scale::stopReplay()
+{
+    sendCommand(ScaleCommand::STOP_REPLAY);
+}
+
+void Scale::startSynthetic(const SyntheticConfig &config)
+{
+    syntheticConfig = config;
+    sendCommand(ScaleCommand::START_SYNTHETIC);
+}
+
+void Scale::restoreLiveSource()
+{
+    if (source == &replay)
+    {
+        Serial.printf("Replay finished after %lu of %lu samples\n",
+                      (unsigned long)replay.getPosition(), (unsigned long)replay.getLength());
+    }
+    else
+    {
+        Serial.printf("Simulation finished after %lu samples\n", (unsigned long)synthetic.getIndex());
+    }
+    replay.end();
+    synthetic.end();
+    printFilterStats();
+    consumption.printLog();
+
+    source = &acquisition;
+    acquisition.clear();
+    hasSamples = false;
+    selectFilters(*activeFilters);
+}
+
+void Scale::printSamplingStats()
+{
+    Serial.printf("sampling: interval=%lums effective=%.2fHz\n",
+                  (unsigned long)sampler.getInterval(), sampler.getEffectiveRate());
+    Serial.printf("acquisition: total=%lu dropped=%lu discarded=%lu not ready=%lu buffered=%u\n",
+                  (unsigned long)acquisition.total(), (unsigned long)acquisition.dropped(),
+                  (unsigned long)acquisition.discarded(), (unsigned long)acquisition.notReady(),
+                  acquisition.available());
+
+    Hx711Driver &hx711 = acquisition.driver();
+    uint32_t mhz = getCpuFrequencyMhz();
+    Serial.printf("hx711: gain=%d read cycles last=%lu avg=%lu max=%lu (max %.1fus)\n",
+                  (int)hx711.getGain(), (unsigned long)hx711.getLastReadCycles(),
+                  (unsigned long)hx711.getAverageReadCycles(), (unsigned long)hx711.getMaxReadCycles(),
+                  (float)hx711.getMaxReadCycles() / mhz);
+}
+
+bool Scale::readWeight(Weight &weight)
+{
+    drainSamples();
+
+    if (!hasSamples || micros() - lastSampleUs > SAMPLE_STALE_TIMEOUT_US)
+    {
+        health.recordStale();
+        return false;
+    }
+
+    weight = countsToWeight(filteredCounts);
+    lastReading = weight;
+    return true;
+}
+
+void Scale::tare()
+{
+    sendCommand(ScaleCommand::TARE);
+}
+
+void Scale::startCapture(CaptureKind kind)
+{
+    captureKind = kind;
+    captureRemaining = kind == CaptureKind::CALIBRATION ? CALIBRATION_CAPTURE_SAMPLES
+                       : kind == CaptureKind::LOAD_BAG  ? LOAD_BAG_CAPTURE_SAMPLES
+                                                        : TARE_CAPTURE_SAMPLES;
+    captureSum = 0;
+    captureCount = 0;
+    captureStartTime = millis();
+
+    // only average what arrives after the request
+    source->clear();
+}
+
+void Scale::updateCapture(const RawSample &sample)
+{
+    if (captureRemaining == 0)
+    {
+        return;
+    }
+
+    // calibration points are only taken from a settled plate, start over if it moves.
+    // An uncalibrated scale has no gram thresholds to judge that by
+    if (captureKind == CaptureKind::CALIBRATION && curve.size() > 0 && !readingIsStable)
+    {
+        captureRemaining += captureCount;
+        captureSum = 0;
+        captureCount = 0;
+        return;
+    }
+
+    captureSum += sample.counts;
+    captureCount++;
+    if (--captureRemaining > 0)
+    {
+        return;
+    }
+
+    long average = captureSum / captureCount;
+    if (captureKind == CaptureKind::TARE)
+    {
+        offset = average;
+        consumption.reset();
+    }
+    else
+    {
+        captureResult = average;
+        // the bag is weighed without the empty bag taken off, the screen shows that separately
+        captureWeight = curve.toWeight(average - offset);
+        captureState.store(CAPTURE_DONE, std::memory_order_release);
+    }
+}
+
+void Scale::checkCaptureTimeout()
+{
+    if (captureRemaining == 0 || millis() - captureStartTime < CAPTURE_TIMEOUT_MS)
+    {
+        return;
+    }
+
+    Serial.printf("%s timed out after %d of %d conversions\n",
+                  captureKind == CaptureKind::TARE          ? "Tare"
+                  : captureKind == CaptureKind::LOAD_BAG    ? "Bag measurement"
+                                                            : "Calibration measurement",
+                  captureCount, captureCount + captureRemaining);
+    captureRemaining = 0;
+    if (captureKind != CaptureKind::TARE)
+    {
+        captureState.store(CAPTURE_FAILED, std::memory_order_release);
+    }
+}
+
+void Scale::sendCommand(ScaleCommand command)
+{
+    if (backgroundWeighingTaskHandle == NULL)
+    {
+        // nobody else is consuming samples right now, so it is safe to apply it directly
+        applyCommand(command);
+        return;
+    }
+
+    if (xQueueSend(commandQueue, &command, 0) != pdTRUE)
+    {
+        Serial.printf("Scale command queue full, dropping command %d\n", (int)command);
+        return;
+    }
+
+    // wake the weighing task so the command doesn't wait for the current interval to run out
+    xTaskNotifyGive(backgroundWeighingTaskHandle);
+}
+
+void Scale::processCommands()
+{
+    ScaleCommand command;
+    while (xQueueReceive(commandQueue, &command, 0) == pdTRUE)
+    {
+        applyCommand(command);
+    }
+}
+
+void Scale::applyCommand(ScaleCommand command)
+{
+    switch (command)
+    {
+    case ScaleCommand::TARE:
+        startCapture(CaptureKind::TARE);
+        break;
+    case ScaleCommand::ENTER_BARISTA:
+        if (!baristaMode)
+        {
+            // the tare below replaces the plate's offset until barista mode is left
+            bagOffset = offset;
+        }
+        baristaMode = true;
+        selectFilters(baristaFilters);
+        sampler.setLimits(BARISTA_SAMPLING_MIN_INTERVAL_MS, BARISTA_SAMPLING_MAX_INTERVAL_MS);
+        startCapture(CaptureKind::TARE);
+        dosing.reset();
+        break;
+    case ScaleCommand::LEAVE_BARISTA:
+        if (baristaMode)
+        {
+            offset = bagOffset;
+        }
+        baristaMode = false;
+        dosing.reset();
+        selectFilters(bagFilters);
+        sampler.setLimits(BAG_SAMPLING_MIN_INTERVAL_MS, BAG_SAMPLING_MAX_INTERVAL_MS);
+        break;
+    case ScaleCommand::BEGIN_CALIBRATION:
+        calibrating = true;
+        break;
+    case ScaleCommand::CAPTURE_CALIBRATION:
+        startCapture(CaptureKind::CALIBRATION);
+        break;
+    case ScaleCommand::LOAD_BAG_CAPTURE:
+        startCapture(CaptureKind::LOAD_BAG);
+        break;
+    case ScaleCommand::APPLY_CALIBRATION:
+        curve = pendingCurve;
+        offset = calibrationZeroCounts;
+        // readings from the old curve are meaningless now
+        selectFilters(*activeFilters);
+        break;
+    case ScaleCommand::END_CALIBRATION:
+        calibrating = false;
+        consumption.reset();
+        break;
+    case ScaleCommand::START_RAW_CAPTURE:
+        rawCapture.start(rawCaptureReset);
+        break;
+    case ScaleCommand::STOP_RAW_CAPTURE:
+        rawCapture.stop();
+        break;
+    case ScaleCommand::START_REPLAY:
+        if (source == &acquisition && replay.begin(CAPTURE_FILE, replaySpeed))
+        {
+            source = &replay;
+            // start the filters from the first recorded conversion
+            hasSamples = false;
+            selectFilters(*activeFilters);
+        }
+        break;
+    case ScaleCommand::START_SYNTHETIC:
+        if (source == &acquisition)
+        {
+            synthetic.begin(syntheticConfig);
+            source = &synthetic;
+            hasSamples = false;
+            selectFilters(*activeFilters);
+        }
+        break;
+    case ScaleCommand::STOP_REPLAY:
+        if (source != &acquisition)
+        {
+            restoreLiveSource();
+        }
+        break;
+    case ScaleCommand::SET_DOSE_TARGET:
+        dosing.setTarget(doseTarget);
+        break;
+    case ScaleCommand::RESTORE_DOSE_LEARNING:
+        dosing.restore(savedDoseLearning);
+        break;
+    case ScaleCommand::SET_TELEMETRY:
+        if (telemetryEnabled)
+        {
+            telemetry.start();
+        }
+        else
+        {
+            telemetry.stop();
+        }
+        break;
+    case ScaleCommand::RESET_HEALTH:
+        health.reset();
+        acquisition.driver().resetStats();
+        shelf.resetStats();
+        break;
+    case ScaleCommand::SHELF_CAPTURE:
+        if (LoadCellChannel *channel = shelf.find(shelfCaptureChannel))
+        {
+            channel->startCapture(shelfCaptureGrams);
+        }
+        break;
+    default:
+        Serial.printf("Unknown scale command %d\n", (int)command);
+        break;
+    }
+}
+
+void Scale::updateBagState()
+{
+    // Bag tracking only acts on settled readings, so lifting the bag or scooping
+    // doesn't flip the bag state or the reorder thresholds while the weight is moving
+    if (!hasBag || baristaMode || calibrating || !hasStableReading)
+    {
+        return;
+    }
+
+    bagTracker.update(stableReading, Weight::milligrams(reorderThreshold.load(std::memory_order_relaxed)),
+                      Weight::milligrams(promptThreshold.load(std::memory_order_relaxed)), handleBagEvent, this);
+}
+
+void Scale::emit(ScaleEventType type, Weight weight)
+{
+    ScaleEvent event;
+    event.type = type;
+    event.weight = weight;
+    event.timestampUs = lastSampleUs;
+    event.channel = 0;
+    queueEvent(event);
+}
+
+void Scale::queueEvent(const ScaleEvent &event)
+{
+    if (telemetry.isEnabled())
+    {
+        telemetry.event(event);
+    }
+    else
+    {
+        Serial.printf("Scale event %s on channel %u at %s\n", scaleEventName(event.type), event.channel,
+                      weightText(event.weight, 1).c_str());
+    }
+
+    if (xQueueSend(eventQueue, &event, 0) != pdTRUE)
+    {
+        Serial.printf("Scale event queue full, dropping %s\n", scaleEventName(event.type));
+    }
+
+    for (auto &slot : eventListeners)
+    {
+        QueueHandle_t listener = slot.load(std::memory_order_acquire);
+        if (listener != NULL && xQueueSend(listener, &event, 0) != pdTRUE)
+        {
+            Serial.printf("Scale event listener full, dropping %s\n", scaleEventName(event.type));
+        }
+    }
+}
+
+void Scale::handleBagEvent(void *arg, ScaleEventType type, Weight weight)
+{
+    static_cast<Scale *>(arg)->emit(type, weight);
+}
+
+void Scale::handleChannelEvent(void *arg, const ScaleEvent &event)
+{
+    static_cast<Scale *>(arg)->queueEvent(event);
+}
+
+bool Scale::addEventListener(QueueHandle_t queue)
+{
+    for (auto &slot : eventListeners)
+    {
+        QueueHandle_t empty = NULL;
+        if (slot.compare_exchange_strong(empty, queue, std::memory_order_acq_rel))
+        {
+            return true;
+        }
+    }
+
+    Serial.println("No free scale event listener slot");
+    return false;
+}
 
-    String text = String(weight, 1) + "g";
-    auto textWidth = tft.textWidth(text.c_str());
-    tft.setCursor(progressX + progressWidth + 10, progressY + progressHeight - 8);
-    tft.setTextColor(textColor);
-    tft.print(text.c_str());
+bool Scale::waitForEvent(ScaleEvent &event, TickType_t timeout)
+{
+    return xQueueReceive(eventQueue, &event, timeout) == pdTRUE;
+}
 
-    if (weight >= 0.0f)
+void Scale::recordConsumption(const ScaleEvent &event)
+{
+    if (event.type != ScaleEventType::CONSUMPTION || event.channel != 0)
     {
-        tft.setFreeFont(&GeistMono_VariableFont_wght14pt7b);
-        auto x = progressX + progressWidth + 10 + textWidth + 8;
-        tft.setCursor(x, progressY + progressHeight - 8);
-        tft.setTextColor(MUTED_TEXT_COLOR);
-        tft.print("/");
+        return;
+    }
 
-        x += tft.textWidth("/") + 4;
-        tft.setFreeFont(&GeistMono_VariableFont_wght12pt7b);
-        text = String(target, 1) + "g";
-        tft.print(text.c_str());
+    if (forecast.record(event.weight, time(nullptr)))
+    {
+        preferences.setForecastState(forecast.getState());
     }
+    updateReorderPoints();
+}
 
-    if (progressBarFill == baristaLastProgress && textColor != TEXT_COLOR_RED)
+void Scale::recordDose(const ScaleEvent &event)
+{
+    if (event.type != ScaleEventType::DOSE_DONE || event.channel != 0)
     {
         return;
     }
-    baristaLastProgress = progressBarFill;
 
-    // draw progress bar
-    tft.fillRect(progressX, progressY, progressWidth, progressHeight, BACKGROUND_COLOR);
-    tft.drawRect(progressX, progressY, progressWidth, progressHeight, BAG_COLOR);
-    tft.fillRect(progressX + 4,
-                 progressY + 4 + progressHeight - progressBarFill,
-                 progressWidth - 8,
-                 progressBarFill - 8,
-                 textColor);
+    preferences.setDoseLearning(doseLearning.read());
+}
+
+Weight Scale::getReorderThreshold(uint8_t channel)
+{
+    if (channel == 0)
+    {
+        return Weight::milligrams(reorderThreshold.load(std::memory_order_relaxed));
+    }
+
+    LoadCellChannel *shelfChannel = shelf.find(channel);
+    return shelfChannel != nullptr ? shelfChannel->getReorderThreshold() : Weight();
+}
+
+Weight Scale::getPromptThreshold(uint8_t channel)
+{
+    if (channel == 0)
+    {
+        return Weight::milligrams(promptThreshold.load(std::memory_order_relaxed));
+    }
+
+    LoadCellChannel *shelfChannel = shelf.find(channel);
+    return shelfChannel != nullptr ? shelfChannel->getPromptThreshold() : Weight();
+}
+
+void Scale::updateReorderPoints()
+{
+    // the last cart knows the current shipping timeframe, remember it for when there is no cart
+    float cartLeadDays = terminalApi.getShippingLeadDays();
+    if (cartLeadDays > 0.0f && cartLeadDays != leadDays)
+    {
+        leadDays = cartLeadDays;
+        preferences.setLeadDays(leadDays);
+    }
+
+    Weight reorder = Weight::grams(REORDER_BUTTON_THRESHOLD);
+    Weight prompt = Weight::grams(REORDER_BUTTON_PROMPT_THRESHOLD);
+    if (forecast.isConfident())
+    {
+        reorder = forecast.reorderPoint(leadDays, FORECAST_BUTTON_EXTRA_DAYS);
+        prompt = forecast.reorderPoint(leadDays);
+    }
+
+    reorderThreshold.store(reorder.toMilligrams(), std::memory_order_relaxed);
+    promptThreshold.store(prompt.toMilligrams(), std::memory_order_relaxed);
+}
+
+void Scale::printForecast()
+{
+    updateReorderPoints();
+    forecast.print(getSample().stableValue, leadDays);
+    Serial.printf("  plate thresholds %s/%s%s\n",
+                  weightText(Weight::milligrams(reorderThreshold.load(std::memory_order_relaxed)), 0).c_str(),
+                  weightText(Weight::milligrams(promptThreshold.load(std::memory_order_relaxed)), 0).c_str(),
+                  forecast.isConfident() ? "" : " (fixed until the forecast is confident)");
+}
+
+void Scale::publish()
+{
+    WeightSample sample;
+    sample.value = lastReading;
+    sample.stableValue = stableReading;
+    sample.rawCounts = lastRawCounts;
+    sample.flowRate = baristaMode ? dosing.getFlowRate() : 0.0f;
+    sample.timestampUs = lastSampleUs;
+    sample.sequence = ++publishedSequence;
+    sample.flags = currentFlags();
+
+    published.write(sample);
+}
+
+void Scale::queueHistory()
+{
+    uint32_t now = time(nullptr);
+    uint16_t flags = currentFlags();
+
+    // barista doses and a scale without settled readings are not bag history
+    if (now < HISTORY_MIN_VALID_TIME || !(flags & WEIGHT_VALID) || !(flags & WEIGHT_HAS_STABLE) || (flags & WEIGHT_BARISTA))
+    {
+        lastHistoryTime = 0;
+        return;
+    }
+
+    // the task sleeps up to SAMPLE_MAX_DRAIN_INTERVAL_MS while the weight holds still, and a wake
+    // on motion means the seconds it slept through read the same as now
+    const uint32_t step = HISTORY_RAW_INTERVAL_MS / 1000;
+    const uint32_t backfill = SAMPLE_MAX_DRAIN_INTERVAL_MS / HISTORY_RAW_INTERVAL_MS;
+    uint32_t second = lastHistoryTime ? lastHistoryTime + step : now;
+    if (second + backfill * step < now)
+    {
+        second = now - backfill * step;
+    }
+
+    for (; second <= now; second += step)
+    {
+        HistoryPoint point;
+        point.time = second;
+        point.mean = stableReading;
+        point.min = stableReading;
+        point.max = stableReading;
+        if (xQueueSend(historyQueue, &point, 0) != pdTRUE)
+        {
+            historyDropped++;
+        }
+        lastHistoryTime = second;
+    }
+}
+
+bool Scale::takeHistoryReading(HistoryPoint &point)
+{
+    return xQueueReceive(historyQueue, &point, 0) == pdTRUE;
+}
+
+uint16_t Scale::currentFlags()
+{
+    uint16_t flags = 0;
+
+    if (hasSamples && micros() - lastSampleUs <= SAMPLE_STALE_TIMEOUT_US)
+        flags |= WEIGHT_VALID;
+    if (readingIsStable)
+        flags |= WEIGHT_STABLE;
+    if (hasStableReading)
+        flags |= WEIGHT_HAS_STABLE;
+    if (baristaMode)
+        flags |= WEIGHT_BARISTA;
+    if (bagTracker.isRemoved())
+        flags |= WEIGHT_BAG_REMOVED;
+    if (bagTracker.isBelowThreshold())
+        flags |= WEIGHT_BELOW_THRESHOLD;
+    if (bagTracker.isBelowPromptThreshold())
+        flags |= WEIGHT_BELOW_PROMPT_THRESHOLD;
+    if (baristaMode && dosing.shouldStop())
+        flags |= WEIGHT_DOSE_STOP;
+
+    return flags;
+}
+
+bool Scale::isCalibrated()
+{
+    return preferences.isScaleCalibrated();
+}
+
+float Scale::getCalibrationFactor()
+{
+    return calibrationFactor;
+}
+
+long Scale::getZeroOffset()
+{
+    return zeroOffset;
+}
+
+void Scale::backgroundWeighingTask(void *parameter)
+{
+    Scale *scale = static_cast<Scale *>(parameter);
+
+    Weight minReading;
+    Weight maxReading;
+    Weight lastReading;
+
+    while (true)
+    {
+        scale->processCommands();
+        scale->checkCaptureTimeout();
+
+        Weight reading;
+        bool valid = scale->readWeight(reading);
+        reading = reading.roundTo(Weight::milligrams(100));
+
+        if (valid)
+        {
+            minReading = min(minReading, reading);
+            maxReading = max(maxReading, reading);
+
+            // the telemetry stream carries every conversion, the text would only corrupt its frames
+            if (reading != lastReading && !scale->telemetry.isEnabled())
+            {
+                Serial.printf("hasBag=%d, reading=%s min=%s max=%s\n", scale->hasBag.load(), weightText(reading, 1, "").c_str(),
+                              weightText(minReading, 1, "").c_str(), weightText(maxReading, 1, "").c_str());
+            }
+
+            lastReading = reading;
+        }
+
+        scale->updateBagState();
+        scale->publish();
+        scale->queueHistory();
+        scale->shelf.service();
+        scale->telemetry.service(Serial, scale->acquisition.total(), scale->acquisition.dropped());
+
+        // sleep until the next reading is due, a command arrives, or the ISR sees the weight start to move.
+        // A missing conversion says nothing about motion, so it keeps the current cadence
+        uint32_t interval = valid ? scale->sampler.update(reading) : scale->sampler.getInterval();
+        if (scale->captureRemaining > 0 || scale->source != &scale->acquisition)
+        {
+            // don't leave a tare, calibration measurement or replay waiting for the slow cadence
+            interval = min(interval, (uint32_t)BAG_SAMPLING_MIN_INTERVAL_MS);
+        }
+        if (scale->dosing.getState() == DoseState::DOSING)
+        {
+            // every buffered conversion is latency the stop signal has to make up for
+            interval = min(interval, (uint32_t)DOSE_POLL_INTERVAL_MS);
+        }
+        // the HX711s keep converting while the task sleeps, neither the plate's nor the shelf's
+        // buffers may overflow before it drains them
+        interval = min(interval, (uint32_t)SAMPLE_MAX_DRAIN_INTERVAL_MS);
+        if (scale->telemetry.isEnabled())
+        {
+            // keep the UART busy so the frame buffer doesn't fill up
+            interval = min(interval, (uint32_t)TELEMETRY_MAX_INTERVAL_MS);
+        }
+        if (scale->curve.size() > 0)
+        {
+            int32_t band = scale->sampler.getMotionThreshold().toGrams() * fabsf(scale->curve.getFactor());
+            scale->acquisition.wakeOnChange(scale->backgroundWeighingTaskHandle, scale->filteredCounts, band);
+        }
+        else
+        {
+            // uncalibrated, a band of 0 counts would wake the task on every conversion
+            scale->acquisition.wakeOnChange(NULL, 0, 0);
+        }
+        scale->shelf.wakeOnChange(scale->backgroundWeighingTaskHandle, scale->sampler.getMotionThreshold());
+        uint32_t sleepStart = micros();
+        bool notified = ulTaskNotifyTake(pdTRUE, interval / portTICK_PERIOD_MS) != 0;
+        scale->health.recordWake(interval * 1000, micros() - sleepStart, notified);
+    }
+}
+
+void Scale::startBackgroundWeighingTask()
+{
+    if (backgroundWeighingTaskHandle != NULL)
+    {
+        return;
+    }
+
+    xTaskCreate(
+        backgroundWeighingTask,
+        "BackgroundWeighing",
+        4096,
+        this,
+        4,
+        &backgroundWeighingTaskHandle);
+}
+
+// Enter Barista mode: single shot by default
+void Scale::enterBaristaMode()
+{
+    ui.clearScreen();
+
+    delay(500);
+    ui.menu->selectMenu(BARISTA_SINGLE);
+
+    // the weighing task switches filters and tares between two samples
+    sendCommand(ScaleCommand::ENTER_BARISTA);
+    setDoseTarget(SINGLE_DOSE_WEIGHT);
+}
+
+// Exit Barista mode: return to main menu
+void Scale::leaveBaristaMode()
+{
+    delay(500);
+    sendCommand(ScaleCommand::LEAVE_BARISTA);
+
+    baristaLastDrawnReading = Weight::grams(-99.0f);
+    ui.menu->selectMenu(MAIN_MENU);
+    ledStrip.turnOff();
+}
+
+// Draw Barista mode UI with progress towards target shot weight
+void Scale::drawBaristaMode()
+{
+    WeightSample sample = getSample();
+
+    // the weighing task hasn't switched over yet
+    if (!sample.has(WEIGHT_BARISTA))
+    {
+        return;
+    }
+
+    // follow the live reading while the dose is changing, settled readings don't flicker
+    Weight weight = sample.has(WEIGHT_STABLE) ? sample.stableValue : sample.value;
+    weight = weight.roundTo(Weight::milligrams(100));
+
+    bool stop = sample.has(WEIGHT_DOSE_STOP);
+    if (weight == baristaLastDrawnReading && stop == baristaLastDrawnStop)
+    {
+        return;
+    }
+    baristaLastDrawnReading = weight;
+    baristaLastDrawnStop = stop;
+
+    // determine target based on mode
+    Weight target = Weight::grams((ui.menu->current == BARISTA_SINGLE) ? SINGLE_DOSE_WEIGHT : DOUBLE_DOSE_WEIGHT);
+
+    uint8_t textColor = READOUT_TEXT;
+
+    // the stop signal comes ahead of the target, the rest is still on its way down
+    Weight diff = abs(target - weight);
+    bool close = diff < Weight::milligrams(600);
+    if (weight > target && !close)
+    {
+        textColor = READOUT_RED;
+        ledStrip.setColor(RgbColor(32, 0, 0));
+    }
+    else if (stop || close)
+    {
+        textColor = READOUT_GREEN;
+        ledStrip.setColor(RgbColor(0, 32, 0));
+    }
+    else
+    {
+        ledStrip.progress(constrain(weight.toGrams() / target.toGrams(), 0.0f, 1.0f), RgbColor(255 / 5, 94 / 5, 0));
+    }
+
+    int progressBarFill = constrain((int)((int64_t)weight.toMilligrams() * READOUT_HEIGHT / target.toMilligrams()), 0, READOUT_HEIGHT);
+
+    TFT_eSprite &canvas = ui.readoutText.canvas();
+
+    // show mode label
+    canvas.setTextSize(1);
+    canvas.setFreeFont(&GeistMono_VariableFont_wght12pt7b);
+    canvas.setCursor(0, GeistMono_VariableFont_wght12pt7b.yAdvance);
+    canvas.setTextColor(READOUT_TEXT);
+    canvas.print((ui.menu->current == BARISTA_SINGLE) ? "single-shot" : "double-shot");
+
+    // show weight vs target
+    String text = weightText(weight, 1);
+    auto textWidth = ui.baristaDigits.textWidth(text.c_str());
+    ui.baristaDigits.draw(canvas, text.c_str(), 0, READOUT_HEIGHT - 8, textColor);
+
+    if (weight >= Weight())
+    {
+        int16_t x = ui.slashGlyph.draw(canvas, "/", textWidth + 8, READOUT_HEIGHT - 8, READOUT_MUTED);
+        text = weightText(target, 1);
+        ui.targetDigits.draw(canvas, text.c_str(), x, READOUT_HEIGHT - 8, READOUT_MUTED);
+    }
+    ui.readoutText.push();
+
+    ui.drawReadoutBar(progressBarFill, textColor, false);
 }
 
 void Scale::forceBaristaRedraw()
 {
-    baristaLastProgress = -99;
-    baristaLastDrawnReading = -99.0f;
+    baristaLastDrawnReading = Weight::grams(-99.0f);
+    ui.readoutText.invalidate();
+    ui.readoutBar.invalidate();
 }
\ No newline at end of file
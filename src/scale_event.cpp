@@ -0,0 +1,28 @@
+#include "scale_event.h"
+
+const char *scaleEventName(ScaleEventType type)
+{
+    switch (type)
+    {
+    case ScaleEventType::BAG_REMOVED:
+        return "bag_removed";
+    case ScaleEventType::BAG_RETURNED:
+        return "bag_returned";
+    case ScaleEventType::BELOW_THRESHOLD:
+        return "below_threshold";
+    case ScaleEventType::ABOVE_THRESHOLD:
+        return "above_threshold";
+    case ScaleEventType::BELOW_PROMPT_THRESHOLD:
+        return "below_prompt_threshold";
+    case ScaleEventType::ABOVE_PROMPT_THRESHOLD:
+        return "above_prompt_threshold";
+    case ScaleEventType::CONSUMPTION:
+        return "consumption";
+    case ScaleEventType::DOSE_STOP:
+        return "dose_stop";
+    case ScaleEventType::DOSE_DONE:
+        return "dose_done";
+    default:
+        return "unknown";
+    }
+}
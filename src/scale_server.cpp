@@ -0,0 +1,212 @@
+#include "scale_server.h"
+#include <ArduinoJson.h>
+
+void ScaleServer::begin()
+{
+    if (isRunning())
+    {
+        return;
+    }
+
+    stateLock = xSemaphoreCreateMutex();
+    events = xQueueCreate(SERVER_EVENT_QUEUE_LENGTH, sizeof(ScaleEvent));
+    update();
+    scale.addEventListener(events);
+
+    socket.onEvent([this](AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t length)
+                   { handleSocketEvent(client, type, arg, data, length); });
+    server.addHandler(&socket);
+
+    server.on("/api/state", HTTP_GET, [this](AsyncWebServerRequest *request)
+              { request->send(200, "application/json", snapshot()); });
+    server.on("/api/stats", HTTP_GET, [this](AsyncWebServerRequest *request)
+              { request->send(200, "application/json", stats()); });
+    server.onNotFound([](AsyncWebServerRequest *request)
+                      { request->send(404, "text/plain", "Not found"); });
+    server.begin();
+
+    xTaskCreate(
+        pushTask,
+        "ScaleServerPush",
+        4096,
+        this,
+        SERVER_TASK_PRIORITY,
+        &pushTaskHandle);
+
+    Serial.printf("Server listening on http://%s:%d\n", WiFi.localIP().toString().c_str(), SERVER_PORT);
+}
+
+void ScaleServer::update()
+{
+    if (!isRunning() || millis() - lastStateRefresh < SERVER_STATE_REFRESH_MS)
+    {
+        return;
+    }
+    lastStateRefresh = millis();
+
+    ServerState fresh;
+    uint8_t channels = min((uint8_t)SCALE_MAX_CHANNELS, scale.getChannelCount());
+    for (uint8_t channel = 0; channel < channels; channel++)
+    {
+        fresh.bagNames[channel] = scale.getBagName(channel);
+        fresh.hasBag[channel] = scale.hasBagOn(channel);
+    }
+    fresh.consumptionRate = scale.getConsumptionRate();
+    fresh.leadDays = scale.getLeadDays();
+
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    state = fresh;
+    xSemaphoreGive(stateLock);
+}
+
+String ScaleServer::snapshot()
+{
+    xSemaphoreTake(stateLock, portMAX_DELAY);
+    ServerState copy = state;
+    xSemaphoreGive(stateLock);
+
+    JsonDocument doc;
+    doc["uptime_ms"] = millis();
+
+    JsonArray channels = doc["channels"].to<JsonArray>();
+    uint8_t count = min((uint8_t)SCALE_MAX_CHANNELS, scale.getChannelCount());
+    for (uint8_t channel = 0; channel < count; channel++)
+    {
+        WeightSample sample = scale.getSample(channel);
+        JsonObject entry = channels.add<JsonObject>();
+        entry["ch"] = channel;
+        entry["seq"] = sample.sequence;
+        entry["t"] = sample.timestampUs;
+        entry["mg"] = sample.value.toMilligrams();
+        entry["stable_mg"] = sample.stableValue.toMilligrams();
+        entry["flags"] = sample.flags;
+        entry["valid"] = sample.has(WEIGHT_VALID);
+        entry["stable"] = sample.has(WEIGHT_STABLE);
+        entry["has_bag"] = copy.hasBag[channel];
+        entry["bag"] = copy.bagNames[channel];
+        entry["bag_removed"] = sample.has(WEIGHT_BAG_REMOVED);
+        entry["reorder_threshold_mg"] = scale.getReorderThreshold(channel).toMilligrams();
+        entry["prompt_threshold_mg"] = scale.getPromptThreshold(channel).toMilligrams();
+        entry["below_reorder_threshold"] = sample.has(WEIGHT_BELOW_THRESHOLD);
+        entry["below_prompt_threshold"] = sample.has(WEIGHT_BELOW_PROMPT_THRESHOLD);
+        if (channel == 0)
+        {
+            entry["barista"] = sample.has(WEIGHT_BARISTA);
+            entry["flow"] = sample.flowRate;
+        }
+    }
+
+    JsonObject forecast = doc["forecast"].to<JsonObject>();
+    forecast["rate_g_per_day"] = copy.consumptionRate;
+    forecast["lead_days"] = copy.leadDays;
+    if (copy.consumptionRate > 0.0f)
+    {
+        forecast["days_until_empty"] = max(scale.getSample().stableValue.toGrams(), 0.0f) / copy.consumptionRate;
+    }
+
+    String json;
+    serializeJson(doc, json);
+    return json;
+}
+
+String ScaleServer::stats()
+{
+    JsonDocument doc;
+    doc["uptime_ms"] = millis();
+    doc["clients"] = socket.count();
+    doc["samples_sent"] = samplesSent;
+    doc["events_sent"] = eventsSent;
+    doc["partial_sends"] = partialSends;
+    doc["free_heap"] = ESP.getFreeHeap();
+
+    String json;
+    serializeJson(doc, json);
+    return json;
+}
+
+void ScaleServer::handleSocketEvent(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t length)
+{
+    if (type == WS_EVT_CONNECT)
+    {
+        // a slow client keeps its connection and misses readings until its queue has room again
+        client->setCloseClientOnQueueFull(false);
+        client->text(snapshot());
+    }
+    else if (type == WS_EVT_DATA)
+    {
+        // any message asks for a fresh snapshot, e.g. after the client noticed a gap
+        client->text(snapshot());
+    }
+}
+
+void ScaleServer::send(const char *message, size_t length)
+{
+    if (socket.textAll(message, length) != AsyncWebSocket::ENQUEUED)
+    {
+        partialSends++;
+    }
+}
+
+void ScaleServer::pushSamples()
+{
+    uint8_t channels = min((uint8_t)SCALE_MAX_CHANNELS, scale.getChannelCount());
+    for (uint8_t channel = 0; channel < channels; channel++)
+    {
+        WeightSample sample = scale.getSample(channel);
+        if (sample.sequence == lastSequence[channel])
+        {
+            continue;
+        }
+        lastSequence[channel] = sample.sequence;
+
+        char message[192];
+        int length = snprintf(message, sizeof(message),
+                              "{\"type\":\"sample\",\"ch\":%u,\"seq\":%u,\"t\":%u,\"mg\":%d,\"stable_mg\":%d,"
+                              "\"flags\":%u,\"stable\":%s,\"flow\":%.2f}",
+                              channel, sample.sequence, sample.timestampUs, sample.value.toMilligrams(),
+                              sample.stableValue.toMilligrams(), sample.flags,
+                              sample.has(WEIGHT_STABLE) ? "true" : "false", sample.flowRate);
+        send(message, length);
+        samplesSent++;
+    }
+}
+
+void ScaleServer::pushEvent(const ScaleEvent &event)
+{
+    char message[128];
+    int length = snprintf(message, sizeof(message),
+                          "{\"type\":\"event\",\"event\":\"%s\",\"ch\":%u,\"t\":%u,\"mg\":%d}",
+                          scaleEventName(event.type), event.channel, event.timestampUs,
+                          event.weight.toMilligrams());
+    send(message, length);
+    eventsSent++;
+}
+
+void ScaleServer::pushTask(void *parameter)
+{
+    ScaleServer *server = static_cast<ScaleServer *>(parameter);
+
+    while (true)
+    {
+        // events go out as soon as they arrive, readings on the next push
+        unsigned long elapsed = millis() - server->lastPushTime;
+        TickType_t wait = elapsed >= SERVER_PUSH_INTERVAL_MS ? 0 : pdMS_TO_TICKS(SERVER_PUSH_INTERVAL_MS - elapsed);
+
+        ScaleEvent event;
+        if (xQueueReceive(server->events, &event, wait) == pdTRUE)
+        {
+            if (server->socket.count() > 0)
+            {
+                server->pushEvent(event);
+            }
+            continue;
+        }
+
+        server->lastPushTime = millis();
+        if (server->socket.count() > 0)
+        {
+            server->pushSamples();
+        }
+        server->socket.cleanupClients(SERVER_MAX_CLIENTS);
+    }
+}
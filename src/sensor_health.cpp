@@ -0,0 +1,143 @@
+#include "sensor_health.h"
+
+void SensorHealth::update(const RawSample &sample, bool stable)
+{
+    if (sample.counts >= 0x7FFFFF || sample.counts <= -0x800000)
+    {
+        saturated++;
+    }
+
+    if (!hasLast)
+    {
+        hasLast = true;
+        lastTimestampUs = sample.timestampUs;
+        lastCounts = sample.counts;
+        return;
+    }
+
+    uint32_t interval = sample.timestampUs - lastTimestampUs;
+    conversionInterval.add(interval);
+
+    if (nominalIntervalUs == 0.0f)
+    {
+        nominalIntervalUs = interval;
+    }
+    else if (interval > nominalIntervalUs * HEALTH_GAP_FACTOR)
+    {
+        gaps++;
+        missedConversions += lroundf(interval / nominalIntervalUs) - 1;
+    }
+    else
+    {
+        // gaps stay out of the estimate so a flaky unit doesn't talk itself into a slower rate
+        nominalIntervalUs += (interval - nominalIntervalUs) * 0.05f;
+    }
+
+    if (sample.counts == lastCounts)
+    {
+        if (++repeatCount == HEALTH_STUCK_SAMPLES)
+        {
+            stuckRuns++;
+        }
+    }
+    else
+    {
+        repeatCount = 0;
+    }
+
+    int32_t diff = sample.counts - lastCounts;
+    if (diffCount == HEALTH_NOISE_WINDOW)
+    {
+        int32_t old = diffs[diffHead];
+        diffSum -= old;
+        diffSumSquares -= (int64_t)old * old;
+    }
+    else
+    {
+        diffCount++;
+    }
+    diffs[diffHead] = diff;
+    diffHead = (diffHead + 1) % HEALTH_NOISE_WINDOW;
+    diffSum += diff;
+    diffSumSquares += (int64_t)diff * diff;
+
+    if (stable && diffCount == HEALTH_NOISE_WINDOW)
+    {
+        stableNoise = getNoise();
+    }
+
+    lastTimestampUs = sample.timestampUs;
+    lastCounts = sample.counts;
+}
+
+void SensorHealth::recordWake(uint32_t requestedUs, uint32_t sleptUs, bool notified)
+{
+    if (notified)
+    {
+        earlyWakes++;
+        return;
+    }
+
+    wakeLateness.add(sleptUs > requestedUs ? sleptUs - requestedUs : 0);
+}
+
+float SensorHealth::getNoise()
+{
+    if (diffCount < HEALTH_NOISE_WINDOW)
+    {
+        return -1.0f;
+    }
+
+    // subtracting the mean removes a constant slope, e.g. a bag being filled
+    float mean = (float)diffSum / diffCount;
+    float variance = ((float)diffSumSquares - mean * diffSum) / (diffCount - 1);
+    return sqrtf(max(variance, 0.0f) / 2.0f);
+}
+
+HealthCounters SensorHealth::getCounters()
+{
+    HealthCounters counters;
+    counters.gaps = gaps;
+    counters.missedConversions = missedConversions;
+    counters.saturated = saturated;
+    counters.stuckRuns = stuckRuns;
+    counters.staleReadings = staleReadings;
+    return counters;
+}
+
+void SensorHealth::reset()
+{
+    conversionInterval.reset();
+    wakeLateness.reset();
+    drainBatch.reset();
+    gaps = 0;
+    missedConversions = 0;
+    saturated = 0;
+    stuckRuns = 0;
+    staleReadings = 0;
+    earlyWakes = 0;
+    hasLast = false;
+    repeatCount = 0;
+    diffHead = 0;
+    diffCount = 0;
+    diffSum = 0;
+    diffSumSquares = 0;
+    stableNoise = -1.0f;
+}
+
+void SensorHealth::print(float countsPerGram)
+{
+    float gramsPerCount = countsPerGram != 0.0f ? 1.0f / fabsf(countsPerGram) : 0.0f;
+    float noise = getNoise();
+
+    Serial.printf("health: nominal interval=%.2fms gaps=%lu missed=%lu saturated=%lu stuck=%lu stale=%lu\n",
+                  nominalIntervalUs / 1000.0f, (unsigned long)gaps, (unsigned long)missedConversions,
+                  (unsigned long)saturated, (unsigned long)stuckRuns, (unsigned long)staleReadings);
+    Serial.printf("noise: rolling=%.1f counts (%.3fg) stable=%.1f counts (%.3fg)\n",
+                  noise, noise * gramsPerCount, stableNoise, stableNoise * gramsPerCount);
+
+    conversionInterval.print("conversion interval", "ms", 1000.0f);
+    wakeLateness.print("wake lateness", "ms", 1000.0f);
+    Serial.printf("early wakes (weight moved or command): %lu\n", (unsigned long)earlyWakes);
+    drainBatch.print("conversions per wake", "");
+}
@@ -0,0 +1,159 @@
+#include "sprite_readout.h"
+
+bool SpriteReadout::begin(int16_t x, int16_t y, uint16_t width, uint16_t height, const uint16_t *colors, uint8_t count)
+{
+    if (!pipeline.isReady())
+    {
+        Serial.println("No display buffers for the readout");
+        return false;
+    }
+
+    this->x = x;
+    this->y = y;
+    // two pixels per byte, rows start on a byte
+    this->width = (width + 1) & ~1;
+    this->height = height;
+
+    for (uint8_t i = 0; i < READOUT_COLORS; i++)
+    {
+        palette[i] = i < count ? colors[i] : colors[0];
+        wirePalette[i] = (palette[i] >> 8) | (palette[i] << 8);
+    }
+
+    for (TFT_eSprite *sprite : {&first, &second})
+    {
+        sprite->setColorDepth(4);
+        if (sprite->createSprite(this->width, height) == nullptr)
+        {
+            Serial.printf("Not enough memory for a %ux%u readout\n", this->width, height);
+            first.deleteSprite();
+            second.deleteSprite();
+            return false;
+        }
+        sprite->createPalette(palette, READOUT_COLORS);
+        sprite->fillSprite(0);
+    }
+
+    ready = true;
+    invalid = true;
+    return true;
+}
+
+TFT_eSprite &SpriteReadout::canvas()
+{
+    frameStarted = micros();
+    drawing->fillSprite(0);
+    return *drawing;
+}
+
+void SpriteReadout::push()
+{
+    if (!isReady())
+    {
+        return;
+    }
+
+    const uint16_t stride = width / 2;
+    const uint8_t *previous = (const uint8_t *)shown->getPointer();
+    const uint8_t *next = (const uint8_t *)drawing->getPointer();
+
+    // bounding box of the bytes that changed
+    int16_t top = -1;
+    int16_t bottom = -1;
+    uint16_t left = stride;
+    uint16_t right = 0;
+    for (uint16_t row = 0; row < height; row++)
+    {
+        const uint8_t *before = previous + row * stride;
+        const uint8_t *after = next + row * stride;
+
+        if (invalid)
+        {
+            left = 0;
+            right = stride - 1;
+        }
+        else
+        {
+            if (memcmp(before, after, stride) == 0)
+            {
+                continue;
+            }
+
+            uint16_t from = 0;
+            while (before[from] == after[from])
+            {
+                from++;
+            }
+            uint16_t to = stride - 1;
+            while (before[to] == after[to])
+            {
+                to--;
+            }
+            left = min(left, from);
+            right = max(right, to);
+        }
+
+        if (top < 0)
+        {
+            top = row;
+        }
+        bottom = row;
+    }
+
+    stats.frames++;
+    stats.bytesFull += (uint32_t)width * height * 2;
+
+    if (top >= 0)
+    {
+        const uint16_t windowWidth = (right - left + 1) * 2;
+        const uint16_t windowHeight = bottom - top + 1;
+
+        // as many rows as fit in a buffer go out at once
+        const uint16_t bandHeight = DISPLAY_BUFFER_PIXELS / windowWidth;
+        pipeline.start();
+        for (uint16_t bandTop = top; bandTop <= bottom; bandTop += bandHeight)
+        {
+            const uint16_t bandBottom = min((uint16_t)(bandTop + bandHeight - 1), (uint16_t)bottom);
+            uint16_t *out = pipeline.buffer();
+            for (uint16_t row = bandTop; row <= bandBottom; row++)
+            {
+                // even pixels are in the high nibble
+                const uint8_t *pixels = next + row * stride;
+                for (uint16_t i = left; i <= right; i++)
+                {
+                    *out++ = wirePalette[pixels[i] >> 4];
+                    *out++ = wirePalette[pixels[i] & 0x0F];
+                }
+            }
+            pipeline.push(x + left * 2, y + bandTop, windowWidth, bandBottom - bandTop + 1);
+        }
+        pipeline.end();
+
+        stats.pushes++;
+        stats.bytesPushed += (uint32_t)windowWidth * windowHeight * 2;
+    }
+
+    TFT_eSprite *pushed = drawing;
+    drawing = shown;
+    shown = pushed;
+    invalid = false;
+
+    stats.micros += micros() - frameStarted;
+}
+
+void SpriteReadout::printStats(const char *name)
+{
+    if (stats.frames == 0)
+    {
+        Serial.printf("%s: no frames\n", name);
+        return;
+    }
+
+    Serial.printf("%s: %u frames, %u pushed, %llu bytes per frame (%llu for the whole area), %llu us per frame\n",
+                  name,
+                  stats.frames,
+                  stats.pushes,
+                  stats.bytesPushed / stats.frames,
+                  stats.bytesFull / stats.frames,
+                  stats.micros / stats.frames);
+}
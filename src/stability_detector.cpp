@@ -0,0 +1,83 @@
+#include "stability_detector.h"
+#include <algorithm>
+
+static int64_t squared(Weight weight)
+{
+    return (int64_t)weight.toMilligrams() * weight.toMilligrams();
+}
+
+StabilityDetector::StabilityDetector(Weight enterStdDev, Weight exitStdDev, Weight enterDrift, Weight exitDrift)
+    : enterVariance(squared(enterStdDev)),
+      exitVariance(squared(std::max(exitStdDev, enterStdDev))),
+      enterDrift(enterDrift),
+      exitDrift(std::max(exitDrift, enterDrift))
+{
+}
+
+bool StabilityDetector::update(Weight weight)
+{
+    window[head] = weight;
+    head = (head + 1) % STABILITY_WINDOW_SIZE;
+    if (count < STABILITY_WINDOW_SIZE)
+    {
+        count++;
+        return false;
+    }
+
+    int64_t sum = 0;
+    for (uint8_t i = 0; i < STABILITY_WINDOW_SIZE; i++)
+    {
+        sum += window[i].toMilligrams();
+    }
+    Weight mean = Weight::milligrams(sum / STABILITY_WINDOW_SIZE);
+
+    int64_t squares = 0;
+    for (uint8_t i = 0; i < STABILITY_WINDOW_SIZE; i++)
+    {
+        squares += squared(window[i] - mean);
+    }
+    variance = squares / STABILITY_WINDOW_SIZE;
+
+    // head now points at the oldest reading
+    Weight drift = abs(weight - window[head]);
+
+    if (stable)
+    {
+        if (variance > exitVariance || drift > exitDrift)
+        {
+            stable = false;
+            return false;
+        }
+
+        // follow slow creep, but ignore noise around the value we already published
+        if (abs(mean - stableValue) > enterDrift)
+        {
+            stableValue = mean;
+            return true;
+        }
+
+        return false;
+    }
+
+    if (variance < enterVariance && drift < enterDrift)
+    {
+        stable = true;
+        bool changed = !hasStable || abs(mean - stableValue) > enterDrift;
+        hasStable = true;
+        if (changed)
+        {
+            stableValue = mean;
+        }
+        return changed;
+    }
+
+    return false;
+}
+
+void StabilityDetector::reset()
+{
+    head = 0;
+    count = 0;
+    stable = false;
+    hasStable = false;
+}
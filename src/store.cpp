@@ -1,6 +1,37 @@
 #include "store.h"
 #include "debug.h"
 #include "buttons.h"
+#include "peer_coordinator.h"
+
+void Store::begin()
+{
+    const char *letters[] = {"B", "U", "Y"};
+    const int16_t letterHeight = GeistMono_VariableFont_wght14pt7b.yAdvance;
+    for (int i = 0; i < 3; i++)
+    {
+        buyLetters[i].setPosition(tft.width() - 20, 120 + i * (letterHeight + 4));
+        buyLetters[i].setText(letters[i]);
+    }
+    productName.setPosition(20, 140);
+    productName.fitFonts(allFonts, tft.width() - 16);
+    productVariant.setPosition(20, 180);
+    productVariant.fitFonts(nonTitleFonts, tft.width() - 16);
+
+    orderId.setPosition(20, 120);
+    orderId.fitFonts(allFonts, tft.width() - 30);
+    orderDate.setPosition(20, 160);
+
+    for (TextWidget *widget : {&buyLetters[0], &buyLetters[1], &buyLetters[2], &productName, &productVariant})
+    {
+        widget->setScreens(SCREEN(STORE_BROWSE));
+        ui.compositor.add(*widget);
+    }
+    for (TextWidget *widget : {&orderId, &orderDate, &orderStatus})
+    {
+        widget->setScreens(SCREEN(STORE_ORDERS));
+        ui.compositor.add(*widget);
+    }
+}
 
 void Store::exit()
 {
@@ -28,7 +59,7 @@ void Store::draw()
     }
 
     // clear the screen except menu clearance
-    tft.fillRect(0, Menu::menuClearance, tft.width(), tft.height() - Menu::menuClearance, BACKGROUND_COLOR);
+    ui.clearContent();
 
     auto bounds = ui.typeText("Store", titleText);
     delay(1000);
@@ -46,7 +77,7 @@ void Store::loadOrders()
         return;
     }
 
-    tft.fillScreen(BACKGROUND_COLOR);
+    ui.clearScreen();
     auto bounds = ui.typeTitle("Loading orders");
     ui.startBlinking();
 
@@ -90,18 +121,8 @@ void Store::drawOrders()
         recalcMenuButtons(orderIndex, orders.size());
     }
 
-    tft.fillRect(0, Menu::menuClearance - tft.fontHeight(), tft.width(), tft.height(), BACKGROUND_COLOR);
-
-    const uint16_t startY = Menu::menuClearance + 40;
-
-    tft.setTextColor(ACCENT_COLOR);
-    tft.setCursor(20, startY);
-
     auto &order = orders[orderIndex];
-    String orderId = order.id.substring(0, 16) + "..";
-    ui.setIdealFont(orderId.c_str(), 30);
-
-    tft.print(orderId);
+    orderId.setText(order.id.substring(0, 16) + "..");
 
     String status = "UNKNOWN";
     if (!order.tracking.status.isEmpty())
@@ -109,28 +130,25 @@ void Store::drawOrders()
         status = order.tracking.status;
     }
 
-    tft.setCursor(20, startY + 40);
-
-    String subheaderText = order.created.substring(0, 10) + " - " + status;
-    ui.setIdealFont(subheaderText.c_str(), 30);
-    tft.setTextColor(TEXT_COLOR);
-    tft.print(order.created.substring(0, 10).c_str());
-    tft.print(" - ");
+    // date and status share the font that fits both
+    String date = order.created.substring(0, 10) + " - ";
+    const GFXfont *font = TextWidget::fit(tft, (date + status).c_str(), allFonts, tft.width() - 30);
+    orderDate.setFont(font);
+    orderDate.setText(date);
 
+    uint16_t statusColor = 0x44FC;
     if (status == "DELIVERED")
     {
-        tft.setTextColor(0x05C8);
+        statusColor = 0x05C8;
     }
     else if (status == "UNKNOWN")
     {
-        tft.setTextColor(0xD9A7);
-    }
-    else
-    {
-        tft.setTextColor(0x44FC);
+        statusColor = 0xD9A7;
     }
-
-    tft.print(status.c_str());
+    orderStatus.setFont(font);
+    orderStatus.setPosition(20 + orderDate.getWidth(), 160);
+    orderStatus.setColor(statusColor);
+    orderStatus.setText(status);
 
     ui.drawProgressIndicator(orderIndex, orders.size());
 }
@@ -163,7 +181,7 @@ void Store::recalcMenuButtons(int index, int size)
 
     if (shouldRedraw)
     {
-        ui.menu->redraw();
+        ui.menu->draw();
     }
 
     ledStrip.scrollIndicator(index, size);
@@ -207,43 +225,16 @@ void Store::drawProducts()
         recalcMenuButtons(productIndex, products.size());
     }
 
-    uint16_t y = 60 + 60;
-    tft.fillRect(0, Menu::menuClearance - tft.fontHeight(), tft.width(), tft.height(), BACKGROUND_COLOR);
-
-    tft.setFreeFont(&GeistMono_VariableFont_wght14pt7b);
-    tft.setTextColor(ACCENT_COLOR);
-    tft.setCursor(tft.width() - 20 - tft.textWidth("B") / 2, y);
-    tft.print("B");
-    tft.setCursor(tft.width() - 20 - tft.textWidth("U") / 2, y + tft.fontHeight() + 4);
-    tft.print("U");
-    tft.setCursor(tft.width() - 20 - tft.textWidth("Y") / 2, y + tft.fontHeight() * 2 + 8);
-    tft.print("Y");
-
-    y += 20;
-
-    tft.setFreeFont(&GeistMono_VariableFont_wght18pt7b);
-
-    tft.setTextColor(ACCENT_COLOR);
-    tft.setCursor(20, y);
-
     auto &product = products[productIndex];
-    ui.setIdealFont(product.name.c_str());
-    tft.print(product.name.c_str());
-
-    y += 40;
-    tft.setCursor(20, y);
-
-    String subheader = product.variants[0].name + " - $" + String(product.variants[0].price / 100.0f, 2);
-    ui.setIdealFont(subheader.c_str(), nonTitleFonts);
-    tft.setTextColor(TEXT_COLOR);
-    tft.print(subheader.c_str());
+    productName.setText(product.name);
+    productVariant.setText(product.variants[0].name + " - $" + String(product.variants[0].price / 100.0f, 2));
 
     ui.drawProgressIndicator(productIndex, products.size());
 }
 
 void Store::loadProducts()
 {
-    tft.fillScreen(BACKGROUND_COLOR);
+    ui.clearScreen();
     auto bounds = ui.typeTitle("Loading products");
     ui.startBlinking();
 
@@ -313,7 +304,7 @@ void Store::nextProduct()
 void Store::buyProduct()
 {
     tft.setFreeFont(&GeistMono_VariableFont_wght18pt7b);
-    tft.fillScreen(BACKGROUND_COLOR);
+    ui.clearScreen();
     tft.setTextColor(TEXT_COLOR);
 
     auto tw = tft.textWidth("Hold to buy");
@@ -361,7 +352,8 @@ void Store::buyProduct()
 
     if (!finished)
     {
-        ui.menu->taint();
+        // the hold animation drew over the page
+        ui.clearScreen();
         taint();
         recalcMenuButtons(productIndex, products.size());
         return;
@@ -394,7 +386,30 @@ void Store::orderProduct(String bagName)
 
 void Store::orderProduct(Product product, Variant variant)
 {
-    tft.fillScreen(BACKGROUND_COLOR);
+    ui.clearScreen();
+
+    // Another scale tracking the same bag may be ordering it too, only one of them goes ahead
+    PeerCoordinator *peers = terminalApi.getPeers();
+    if (peers != nullptr && peers->isRunning())
+    {
+        auto bounds = ui.typeTitle("Checking other scales...");
+        uint32_t holder = 0;
+        LeaseStatus status = peers->acquireOrderLease(variant.id, holder);
+        ui.wipeText(bounds);
+
+        if (status != LeaseStatus::GRANTED)
+        {
+            Serial.printf("Not ordering %s, %s by %08x\n", variant.id.c_str(), leaseStatusName(status), holder);
+            bounds = ui.typeTitle(status == LeaseStatus::DENIED_ORDERED ? "Ordered by another scale" : "Another scale is ordering");
+            delay(3000);
+            ui.wipeText(bounds);
+
+            taint();
+            ui.menu->selectMenu(MAIN_MENU);
+            return;
+        }
+    }
+
     auto bounds = ui.typeTitle("Clearing cart...");
     if (terminalApi.clearCart())
     {
@@ -407,11 +422,15 @@ void Store::orderProduct(Product product, Variant variant)
 
     ui.wipeText(bounds);
     bounds = ui.typeTitle("Adding to cart...");
-    Cart *cart = terminalApi.addItemToCart(products[productIndex].variants[0].id.c_str(), 1);
+    Cart *cart = terminalApi.addItemToCart(variant.id.c_str(), 1);
     if (!cart)
     {
+        if (peers != nullptr)
+        {
+            peers->releaseOrderLease(variant.id, false);
+        }
+        ui.clearScreen();
         taint();
-        ui.menu->taint();
         return;
     }
     ui.wipeText(bounds);
@@ -422,10 +441,14 @@ void Store::orderProduct(Product product, Variant variant)
 
     bounds = ui.typeTitle("Placing order...");
     Order *order = terminalApi.convertCartToOrder();
+    if (peers != nullptr)
+    {
+        peers->releaseOrderLease(variant.id, order != nullptr);
+    }
     if (!order)
     {
+        ui.clearScreen();
         taint();
-        ui.menu->taint();
         return;
     }
 
@@ -442,7 +465,7 @@ void Store::orderProduct(Product product, Variant variant)
 
 void Store::openToReorder(String bagName)
 {
-    tft.fillScreen(BACKGROUND_COLOR);
+    ui.clearScreen();
 
     loadProducts();
     if (products.empty())
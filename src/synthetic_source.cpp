@@ -0,0 +1,234 @@
+#include "synthetic_source.h"
+#include <string.h>
+#include <algorithm>
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+
+static uint32_t micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+#define SYNTHETIC_TWO_PI 6.2831853f
+
+SyntheticConfig syntheticDefaults(SyntheticScenario scenario)
+{
+    SyntheticConfig config;
+    config.scenario = scenario;
+
+    switch (scenario)
+    {
+    case SyntheticScenario::MAINS_NOISE:
+        config.mainsGrams = 0.5f;
+        break;
+    case SyntheticScenario::SPIKES:
+        config.spikeProbability = 0.002f;
+        break;
+    case SyntheticScenario::ESPRESSO_POUR:
+        config.samples = config.sampleRate * 40;
+        break;
+    default:
+        break;
+    }
+
+    return config;
+}
+
+void SyntheticSource::begin(const SyntheticConfig &newConfig)
+{
+    config = newConfig;
+    index = 0;
+    // xorshift gets stuck on a zero state
+    rngState = config.seed != 0 ? config.seed : 1;
+    startUs = micros();
+    truthGrams = 0.0f;
+    truthSettled = true;
+}
+
+uint32_t SyntheticSource::nextRandom()
+{
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState;
+}
+
+float SyntheticSource::uniform()
+{
+    return (nextRandom() >> 8) * (1.0f / 16777216.0f);
+}
+
+float SyntheticSource::gaussian()
+{
+    // Irwin-Hall: the sum of 4 uniforms is close enough to normal for sensor noise and much cheaper
+    // than Box-Muller. Scaled to unit variance
+    float sum = uniform() + uniform() + uniform() + uniform();
+    return (sum - 2.0f) * 1.7320508f;
+}
+
+// Linear move from `from` to `to` between `start` and `end` seconds
+static float ramp(float t, float start, float end, float from, float to)
+{
+    return from + (to - from) * (t - start) / (end - start);
+}
+
+float SyntheticSource::profile(float t, bool &settled)
+{
+    settled = true;
+
+    switch (config.scenario)
+    {
+    case SyntheticScenario::CREEP:
+        // load cell creep settles over ~10 minutes, temperature swings over an hour
+        return SYNTHETIC_FULL_BAG_GRAMS + 3.0f * (1.0f - expf(-t / 600.0f)) + 0.3f * sinf(SYNTHETIC_TWO_PI * t / 3600.0f);
+
+    case SyntheticScenario::SCOOP:
+    {
+        uint32_t cycle = t / 30.0f;
+        float phase = t - cycle * 30.0f;
+        float before = std::max(SYNTHETIC_FULL_BAG_GRAMS - cycle * 8.0f, SYNTHETIC_EMPTY_BAG_GRAMS);
+        float after = std::max(before - 8.0f, SYNTHETIC_EMPTY_BAG_GRAMS);
+
+        if (phase < 20.0f)
+            return before;
+        if (phase < 20.3f)
+        {
+            settled = false;
+            return ramp(phase, 20.0f, 20.3f, before, 0.0f);
+        }
+        if (phase < 22.0f)
+            return 0.0f;
+        if (phase < 22.3f)
+        {
+            settled = false;
+            return ramp(phase, 22.0f, 22.3f, 0.0f, after);
+        }
+        return after;
+    }
+
+    case SyntheticScenario::BAG_SWAP:
+    {
+        float half = config.samples / (2.0f * config.sampleRate);
+        float empty = SYNTHETIC_EMPTY_BAG_GRAMS + 20.0f;
+
+        if (t < half)
+            return empty;
+        if (t < half + 0.5f)
+        {
+            settled = false;
+            return ramp(t, half, half + 0.5f, empty, 0.0f);
+        }
+        if (t < half + 5.0f)
+            return 0.0f;
+        if (t < half + 5.5f)
+        {
+            settled = false;
+            return ramp(t, half + 5.0f, half + 5.5f, 0.0f, SYNTHETIC_FULL_BAG_GRAMS);
+        }
+        return SYNTHETIC_FULL_BAG_GRAMS;
+    }
+
+    case SyntheticScenario::ESPRESSO_POUR:
+        if (t < 2.0f)
+            return 0.0f;
+        if (t < 20.0f)
+        {
+            // flow starts slow and picks up, 36g in 18s
+            settled = false;
+            float progress = (t - 2.0f) / 18.0f;
+            return 36.0f * progress * progress * (3.0f - 2.0f * progress);
+        }
+        return 36.0f;
+
+    default:
+        return SYNTHETIC_FULL_BAG_GRAMS;
+    }
+}
+
+bool SyntheticSource::read(RawSample &sample)
+{
+    if (index >= config.samples)
+    {
+        return false;
+    }
+
+    // 32 bits of microseconds would wrap after 71 minutes of stream
+    uint64_t offsetUs = (uint64_t)index * 1000000 / config.sampleRate;
+    if (config.speed > 0.0f && offsetUs > (micros() - startUs) * config.speed)
+    {
+        return false;
+    }
+
+    float t = offsetUs / 1000000.0f;
+    truthGrams = profile(t, truthSettled);
+
+    float grams = truthGrams + gaussian() * config.noiseGrams;
+    if (config.mainsGrams > 0.0f)
+    {
+        // whole mains periods fit in a second, the phase stays exact however long the stream runs
+        float second = (offsetUs % 1000000) / 1000000.0f;
+        grams += config.mainsGrams * sinf(SYNTHETIC_TWO_PI * SYNTHETIC_MAINS_HZ * second);
+    }
+
+    int32_t counts = config.zeroCounts + lroundf(grams * config.countsPerGram);
+
+    if (config.spikeProbability > 0.0f && uniform() < config.spikeProbability)
+    {
+        int32_t spike = (1 << 18) + (nextRandom() % (1 << 20));
+        counts += (nextRandom() & 1) ? spike : -spike;
+    }
+
+    // the HX711 saturates at its 24-bit range
+    sample.counts = std::min(std::max(counts, -0x800000), 0x7FFFFF);
+    sample.timestampUs = micros();
+
+    index++;
+    return true;
+}
+
+const char *syntheticScenarioName(SyntheticScenario scenario)
+{
+    switch (scenario)
+    {
+    case SyntheticScenario::CREEP:
+        return "creep";
+    case SyntheticScenario::SCOOP:
+        return "scoop";
+    case SyntheticScenario::BAG_SWAP:
+        return "swap";
+    case SyntheticScenario::ESPRESSO_POUR:
+        return "pour";
+    case SyntheticScenario::MAINS_NOISE:
+        return "mains";
+    case SyntheticScenario::SPIKES:
+        return "spikes";
+    default:
+        return "unknown";
+    }
+}
+
+bool parseSyntheticScenario(const char *name, SyntheticScenario &scenario)
+{
+    const SyntheticScenario scenarios[] = {
+        SyntheticScenario::CREEP,
+        SyntheticScenario::SCOOP,
+        SyntheticScenario::BAG_SWAP,
+        SyntheticScenario::ESPRESSO_POUR,
+        SyntheticScenario::MAINS_NOISE,
+        SyntheticScenario::SPIKES,
+    };
+
+    for (SyntheticScenario candidate : scenarios)
+    {
+        if (strcmp(name, syntheticScenarioName(candidate)) == 0)
+        {
+            scenario = candidate;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,170 @@
+#include "telemetry.h"
+
+static uint8_t *put(uint8_t *out, const void *value, size_t size)
+{
+    memcpy(out, value, size);
+    return out + size;
+}
+
+uint16_t TelemetryStream::crc16(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+size_t TelemetryStream::cobsEncode(const uint8_t *data, size_t length, uint8_t *out)
+{
+    size_t codeIndex = 0;
+    size_t written = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (data[i] != 0)
+        {
+            out[written++] = data[i];
+            code++;
+        }
+
+        if (data[i] == 0 || code == 0xFF)
+        {
+            out[codeIndex] = code;
+            codeIndex = written++;
+            code = 1;
+        }
+    }
+
+    out[codeIndex] = code;
+    return written;
+}
+
+void TelemetryStream::start()
+{
+    head = 0;
+    tail = 0;
+    sequence = 0;
+    framesQueued = 0;
+    framesDropped = 0;
+    lastStatusTime = 0;
+    enabled = true;
+}
+
+void TelemetryStream::stop()
+{
+    enabled = false;
+}
+
+void TelemetryStream::queueFrame(TelemetryFrameType type, const uint8_t *payload, uint8_t length)
+{
+    uint8_t frame[TELEMETRY_MAX_FRAME];
+    uint8_t *out = frame;
+    *out++ = (uint8_t)type;
+    out = put(out, &sequence, sizeof(sequence));
+    out = put(out, payload, length);
+    uint16_t crc = crc16(frame, out - frame);
+    out = put(out, &crc, sizeof(crc));
+    sequence++;
+
+    uint8_t encoded[TELEMETRY_MAX_FRAME + TELEMETRY_MAX_FRAME / 254 + 2];
+    size_t encodedLength = cobsEncode(frame, out - frame, encoded);
+    encoded[encodedLength++] = 0;
+
+    // a frame is queued whole or not at all, the host finds the gap in the sequence
+    if (encodedLength > freeSpace())
+    {
+        framesDropped++;
+        return;
+    }
+
+    for (size_t i = 0; i < encodedLength; i++)
+    {
+        buffer[head] = encoded[i];
+        head = (head + 1) % TELEMETRY_BUFFER_SIZE;
+    }
+    framesQueued++;
+}
+
+void TelemetryStream::sample(uint32_t timestampUs, int32_t rawCounts, int32_t filteredCounts, Weight weight, uint16_t flags)
+{
+    if (!enabled)
+    {
+        return;
+    }
+
+    uint8_t payload[18];
+    uint8_t *out = payload;
+    int32_t milligrams = weight.toMilligrams();
+    out = put(out, &timestampUs, sizeof(timestampUs));
+    out = put(out, &rawCounts, sizeof(rawCounts));
+    out = put(out, &filteredCounts, sizeof(filteredCounts));
+    out = put(out, &milligrams, sizeof(milligrams));
+    out = put(out, &flags, sizeof(flags));
+    queueFrame(TelemetryFrameType::SAMPLE, payload, out - payload);
+}
+
+void TelemetryStream::event(const ScaleEvent &event)
+{
+    if (!enabled)
+    {
+        return;
+    }
+
+    uint8_t payload[10];
+    uint8_t *out = payload;
+    int32_t milligrams = event.weight.toMilligrams();
+    out = put(out, &event.timestampUs, sizeof(event.timestampUs));
+    *out++ = (uint8_t)event.type;
+    *out++ = event.channel;
+    out = put(out, &milligrams, sizeof(milligrams));
+    queueFrame(TelemetryFrameType::EVENT, payload, out - payload);
+}
+
+void TelemetryStream::service(HardwareSerial &out, uint32_t conversions, uint32_t conversionsDropped)
+{
+    if (!enabled)
+    {
+        return;
+    }
+
+    unsigned long now = millis();
+    if (lastStatusTime == 0 || now - lastStatusTime >= TELEMETRY_STATUS_INTERVAL_MS)
+    {
+        lastStatusTime = now;
+
+        uint8_t payload[17];
+        uint8_t *cursor = payload;
+        uint32_t uptime = now;
+        cursor = put(cursor, &uptime, sizeof(uptime));
+        cursor = put(cursor, &framesDropped, sizeof(framesDropped));
+        cursor = put(cursor, &conversions, sizeof(conversions));
+        cursor = put(cursor, &conversionsDropped, sizeof(conversionsDropped));
+        *cursor++ = TELEMETRY_VERSION;
+        queueFrame(TelemetryFrameType::STATUS, payload, cursor - payload);
+    }
+
+    // only what fits into the UART's TX buffer, the weighing task must never wait on the wire
+    while (head != tail)
+    {
+        int room = out.availableForWrite();
+        if (room <= 0)
+        {
+            break;
+        }
+
+        uint16_t contiguous = head > tail ? head - tail : TELEMETRY_BUFFER_SIZE - tail;
+        size_t written = out.write(&buffer[tail], min((size_t)room, (size_t)contiguous));
+        if (written == 0)
+        {
+            break;
+        }
+        tail = (tail + written) % TELEMETRY_BUFFER_SIZE;
+    }
+}
@@ -1,6 +1,8 @@
 #include "terminal_api.h"
 #include "wifi.secret.h"
 #include <ArduinoJson.h>
+#include "consumption_forecast.h"
+#include "peer_coordinator.h"
 
 TerminalApi::TerminalApi()
 {
@@ -20,6 +22,11 @@ std::vector<Product> TerminalApi::getProducts()
 {
     std::vector<Product> products;
 
+    if (peers != nullptr && peers->getCatalog(products))
+    {
+        return products;
+    }
+
     wifiManager->reconnect();
 
     // Prepare request URL
@@ -66,6 +73,11 @@ std::vector<Product> TerminalApi::getProducts()
 
             products.push_back(product);
         }
+
+        if (peers != nullptr && !products.empty())
+        {
+            peers->shareCatalog(products);
+        }
     }
     else
     {
@@ -181,6 +193,42 @@ bool TerminalApi::clearCart()
 }
 
 // GET /cart
+void TerminalApi::parseCart(JsonObject data, Cart *cart)
+{
+    cart->subtotal = data["subtotal"].as<uint32_t>();
+    cart->addressID = data["addressID"].as<String>();
+    cart->cardID = data["cardID"].as<String>();
+
+    JsonArray items = data["items"].as<JsonArray>();
+    for (JsonVariant itemVariant : items)
+    {
+        JsonObject itemObj = itemVariant.as<JsonObject>();
+        CartItem item;
+
+        item.id = itemObj["id"].as<String>();
+        item.productVariantID = itemObj["productVariantID"].as<String>();
+        item.quantity = itemObj["quantity"].as<uint32_t>();
+        item.subtotal = itemObj["subtotal"].as<uint32_t>();
+
+        cart->items.push_back(item);
+    }
+
+    JsonObject amount = data["amount"].as<JsonObject>();
+    cart->amount.subtotal = amount["subtotal"].as<uint32_t>();
+    cart->amount.shipping = amount["shipping"].as<uint32_t>();
+    cart->amount.total = amount["total"].as<uint32_t>();
+
+    JsonObject shipping = data["shipping"].as<JsonObject>();
+    cart->shipping.service = shipping["service"].as<String>();
+    cart->shipping.timeframe = shipping["timeframe"].as<String>();
+
+    float leadDays = parseLeadTimeDays(cart->shipping.timeframe);
+    if (leadDays > 0.0f)
+    {
+        shippingLeadDays = leadDays;
+    }
+}
+
 Cart *TerminalApi::getCart()
 {
     wifiManager->reconnect();
@@ -202,27 +250,8 @@ Cart *TerminalApi::getCart()
             return nullptr;
         }
 
-        JsonObject data = doc["data"].as<JsonObject>();
         Cart *cart = new Cart();
-
-        cart->subtotal = data["subtotal"].as<uint32_t>();
-        cart->addressID = data["addressID"].as<String>();
-        cart->cardID = data["cardID"].as<String>();
-
-        JsonArray items = data["items"].as<JsonArray>();
-        for (JsonVariant itemVariant : items)
-        {
-            JsonObject itemObj = itemVariant.as<JsonObject>();
-            CartItem item;
-
-            item.id = itemObj["id"].as<String>();
-            item.productVariantID = itemObj["productVariantID"].as<String>();
-            item.quantity = itemObj["quantity"].as<uint32_t>();
-            item.subtotal = itemObj["subtotal"].as<uint32_t>();
-
-            cart->items.push_back(item);
-        }
-
+        parseCart(doc["data"].as<JsonObject>(), cart);
         return cart;
     }
 
@@ -260,27 +289,8 @@ Cart *TerminalApi::addItemToCart(const char *productVariantID, uint32_t quantity
             return nullptr;
         }
 
-        JsonObject data = doc["data"].as<JsonObject>();
         Cart *cart = new Cart();
-
-        cart->subtotal = data["subtotal"].as<uint32_t>();
-        cart->addressID = data["addressID"].as<String>();
-        cart->cardID = data["cardID"].as<String>();
-
-        JsonArray items = data["items"].as<JsonArray>();
-        for (JsonVariant itemVariant : items)
-        {
-            JsonObject itemObj = itemVariant.as<JsonObject>();
-            CartItem item;
-
-            item.id = itemObj["id"].as<String>();
-            item.productVariantID = itemObj["productVariantID"].as<String>();
-            item.quantity = itemObj["quantity"].as<uint32_t>();
-            item.subtotal = itemObj["subtotal"].as<uint32_t>();
-
-            cart->items.push_back(item);
-        }
-
+        parseCart(doc["data"].as<JsonObject>(), cart);
         return cart;
     }
 
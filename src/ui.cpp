@@ -29,7 +29,7 @@ void cursorBlinkTaskWrapper(void *parameter)
 
         if (state->isVisible)
         {
-            uiInstance->tft.fillRect(
+            uiInstance->display.fillRect(
                 state->bounds.cursorX,
                 state->bounds.cursorY,
                 state->bounds.cursorWidth,
@@ -38,7 +38,7 @@ void cursorBlinkTaskWrapper(void *parameter)
         }
         else
         {
-            uiInstance->tft.fillRect(
+            uiInstance->display.fillRect(
                 state->bounds.cursorX,
                 state->bounds.cursorY,
                 state->bounds.cursorWidth,
@@ -52,7 +52,11 @@ void cursorBlinkTaskWrapper(void *parameter)
 
 // Constructor
 UI::UI(TFT_eSPI &tftDisplay, LedStrip &ledStrip, TerminalApi &terminalApi, PreferencesManager &preferences)
-    : tft(tftDisplay),
+    : display(tftDisplay),
+      compositor(tftDisplay, display, BACKGROUND_COLOR),
+      readoutText(tftDisplay, display),
+      readoutBar(tftDisplay, display),
+      tft(tftDisplay),
       ledStrip(ledStrip),
       imageLoader(tftDisplay),
       cursorBlinkTaskHandle(NULL),
@@ -64,14 +68,44 @@ UI::UI(TFT_eSPI &tftDisplay, LedStrip &ledStrip, TerminalApi &terminalApi, Prefe
     this->bagSelect = new BagSelect(tftDisplay, *this, ledStrip);
     this->store = new Store(*this, tftDisplay, *scaleManager, terminalApi, ledStrip);
     memset(&lastCursorState, 0, sizeof(TextBounds));
+    taint();
 }
 
 // Initialize UI
 void UI::begin(Scale *scaleManager)
 {
     this->scaleManager = scaleManager;
+    display.begin();
+    compositor.onCleared(handleAreaCleared, this);
     menu->begin();
     bagSelect->begin(scaleManager);
+    store->begin();
+
+    pageIndicator.setScreens(SCREEN(STORE_ORDERS) | SCREEN(STORE_BROWSE));
+    pageIndicator.setPosition(tft.width() / 2, tft.height() - 4);
+    compositor.add(pageIndicator);
+
+    for (uint8_t channel = 0; channel < SCALE_MAX_CHANNELS; channel++)
+    {
+        shelfLabels[channel] = new TextWidget(SMALL_FONT, TEXT_COLOR);
+        shelfBars[channel] = new ProgressBarWidget(BAG_COLOR, TEXT_COLOR);
+        shelfLabels[channel]->setVisible(false);
+        shelfBars[channel]->setVisible(false);
+        shelfLabels[channel]->setScreens(SCREEN(MAIN_MENU) | SCREEN(MAIN_MENU_REORDER));
+        shelfBars[channel]->setScreens(SCREEN(MAIN_MENU) | SCREEN(MAIN_MENU_REORDER));
+        compositor.add(*shelfLabels[channel]);
+        compositor.add(*shelfBars[channel]);
+    }
+
+    const uint16_t readoutPalette[] = {BACKGROUND_COLOR, TEXT_COLOR, ACCENT_COLOR, MUTED_TEXT_COLOR,
+                                       TEXT_COLOR_RED, TEXT_COLOR_GREEN, BAG_COLOR};
+    const int16_t readoutY = readoutArea().y;
+    readoutBar.begin(READOUT_BAR_X, readoutY, READOUT_BAR_WIDTH, READOUT_HEIGHT, readoutPalette, 7);
+    readoutText.begin(READOUT_TEXT_X, readoutY, tft.width() - READOUT_TEXT_X - 10, READOUT_HEIGHT, readoutPalette, 7);
+    weightDigits.begin(&GeistMono_VariableFont_wght18pt7b);
+    baristaDigits.begin(&GeistMono_VariableFont_wght16pt7b);
+    slashGlyph.begin(&GeistMono_VariableFont_wght14pt7b, "/");
+    targetDigits.begin(&GeistMono_VariableFont_wght12pt7b);
 
     if (!imageLoader.begin())
     {
@@ -81,7 +115,7 @@ void UI::begin(Scale *scaleManager)
 
 void UI::beginConfiguration()
 {
-    tft.fillScreen(BACKGROUND_COLOR);
+    clearScreen();
     auto bounds = typeTitle("Configuration");
     delay(2000);
     wipeText(bounds);
@@ -111,7 +145,7 @@ void UI::finishConfiguration(bool enableAutoReorder)
 {
     preferences.setShouldReorderAutomatically(enableAutoReorder);
 
-    tft.fillScreen(BACKGROUND_COLOR);
+    clearScreen();
     auto bounds = typeTitle("Configuration complete");
     delay(2000);
     wipeText(bounds);
@@ -302,7 +336,7 @@ void UI::wipeText(const TextBounds &bounds, int speed_ms)
 void UI::terminalAnimation()
 {
     ledStrip.turnOnAnimation();
-    tft.fillScreen(BACKGROUND_COLOR);
+    clearScreen();
 
     const char *text = "terminal";
     auto config = createTextConfig(&GeistMono_VariableFont_wght18pt7b);
@@ -314,7 +348,7 @@ void UI::terminalAnimation()
 
     wipeText(bounds);
 
-    tft.fillScreen(BACKGROUND_COLOR);
+    clearScreen();
 }
 
 // Start blinking cursor using the last cursor position
@@ -397,17 +431,122 @@ bool UI::isBlinking()
 
 void UI::drawMenu()
 {
-    menu->draw();
+    // the menu is widgets like everything else, this paints whatever changed
+    compositor.render();
+}
+
+void UI::taintReadouts()
+{
+    lastDrawnReading = Weight::milligrams(INT32_MIN);
+    readoutText.invalidate();
+    readoutBar.invalidate();
+    if (scaleManager != nullptr)
+    {
+        scaleManager->forceBaristaRedraw();
+    }
+}
+
+ScreenRect UI::readoutArea()
+{
+    return ScreenRect(READOUT_BAR_X, tft.height() - READOUT_HEIGHT - READOUT_MARGIN,
+                      tft.width() - READOUT_BAR_X - 10, READOUT_HEIGHT);
+}
+
+void UI::handleAreaCleared(void *arg, const ScreenRect &area)
+{
+    UI *ui = static_cast<UI *>(arg);
+    if (area.intersects(ui->readoutArea()))
+    {
+        ui->taintReadouts();
+    }
+}
+
+void UI::clearScreen()
+{
+    display.fillRect(0, 0, tft.width(), tft.height(), BACKGROUND_COLOR);
+    taint();
+}
+
+void UI::clearContent()
+{
+    display.fillRect(0, Menu::menuClearance, tft.width(), tft.height() - Menu::menuClearance, BACKGROUND_COLOR);
+    taintReadouts();
+    compositor.damage(ScreenRect(0, Menu::menuClearance, tft.width(), tft.height() - Menu::menuClearance));
+}
+
+void UI::processScaleEvents(TickType_t timeout)
+{
+    ScaleEvent event;
+    while (scaleManager->waitForEvent(event, timeout))
+    {
+        handleScaleEvent(event);
+        timeout = 0;
+    }
+}
+
+void UI::handleScaleEvent(const ScaleEvent &event)
+{
+    switch (event.type)
+    {
+    // shelf bags show up in the shelf row, only the plate has the "bag not found" screen
+    case ScaleEventType::BAG_REMOVED:
+        if (event.channel == 0)
+            bagRemoved = true;
+        break;
+    case ScaleEventType::BAG_RETURNED:
+        if (event.channel == 0)
+            bagRemoved = false;
+        break;
+    case ScaleEventType::BELOW_THRESHOLD:
+        channelsBelowThreshold |= 1 << event.channel;
+        break;
+    case ScaleEventType::ABOVE_THRESHOLD:
+        channelsBelowThreshold &= ~(1 << event.channel);
+        break;
+    case ScaleEventType::BELOW_PROMPT_THRESHOLD:
+        channelsBelowPromptThreshold |= 1 << event.channel;
+        break;
+    case ScaleEventType::ABOVE_PROMPT_THRESHOLD:
+        channelsBelowPromptThreshold &= ~(1 << event.channel);
+        break;
+    case ScaleEventType::CONSUMPTION:
+        // the reorder thresholds follow the forecast, the transitions come back as events
+        scaleManager->recordConsumption(event);
+        break;
+    case ScaleEventType::DOSE_DONE:
+        // the learned lead time outlives a restart
+        scaleManager->recordDose(event);
+        break;
+    default:
+        break;
+    }
+}
+
+String UI::reorderBagName()
+{
+    uint16_t channels = channelsBelowPromptThreshold != 0 ? channelsBelowPromptThreshold : channelsBelowThreshold;
+    uint8_t channel = channels != 0 ? __builtin_ctz(channels) : 0;
+    return scaleManager->getBagName(channel);
 }
 
 void UI::loop()
 {
+    // sleeps until the scale reports a transition or the next redraw is due, instead of spinning
+    processScaleEvents(pdMS_TO_TICKS(UI_EVENT_WAIT_MS));
+
     if (menu->current == STORE ||
         menu->current == STORE_ORDERS ||
         menu->current == STORE_BROWSE)
     {
-        drawMenu();
         store->draw();
+        drawMenu();
+        return;
+    }
+
+    if (menu->current == CALIBRATION)
+    {
+        scaleManager->drawCalibration();
+        drawMenu();
         return;
     }
 
@@ -418,7 +557,7 @@ void UI::loop()
         return;
     }
 
-    if (!scaleManager->bagRemovedFromSurface)
+    if (!bagRemoved)
     {
         handleBagNotOnSurface();
     }
@@ -429,21 +568,24 @@ void UI::loop()
         {
             reorderPromptDismissed = false;
         }
-        bagSelect->draw();
         drawMenu();
         return;
     }
 
-    if (scaleManager->bagRemovedFromSurface || !scaleManager->hasBag)
+    if (bagRemoved || !scaleManager->hasBag)
     {
         if (!drawnBagNotFound)
         {
+            // cleared before the text is typed where the shelf was
+            setShelfVisible(false);
+            drawMenu();
+
             unsigned long currentTime = millis();
             auto textConfig = createTextConfig(&GeistMono_VariableFont_wght14pt7b);
             textConfig.y = tft.height() / 2 + titleText.font->yAdvance + 8;
             // FIXME: should probably be a background task?
-            tft.fillRect(0, tft.height() / 2 - titleText.font->yAdvance - 8,
-                         tft.width(), tft.height(), BACKGROUND_COLOR);
+            display.fillRect(0, tft.height() / 2 - titleText.font->yAdvance - 8,
+                             tft.width(), tft.height(), BACKGROUND_COLOR);
 
             auto titleTextConfig = titleText;
             titleTextConfig.enableCursor = false;
@@ -462,9 +604,10 @@ void UI::loop()
     if (drawnBagNotFound)
     {
         drawnBagNotFound = false;
-        tft.fillRect(0, tft.height() / 2 - titleText.font->yAdvance - 8,
-                     tft.width(), tft.height(), BACKGROUND_COLOR);
+        display.fillRect(0, tft.height() / 2 - titleText.font->yAdvance - 8,
+                         tft.width(), tft.height(), BACKGROUND_COLOR);
         stopBlinking();
+        taint();
     }
 
     // Barista mode drawing
@@ -476,15 +619,23 @@ void UI::loop()
         return;
     }
 
-    drawWeight(scaleManager->lastReading);
+    WeightSample sample = scaleManager->getSample();
+
+    // only the settled weight is shown, so noise doesn't redraw a bag that is just sitting there
+    // barista readings are tared and may still be published while leaving barista mode
+    if (sample.has(WEIGHT_HAS_STABLE) && !sample.has(WEIGHT_BARISTA))
+    {
+        drawWeight(sample.stableValue);
+    }
+    drawShelf();
 
     drawMenu();
 }
 
-void UI::drawWeight(float weight)
+void UI::drawWeight(Weight weight)
 {
     // round to nearest 0.1g
-    weight = round(weight * 10.0) / 10.0;
+    weight = weight.roundTo(Weight::milligrams(100));
 
     if (weight == lastDrawnReading)
     {
@@ -493,63 +644,126 @@ void UI::drawWeight(float weight)
 
     lastDrawnReading = weight;
 
-    float progress = max(min(weight / TERMINAL_COFFEE_WEIGHT, 1.0f), 0.0f);
+    const int progressBarFill = constrain((int)((int64_t)weight.toMilligrams() * READOUT_HEIGHT / Weight::grams(TERMINAL_COFFEE_WEIGHT).toMilligrams()),
+                                          0, READOUT_HEIGHT);
 
-    const uint16_t progressX = 20;
-    const uint16_t progressHeight = 100;
-    const uint16_t progressY = tft.height() - progressHeight - 20;
-    const uint16_t progressWidth = 60;
-    const int progressBarFill = constrain(progress * progressHeight, 0, progressHeight);
+    auto text = weightText(weight, 1, " g");
 
-    auto text = String(weight, 1) + " g";
+    TFT_eSprite &canvas = readoutText.canvas();
+    canvas.setTextSize(1);
+    canvas.setFreeFont(&GeistMono_VariableFont_wght12pt7b);
+    canvas.setCursor(0, GeistMono_VariableFont_wght12pt7b.yAdvance);
+    canvas.setTextColor(READOUT_ACCENT);
+    canvas.print(scaleManager->bagName.c_str());
 
-    // clear weight text area
-    tft.fillRect(progressX + progressWidth + 10, progressY,
-                 tft.width() - progressX - progressWidth - 20, progressHeight, BACKGROUND_COLOR);
+    weightDigits.draw(canvas, text.c_str(), 0, READOUT_HEIGHT - 8, READOUT_TEXT);
+    readoutText.push();
 
-    tft.setTextSize(1);
-    tft.setFreeFont(&GeistMono_VariableFont_wght12pt7b);
-    tft.setCursor(progressX + progressWidth + 10, progressY + GeistMono_VariableFont_wght12pt7b.yAdvance);
-    tft.setTextColor(ACCENT_COLOR);
-    tft.print(scaleManager->bagName.c_str());
+    drawReadoutBar(progressBarFill, READOUT_ACCENT, true);
+}
 
-    tft.setFreeFont(&GeistMono_VariableFont_wght18pt7b);
-    tft.setTextColor(TEXT_COLOR);
-    tft.setCursor(progressX + progressWidth + 10, progressY + progressHeight - 8);
-    tft.print(text);
+void UI::drawReadoutBar(int fill, uint8_t color, bool notches)
+{
+    TFT_eSprite &canvas = readoutBar.canvas();
+    canvas.drawRect(0, 0, READOUT_BAR_WIDTH, READOUT_HEIGHT, READOUT_BAG);
+    canvas.fillRect(4, 4 + READOUT_HEIGHT - fill, READOUT_BAR_WIDTH - 8, fill - 8, color);
 
-    if (progressBarFill == lastProgressBarFill)
+    for (int i = 1; notches && i - 1 < fill / 20; i++)
     {
-        return;
+        canvas.drawFastHLine(2, 2 + READOUT_HEIGHT - i * 20, READOUT_BAR_WIDTH - 4, READOUT_BACKGROUND);
     }
-    lastProgressBarFill = progressBarFill;
+    readoutBar.push();
+}
 
-    tft.fillRect(progressX, progressY, progressWidth, progressHeight, BACKGROUND_COLOR);
-    tft.drawRect(progressX, progressY, progressWidth, progressHeight, BAG_COLOR);
-    tft.fillRect(progressX + 4, progressY + 4 + progressHeight - progressBarFill, progressWidth - 8, progressBarFill - 8, ACCENT_COLOR);
+void UI::drawShelf()
+{
+    uint8_t channels = scaleManager->getChannelCount();
+    if (channels != shelfChannels)
+    {
+        layoutShelf(channels);
+    }
+    setShelfVisible(true);
 
-    for (int i = 1; i - 1 < progressBarFill / 20; i++)
+    for (uint8_t channel = 1; channel < channels; channel++)
     {
-        tft.drawFastHLine(progressX + 2, progressY + 2 + progressHeight - i * 20, progressWidth - 4, BACKGROUND_COLOR);
+        WeightSample sample = scaleManager->getSample(channel);
+        bool low = (channelsBelowThreshold & (1 << channel)) != 0;
+        int grams = max(sample.stableValue, Weight()).roundTo(Weight::grams(1)).toMilligrams() / 1000;
+
+        String text = String(grams) + "g";
+        uint16_t color = low ? ACCENT_COLOR : TEXT_COLOR;
+        if (!scaleManager->hasBagOn(channel))
+        {
+            text = "-";
+            color = MUTED_TEXT_COLOR;
+            grams = 0;
+        }
+        else if (sample.has(WEIGHT_BAG_REMOVED))
+        {
+            text = "off";
+            color = low ? ACCENT_COLOR : MUTED_TEXT_COLOR;
+            grams = 0;
+        }
+        else if (!sample.has(WEIGHT_VALID) || !sample.has(WEIGHT_HAS_STABLE))
+        {
+            text = "?";
+            color = low ? ACCENT_COLOR : MUTED_TEXT_COLOR;
+            grams = 0;
+        }
+
+        shelfLabels[channel]->setText(text);
+        shelfLabels[channel]->setColor(color);
+        shelfBars[channel]->setProgress(grams / TERMINAL_COFFEE_WEIGHT);
+        shelfBars[channel]->setFillColor(low ? ACCENT_COLOR : TEXT_COLOR);
     }
 }
 
-void UI::drawProgressIndicator(uint index, uint size)
+void UI::layoutShelf(uint8_t channels)
 {
-    tft.setFreeFont(SMALL_FONT);
-    const uint16_t y = tft.height() - 4;
+    shelfChannels = channels;
 
-    String text = String(index + 1) + "/" + String(size);
-    const uint16_t x = tft.width() / 2 - tft.textWidth(text.c_str()) / 2;
+    // one cell per shelf channel in the gap between the menu and the plate's progress bar
+    const uint16_t rowY = Menu::menuClearance + 2;
+    const uint16_t rowHeight = 34;
+    const uint16_t cellWidth = channels > 1 ? (tft.width() - 40) / (channels - 1) : 0;
 
-    tft.setCursor(x, y);
-    tft.setTextColor(MUTED_TEXT_COLOR);
-    tft.print(text.c_str());
+    for (uint8_t channel = 1; channel < SCALE_MAX_CHANNELS; channel++)
+    {
+        const uint16_t x = 20 + (channel - 1) * cellWidth;
+        shelfLabels[channel]->setPosition(x + 2, rowY + 16);
+        shelfBars[channel]->setBounds(ScreenRect(x + 2, rowY + rowHeight - 10, cellWidth - 6, 8));
+    }
+}
+
+void UI::setShelfVisible(bool visible)
+{
+    for (uint8_t channel = 1; channel < SCALE_MAX_CHANNELS; channel++)
+    {
+        shelfLabels[channel]->setVisible(visible && channel < shelfChannels);
+        shelfBars[channel]->setVisible(visible && channel < shelfChannels);
+    }
+}
+
+void UI::drawProgressIndicator(uint index, uint size)
+{
+    pageIndicator.setText(String(index + 1) + "/" + String(size));
+}
+
+void UI::printDisplayStats()
+{
+    display.printStats();
+    readoutText.printStats("Weight text");
+    readoutBar.printStats("Progress bar");
+    compositor.printStats();
+    readoutText.resetStats();
+    readoutBar.resetStats();
+    compositor.resetStats();
+    display.resetStats();
 }
 
 void UI::drawReorderPrompt()
 {
-    tft.fillRect(0, Menu::menuClearance, tft.width(), tft.height() - Menu::menuClearance, BACKGROUND_COLOR);
+    clearContent();
 
     auto bounds = typeTitle("Order new bag?");
     startBlinkingAt(bounds);
@@ -558,8 +772,7 @@ void UI::drawReorderPrompt()
 void UI::dismissReorderPrompt()
 {
     reorderPromptDismissed = true;
-    tft.fillRect(0, Menu::menuClearance, tft.width(), tft.height() - Menu::menuClearance, BACKGROUND_COLOR);
-    taint();
+    clearContent();
     stopBlinking();
     ledStrip.turnOff();
     menu->selectMenu(MAIN_MENU, false);
@@ -567,12 +780,11 @@ void UI::dismissReorderPrompt()
 
 void UI::handleBagNotOnSurface()
 {
-    if (scaleManager->bagIsBelowThreshold)
+    if (channelsBelowThreshold != 0)
     {
         if (menu->current == MAIN_MENU)
         {
             menu->selectMenu(MAIN_MENU_REORDER, false);
-            menu->taint();
         }
     }
     else
@@ -580,11 +792,10 @@ void UI::handleBagNotOnSurface()
         if (menu->current == MAIN_MENU_REORDER)
         {
             menu->selectMenu(MAIN_MENU, false);
-            menu->taint();
         }
     }
 
-    if (scaleManager->bagIsBelowPromptThreshold)
+    if (channelsBelowPromptThreshold != 0)
     {
         if (preferences.shouldReorderAutomatically())
         {
@@ -604,7 +815,6 @@ void UI::handleBagNotOnSurface()
             {
                 ledStrip.reorderAnimation();
                 menu->selectMenu(MAIN_MENU_PROMPT_REORDER, false);
-                menu->taint();
                 drawMenu();
                 drawReorderPrompt();
                 return;
@@ -623,7 +833,6 @@ void UI::handleBagNotOnSurface()
         if (menu->current == MAIN_MENU_PROMPT_REORDER)
         {
             menu->selectMenu(MAIN_MENU, false);
-            menu->taint();
             ledStrip.turnOff();
         }
         reorderPromptDismissed = false;
@@ -639,7 +848,7 @@ void UI::drawAutoReorder()
     menu->selectMenu(MAIN_MENU_PROMPT_REORDER_AUTO, false);
 
     int lastRenderedSecond = -1;
-    tft.fillScreen(ACCENT_COLOR);
+    display.fillRect(0, 0, tft.width(), tft.height(), ACCENT_COLOR);
     ledStrip.reorderAnimation();
 
     String text = "Press any button to cancel";
@@ -668,30 +877,28 @@ void UI::drawAutoReorder()
         if (menu->checkButtonEvents())
         {
             preferences.setDoNotReorder(true);
-            tft.fillScreen(BACKGROUND_COLOR);
+            clearScreen();
             menu->selectMenu(MAIN_MENU);
             ledStrip.turnOff();
-            taint();
             return;
         }
 
-        if (!scaleManager->bagIsBelowPromptThreshold)
+        if (channelsBelowPromptThreshold == 0)
         {
-            tft.fillScreen(BACKGROUND_COLOR);
+            clearScreen();
             menu->selectMenu(MAIN_MENU);
             ledStrip.turnOff();
-            taint();
             return;
         }
 
-        delay(500);
+        // waiting on the scale instead of a plain delay, so the bag being refilled cancels right away
+        processScaleEvents(pdMS_TO_TICKS(500));
         remaining = endTime - millis();
     }
 
-    // store->orderProduct(scaleManager->bagName);
+    // store->orderProduct(reorderBagName());
     // preferences.setDoNotReorder(true);
-    tft.fillScreen(BACKGROUND_COLOR);
+    clearScreen();
     menu->selectMenu(MAIN_MENU);
     ledStrip.turnOff();
-    taint();
 }
\ No newline at end of file
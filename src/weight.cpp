@@ -0,0 +1,50 @@
+#include "weight.h"
+#include <algorithm>
+
+static const int32_t decimalSteps[] = {1000, 100, 10, 1};
+
+size_t formatWeight(char *buffer, Weight weight, uint8_t decimals)
+{
+    decimals = std::min(decimals, (uint8_t)3);
+    int32_t step = decimalSteps[decimals];
+    int32_t value = weight.roundTo(Weight::milligrams(step)).toMilligrams();
+
+    // digits are produced backwards into a scratch buffer, in units of the last decimal
+    char digits[WEIGHT_TEXT_SIZE];
+    uint8_t length = 0;
+    bool negative = value < 0;
+    uint32_t units = (negative ? -(int64_t)value : value) / step;
+
+    do
+    {
+        if (decimals > 0 && length == decimals)
+        {
+            digits[length++] = '.';
+        }
+        digits[length++] = '0' + units % 10;
+        units /= 10;
+    } while (units > 0 || length <= decimals);
+
+    size_t out = 0;
+    // rounding happened first, so a reading that rounds to zero has no sign
+    if (negative)
+    {
+        buffer[out++] = '-';
+    }
+    while (length > 0)
+    {
+        buffer[out++] = digits[--length];
+    }
+    buffer[out] = '\0';
+
+    return out;
+}
+
+#ifdef ARDUINO
+String weightText(Weight weight, uint8_t decimals, const char *unit)
+{
+    char buffer[WEIGHT_TEXT_SIZE];
+    formatWeight(buffer, weight, decimals);
+    return String(buffer) + unit;
+}
+#endif
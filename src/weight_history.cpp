@@ -0,0 +1,775 @@
+#include "weight_history.h"
+#include <time.h>
+
+#define HISTORY_PAYLOAD_BITS (HISTORY_PAYLOAD_SIZE * 8)
+// Blocks are streamed from flash through a buffer of this size
+#define HISTORY_READ_CHUNK 32
+// No leading/trailing zero window has been set for the field yet
+#define HISTORY_NO_WINDOW 0xFF
+
+class HistoryBitWriter
+{
+private:
+    uint8_t *data;
+
+public:
+    uint16_t bits;
+    bool overflow = false;
+
+    HistoryBitWriter(uint8_t *data, uint16_t bits) : data(data), bits(bits) {}
+
+    void write(uint32_t value, uint8_t count)
+    {
+        if (overflow || bits + count > HISTORY_PAYLOAD_BITS)
+        {
+            overflow = true;
+            return;
+        }
+
+        for (int8_t i = count - 1; i >= 0; i--)
+        {
+            if ((value >> i) & 1)
+            {
+                data[bits >> 3] |= 0x80 >> (bits & 7);
+            }
+            bits++;
+        }
+    }
+};
+
+class HistoryBitReader
+{
+private:
+    File *file;
+    const uint8_t *data;
+    uint32_t remaining;
+
+    uint8_t buffer[HISTORY_READ_CHUNK];
+    uint8_t bufferLength = 0;
+    uint8_t bufferPosition = 0;
+    uint8_t current = 0;
+    uint8_t currentBits = 0;
+
+    bool nextByte()
+    {
+        if (data != nullptr)
+        {
+            current = *data++;
+            return true;
+        }
+
+        if (bufferPosition == bufferLength)
+        {
+            bufferLength = file->read(buffer, sizeof(buffer));
+            bufferPosition = 0;
+            if (bufferLength == 0)
+            {
+                return false;
+            }
+        }
+        current = buffer[bufferPosition++];
+        return true;
+    }
+
+public:
+    // Reads from `file` at its current position, or from `data` when there is no file
+    HistoryBitReader(File *file, const uint8_t *data, uint32_t bits) : file(file), data(data), remaining(bits) {}
+
+    bool read(uint8_t count, uint32_t &value)
+    {
+        if (count > remaining)
+        {
+            return false;
+        }
+        remaining -= count;
+
+        value = 0;
+        while (count > 0)
+        {
+            if (currentBits == 0)
+            {
+                if (!nextByte())
+                {
+                    return false;
+                }
+                currentBits = 8;
+            }
+
+            uint8_t take = min(count, currentBits);
+            uint8_t bits = (current >> (currentBits - take)) & ((1 << take) - 1);
+            value = (value << take) | bits;
+            currentBits -= take;
+            count -= take;
+        }
+        return true;
+    }
+};
+
+// Delta-of-delta buckets after the prefix: '0' same interval, '10' 7 bits, '110' 9 bits,
+// '1110' 12 bits, '1111' the full 32 bit delta-of-delta
+static void encodeTime(HistoryBitWriter &writer, int32_t dod)
+{
+    if (dod == 0)
+    {
+        writer.write(0, 1);
+    }
+    else if (dod >= -63 && dod <= 64)
+    {
+        writer.write(0b10, 2);
+        writer.write(dod + 63, 7);
+    }
+    else if (dod >= -255 && dod <= 256)
+    {
+        writer.write(0b110, 3);
+        writer.write(dod + 255, 9);
+    }
+    else if (dod >= -2047 && dod <= 2048)
+    {
+        writer.write(0b1110, 4);
+        writer.write(dod + 2047, 12);
+    }
+    else
+    {
+        writer.write(0b1111, 4);
+        writer.write((uint32_t)dod, 32);
+    }
+}
+
+static bool decodeTime(HistoryBitReader &reader, int32_t &dod)
+{
+    static const uint8_t widths[] = {7, 9, 12};
+    static const int32_t biases[] = {63, 255, 2047};
+
+    uint32_t bit;
+    uint8_t ones = 0;
+    while (ones < 4)
+    {
+        if (!reader.read(1, bit))
+        {
+            return false;
+        }
+        if (bit == 0)
+        {
+            break;
+        }
+        ones++;
+    }
+
+    uint32_t value;
+    if (ones == 0)
+    {
+        dod = 0;
+    }
+    else if (ones < 4)
+    {
+        if (!reader.read(widths[ones - 1], value))
+        {
+            return false;
+        }
+        dod = (int32_t)value - biases[ones - 1];
+    }
+    else
+    {
+        if (!reader.read(32, value))
+        {
+            return false;
+        }
+        dod = (int32_t)value;
+    }
+    return true;
+}
+
+// '0' unchanged, '10' the XOR fits the previous window of meaningful bits, '11' a new window as
+// 5 bits of leading zeros, 5 bits of length - 1 and the meaningful bits
+static void encodeValue(HistoryBitWriter &writer, HistoryCodecState &state, uint8_t field, int32_t value)
+{
+    uint32_t x = (uint32_t)value ^ (uint32_t)state.values[field];
+    state.values[field] = value;
+
+    if (x == 0)
+    {
+        writer.write(0, 1);
+        return;
+    }
+
+    uint8_t leading = min(__builtin_clz(x), 31);
+    uint8_t trailing = __builtin_ctz(x);
+
+    if (state.leading[field] != HISTORY_NO_WINDOW && leading >= state.leading[field] && trailing >= state.trailing[field])
+    {
+        writer.write(0b10, 2);
+        writer.write(x >> state.trailing[field], 32 - state.leading[field] - state.trailing[field]);
+        return;
+    }
+
+    uint8_t length = 32 - leading - trailing;
+    writer.write(0b11, 2);
+    writer.write(leading, 5);
+    writer.write(length - 1, 5);
+    writer.write(x >> trailing, length);
+    state.leading[field] = leading;
+    state.trailing[field] = trailing;
+}
+
+static bool decodeValue(HistoryBitReader &reader, HistoryCodecState &state, uint8_t field)
+{
+    uint32_t control;
+    if (!reader.read(1, control))
+    {
+        return false;
+    }
+    if (control == 0)
+    {
+        return true;
+    }
+
+    if (!reader.read(1, control))
+    {
+        return false;
+    }
+
+    if (control == 1)
+    {
+        uint32_t leading, length;
+        if (!reader.read(5, leading) || !reader.read(5, length))
+        {
+            return false;
+        }
+        state.leading[field] = leading;
+        state.trailing[field] = 32 - leading - (length + 1);
+    }
+    else if (state.leading[field] == HISTORY_NO_WINDOW)
+    {
+        return false;
+    }
+
+    uint32_t meaningful;
+    if (!reader.read(32 - state.leading[field] - state.trailing[field], meaningful))
+    {
+        return false;
+    }
+    state.values[field] ^= meaningful << state.trailing[field];
+    return true;
+}
+
+static void resetCodec(HistoryCodecState &state)
+{
+    state = HistoryCodecState();
+    memset(state.leading, HISTORY_NO_WINDOW, sizeof(state.leading));
+    memset(state.trailing, 0, sizeof(state.trailing));
+}
+
+static void encodePoint(HistoryBitWriter &writer, HistoryCodecState &state, uint32_t time, const int32_t *values, uint8_t fields)
+{
+    if (state.count == 0)
+    {
+        // the first time is in the block header
+        for (uint8_t f = 0; f < fields; f++)
+        {
+            writer.write((uint32_t)values[f], 32);
+            state.values[f] = values[f];
+        }
+    }
+    else
+    {
+        int32_t delta = time - state.time;
+        encodeTime(writer, delta - state.delta);
+        state.delta = delta;
+
+        for (uint8_t f = 0; f < fields; f++)
+        {
+            encodeValue(writer, state, f, values[f]);
+        }
+    }
+
+    state.time = time;
+    state.count++;
+}
+
+static bool decodePoint(HistoryBitReader &reader, HistoryCodecState &state, uint32_t firstTime, uint8_t fields)
+{
+    if (state.count == 0)
+    {
+        for (uint8_t f = 0; f < fields; f++)
+        {
+            uint32_t value;
+            if (!reader.read(32, value))
+            {
+                return false;
+            }
+            state.values[f] = (int32_t)value;
+        }
+        state.time = firstTime;
+    }
+    else
+    {
+        int32_t dod;
+        if (!decodeTime(reader, dod))
+        {
+            return false;
+        }
+        state.delta += dod;
+        state.time += state.delta;
+
+        for (uint8_t f = 0; f < fields; f++)
+        {
+            if (!decodeValue(reader, state, f))
+            {
+                return false;
+            }
+        }
+    }
+
+    state.count++;
+    return true;
+}
+
+static int32_t toSteps(Weight weight)
+{
+    return weight.roundTo(Weight::milligrams(HISTORY_RESOLUTION_MG)).toMilligrams() / HISTORY_RESOLUTION_MG;
+}
+
+static Weight fromSteps(int32_t steps)
+{
+    return Weight::milligrams(steps * HISTORY_RESOLUTION_MG);
+}
+
+HistoryTier::HistoryTier(const char *name, HistoryTierId id, uint8_t fields, uint16_t slots)
+    : name(name), id(id), fields(fields), slots(slots)
+{
+}
+
+String HistoryTier::slotPath(uint16_t index)
+{
+    return String(HISTORY_DIR "/") + name + "_" + String(index) + ".bin";
+}
+
+bool HistoryTier::readHeader(File &file, HistoryBlockHeader &blockHeader)
+{
+    return file.read((uint8_t *)&blockHeader, sizeof(blockHeader)) == sizeof(blockHeader) &&
+           blockHeader.magic == HISTORY_MAGIC && blockHeader.version == HISTORY_VERSION &&
+           blockHeader.tier == (uint8_t)id && blockHeader.fields == fields &&
+           blockHeader.count > 0 && blockHeader.bits <= HISTORY_PAYLOAD_BITS;
+}
+
+void HistoryTier::begin()
+{
+    uint32_t newest = 0;
+    for (uint16_t i = 0; i < slots; i++)
+    {
+        File file = LittleFS.open(slotPath(i), "r");
+        HistoryBlockHeader blockHeader;
+        if (file && readHeader(file, blockHeader) && blockHeader.sequence > newest)
+        {
+            newest = blockHeader.sequence;
+            slot = i;
+        }
+    }
+
+    if (newest == 0)
+    {
+        startBlock(1);
+        return;
+    }
+    if (!restoreOpenBlock())
+    {
+        // start over in the same slot, the blocks before it are still in order
+        startBlock(newest + 1);
+        return;
+    }
+
+    lastTime = header.lastTime;
+    Serial.printf("History %s: resumed block %lu in slot %u with %u points\n", name,
+                  (unsigned long)header.sequence, slot, header.count);
+}
+
+bool HistoryTier::restoreOpenBlock()
+{
+    File file = LittleFS.open(slotPath(slot), "r");
+    if (!file || !readHeader(file, header))
+    {
+        return false;
+    }
+
+    memset(payload, 0, sizeof(payload));
+    size_t bytes = (header.bits + 7) / 8;
+    if (file.read(payload, bytes) != bytes)
+    {
+        return false;
+    }
+
+    // replay the block to get the encoder back to where it stopped
+    resetCodec(state);
+    HistoryBitReader reader(nullptr, payload, header.bits);
+    for (uint16_t i = 0; i < header.count; i++)
+    {
+        if (!decodePoint(reader, state, header.firstTime, fields))
+        {
+            Serial.printf("History %s: block in slot %u is corrupt\n", name, slot);
+            return false;
+        }
+    }
+
+    dirty = false;
+    return true;
+}
+
+void HistoryTier::startBlock(uint32_t sequence)
+{
+    header.magic = HISTORY_MAGIC;
+    header.sequence = sequence;
+    header.firstTime = 0;
+    header.lastTime = 0;
+    header.count = 0;
+    header.bits = 0;
+    header.tier = (uint8_t)id;
+    header.fields = fields;
+    header.version = HISTORY_VERSION;
+    header.reserved = 0;
+
+    memset(payload, 0, sizeof(payload));
+    resetCodec(state);
+    dirty = false;
+}
+
+bool HistoryTier::writeOpenBlock()
+{
+    // the whole file is replaced, LittleFS keeps the old copy until the new one is committed
+    File file = LittleFS.open(slotPath(slot), "w");
+    if (!file)
+    {
+        Serial.printf("History %s: failed to open slot %u\n", name, slot);
+        return false;
+    }
+
+    size_t bytes = (header.bits + 7) / 8;
+    bool ok = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+              file.write(payload, bytes) == bytes;
+    file.close();
+
+    if (!ok)
+    {
+        Serial.printf("History %s: failed to write slot %u\n", name, slot);
+        return false;
+    }
+
+    blockWrites++;
+    dirty = false;
+    return true;
+}
+
+bool HistoryTier::append(const HistoryPoint &point)
+{
+    if (point.time <= lastTime)
+    {
+        return false;
+    }
+
+    int32_t values[HISTORY_MAX_FIELDS] = {toSteps(point.mean), toSteps(point.min), toSteps(point.max)};
+
+    for (uint8_t attempt = 0; attempt < 2; attempt++)
+    {
+        if (header.count == 0)
+        {
+            header.firstTime = point.time;
+        }
+
+        HistoryCodecState saved = state;
+        HistoryBitWriter writer(payload, header.bits);
+        encodePoint(writer, state, point.time, values, fields);
+
+        if (!writer.overflow)
+        {
+            header.bits = writer.bits;
+            header.count++;
+            header.lastTime = point.time;
+            lastTime = point.time;
+            dirty = true;
+            return true;
+        }
+
+        // seal the full block and carry on in the next slot, overwriting the oldest
+        state = saved;
+        writeOpenBlock();
+        slot = (slot + 1) % slots;
+        startBlock(header.sequence + 1);
+    }
+
+    return false;
+}
+
+void HistoryTier::checkpoint()
+{
+    if (dirty)
+    {
+        writeOpenBlock();
+    }
+}
+
+void HistoryTier::visitBlock(const HistoryBlockHeader &blockHeader, File *file, const uint8_t *data,
+                             uint32_t from, uint32_t to, HistoryVisitor visitor, void *arg, uint32_t &visited)
+{
+    HistoryCodecState decoder;
+    resetCodec(decoder);
+    HistoryBitReader reader(file, data, blockHeader.bits);
+
+    for (uint16_t i = 0; i < blockHeader.count; i++)
+    {
+        if (!decodePoint(reader, decoder, blockHeader.firstTime, fields))
+        {
+            Serial.printf("History %s: block %lu is corrupt\n", name, (unsigned long)blockHeader.sequence);
+            return;
+        }
+
+        if (decoder.time > to)
+        {
+            return;
+        }
+        if (decoder.time < from)
+        {
+            continue;
+        }
+
+        HistoryPoint point;
+        point.time = decoder.time;
+        point.mean = fromSteps(decoder.values[0]);
+        point.min = fields > 1 ? fromSteps(decoder.values[1]) : point.mean;
+        point.max = fields > 2 ? fromSteps(decoder.values[2]) : point.mean;
+        visitor(arg, point);
+        visited++;
+    }
+}
+
+uint32_t HistoryTier::query(uint32_t from, uint32_t to, HistoryVisitor visitor, void *arg)
+{
+    uint32_t visited = 0;
+
+    // the slot after the open one holds the oldest block once the ring has wrapped
+    for (uint16_t n = 1; n < slots; n++)
+    {
+        uint16_t index = (slot + n) % slots;
+        File file = LittleFS.open(slotPath(index), "r");
+        HistoryBlockHeader blockHeader;
+        if (!file || !readHeader(file, blockHeader) || blockHeader.sequence >= header.sequence)
+        {
+            continue;
+        }
+        if (blockHeader.lastTime < from)
+        {
+            continue;
+        }
+        if (blockHeader.firstTime > to)
+        {
+            return visited;
+        }
+
+        visitBlock(blockHeader, &file, nullptr, from, to, visitor, arg, visited);
+    }
+
+    // the open block may be ahead of its copy on flash
+    if (header.count > 0 && header.lastTime >= from && header.firstTime <= to)
+    {
+        visitBlock(header, nullptr, payload, from, to, visitor, arg, visited);
+    }
+
+    return visited;
+}
+
+void HistoryTier::printStats()
+{
+    uint16_t used = 0;
+    uint32_t points = 0;
+    uint32_t bits = 0;
+    uint32_t oldest = header.count > 0 ? header.firstTime : 0;
+
+    for (uint16_t i = 0; i < slots; i++)
+    {
+        HistoryBlockHeader blockHeader;
+        if (i == slot)
+        {
+            blockHeader = header;
+        }
+        else
+        {
+            File file = LittleFS.open(slotPath(i), "r");
+            if (!file || !readHeader(file, blockHeader))
+            {
+                continue;
+            }
+        }
+        if (blockHeader.count == 0)
+        {
+            continue;
+        }
+
+        used++;
+        points += blockHeader.count;
+        bits += blockHeader.bits;
+        if (oldest == 0 || blockHeader.firstTime < oldest)
+        {
+            oldest = blockHeader.firstTime;
+        }
+    }
+
+    Serial.printf("history %s: %u/%u blocks, %lu points, %.1f bits/point, %luB, oldest %lu, open block %u points, %lu writes\n",
+                  name, used, slots, (unsigned long)points, points ? (float)bits / points : 0.0f,
+                  (unsigned long)(bits / 8), (unsigned long)oldest, header.count, (unsigned long)blockWrites);
+}
+
+void HistoryAggregate::add(Weight low, Weight high, int64_t total, uint32_t readings)
+{
+    if (count == 0 || low < min)
+    {
+        min = low;
+    }
+    if (count == 0 || high > max)
+    {
+        max = high;
+    }
+    sum += total;
+    count += readings;
+}
+
+HistoryPoint HistoryAggregate::point() const
+{
+    HistoryPoint point;
+    point.time = start;
+    point.mean = Weight::milligrams(count ? sum / (int64_t)count : 0);
+    point.min = min;
+    point.max = max;
+    return point;
+}
+
+bool WeightHistory::begin()
+{
+    if (!LittleFS.exists(HISTORY_DIR) && !LittleFS.mkdir(HISTORY_DIR))
+    {
+        Serial.println("Failed to create the history directory");
+        return false;
+    }
+
+    raw.begin();
+    minutes.begin();
+    hours.begin();
+
+    started = true;
+    lastCheckpointTime = millis();
+    return true;
+}
+
+void WeightHistory::update()
+{
+    if (!started)
+    {
+        return;
+    }
+
+    unsigned long now = millis();
+    if (now - lastCheckpointTime >= HISTORY_CHECKPOINT_MS)
+    {
+        lastCheckpointTime = now;
+        checkpoint();
+    }
+}
+
+void WeightHistory::record(uint32_t time, Weight weight)
+{
+    if (!started)
+    {
+        return;
+    }
+
+    if (minute.count > 0 && time / 60 != minute.start / 60)
+    {
+        closeMinute();
+    }
+    if (hour.count > 0 && time / 3600 != hour.start / 3600)
+    {
+        closeHour();
+    }
+
+    HistoryPoint point;
+    point.time = time;
+    point.mean = weight;
+    point.min = weight;
+    point.max = weight;
+    raw.append(point);
+
+    if (minute.count == 0)
+    {
+        minute.start = time - time % 60;
+    }
+    minute.add(weight, weight, weight.toMilligrams(), 1);
+}
+
+void WeightHistory::closeMinute()
+{
+    minutes.append(minute.point());
+
+    if (hour.count == 0)
+    {
+        hour.start = minute.start - minute.start % 3600;
+    }
+    hour.add(minute.min, minute.max, minute.sum, minute.count);
+
+    minute = HistoryAggregate();
+}
+
+void WeightHistory::closeHour()
+{
+    hours.append(hour.point());
+    hour = HistoryAggregate();
+}
+
+void WeightHistory::checkpoint()
+{
+    raw.checkpoint();
+    minutes.checkpoint();
+    hours.checkpoint();
+}
+
+HistoryTier &WeightHistory::tier(HistoryTierId id)
+{
+    switch (id)
+    {
+    case HistoryTierId::MINUTE:
+        return minutes;
+    case HistoryTierId::HOUR:
+        return hours;
+    default:
+        return raw;
+    }
+}
+
+static void printPoint(void *arg, const HistoryPoint &point)
+{
+    Print *out = static_cast<Print *>(arg);
+    char mean[WEIGHT_TEXT_SIZE], low[WEIGHT_TEXT_SIZE], high[WEIGHT_TEXT_SIZE];
+    formatWeight(mean, point.mean, 1);
+    formatWeight(low, point.min, 1);
+    formatWeight(high, point.max, 1);
+    out->printf("%lu,%s,%s,%s\n", (unsigned long)point.time, mean, low, high);
+}
+
+void WeightHistory::dump(Print &out, HistoryTierId id, uint32_t from, uint32_t to)
+{
+    HistoryTier &selected = tier(id);
+    out.printf("HISTORY BEGIN %s\n", selected.getName());
+    uint32_t points = selected.query(from, to, printPoint, &out);
+    out.printf("HISTORY END %lu\n", (unsigned long)points);
+}
+
+void WeightHistory::printStats()
+{
+    if (!started)
+    {
+        Serial.println("History not started");
+        return;
+    }
+
+    raw.printStats();
+    minutes.printStats();
+    hours.printStats();
+    Serial.printf("history pending: minute %lu readings, hour %lu readings\n",
+                  (unsigned long)minute.count, (unsigned long)hour.count);
+}
@@ -0,0 +1,507 @@
+#include "widget.h"
+
+bool ScreenRect::intersects(const ScreenRect &other) const
+{
+    return !isEmpty() && !other.isEmpty() &&
+           x < other.x + other.width && other.x < x + width &&
+           y < other.y + other.height && other.y < y + height;
+}
+
+ScreenRect ScreenRect::united(const ScreenRect &other) const
+{
+    if (isEmpty())
+    {
+        return other;
+    }
+    if (other.isEmpty())
+    {
+        return *this;
+    }
+
+    int16_t left = min(x, other.x);
+    int16_t top = min(y, other.y);
+    int16_t right = max(x + width, other.x + other.width);
+    int16_t bottom = max(y + height, other.y + other.height);
+    return ScreenRect(left, top, right - left, bottom - top);
+}
+
+ScreenRect ScreenRect::intersected(const ScreenRect &other) const
+{
+    int16_t left = max(x, other.x);
+    int16_t top = max(y, other.y);
+    int16_t right = min(x + width, other.x + other.width);
+    int16_t bottom = min(y + height, other.y + other.height);
+    if (right <= left || bottom <= top)
+    {
+        return ScreenRect();
+    }
+    return ScreenRect(left, top, right - left, bottom - top);
+}
+
+void Widget::changed()
+{
+    if (compositor == nullptr)
+    {
+        return;
+    }
+
+    ScreenRect before = area;
+    area = measure(compositor->getTft());
+    if (isShown())
+    {
+        compositor->invalidate(before);
+        compositor->invalidate(area);
+    }
+}
+
+void Widget::invalidate()
+{
+    if (compositor != nullptr && isShown())
+    {
+        compositor->invalidate(area);
+    }
+}
+
+void Widget::setVisible(bool visible)
+{
+    if (this->visible == visible)
+    {
+        return;
+    }
+
+    bool wasShown = isShown();
+    this->visible = visible;
+    if (compositor != nullptr && wasShown != isShown())
+    {
+        compositor->invalidate(area);
+    }
+}
+
+void Widget::setScreens(uint32_t screens)
+{
+    bool wasShown = isShown();
+    this->screens = screens;
+    if (compositor != nullptr && wasShown != isShown())
+    {
+        compositor->invalidate(area);
+    }
+}
+
+bool Widget::isShown()
+{
+    return visible && compositor != nullptr && (screens & SCREEN(compositor->getScreen())) != 0;
+}
+
+// Tallest ascent and deepest descent of a font's glyphs, the fonts don't store them
+static void fontExtent(const GFXfont *font, int16_t &ascent, int16_t &descent)
+{
+    struct Extent
+    {
+        const GFXfont *font;
+        int16_t ascent;
+        int16_t descent;
+    };
+    static Extent cache[8];
+    static uint8_t cached = 0;
+
+    for (uint8_t i = 0; i < cached; i++)
+    {
+        if (cache[i].font == font)
+        {
+            ascent = cache[i].ascent;
+            descent = cache[i].descent;
+            return;
+        }
+    }
+
+    ascent = 0;
+    descent = 0;
+    for (uint16_t c = font->first; c <= font->last; c++)
+    {
+        const GFXglyph &glyph = font->glyph[c - font->first];
+        ascent = max(ascent, (int16_t)-glyph.yOffset);
+        descent = max(descent, (int16_t)(glyph.yOffset + glyph.height));
+    }
+
+    if (cached < 8)
+    {
+        cache[cached++] = {font, ascent, descent};
+    }
+}
+
+ScreenRect TextWidget::measure(TFT_eSPI &tft)
+{
+    if (!fonts.empty())
+    {
+        font = fit(tft, text.c_str(), fonts, maxWidth);
+    }
+
+    if (text.isEmpty())
+    {
+        width = 0;
+        return ScreenRect();
+    }
+
+    tft.setTextSize(1);
+    tft.setFreeFont(font);
+    width = tft.textWidth(text);
+
+    int16_t left = x;
+    if (align == TextAlign::CENTER)
+    {
+        left = x - width / 2;
+    }
+    else if (align == TextAlign::RIGHT)
+    {
+        left = x - width;
+    }
+
+    int16_t ascent, descent;
+    fontExtent(font, ascent, descent);
+    // glyphs may reach a little past their advance
+    return ScreenRect(left - 2, baseline - ascent, width + 4, ascent + descent);
+}
+
+void TextWidget::paint(TFT_eSPI &tft)
+{
+    tft.setTextSize(1);
+    tft.setFreeFont(font);
+    tft.setTextColor(color);
+    tft.setCursor(area.x + 2, baseline);
+    tft.print(text);
+}
+
+void TextWidget::setText(const String &text)
+{
+    if (this->text == text)
+    {
+        return;
+    }
+    this->text = text;
+    changed();
+}
+
+void TextWidget::setColor(uint16_t color)
+{
+    if (this->color == color)
+    {
+        return;
+    }
+    this->color = color;
+    invalidate();
+}
+
+void TextWidget::setFont(const GFXfont *font)
+{
+    if (this->font == font && fonts.empty())
+    {
+        return;
+    }
+    this->font = font;
+    fonts.clear();
+    changed();
+}
+
+void TextWidget::setPosition(int16_t x, int16_t baseline)
+{
+    if (this->x == x && this->baseline == baseline)
+    {
+        return;
+    }
+    this->x = x;
+    this->baseline = baseline;
+    changed();
+}
+
+void TextWidget::fitFonts(const std::vector<const GFXfont *> &fonts, int16_t maxWidth)
+{
+    this->fonts = fonts;
+    this->maxWidth = maxWidth;
+    changed();
+}
+
+const GFXfont *TextWidget::fit(TFT_eSPI &tft, const char *text, const std::vector<const GFXfont *> &fonts, int16_t maxWidth)
+{
+    for (const GFXfont *font : fonts)
+    {
+        tft.setFreeFont(font);
+        if (tft.textWidth(text) < maxWidth)
+        {
+            return font;
+        }
+    }
+    return fonts.back();
+}
+
+ScreenRect IconWidget::measure(TFT_eSPI &tft)
+{
+    uint16_t width, height;
+    if (path == nullptr || !images.getImageInfo(path, width, height))
+    {
+        return ScreenRect();
+    }
+    return ScreenRect(centerX - width / 2, y, width, height);
+}
+
+void IconWidget::paint(TFT_eSPI &tft)
+{
+    images.drawPNG(path, area.x, area.y, compositor->getPipeline(), compositor->getBackground());
+}
+
+void IconWidget::setImage(const char *path)
+{
+    if (this->path == path || (this->path != nullptr && path != nullptr && strcmp(this->path, path) == 0))
+    {
+        return;
+    }
+    this->path = path;
+    changed();
+}
+
+void IconWidget::setPosition(int16_t centerX, int16_t y)
+{
+    if (this->centerX == centerX && this->y == y)
+    {
+        return;
+    }
+    this->centerX = centerX;
+    this->y = y;
+    changed();
+}
+
+void ProgressBarWidget::paint(TFT_eSPI &tft)
+{
+    tft.drawRect(bounds.x, bounds.y, bounds.width, bounds.height, frameColor);
+    if (fillWidth > 0)
+    {
+        tft.fillRect(bounds.x + 2, bounds.y + 2, fillWidth, bounds.height - 4, fillColor);
+    }
+}
+
+void ProgressBarWidget::setBounds(const ScreenRect &bounds)
+{
+    if (this->bounds.x == bounds.x && this->bounds.y == bounds.y &&
+        this->bounds.width == bounds.width && this->bounds.height == bounds.height)
+    {
+        return;
+    }
+    this->bounds = bounds;
+    fillWidth = (bounds.width - 4) * progress;
+    changed();
+}
+
+void ProgressBarWidget::setProgress(float progress)
+{
+    progress = constrain(progress, 0.0f, 1.0f);
+    int16_t width = (bounds.width - 4) * progress;
+    this->progress = progress;
+    if (width == fillWidth)
+    {
+        return;
+    }
+
+    // only the part of the bar that grew or shrank
+    int16_t from = min(width, fillWidth);
+    int16_t to = max(width, fillWidth);
+    fillWidth = width;
+    if (compositor != nullptr && isShown())
+    {
+        compositor->invalidate(ScreenRect(bounds.x + 2 + from, bounds.y + 2, to - from, bounds.height - 4));
+    }
+}
+
+void ProgressBarWidget::setFillColor(uint16_t color)
+{
+    if (fillColor == color)
+    {
+        return;
+    }
+    fillColor = color;
+    if (compositor != nullptr && isShown())
+    {
+        compositor->invalidate(ScreenRect(bounds.x + 2, bounds.y + 2, fillWidth, bounds.height - 4));
+    }
+}
+
+void ListItemWidget::attach(Compositor &compositor)
+{
+    compositor.add(icon);
+    compositor.add(label);
+}
+
+void ListItemWidget::setPosition(int16_t centerX, int16_t iconY, int16_t labelBaseline)
+{
+    icon.setPosition(centerX, iconY);
+    label.setPosition(centerX, labelBaseline);
+}
+
+void ListItemWidget::set(const char *imagePath, const String &text, uint16_t color)
+{
+    icon.setImage(imagePath);
+    label.setText(text);
+    label.setColor(color);
+}
+
+void ListItemWidget::setVisible(bool visible)
+{
+    icon.setVisible(visible);
+    label.setVisible(visible);
+}
+
+void ListItemWidget::invalidate()
+{
+    icon.invalidate();
+    label.invalidate();
+}
+
+void Compositor::add(Widget &widget)
+{
+    widget.compositor = this;
+    widget.area = widget.measure(tft);
+    widgets.push_back(&widget);
+    widget.invalidate();
+}
+
+void Compositor::setScreen(uint8_t screen)
+{
+    if (this->screen == screen)
+    {
+        return;
+    }
+
+    // what disappears is cleared and what appears is painted, the rest stays
+    uint8_t previous = this->screen;
+    for (Widget *widget : widgets)
+    {
+        this->screen = previous;
+        bool wasShown = widget->isShown();
+        this->screen = screen;
+        if (wasShown != widget->isShown())
+        {
+            invalidate(widget->area);
+        }
+    }
+    this->screen = screen;
+}
+
+void Compositor::invalidate(const ScreenRect &area)
+{
+    ScreenRect rect = area.intersected(ScreenRect(0, 0, tft.width(), tft.height()));
+    if (rect.isEmpty())
+    {
+        return;
+    }
+
+    while (true)
+    {
+        // absorb what overlaps or sits close enough that one area is cheaper than two
+        bool merged = false;
+        for (uint8_t i = 0; i < dirtyCount; i++)
+        {
+            ScreenRect united = rect.united(dirty[i]);
+            if (rect.intersects(dirty[i]) ||
+                united.area() <= rect.area() + dirty[i].area() + COMPOSITOR_MERGE_SLACK)
+            {
+                rect = united;
+                dirty[i] = dirty[--dirtyCount];
+                merged = true;
+                break;
+            }
+        }
+        if (merged)
+        {
+            continue;
+        }
+
+        if (dirtyCount < COMPOSITOR_MAX_DIRTY)
+        {
+            dirty[dirtyCount++] = rect;
+            return;
+        }
+
+        // full, merge into the one that grows the least
+        uint8_t closest = 0;
+        int32_t smallestGrowth = INT32_MAX;
+        for (uint8_t i = 0; i < dirtyCount; i++)
+        {
+            int32_t growth = rect.united(dirty[i]).area() - dirty[i].area();
+            if (growth < smallestGrowth)
+            {
+                smallestGrowth = growth;
+                closest = i;
+            }
+        }
+        rect = rect.united(dirty[closest]);
+        dirty[closest] = dirty[--dirtyCount];
+    }
+}
+
+void Compositor::damage(const ScreenRect &area)
+{
+    for (Widget *widget : widgets)
+    {
+        if (widget->isShown() && widget->area.intersects(area))
+        {
+            invalidate(widget->area);
+        }
+    }
+}
+
+void Compositor::render()
+{
+    if (dirtyCount == 0)
+    {
+        return;
+    }
+
+    uint32_t started = micros();
+    pipeline.start();
+    for (uint8_t i = 0; i < dirtyCount; i++)
+    {
+        const ScreenRect &rect = dirty[i];
+
+        // drawing stays inside the area, widgets that reach out of it are repainted in part
+        tft.setViewport(rect.x, rect.y, rect.width, rect.height, false);
+        pipeline.fillRect(rect.x, rect.y, rect.width, rect.height, background);
+        if (clearedCallback != nullptr)
+        {
+            clearedCallback(clearedArg, rect);
+        }
+        for (Widget *widget : widgets)
+        {
+            if (widget->isShown() && widget->area.intersects(rect))
+            {
+                // text and frames go straight to the panel, not while a band is on its way
+                pipeline.wait();
+                widget->paint(tft);
+                stats.widgetsPainted++;
+            }
+        }
+        pipeline.wait();
+        tft.resetViewport();
+
+        stats.regions++;
+        stats.pixels += rect.area();
+    }
+    pipeline.end();
+    dirtyCount = 0;
+
+    stats.frames++;
+    stats.micros += micros() - started;
+}
+
+void Compositor::printStats()
+{
+    if (stats.frames == 0)
+    {
+        Serial.println("Widgets: nothing repainted");
+        return;
+    }
+
+    Serial.printf("Widgets: %u frames, %u areas, %u widgets painted, %llu pixels per frame, %llu us per frame\n",
+                  stats.frames,
+                  stats.regions,
+                  stats.widgetsPainted,
+                  stats.pixels / stats.frames,
+                  stats.micros / stats.frames);
+}
@@ -0,0 +1,44 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Just enough of the ESP32 Arduino core and FreeRTOS for the native tests to build the HX711
+// acquisition. The clock and the data ready interrupt are driven by the test.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+#define FALLING 0x02
+
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+#define pdFALSE 0
+#define pdTRUE 1
+
+// Tests run single threaded, the "interrupt" is a plain call between consumer steps
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portYIELD_FROM_ISR()
+
+inline uint32_t hostMicros = 0;
+inline uint32_t micros() { return hostMicros; }
+inline uint32_t millis() { return hostMicros / 1000; }
+
+inline void (*hostInterrupt)(void *) = nullptr;
+inline void *hostInterruptArg = nullptr;
+inline void attachInterruptArg(uint8_t, void (*handler)(void *), void *arg, int)
+{
+    hostInterrupt = handler;
+    hostInterruptArg = arg;
+}
+inline void detachInterrupt(uint8_t) { hostInterrupt = nullptr; }
+
+inline uint32_t hostNotifications = 0;
+inline void vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t *) { hostNotifications++; }
+
+#endif
@@ -0,0 +1 @@
+// Stand-in for the ESP32 GPIO registers, the native tests replace the HX711 driver
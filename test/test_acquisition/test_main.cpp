@@ -0,0 +1,159 @@
+#include <unity.h>
+#include "sample_acquisition.h"
+#include "../../src/sample_acquisition.cpp"
+
+// The HX711 at 80 SPS signals a conversion every 12.5ms
+#define TEST_PERIOD_US 12500
+#define TEST_SECONDS 600
+
+// Stand-in for the HX711: DOUT low while a conversion waits, the counts count up from 1
+static volatile uint32_t dout = 1;
+static int32_t nextCounts = 1;
+
+Hx711Driver::Hx711Driver(int dt_pin, int sck_pin) : PIN_DT(dt_pin), PIN_SCK(sck_pin) {}
+
+void Hx711Driver::begin(bool)
+{
+    dtIn = &dout;
+    dtMask = 1;
+}
+
+int32_t Hx711Driver::read()
+{
+    dout = 1;
+    return nextCounts++;
+}
+
+// A conversion is ready: DOUT falls and the interrupt runs
+static void dataReady()
+{
+    dout = 0;
+    hostInterrupt(hostInterruptArg);
+}
+
+void setUp()
+{
+    hostMicros = 0;
+    hostNotifications = 0;
+    dout = 1;
+    nextCounts = 1;
+}
+
+void tearDown() {}
+
+void test_ring_buffer_keeps_order_and_counts_drops()
+{
+    SampleRingBuffer<RawSample, 8> buffer;
+    for (int32_t i = 0; i < 13; i++)
+    {
+        TEST_ASSERT_EQUAL(i < 8, buffer.push({i, (uint32_t)i * TEST_PERIOD_US}));
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, buffer.dropped());
+    TEST_ASSERT_EQUAL_UINT32(8, buffer.size());
+
+    RawSample sample;
+    for (int32_t i = 0; i < 8; i++)
+    {
+        TEST_ASSERT_TRUE(buffer.pop(sample));
+        TEST_ASSERT_EQUAL_INT32(i, sample.counts);
+    }
+    TEST_ASSERT_FALSE(buffer.pop(sample));
+
+    // indices keep running past the end of the array
+    for (int32_t i = 0; i < 100; i++)
+    {
+        TEST_ASSERT_TRUE(buffer.push({i, 0}));
+        TEST_ASSERT_TRUE(buffer.pop(sample));
+        TEST_ASSERT_EQUAL_INT32(i, sample.counts);
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, buffer.dropped());
+}
+
+// Ten minutes at 80 SPS, drained the way the weighing task does at its slowest
+void test_every_conversion_arrives_in_order_with_its_time()
+{
+    SampleAcquisition acquisition(1, 2);
+    acquisition.begin();
+
+    uint32_t edges = 0;
+    uint32_t received = 0;
+    uint32_t nextDrainUs = SAMPLE_MAX_DRAIN_INTERVAL_MS * 1000;
+    RawSample sample;
+
+    while (edges < TEST_SECONDS * 1000000 / TEST_PERIOD_US)
+    {
+        hostMicros = ++edges * TEST_PERIOD_US;
+        dataReady();
+        // clocking the bits out toggles DOUT, which fires the interrupt once more
+        hostInterrupt(hostInterruptArg);
+
+        if (hostMicros >= nextDrainUs)
+        {
+            nextDrainUs += SAMPLE_MAX_DRAIN_INTERVAL_MS * 1000;
+            while (acquisition.read(sample))
+            {
+                received++;
+                TEST_ASSERT_EQUAL_INT32(received, sample.counts);
+                TEST_ASSERT_EQUAL_UINT32(received * TEST_PERIOD_US, sample.timestampUs);
+            }
+        }
+    }
+    while (acquisition.read(sample))
+    {
+        received++;
+        TEST_ASSERT_EQUAL_UINT32(received * TEST_PERIOD_US, sample.timestampUs);
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(edges, received);
+    TEST_ASSERT_EQUAL_UINT32(edges, acquisition.total());
+    TEST_ASSERT_EQUAL_UINT32(0, acquisition.dropped());
+    // begin() looks for a conversion that was waiting before the interrupt was attached
+    TEST_ASSERT_EQUAL_UINT32(edges + 1, acquisition.notReady());
+}
+
+void test_gain_change_discards_settling_conversions()
+{
+    SampleAcquisition acquisition(1, 2);
+    acquisition.begin();
+    acquisition.setGain(HX711_CHANNEL_A_64);
+
+    for (uint32_t i = 1; i <= 20; i++)
+    {
+        hostMicros = i * TEST_PERIOD_US;
+        dataReady();
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(HX711_SETTLE_CONVERSIONS + 1, acquisition.discarded());
+    TEST_ASSERT_EQUAL_UINT32(20 - HX711_SETTLE_CONVERSIONS - 1, acquisition.total());
+
+    RawSample sample;
+    TEST_ASSERT_TRUE(acquisition.read(sample));
+    TEST_ASSERT_EQUAL_UINT32((HX711_SETTLE_CONVERSIONS + 2) * TEST_PERIOD_US, sample.timestampUs);
+}
+
+void test_wakes_the_task_only_outside_the_band()
+{
+    SampleAcquisition acquisition(1, 2);
+    acquisition.begin();
+    int task;
+    // counts run 1, 2, 3, ... so the first 10 conversions stay within 10 of 0
+    acquisition.wakeOnChange(&task, 0, 10);
+
+    for (uint32_t i = 1; i <= 15; i++)
+    {
+        hostMicros = i * TEST_PERIOD_US;
+        dataReady();
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(5, hostNotifications);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ring_buffer_keeps_order_and_counts_drops);
+    RUN_TEST(test_every_conversion_arrives_in_order_with_its_time);
+    RUN_TEST(test_gain_change_discards_settling_conversions);
+    RUN_TEST(test_wakes_the_task_only_outside_the_band);
+    return UNITY_END();
+}
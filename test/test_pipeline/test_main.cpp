@@ -0,0 +1,155 @@
+#include <unity.h>
+#include "bag_pipeline.h"
+#include "synthetic_source.h"
+
+// Long enough to run past the 71 minutes where 32 bits of microseconds wrap
+#define TEST_LONG_SAMPLES 2000000
+
+void setUp() {}
+void tearDown() {}
+
+static SyntheticConfig config(SyntheticScenario scenario, uint32_t seed, uint32_t samples)
+{
+    SyntheticConfig config = syntheticDefaults(scenario);
+    config.seed = seed;
+    config.samples = samples;
+    return config;
+}
+
+void test_same_seed_same_stream()
+{
+    SyntheticSource first;
+    SyntheticSource second;
+    first.begin(config(SyntheticScenario::SPIKES, 7, TEST_LONG_SAMPLES));
+    second.begin(config(SyntheticScenario::SPIKES, 7, TEST_LONG_SAMPLES));
+
+    RawSample a, b;
+    uint32_t count = 0;
+    while (first.read(a))
+    {
+        TEST_ASSERT_TRUE(second.read(b));
+        TEST_ASSERT_EQUAL_INT32(a.counts, b.counts);
+        count++;
+    }
+    TEST_ASSERT_FALSE(second.read(b));
+    TEST_ASSERT_EQUAL_UINT32(TEST_LONG_SAMPLES, count);
+}
+
+void test_other_seed_other_stream()
+{
+    SyntheticSource first;
+    SyntheticSource second;
+    first.begin(config(SyntheticScenario::CREEP, 1, 1000));
+    second.begin(config(SyntheticScenario::CREEP, 2, 1000));
+
+    RawSample a, b;
+    uint32_t differing = 0;
+    while (first.read(a) && second.read(b))
+    {
+        differing += a.counts != b.counts;
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32(900, differing);
+}
+
+void test_long_stream_swaps_at_the_half()
+{
+    SyntheticSource source;
+    source.begin(config(SyntheticScenario::BAG_SWAP, 1, TEST_LONG_SAMPLES));
+
+    RawSample sample;
+    uint32_t firstMove = 0;
+    while (source.read(sample))
+    {
+        if (!source.isTruthSettled())
+        {
+            firstMove = source.getIndex() - 1;
+            break;
+        }
+    }
+    TEST_ASSERT_UINT32_WITHIN(1, TEST_LONG_SAMPLES / 2, firstMove);
+}
+
+void test_pipeline_settles_on_every_scoop()
+{
+    SyntheticSource source;
+    source.begin(config(SyntheticScenario::SCOOP, 3, TEST_LONG_SAMPLES));
+    BagPipeline pipeline;
+    pipeline.getCurve().setLinear(source.getConfig().countsPerGram);
+
+    // every change of the truth settles before the next one, and on the truth
+    bool moving = false;
+    bool waiting = false;
+    uint32_t changes = 0;
+    RawSample sample;
+    while (source.read(sample))
+    {
+        pipeline.process(sample.counts);
+
+        if (!source.isTruthSettled())
+        {
+            TEST_ASSERT_FALSE(waiting);
+            moving = true;
+            continue;
+        }
+        if (moving)
+        {
+            moving = false;
+            waiting = true;
+        }
+
+        Weight truth = pipeline.toWeight(source.getTruthCounts());
+        if (waiting && pipeline.isStable() && abs(pipeline.getStableValue() - truth) < Weight::grams(0.5f))
+        {
+            waiting = false;
+            changes++;
+        }
+    }
+
+    TEST_ASSERT_FALSE(waiting);
+    // a lift and a put back every 30s
+    TEST_ASSERT_UINT32_WITHIN(2, TEST_LONG_SAMPLES / source.getConfig().sampleRate / 30 * 2, changes);
+}
+
+// Both modes' chains on glitches that sometimes come two within a few samples
+void test_chains_reject_spikes()
+{
+    MedianFilter bagMedian(BAG_FILTER_MEDIAN_WINDOW);
+    KalmanFilter bagKalman(BAG_FILTER_PROCESS_NOISE, FILTER_MEASUREMENT_NOISE);
+    MedianFilter baristaMedian(BARISTA_FILTER_MEDIAN_WINDOW);
+    EmaFilter baristaEma(BARISTA_FILTER_EMA_ALPHA);
+    FilterChain bag, barista;
+    bag.add(&bagMedian).add(&bagKalman);
+    barista.add(&baristaMedian).add(&baristaEma);
+
+    SyntheticSource source;
+    source.begin(config(SyntheticScenario::SPIKES, 1, 200000));
+    int32_t countsPerGram = source.getConfig().countsPerGram;
+    // half a gram, a spike that gets through moves the output by hundreds
+    uint32_t tolerance = countsPerGram / 2;
+
+    RawSample sample;
+    TEST_ASSERT_TRUE(source.read(sample));
+    bag.reset(sample.counts);
+    barista.reset(sample.counts);
+
+    int32_t spikes = 0;
+    while (source.read(sample))
+    {
+        int32_t truth = source.getTruthCounts();
+        spikes += abs(sample.counts - truth) > countsPerGram * 100;
+        TEST_ASSERT_LESS_THAN_UINT32(tolerance, (uint32_t)abs(bag.process(sample.counts) - truth));
+        TEST_ASSERT_LESS_THAN_UINT32(tolerance, (uint32_t)abs(barista.process(sample.counts) - truth));
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32(300, spikes);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_same_seed_same_stream);
+    RUN_TEST(test_other_seed_other_stream);
+    RUN_TEST(test_long_stream_swaps_at_the_half);
+    RUN_TEST(test_pipeline_settles_on_every_scoop);
+    RUN_TEST(test_chains_reject_spikes);
+    return UNITY_END();
+}
@@ -0,0 +1,135 @@
+#include <unity.h>
+#include <chrono>
+#include <string.h>
+#include "bag_pipeline.h"
+#include "bag_tracker.h"
+#include "capture_format.h"
+#include "synthetic_source.h"
+
+// 40 scoops take the bag below both thresholds and leave 20g in it. An empty bag settles
+// around 0g with the tare, which is too close to the bag presence threshold to count returns
+#define TEST_SCOOP_SECONDS 1200
+
+void setUp() {}
+void tearDown() {}
+
+// A capture file as tools/capture.py writes it, `capacity` records long
+static std::vector<uint8_t> writeCapture(const std::vector<RawSample> &samples, uint32_t capacity)
+{
+    CaptureHeader header = {CAPTURE_MAGIC, CAPTURE_VERSION, CAPTURE_RECORD_SIZE, capacity, 0, 0};
+    std::vector<uint8_t> data(sizeof(header) + capacity * CAPTURE_RECORD_SIZE);
+    for (const RawSample &sample : samples)
+    {
+        encodeCaptureRecord(sample, &data[sizeof(header) + header.head * CAPTURE_RECORD_SIZE]);
+        header.head = (header.head + 1) % capacity;
+        header.count = header.count < capacity ? header.count + 1 : capacity;
+    }
+    memcpy(data.data(), &header, sizeof(header));
+    return data;
+}
+
+struct EventLog
+{
+    uint32_t counts[(uint8_t)ScaleEventType::DOSE_DONE + 1] = {};
+    uint32_t belowAtUs = 0;
+    uint32_t promptAtUs = 0;
+    uint32_t nowUs = 0;
+};
+
+static void logEvent(void *arg, ScaleEventType type, Weight)
+{
+    EventLog *log = static_cast<EventLog *>(arg);
+    log->counts[(uint8_t)type]++;
+    if (type == ScaleEventType::BELOW_THRESHOLD)
+        log->belowAtUs = log->nowUs;
+    if (type == ScaleEventType::BELOW_PROMPT_THRESHOLD)
+        log->promptAtUs = log->nowUs;
+}
+
+void test_capture_comes_back_oldest_first()
+{
+    std::vector<RawSample> samples;
+    for (int32_t i = 0; i < 13; i++)
+    {
+        // negative counts survive the 24 bits
+        samples.push_back({i % 2 ? -i * 1000 : i * 1000, (uint32_t)i * 12500});
+    }
+    std::vector<uint8_t> data = writeCapture(samples, 8);
+
+    std::vector<RawSample> parsed;
+    TEST_ASSERT_TRUE(parseCapture(data.data(), data.size(), parsed));
+    TEST_ASSERT_EQUAL_UINT32(8, parsed.size());
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        TEST_ASSERT_EQUAL_INT32(samples[i + 5].counts, parsed[i].counts);
+        TEST_ASSERT_EQUAL_UINT32(samples[i + 5].timestampUs, parsed[i].timestampUs);
+    }
+
+    TEST_ASSERT_FALSE(parseCapture(data.data(), data.size() - 1, parsed));
+    data[0] ^= 1;
+    TEST_ASSERT_FALSE(parseCapture(data.data(), data.size(), parsed));
+}
+
+// Scoops every 30s recorded at 80 SPS, replayed through the shelf channels' pipeline and thresholds
+void test_replay_crosses_each_threshold_once()
+{
+    SyntheticConfig config = syntheticDefaults(SyntheticScenario::SCOOP);
+    config.samples = TEST_SCOOP_SECONDS * config.sampleRate;
+    SyntheticSource source;
+    source.begin(config);
+
+    std::vector<RawSample> recorded;
+    RawSample sample;
+    while (source.read(sample))
+    {
+        sample.timestampUs = recorded.size() * 1000000 / config.sampleRate;
+        recorded.push_back(sample);
+    }
+    std::vector<uint8_t> data = writeCapture(recorded, recorded.size());
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<RawSample> samples;
+    TEST_ASSERT_TRUE(parseCapture(data.data(), data.size(), samples));
+    TEST_ASSERT_EQUAL_UINT32(recorded.size(), samples.size());
+
+    BagPipeline pipeline;
+    pipeline.getCurve().setLinear(config.countsPerGram);
+    BagTracker tracker;
+    EventLog log;
+    for (const RawSample &replayed : samples)
+    {
+        log.nowUs = replayed.timestampUs;
+        pipeline.process(replayed.counts, Weight::grams(TERMINAL_COFFEE_BAG_EMPTY_WEIGHT));
+        if (pipeline.hasStableValue())
+        {
+            tracker.update(pipeline.getStableValue(), Weight::grams(REORDER_BUTTON_THRESHOLD),
+                           Weight::grams(REORDER_BUTTON_PROMPT_THRESHOLD), logEvent, &log);
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // lifted and put back once per scoop
+    uint32_t scoops = TEST_SCOOP_SECONDS / 30;
+    TEST_ASSERT_EQUAL_UINT32(scoops, log.counts[(uint8_t)ScaleEventType::BAG_REMOVED]);
+    TEST_ASSERT_EQUAL_UINT32(scoops, log.counts[(uint8_t)ScaleEventType::BAG_RETURNED]);
+    TEST_ASSERT_FALSE(tracker.isRemoved());
+
+    // 340g of coffee less 8g a scoop: below 150g after the 24th scoop, below 80g after the 33rd
+    TEST_ASSERT_EQUAL_UINT32(1, log.counts[(uint8_t)ScaleEventType::BELOW_THRESHOLD]);
+    TEST_ASSERT_EQUAL_UINT32(0, log.counts[(uint8_t)ScaleEventType::ABOVE_THRESHOLD]);
+    TEST_ASSERT_EQUAL_UINT32(1, log.counts[(uint8_t)ScaleEventType::BELOW_PROMPT_THRESHOLD]);
+    TEST_ASSERT_EQUAL_UINT32(0, log.counts[(uint8_t)ScaleEventType::ABOVE_PROMPT_THRESHOLD]);
+    TEST_ASSERT_UINT32_WITHIN(2000000, 23 * 30000000 + 23000000, log.belowAtUs);
+    TEST_ASSERT_UINT32_WITHIN(2000000, 32 * 30000000 + 23000000, log.promptAtUs);
+
+    // 20 minutes of readings, done in well under a second
+    TEST_ASSERT_TRUE(elapsed < TEST_SCOOP_SECONDS / 100.0);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_capture_comes_back_oldest_first);
+    RUN_TEST(test_replay_crosses_each_threshold_once);
+    return UNITY_END();
+}
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Fetch a raw HX711 capture from the scale and store it for replay.
+
+Sends `capture dump` over serial (SERIAL_LISTEN must be enabled) and writes the samples
+either as CSV or in the same binary ring format the firmware uses. Copy a binary capture
+to data/capture.bin and run `pio run -t uploadfs` to replay it on another scale with
+`replay <speed>`.
+
+    python tools/capture.py /dev/ttyUSB0 capture.bin
+    python tools/capture.py /dev/ttyUSB0 capture.csv
+"""
+
+import argparse
+import struct
+import sys
+
+import serial
+
+CAPTURE_MAGIC = 0x50435848
+CAPTURE_VERSION = 1
+CAPTURE_RECORD_SIZE = 7
+CAPTURE_MAX_SAMPLES = 32768
+
+
+def read_dump(port, baudrate, timeout):
+    with serial.Serial(port, baudrate, timeout=timeout) as connection:
+        connection.reset_input_buffer()
+        connection.write(b"capture dump\n")
+
+        samples = []
+        started = False
+        while True:
+            line = connection.readline().decode(errors="replace").strip()
+            if not line:
+                raise TimeoutError("scale stopped responding before the end of the capture")
+
+            if line.startswith("CAPTURE BEGIN"):
+                started = True
+                continue
+            if line == "CAPTURE END":
+                return samples
+            if line in ("No capture", "Stop the capture before dumping it"):
+                raise RuntimeError(line)
+            if not started:
+                continue
+
+            # log lines from other tasks can be interleaved with the dump
+            try:
+                counts, timestamp = (int(part) for part in line.split(","))
+            except ValueError:
+                continue
+            samples.append((counts, timestamp))
+
+
+def write_binary(path, samples):
+    samples = samples[-CAPTURE_MAX_SAMPLES:]
+    with open(path, "wb") as out:
+        out.write(struct.pack("<IHHIII", CAPTURE_MAGIC, CAPTURE_VERSION, CAPTURE_RECORD_SIZE,
+                              CAPTURE_MAX_SAMPLES, len(samples) % CAPTURE_MAX_SAMPLES, len(samples)))
+        for counts, timestamp in samples:
+            out.write((counts & 0xFFFFFF).to_bytes(3, "little"))
+            out.write(struct.pack("<I", timestamp & 0xFFFFFFFF))
+
+
+def write_csv(path, samples):
+    with open(path, "w") as out:
+        out.write("counts,timestamp_us\n")
+        for counts, timestamp in samples:
+            out.write(f"{counts},{timestamp}\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port")
+    parser.add_argument("output", help="*.csv for CSV, anything else for the binary capture format")
+    parser.add_argument("--baudrate", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=5.0)
+    args = parser.parse_args()
+
+    samples = read_dump(args.port, args.baudrate, args.timeout)
+    if args.output.endswith(".csv"):
+        write_csv(args.output, samples)
+    else:
+        write_binary(args.output, samples)
+
+    print(f"wrote {len(samples)} samples to {args.output}", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
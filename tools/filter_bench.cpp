@@ -0,0 +1,268 @@
+// Compares the filter stages (src/sample_filter.cpp) on a host, on a recorded capture
+// (tools/capture.py, binary or CSV) or a simulated stream. Every stage runs alone on the raw
+// conversions, then the bag tracking and barista chains run as configured on the scale. For each
+// one it reports the cost per sample and the error of its output against a reference: the truth
+// for a simulated stream, the median of the raw conversions within REFERENCE_HALF_WINDOW samples
+// either side for a capture. Errors are split into samples where the weight holds still (how
+// much noise and how many spikes get through) and where it moves (how far the output lags).
+//
+//   g++ -std=c++17 -O2 -Iinclude -o filter_bench tools/filter_bench.cpp src/sample_filter.cpp
+//       src/capture_format.cpp src/synthetic_source.cpp
+//   ./filter_bench capture.bin --factor 412.5
+//   ./filter_bench spikes --samples 100000
+//
+// --factor converts the errors to grams (counts otherwise), --repeat runs the input several times
+// for steadier costs. Costs are timed by FilterChain like on the scale, on a host that includes
+// reading the clock around every stage.
+
+#include "capture_format.h"
+#include "pipeline_tuning.h"
+#include "sample_filter.h"
+#include "synthetic_source.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// 0.5s either side at 80 SPS
+#define REFERENCE_HALF_WINDOW 40
+#define MOVING_SIGMA 6
+
+static bool readFile(const char *path, std::vector<uint8_t> &data)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    uint8_t buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+    fclose(file);
+    return true;
+}
+
+// counts,timestamp_us per line after the header
+static bool parseCsv(const std::vector<uint8_t> &data, std::vector<RawSample> &samples)
+{
+    std::string text(data.begin(), data.end());
+    size_t line = text.find('\n');
+    while (line != std::string::npos && line + 1 < text.size())
+    {
+        long counts;
+        unsigned long timestamp;
+        if (sscanf(text.c_str() + line + 1, "%ld,%lu", &counts, &timestamp) == 2)
+        {
+            samples.push_back({(int32_t)counts, (uint32_t)timestamp});
+        }
+        line = text.find('\n', line + 1);
+    }
+    return !samples.empty();
+}
+
+// Median of the raw counts within REFERENCE_HALF_WINDOW samples either side, fewer at both ends.
+// Keeps the steps of a bag being lifted or put down sharp, unlike an average
+static std::vector<int32_t> centeredMedian(const std::vector<int32_t> &counts)
+{
+    std::vector<int32_t> reference(counts.size());
+    std::vector<int32_t> window;
+    for (size_t i = 0; i < counts.size(); i++)
+    {
+        size_t first = i >= REFERENCE_HALF_WINDOW ? i - REFERENCE_HALF_WINDOW : 0;
+        size_t last = std::min(i + REFERENCE_HALF_WINDOW + 1, counts.size());
+        window.assign(counts.begin() + first, counts.begin() + last);
+        std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+        reference[i] = window[window.size() / 2];
+    }
+    return reference;
+}
+
+// Marks the samples where the reference moves by more than MOVING_SIGMA times the conversion noise
+// within REFERENCE_HALF_WINDOW samples either side. The noise is estimated from the median
+// difference between consecutive conversions, which ignores spikes and steps
+static std::vector<bool> movingSamples(const std::vector<int32_t> &counts, const std::vector<int32_t> &reference)
+{
+    std::vector<int64_t> differences;
+    for (size_t i = 1; i < counts.size(); i++)
+    {
+        differences.push_back(std::llabs((int64_t)counts[i] - counts[i - 1]));
+    }
+    int64_t sigma = 1;
+    if (!differences.empty())
+    {
+        std::nth_element(differences.begin(), differences.begin() + differences.size() / 2, differences.end());
+        sigma = std::max<int64_t>(1, differences[differences.size() / 2] * 1.4826 / sqrt(2.0));
+    }
+
+    std::vector<bool> moving(counts.size());
+    for (size_t i = 0; i < counts.size(); i++)
+    {
+        size_t first = i >= REFERENCE_HALF_WINDOW ? i - REFERENCE_HALF_WINDOW : 0;
+        size_t last = std::min(i + REFERENCE_HALF_WINDOW + 1, counts.size());
+        auto range = std::minmax_element(reference.begin() + first, reference.begin() + last);
+        moving[i] = (int64_t)*range.second - *range.first > MOVING_SIGMA * sigma;
+    }
+    return moving;
+}
+
+struct ErrorStats
+{
+    double squared = 0.0;
+    int64_t max = 0;
+    uint32_t samples = 0;
+
+    void add(int64_t error)
+    {
+        squared += (double)error * error;
+        max = std::max(max, error < 0 ? -error : error);
+        samples++;
+    }
+    double rms() const { return samples ? sqrt(squared / samples) : 0.0; }
+};
+
+static void run(const char *label, FilterChain &chain, const std::vector<int32_t> &counts,
+                const std::vector<int32_t> &reference, const std::vector<bool> &moving, uint32_t repeat, float factor)
+{
+    ErrorStats still;
+    ErrorStats moved;
+    chain.resetStats();
+
+    for (uint32_t pass = 0; pass < repeat; pass++)
+    {
+        chain.reset(counts[0]);
+        for (size_t i = 0; i < counts.size(); i++)
+        {
+            int32_t filtered = chain.process(counts[i]);
+            if (pass == 0)
+            {
+                (moving[i] ? moved : still).add((int64_t)filtered - reference[i]);
+            }
+        }
+    }
+
+    double scale = factor > 0.0f ? 1.0 / factor : 1.0;
+    printf("  %-14s %9.3f %9.3f  %9.3f %9.3f", label, still.rms() * scale, still.max * scale, moved.rms() * scale,
+           moved.max * scale);
+    for (uint8_t i = 0; i < chain.size(); i++)
+    {
+        printf("  %s %lu", chain.stage(i)->name(), (unsigned long)chain.stage(i)->cyclesPerSample());
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <capture.bin|capture.csv|creep|scoop|swap|pour|mains|spikes> [--factor counts/g] [--repeat n] [--samples n] [--seed n]\n", argv[0]);
+        return 2;
+    }
+
+    float factor = 0.0f;
+    uint32_t repeat = 1;
+    SyntheticScenario scenario;
+    bool synthetic = parseSyntheticScenario(argv[1], scenario);
+    SyntheticConfig config = syntheticDefaults(synthetic ? scenario : SyntheticScenario::SCOOP);
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--factor") == 0)
+            factor = strtof(argv[i + 1], nullptr);
+        else if (strcmp(argv[i], "--repeat") == 0)
+            repeat = std::max(1ul, strtoul(argv[i + 1], nullptr, 10));
+        else if (strcmp(argv[i], "--samples") == 0)
+            config.samples = strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--seed") == 0)
+            config.seed = strtoul(argv[i + 1], nullptr, 10);
+    }
+
+    std::vector<int32_t> counts;
+    std::vector<int32_t> reference;
+    if (synthetic)
+    {
+        SyntheticSource source;
+        source.begin(config);
+        RawSample sample;
+        while (source.read(sample))
+        {
+            counts.push_back(sample.counts);
+            reference.push_back(source.getTruthCounts());
+        }
+        if (factor == 0.0f)
+        {
+            factor = config.countsPerGram;
+        }
+        printf("%s: %lu samples, seed %lu, error against the truth\n", syntheticScenarioName(config.scenario),
+               (unsigned long)counts.size(), (unsigned long)config.seed);
+    }
+    else
+    {
+        std::vector<uint8_t> data;
+        std::vector<RawSample> samples;
+        if (!readFile(argv[1], data))
+        {
+            fprintf(stderr, "can't read %s\n", argv[1]);
+            return 1;
+        }
+        if (!parseCapture(data.data(), data.size(), samples) && !parseCsv(data, samples))
+        {
+            fprintf(stderr, "%s is neither a capture, a capture CSV nor a scenario\n", argv[1]);
+            return 1;
+        }
+
+        for (const RawSample &sample : samples)
+        {
+            counts.push_back(sample.counts);
+        }
+        reference = centeredMedian(counts);
+        printf("%s: %lu samples, error against the median of %d samples around each\n", argv[1],
+               (unsigned long)counts.size(), REFERENCE_HALF_WINDOW * 2 + 1);
+    }
+
+    if (counts.empty())
+    {
+        fprintf(stderr, "no samples\n");
+        return 1;
+    }
+
+    // each stage alone, with the tuning of the mode it belongs to
+    MedianFilter bagMedian(BAG_FILTER_MEDIAN_WINDOW);
+    EmaFilter baristaEma(BARISTA_FILTER_EMA_ALPHA);
+    KalmanFilter bagKalman(BAG_FILTER_PROCESS_NOISE, FILTER_MEASUREMENT_NOISE);
+    FilterChain medianOnly, emaOnly, kalmanOnly;
+    medianOnly.add(&bagMedian);
+    emaOnly.add(&baristaEma);
+    kalmanOnly.add(&bagKalman);
+
+    // the chains the scale runs, see the Scale constructor and BagPipeline
+    MedianFilter chainBagMedian(BAG_FILTER_MEDIAN_WINDOW);
+    KalmanFilter chainBagKalman(BAG_FILTER_PROCESS_NOISE, FILTER_MEASUREMENT_NOISE);
+    MedianFilter chainBaristaMedian(BARISTA_FILTER_MEDIAN_WINDOW);
+    EmaFilter chainBaristaEma(BARISTA_FILTER_EMA_ALPHA);
+    FilterChain bag, barista;
+    bag.add(&chainBagMedian).add(&chainBagKalman);
+    barista.add(&chainBaristaMedian).add(&chainBaristaEma);
+
+    std::vector<bool> moving = movingSamples(counts, reference);
+    uint32_t movingCount = std::count(moving.begin(), moving.end(), true);
+    printf("  %lu samples still, %lu moving, errors in %s, costs in ns/sample\n", (unsigned long)(counts.size() - movingCount),
+           (unsigned long)movingCount, factor > 0.0f ? "g" : "counts");
+    printf("  %-14s %9s %9s  %9s %9s\n", "", "still rms", "max", "moving rms", "max");
+
+    // raw conversions for comparison, an empty chain passes them through
+    FilterChain raw;
+    run("raw", raw, counts, reference, moving, repeat, factor);
+    run("median", medianOnly, counts, reference, moving, repeat, factor);
+    run("ema", emaOnly, counts, reference, moving, repeat, factor);
+    run("kalman", kalmanOnly, counts, reference, moving, repeat, factor);
+    run("bag chain", bag, counts, reference, moving, repeat, factor);
+    run("barista chain", barista, counts, reference, moving, repeat, factor);
+    return 0;
+}
@@ -0,0 +1,449 @@
+#!/usr/bin/env python3
+"""Collect the UDP reports of a fleet of scales.
+
+Scales report to this collector once FLEET_COLLECTOR_HOST is set in wifi.secret.h. The collector
+keeps per device time series of the weights, events and health counters in <out>/<device>_*.csv
+and prints a fleet summary every few seconds. Lost, reordered and duplicated datagrams are told
+apart by their sequence number, a scale restart by its boot id. Events are repeated in the
+following event datagrams and deduplicated here, so single losses don't lose events.
+
+    python tools/fleet_collector.py collect --out fleet
+    python tools/fleet_collector.py simulate 192.168.1.10 --devices 200 --rate 2000 --loss 0.01
+    python tools/fleet_collector.py bench --devices 500 --rates 5000,20000,50000
+
+`simulate` sends the datagrams of many made up scales, with loss, reordering and duplication
+injected. `bench` runs a simulator against an in-process collector on localhost at each rate
+and reports the sustained ingest rate and whether the detected loss matches the injected one.
+"""
+
+import argparse
+import json
+import os
+import random
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+FLEET_MAGIC = 0x5354
+FLEET_VERSION = 1
+DEFAULT_PORT = 4210
+EVENT_REDUNDANCY = 3
+
+WEIGHT = 1
+EVENT = 2
+HEALTH = 3
+
+HEADER = struct.Struct("<HBBIHII")
+WEIGHT_ENTRY = struct.Struct("<BHii")
+EVENT_ENTRY = struct.Struct("<IBBiI")
+HEALTH_BODY = struct.Struct("<IbIIIIIII")
+
+EVENT_NAMES = [
+    "bag_removed",
+    "bag_returned",
+    "below_threshold",
+    "above_threshold",
+    "below_prompt_threshold",
+    "above_prompt_threshold",
+    "consumption",
+    "dose_stop",
+    "dose_done",
+]
+
+HEALTH_COLUMNS = ["free_heap", "rssi", "conversions", "conversions_dropped", "gaps", "missed_conversions",
+                  "saturated", "stuck_runs", "stale_readings"]
+SERIES = {
+    "weight": ["received", "boot", "sequence", "uptime_ms", "channel", "flags", "weight_mg", "stable_mg"],
+    "events": ["received", "boot", "event", "timestamp_us", "name", "channel", "weight_mg"],
+    "health": ["received", "boot", "sequence", "uptime_ms"] + HEALTH_COLUMNS,
+}
+
+# Sequence numbers this far behind the newest one are too old to tell late from duplicate
+WINDOW = 1024
+# A device that sent nothing for this long counts as offline
+OFFLINE_SECONDS = 30
+
+
+class SequenceTracker:
+    """Accepts each sequence number of one boot once and counts what never arrived."""
+
+    def __init__(self):
+        self.first = None
+        self.highest = None
+        self.seen = 0  # bit i is set if highest - i arrived
+        self.accepted = 0
+        self.reordered = 0
+        self.duplicates = 0
+        self.too_old = 0
+
+    def accept(self, sequence):
+        if self.highest is None:
+            self.first = self.highest = sequence
+            self.seen = 1
+            self.accepted = 1
+            return True
+
+        if sequence > self.highest:
+            self.seen = ((self.seen << (sequence - self.highest)) | 1) & ((1 << WINDOW) - 1)
+            self.highest = sequence
+            self.accepted += 1
+            return True
+
+        offset = self.highest - sequence
+        if offset >= WINDOW:
+            self.too_old += 1
+            return False
+        if self.seen & (1 << offset):
+            self.duplicates += 1
+            return False
+        self.seen |= 1 << offset
+        self.reordered += 1
+        self.accepted += 1
+        return True
+
+    def lost(self):
+        if self.highest is None:
+            return 0
+        return self.highest - self.first + 1 - self.accepted
+
+
+class Device:
+    def __init__(self, device):
+        self.device = device
+        self.boot = None
+        self.restarts = 0
+        self.datagrams = SequenceTracker()
+        self.events = SequenceTracker()
+        # counters of earlier boots, the trackers start over on a restart
+        self.finished = {"lost": 0, "reordered": 0, "duplicates": 0, "events_lost": 0}
+        self.last_seen = 0.0
+        self.last_health = None
+        self.rows = {name: [] for name in SERIES}
+
+    def restart(self, boot):
+        if self.boot is not None:
+            self.restarts += 1
+            self.finished["lost"] += self.datagrams.lost()
+            self.finished["reordered"] += self.datagrams.reordered
+            self.finished["duplicates"] += self.datagrams.duplicates
+            self.finished["events_lost"] += self.events.lost()
+        self.boot = boot
+        self.datagrams = SequenceTracker()
+        self.events = SequenceTracker()
+
+    def totals(self):
+        return {
+            "lost": self.finished["lost"] + self.datagrams.lost(),
+            "reordered": self.finished["reordered"] + self.datagrams.reordered,
+            "duplicates": self.finished["duplicates"] + self.datagrams.duplicates,
+            "events_lost": self.finished["events_lost"] + self.events.lost(),
+        }
+
+
+class Collector:
+    def __init__(self, out):
+        self.out = out
+        self.devices = {}
+        self.datagrams = 0
+        self.malformed = 0
+        if out is not None:
+            os.makedirs(out, exist_ok=True)
+
+    def ingest(self, data, received):
+        self.datagrams += 1
+        if len(data) < HEADER.size:
+            self.malformed += 1
+            return
+        magic, version, kind, device_id, boot, sequence, uptime = HEADER.unpack_from(data)
+        if magic != FLEET_MAGIC or version != FLEET_VERSION:
+            self.malformed += 1
+            return
+
+        device = self.devices.get(device_id)
+        if device is None:
+            device = self.devices[device_id] = Device(device_id)
+        if boot != device.boot:
+            device.restart(boot)
+        device.last_seen = received
+        if not device.datagrams.accept(sequence):
+            return
+
+        try:
+            if kind == WEIGHT:
+                count = data[HEADER.size]
+                offset = HEADER.size + 1
+                for _ in range(count):
+                    channel, flags, weight, stable = WEIGHT_ENTRY.unpack_from(data, offset)
+                    offset += WEIGHT_ENTRY.size
+                    device.rows["weight"].append((received, boot, sequence, uptime, channel, flags, weight, stable))
+            elif kind == EVENT:
+                count = data[HEADER.size]
+                offset = HEADER.size + 1
+                for _ in range(count):
+                    number, event, channel, weight, timestamp = EVENT_ENTRY.unpack_from(data, offset)
+                    offset += EVENT_ENTRY.size
+                    # the repeated events of earlier datagrams are duplicates, unless that datagram got lost
+                    if device.events.accept(number):
+                        name = EVENT_NAMES[event] if event < len(EVENT_NAMES) else str(event)
+                        device.rows["events"].append((received, boot, number, timestamp, name, channel, weight))
+            elif kind == HEALTH:
+                values = HEALTH_BODY.unpack_from(data, HEADER.size)
+                device.last_health = dict(zip(HEALTH_COLUMNS, values))
+                device.rows["health"].append((received, boot, sequence, uptime) + values)
+            else:
+                self.malformed += 1
+        except (struct.error, IndexError):
+            self.malformed += 1
+
+    def flush(self):
+        # files are only open while they are written, hundreds of devices would run out of descriptors
+        for device in self.devices.values():
+            for name, rows in device.rows.items():
+                if not rows:
+                    continue
+                if self.out is not None:
+                    path = os.path.join(self.out, f"{device.device:08x}_{name}.csv")
+                    exists = os.path.exists(path)
+                    with open(path, "a") as out:
+                        if not exists:
+                            out.write(",".join(SERIES[name]) + "\n")
+                        out.write("".join(",".join(str(value) for value in row) + "\n" for row in rows))
+                rows.clear()
+
+    def totals(self):
+        totals = {"lost": 0, "reordered": 0, "duplicates": 0, "events_lost": 0, "accepted": 0, "restarts": 0}
+        for device in self.devices.values():
+            for key, value in device.totals().items():
+                totals[key] += value
+            totals["accepted"] += device.datagrams.accepted
+            totals["restarts"] += device.restarts
+        return totals
+
+    def summary(self, now, interval_datagrams, interval):
+        totals = self.totals()
+        online = sum(1 for device in self.devices.values() if now - device.last_seen < OFFLINE_SECONDS)
+        expected = totals["accepted"] + totals["lost"]
+        loss = 100.0 * totals["lost"] / expected if expected else 0.0
+        unhealthy = sum(1 for device in self.devices.values()
+                        if device.last_health and (device.last_health["stuck_runs"] or device.last_health["saturated"]))
+        return (f"{online}/{len(self.devices)} devices online, {interval_datagrams / interval:.0f} datagrams/s, "
+                f"{loss:.2f}% lost, {totals['reordered']} reordered, {totals['duplicates']} duplicates, "
+                f"{totals['events_lost']} events lost, {self.malformed} malformed, {totals['restarts']} restarts, "
+                f"{unhealthy} with a stuck or saturated load cell")
+
+    def write_devices(self):
+        if self.out is None:
+            return
+        with open(os.path.join(self.out, "devices.csv"), "w") as out:
+            out.write("device,restarts,datagrams,lost,reordered,duplicates,events_lost\n")
+            for device in self.devices.values():
+                totals = device.totals()
+                out.write(f"{device.device:08x},{device.restarts},{device.datagrams.accepted},{totals['lost']},"
+                          f"{totals['reordered']},{totals['duplicates']},{totals['events_lost']}\n")
+
+
+def open_socket(port):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 8 * 1024 * 1024)
+    sock.bind(("0.0.0.0", port))
+    sock.settimeout(0.2)
+    return sock
+
+
+def receive(sock, collector, duration, report, flush, stop=None):
+    started = last_report = last_flush = time.monotonic()
+    interval_datagrams = 0
+    while duration is None or time.monotonic() - started < duration:
+        if stop is not None and stop.is_set():
+            break
+        try:
+            data = sock.recv(2048)
+            collector.ingest(data, time.time())
+            interval_datagrams += 1
+        except socket.timeout:
+            pass
+
+        now = time.monotonic()
+        if now - last_flush >= flush:
+            last_flush = now
+            collector.flush()
+        if report and now - last_report >= report:
+            print(collector.summary(time.time(), interval_datagrams, now - last_report), flush=True)
+            interval_datagrams = 0
+            last_report = now
+    collector.flush()
+
+
+def collect(args):
+    collector = Collector(args.out)
+    sock = open_socket(args.port)
+    print(f"Listening on UDP port {args.port}, writing to {args.out}")
+    try:
+        receive(sock, collector, args.duration, args.report, args.flush)
+    except KeyboardInterrupt:
+        collector.flush()
+    collector.write_devices()
+
+
+class SimulatedScale:
+    def __init__(self, device, rng):
+        self.device = device
+        self.boot = rng.randrange(1 << 16)
+        self.sequence = 0
+        self.event_sequence = 0
+        self.recent = []
+        self.started = time.monotonic()
+        self.weight = rng.randrange(50_000, 340_000)
+        self.datagrams = 0
+
+    def header(self, kind):
+        uptime = int((time.monotonic() - self.started) * 1000) & 0xFFFFFFFF
+        data = HEADER.pack(FLEET_MAGIC, FLEET_VERSION, kind, self.device, self.boot, self.sequence, uptime)
+        self.sequence += 1
+        return data
+
+    def next(self, rng):
+        self.datagrams += 1
+        if self.datagrams % 10 == 0:
+            return self.header(HEALTH) + HEALTH_BODY.pack(180_000, -60, self.datagrams * 80, 0, 0, 0, 0, 0, 0)
+
+        if rng.random() < 0.05:
+            self.event_sequence += 1
+            self.weight = max(0, self.weight - rng.randrange(14_000, 22_000))
+            self.recent = (self.recent + [(self.event_sequence, 6, 0, 18_000, self.datagrams)])[-EVENT_REDUNDANCY:]
+            return (self.header(EVENT) + bytes([len(self.recent)]) +
+                    b"".join(EVENT_ENTRY.pack(*event) for event in self.recent))
+
+        return self.header(WEIGHT) + bytes([1]) + WEIGHT_ENTRY.pack(0, 0x7, self.weight, self.weight)
+
+
+def simulate(args):
+    rng = random.Random(args.seed)
+    scales = [SimulatedScale(0x5C000000 + i, rng) for i in range(args.devices)]
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, 8 * 1024 * 1024)
+    target = (args.host, args.port)
+
+    sent = injected_lost = injected_reordered = injected_duplicates = 0
+    held = []  # (produced count to send at, datagram)
+    started = time.monotonic()
+    produced = 0
+    index = 0
+    while time.monotonic() - started < args.duration:
+        due = int((time.monotonic() - started) * args.rate)
+        if produced >= due:
+            time.sleep(0.001)
+            continue
+
+        for _ in range(min(due - produced, 1000)):
+            produced += 1
+            data = scales[index].next(rng)
+            index = (index + 1) % len(scales)
+
+            if rng.random() < args.loss:
+                injected_lost += 1
+                continue
+            if rng.random() < args.reorder:
+                # goes out right after the next datagram of the same scale
+                held.append((produced + len(scales), data))
+                injected_reordered += 1
+                continue
+
+            sock.sendto(data, target)
+            sent += 1
+            if rng.random() < args.duplicate:
+                sock.sendto(data, target)
+                sent += 1
+                injected_duplicates += 1
+            while held and held[0][0] <= produced:
+                sock.sendto(held.pop(0)[1], target)
+                sent += 1
+
+    for _, data in held:
+        sock.sendto(data, target)
+        sent += 1
+
+    stats = {"produced": produced, "sent": sent, "lost": injected_lost, "reordered": injected_reordered,
+             "duplicates": injected_duplicates, "seconds": time.monotonic() - started}
+    if args.stats:
+        with open(args.stats, "w") as out:
+            json.dump(stats, out)
+    else:
+        print(stats)
+
+
+def bench(args):
+    print("offered/s  ingested/s  kernel drops  lost (injected)  reordered (injected)  cpu")
+    for rate in [int(rate) for rate in args.rates.split(",")]:
+        sock = open_socket(args.port)
+        collector = Collector(tempfile.mkdtemp(prefix="fleet_bench_") if args.write else None)
+        stop = threading.Event()
+        receiver = threading.Thread(target=receive, args=(sock, collector, None, 0, 1.0, stop))
+
+        with tempfile.NamedTemporaryFile(suffix=".json") as stats_file:
+            cpu_started = time.process_time()
+            started = time.monotonic()
+            receiver.start()
+            subprocess.run([sys.executable, __file__, "simulate", "127.0.0.1", "--port", str(args.port),
+                            "--devices", str(args.devices), "--rate", str(rate), "--duration", str(args.duration),
+                            "--loss", str(args.loss), "--reorder", str(args.reorder),
+                            "--duplicate", str(args.duplicate), "--seed", str(args.seed), "--stats", stats_file.name],
+                           check=True)
+            # let the socket buffer drain before stopping
+            time.sleep(0.5)
+            stop.set()
+            receiver.join()
+            elapsed = time.monotonic() - started
+            cpu = (time.process_time() - cpu_started) / elapsed
+            with open(stats_file.name) as source:
+                sent = json.load(source)
+        sock.close()
+
+        totals = collector.totals()
+        kernel_drops = sent["sent"] - collector.datagrams
+        print(f"{rate:9d}  {collector.datagrams / sent['seconds']:10.0f}  {kernel_drops:12d}  "
+              f"{totals['lost']:6d} ({sent['lost']:6d})  {totals['reordered']:9d} ({sent['reordered']:9d})  "
+              f"{cpu * 100:3.0f}%", flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    parser_collect = commands.add_parser("collect", help="receive reports and write per device time series")
+    parser_collect.add_argument("--port", type=int, default=DEFAULT_PORT)
+    parser_collect.add_argument("--out", default="fleet")
+    parser_collect.add_argument("--duration", type=float, help="seconds to run, until Ctrl-C if not set")
+    parser_collect.add_argument("--report", type=float, default=10.0, help="seconds between summaries")
+    parser_collect.add_argument("--flush", type=float, default=5.0, help="seconds between writes to disk")
+
+    def add_simulation(subparser):
+        subparser.add_argument("--port", type=int, default=DEFAULT_PORT)
+        subparser.add_argument("--devices", type=int, default=200)
+        subparser.add_argument("--duration", type=float, default=10.0)
+        subparser.add_argument("--loss", type=float, default=0.01, help="fraction of datagrams dropped")
+        subparser.add_argument("--reorder", type=float, default=0.01, help="fraction of datagrams sent late")
+        subparser.add_argument("--duplicate", type=float, default=0.001, help="fraction of datagrams sent twice")
+        subparser.add_argument("--seed", type=int, default=1)
+
+    parser_simulate = commands.add_parser("simulate", help="send the reports of made up scales")
+    parser_simulate.add_argument("host")
+    parser_simulate.add_argument("--rate", type=float, default=2000.0, help="datagrams per second of all scales")
+    parser_simulate.add_argument("--stats", help="write what was sent and injected to this JSON file")
+    add_simulation(parser_simulate)
+
+    parser_bench = commands.add_parser("bench", help="measure the sustained ingest rate on localhost")
+    parser_bench.add_argument("--rates", default="5000,10000,20000,50000", help="comma separated datagrams per second")
+    parser_bench.add_argument("--write", action="store_true", help="also write the time series to a temporary directory")
+    add_simulation(parser_bench)
+
+    args = parser.parse_args()
+    {"collect": collect, "simulate": simulate, "bench": bench}[args.command](args)
+
+
+if __name__ == "__main__":
+    main()
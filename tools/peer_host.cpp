@@ -0,0 +1,281 @@
+// Runs the scales' peer protocol (src/peer_node.cpp) on a host, to try the leader election,
+// catalog sharing and order leases with several instances on loopback or next to real scales.
+//
+//   g++ -std=c++17 -O2 -Iinclude tools/peer_host.cpp src/peer_node.cpp -o peer_host
+//   ./peer_host 1 --catalog '{"products":[]}' &
+//   ./peer_host 2 --order flow-12oz@4000 &
+//   ./peer_host 3 --order flow-12oz@4000 --run 10
+//
+// Without --run it reads commands from stdin: order <variant>, ordered <variant>,
+// release <variant>, catalog <text>, status, quit. --loopback keeps the traffic on 127.0.0.1.
+
+#include "peer_node.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define PEER_GROUP "239.255.84.83"
+#define PEER_PORT 4211
+
+static uint32_t nowMs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static uint32_t startedMs;
+
+static void printLog(const char *message)
+{
+    printf("[%6.3f] %s\n", (nowMs() - startedMs) / 1000.0, message);
+    fflush(stdout);
+}
+
+class MulticastTransport : public PeerTransport
+{
+private:
+    int fd;
+    sockaddr_in group{};
+
+public:
+    MulticastTransport(bool loopback)
+    {
+        fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes));
+
+        sockaddr_in local{};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(PEER_PORT);
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(fd, (sockaddr *)&local, sizeof(local)) != 0)
+        {
+            perror("bind");
+            exit(1);
+        }
+
+        in_addr interface{};
+        interface.s_addr = loopback ? htonl(INADDR_LOOPBACK) : htonl(INADDR_ANY);
+        ip_mreq membership{};
+        inet_pton(AF_INET, PEER_GROUP, &membership.imr_multiaddr);
+        membership.imr_interface = interface;
+        if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0)
+        {
+            perror("IP_ADD_MEMBERSHIP");
+            exit(1);
+        }
+        if (loopback)
+        {
+            setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface));
+        }
+        unsigned char loop = 1;
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+        group.sin_family = AF_INET;
+        group.sin_port = htons(PEER_PORT);
+        group.sin_addr = membership.imr_multiaddr;
+    }
+
+    int descriptor() { return fd; }
+
+    void send(const uint8_t *data, size_t length) override
+    {
+        sendto(fd, data, length, 0, (sockaddr *)&group, sizeof(group));
+    }
+};
+
+struct ScheduledOrder
+{
+    std::string variant;
+    uint32_t at;
+    bool requested = false;
+    bool done = false;
+};
+
+// Order: ask for the lease, "place" the order once granted and release it as ordered
+static void runOrder(PeerNode &node, ScheduledOrder &order, uint32_t now)
+{
+    if (!order.requested)
+    {
+        printLog(("ordering " + order.variant).c_str());
+        node.requestLease(order.variant, now);
+        order.requested = true;
+        return;
+    }
+
+    uint32_t holder = 0;
+    LeaseStatus status = node.leaseStatus(order.variant, holder);
+    if (status == LeaseStatus::PENDING)
+    {
+        return;
+    }
+
+    char message[128];
+    if (status == LeaseStatus::GRANTED)
+    {
+        snprintf(message, sizeof(message), "ORDER PLACED %s", order.variant.c_str());
+        node.releaseLease(order.variant, true, now);
+    }
+    else
+    {
+        snprintf(message, sizeof(message), "ORDER SKIPPED %s, %s %08x", order.variant.c_str(),
+                 leaseStatusName(status), holder);
+        node.releaseLease(order.variant, false, now);
+    }
+    printLog(message);
+    order.done = true;
+}
+
+static void handleCommand(PeerNode &node, const std::string &line, std::vector<ScheduledOrder> &orders, bool &running)
+{
+    uint32_t now = nowMs();
+    size_t space = line.find(' ');
+    std::string command = line.substr(0, space);
+    std::string argument = space == std::string::npos ? std::string() : line.substr(space + 1);
+
+    if (command == "order" && !argument.empty())
+    {
+        orders.push_back({argument, now});
+    }
+    else if (command == "ordered" || command == "release")
+    {
+        node.releaseLease(argument, command == "ordered", now);
+    }
+    else if (command == "catalog")
+    {
+        node.setCatalog(argument, time(nullptr), now);
+    }
+    else if (command == "status")
+    {
+        node.printStatus(now);
+    }
+    else if (command == "quit")
+    {
+        running = false;
+    }
+    else if (!command.empty())
+    {
+        printLog("commands: order <variant>, ordered <variant>, release <variant>, catalog <text>, status, quit");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <node id> [--loopback] [--catalog <text>] [--order <variant>@<ms>]... [--run <seconds>]\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t id = strtoul(argv[1], nullptr, 0);
+    bool loopback = false;
+    std::string catalog;
+    double runSeconds = 0.0;
+    std::vector<ScheduledOrder> orders;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string option = argv[i];
+        if (option == "--loopback")
+        {
+            loopback = true;
+        }
+        else if (option == "--catalog" && i + 1 < argc)
+        {
+            catalog = argv[++i];
+        }
+        else if (option == "--order" && i + 1 < argc)
+        {
+            std::string value = argv[++i];
+            size_t at = value.find('@');
+            orders.push_back({value.substr(0, at), at == std::string::npos ? 0u : (uint32_t)strtoul(value.c_str() + at + 1, nullptr, 10)});
+        }
+        else if (option == "--run" && i + 1 < argc)
+        {
+            runSeconds = atof(argv[++i]);
+        }
+    }
+
+    startedMs = nowMs();
+    for (auto &order : orders)
+    {
+        order.at += startedMs;
+    }
+
+    MulticastTransport transport(loopback);
+    PeerNode node(id, transport);
+    node.logger = printLog;
+    node.start(nowMs());
+    if (!catalog.empty())
+    {
+        node.setCatalog(catalog, time(nullptr), nowMs());
+    }
+
+    bool running = true;
+    bool interactive = runSeconds == 0.0;
+    uint32_t lastCatalogVersion = node.getCatalogVersion();
+    std::string input;
+    while (running)
+    {
+        pollfd fds[2] = {{transport.descriptor(), POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+        poll(fds, interactive ? 2 : 1, 50);
+
+        uint32_t now = nowMs();
+        if (fds[0].revents & POLLIN)
+        {
+            uint8_t buffer[PEER_MAX_DATAGRAM];
+            ssize_t length = recv(transport.descriptor(), buffer, sizeof(buffer), 0);
+            if (length > 0)
+            {
+                node.receive(buffer, length, now);
+            }
+        }
+        if (interactive && (fds[1].revents & (POLLIN | POLLHUP)))
+        {
+            if (!std::getline(std::cin, input))
+            {
+                interactive = false;
+                running = runSeconds > 0.0;
+            }
+            else
+            {
+                handleCommand(node, input, orders, running);
+            }
+        }
+
+        node.poll(now);
+        for (auto &order : orders)
+        {
+            if (!order.done && (int32_t)(now - order.at) >= 0)
+            {
+                runOrder(node, order, now);
+            }
+        }
+
+        if (node.getCatalogVersion() != lastCatalogVersion)
+        {
+            lastCatalogVersion = node.getCatalogVersion();
+            printLog(("catalog: " + node.getCatalog()).c_str());
+        }
+
+        if (runSeconds > 0.0 && now - startedMs >= runSeconds * 1000.0)
+        {
+            node.printStatus(now);
+            running = false;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+// Runs the load cell simulator (src/synthetic_source.cpp) through the bag tracking pipeline
+// (src/bag_pipeline.cpp) on a host, to compare filter and settle changes on millions of samples.
+// The same scenario and seed always produce the same stream, the checksum at the end covers
+// every filtered and settled value so two builds can be compared run for run.
+//
+//   g++ -std=c++17 -O2 -Iinclude -o pipeline_bench tools/pipeline_bench.cpp src/bag_pipeline.cpp
+//       src/sample_filter.cpp src/stability_detector.cpp src/calibration_curve.cpp src/weight.cpp src/synthetic_source.cpp
+//   ./pipeline_bench scoop --samples 8000000 --seed 7
+//
+// Scenarios: creep, scoop, swap, pour, mains, spikes. --factor sets the counts per gram.
+
+#include "bag_pipeline.h"
+#include "synthetic_source.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// A reading counts as settled once it is stable within this many grams of the truth
+#define BENCH_SETTLE_TOLERANCE 0.5f
+
+static uint32_t fnv1a(uint32_t hash, int32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int main(int argc, char **argv)
+{
+    SyntheticScenario scenario;
+    if (argc < 2 || !parseSyntheticScenario(argv[1], scenario))
+    {
+        fprintf(stderr, "usage: %s <creep|scoop|swap|pour|mains|spikes> [--samples n] [--seed n] [--factor counts/g]\n", argv[0]);
+        return 2;
+    }
+
+    SyntheticConfig config = syntheticDefaults(scenario);
+    config.samples = 8000000;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--samples") == 0)
+            config.samples = strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--seed") == 0)
+            config.seed = strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--factor") == 0)
+            config.countsPerGram = strtof(argv[i + 1], nullptr);
+    }
+
+    SyntheticSource source;
+    source.begin(config);
+    BagPipeline pipeline;
+    pipeline.setOffset(config.zeroCounts);
+    pipeline.getCurve().setLinear(config.countsPerGram);
+
+    printf("%s: %lu samples at %lu SPS, seed %lu\n", syntheticScenarioName(config.scenario),
+           (unsigned long)config.samples, (unsigned long)config.sampleRate, (unsigned long)config.seed);
+
+    // settle latency: samples from the truth holding still until the reading is stable on it
+    bool moving = false;
+    bool waitingForSettle = false;
+    uint32_t settledAt = 0;
+    Weight expected;
+    uint32_t settles = 0;
+    uint32_t missedSettles = 0;
+    uint64_t totalLatency = 0;
+    uint32_t maxLatency = 0;
+    // absolute error of the stable value against the truth while the truth holds still
+    uint64_t totalError = 0;
+    uint32_t errorSamples = 0;
+    Weight maxError;
+
+    uint32_t checksum = 2166136261u;
+    uint32_t processed = 0;
+    RawSample sample;
+
+    auto start = std::chrono::steady_clock::now();
+    while (source.read(sample))
+    {
+        pipeline.process(sample.counts);
+        checksum = fnv1a(fnv1a(checksum, pipeline.getFilteredCounts()), pipeline.getStableValue().toMilligrams());
+
+        if (!source.isTruthSettled())
+        {
+            if (waitingForSettle)
+            {
+                missedSettles++;
+                waitingForSettle = false;
+            }
+            moving = true;
+        }
+        else if (moving)
+        {
+            moving = false;
+            waitingForSettle = true;
+            settledAt = processed;
+            expected = pipeline.toWeight(source.getTruthCounts());
+        }
+
+        if (waitingForSettle && pipeline.isStable() && abs(pipeline.getStableValue() - expected) < Weight::grams(BENCH_SETTLE_TOLERANCE))
+        {
+            uint32_t latency = processed - settledAt;
+            totalLatency += latency;
+            maxLatency = latency > maxLatency ? latency : maxLatency;
+            settles++;
+            waitingForSettle = false;
+        }
+
+        if (source.isTruthSettled() && !waitingForSettle && pipeline.isStable())
+        {
+            Weight error = abs(pipeline.getStableValue() - pipeline.toWeight(source.getTruthCounts()));
+            totalError += error.toMilligrams();
+            errorSamples++;
+            maxError = error > maxError ? error : maxError;
+        }
+
+        processed++;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (waitingForSettle)
+    {
+        missedSettles++;
+    }
+
+    float msPerSample = 1000.0f / config.sampleRate;
+    printf("  throughput: %lu samples in %.0fms, %.0f samples/s, %.0fx real time\n", (unsigned long)processed,
+           elapsed * 1000.0, processed / elapsed, processed / elapsed / config.sampleRate);
+    for (uint8_t i = 0; i < pipeline.getFilters().size(); i++)
+    {
+        SampleFilter *stage = pipeline.getFilters().stage(i);
+        printf("  %-8s %6lu ns/sample\n", stage->name(), (unsigned long)stage->cyclesPerSample());
+    }
+    printf("  settling: %lu changes, avg=%.0fms max=%.0fms, %lu never settled\n", (unsigned long)settles,
+           settles ? (float)totalLatency / settles * msPerSample : 0.0f, maxLatency * msPerSample, (unsigned long)missedSettles);
+    printf("  settled error: avg=%.0fmg max=%ldmg over %lu samples\n", errorSamples ? (double)totalError / errorSamples : 0.0,
+           (long)maxError.toMilligrams(), (unsigned long)errorSamples);
+    printf("  checksum: %08lx\n", (unsigned long)checksum);
+    return 0;
+}
@@ -0,0 +1,132 @@
+// Replays a raw capture (tools/capture.py, binary or CSV) on a host through the bag tracking
+// pipeline (src/bag_pipeline.cpp) and the bag thresholds (src/bag_tracker.cpp), as fast as the
+// host runs. Prints every bag event with the time into the capture it happened at.
+//
+//   g++ -std=c++17 -O2 -Iinclude -o replay_host tools/replay_host.cpp src/bag_pipeline.cpp src/bag_tracker.cpp
+//       src/capture_format.cpp src/scale_event.cpp src/sample_filter.cpp src/stability_detector.cpp
+//       src/calibration_curve.cpp src/weight.cpp
+//   ./replay_host capture.bin --offset 84213 --factor 412.5
+//
+// --offset and --factor are the zero offset and calibration factor the scale prints at boot.
+// --reorder and --prompt set the thresholds in grams, --tare the empty bag (0 for no bag).
+
+#include "bag_pipeline.h"
+#include "bag_tracker.h"
+#include "capture_format.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static bool readFile(const char *path, std::vector<uint8_t> &data)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    uint8_t buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        data.insert(data.end(), buffer, buffer + read);
+    }
+    fclose(file);
+    return true;
+}
+
+// counts,timestamp_us per line after the header
+static bool parseCsv(const std::vector<uint8_t> &data, std::vector<RawSample> &samples)
+{
+    std::string text(data.begin(), data.end());
+    size_t line = text.find('\n');
+    while (line != std::string::npos && line + 1 < text.size())
+    {
+        long counts;
+        unsigned long timestamp;
+        if (sscanf(text.c_str() + line + 1, "%ld,%lu", &counts, &timestamp) == 2)
+        {
+            samples.push_back({(int32_t)counts, (uint32_t)timestamp});
+        }
+        line = text.find('\n', line + 1);
+    }
+    return !samples.empty();
+}
+
+static void printEvent(void *arg, ScaleEventType type, Weight weight)
+{
+    uint32_t elapsedUs = *static_cast<uint32_t *>(arg);
+    printf("  %10.3fs  %-24s %.1fg\n", elapsedUs / 1e6, scaleEventName(type), weight.toGrams());
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <capture.bin|capture.csv> [--offset counts] [--factor counts/g] [--reorder g] [--prompt g] [--tare g]\n", argv[0]);
+        return 2;
+    }
+
+    int32_t offset = 0;
+    float factor = 1.0f;
+    float reorder = REORDER_BUTTON_THRESHOLD;
+    float prompt = REORDER_BUTTON_PROMPT_THRESHOLD;
+    float tare = TERMINAL_COFFEE_BAG_EMPTY_WEIGHT;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--offset") == 0)
+            offset = strtol(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--factor") == 0)
+            factor = strtof(argv[i + 1], nullptr);
+        else if (strcmp(argv[i], "--reorder") == 0)
+            reorder = strtof(argv[i + 1], nullptr);
+        else if (strcmp(argv[i], "--prompt") == 0)
+            prompt = strtof(argv[i + 1], nullptr);
+        else if (strcmp(argv[i], "--tare") == 0)
+            tare = strtof(argv[i + 1], nullptr);
+    }
+
+    std::vector<uint8_t> data;
+    std::vector<RawSample> samples;
+    if (!readFile(argv[1], data))
+    {
+        fprintf(stderr, "can't read %s\n", argv[1]);
+        return 1;
+    }
+    if (!parseCapture(data.data(), data.size(), samples) && !parseCsv(data, samples))
+    {
+        fprintf(stderr, "%s is neither a capture nor a capture CSV\n", argv[1]);
+        return 1;
+    }
+
+    BagPipeline pipeline;
+    pipeline.setOffset(offset);
+    pipeline.getCurve().setLinear(factor);
+    BagTracker tracker;
+
+    // timestamps wrap after 71 minutes, the difference is right across one wrap
+    double captured = (uint32_t)(samples.back().timestampUs - samples.front().timestampUs) / 1e6;
+    printf("%s: %lu samples over %.1fs\n", argv[1], (unsigned long)samples.size(), captured);
+
+    uint32_t elapsedUs = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const RawSample &sample : samples)
+    {
+        elapsedUs = sample.timestampUs - samples.front().timestampUs;
+        pipeline.process(sample.counts, Weight::grams(tare));
+        // same gate as the shelf channels, thresholds only act on settled readings
+        if (pipeline.hasStableValue())
+        {
+            tracker.update(pipeline.getStableValue(), Weight::grams(reorder), Weight::grams(prompt), printEvent, &elapsedUs);
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("  final: %.1fg%s, replayed in %.0fms, %.0fx real time\n", pipeline.getStableValue().toGrams(),
+           pipeline.isStable() ? " stable" : "", elapsed * 1000.0, elapsed > 0 ? captured / elapsed : 0.0);
+    return 0;
+}
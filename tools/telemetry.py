@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+"""Record the binary telemetry stream of the scale.
+
+Sends `telemetry on` over serial (SERIAL_LISTEN must be enabled), decodes the COBS framed
+samples, events and status frames and writes them as CSV, or as Parquet with --parquet
+(needs pyarrow). Frames that fail their CRC, gaps in the frame sequence and the drops the
+scale reports itself are counted and printed when the recording stops (Ctrl-C or --duration).
+A recording can be kept with --raw and decoded again later with --replay.
+
+    python tools/telemetry.py /dev/ttyUSB0 pour
+    python tools/telemetry.py /dev/ttyUSB0 drift --duration 3600 --parquet
+    python tools/telemetry.py --replay pour.bin pour
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+TELEMETRY_VERSION = 1
+
+SAMPLE = 1
+EVENT = 2
+STATUS = 3
+
+EVENT_NAMES = [
+    "bag_removed",
+    "bag_returned",
+    "below_threshold",
+    "above_threshold",
+    "below_prompt_threshold",
+    "above_prompt_threshold",
+    "consumption",
+    "dose_stop",
+    "dose_done",
+]
+
+COLUMNS = {
+    SAMPLE: ["sequence", "timestamp_us", "raw_counts", "filtered_counts", "weight_mg", "flags"],
+    EVENT: ["sequence", "timestamp_us", "event", "channel", "weight_mg"],
+    STATUS: ["sequence", "uptime_ms", "frames_dropped", "conversions", "conversions_dropped", "version"],
+}
+LAYOUTS = {SAMPLE: "<IiiiH", EVENT: "<IBBi", STATUS: "<IIIIB"}
+NAMES = {SAMPLE: "samples", EVENT: "events", STATUS: "status"}
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    index = 0
+    while index < len(data):
+        code = data[index]
+        if code == 0 or index + code > len(data):
+            raise ValueError("bad COBS code")
+        out += data[index + 1:index + code]
+        index += code
+        if code < 0xFF and index < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Stats:
+    def __init__(self):
+        self.frames = {SAMPLE: 0, EVENT: 0, STATUS: 0}
+        self.bad_frames = 0
+        self.lost_frames = 0
+        self.expected_sequence = None
+        self.last_status = None
+        self.first_status = None
+        self.first_sample_us = None
+        self.last_sample_us = None
+
+    def sequence(self, sequence):
+        if self.expected_sequence is not None:
+            self.lost_frames += (sequence - self.expected_sequence) & 0xFFFF
+        self.expected_sequence = (sequence + 1) & 0xFFFF
+
+    def report(self, out):
+        received = sum(self.frames.values())
+        print(f"frames: {received} ok ({self.frames[SAMPLE]} samples, {self.frames[EVENT]} events, "
+              f"{self.frames[STATUS]} status), {self.bad_frames} corrupt, {self.lost_frames} missing from the sequence",
+              file=out)
+        if self.first_sample_us is not None and self.frames[SAMPLE] > 1:
+            span = ((self.last_sample_us - self.first_sample_us) & 0xFFFFFFFF) / 1e6
+            if span > 0:
+                print(f"sample rate: {(self.frames[SAMPLE] - 1) / span:.1f} SPS over {span:.1f}s", file=out)
+        if self.last_status is not None:
+            _, _, dropped, conversions, conversions_dropped, version = self.last_status
+            _, _, first_dropped, first_conversions, first_conversions_dropped, _ = self.first_status
+            print(f"scale: {dropped - first_dropped} frames dropped for a full UART buffer, "
+                  f"{conversions_dropped - first_conversions_dropped} of {conversions - first_conversions} "
+                  f"conversions dropped before filtering (protocol v{version})", file=out)
+
+
+class Writer:
+    def __init__(self, prefix, parquet):
+        self.prefix = prefix
+        self.parquet = parquet
+        self.rows = {kind: [] for kind in COLUMNS}
+        self.files = {}
+        if not parquet:
+            for kind, columns in COLUMNS.items():
+                self.files[kind] = open(f"{prefix}_{NAMES[kind]}.csv", "w")
+                self.files[kind].write(",".join(columns) + "\n")
+
+    def write(self, kind, row):
+        if self.parquet:
+            self.rows[kind].append(row)
+        else:
+            self.files[kind].write(",".join(str(value) for value in row) + "\n")
+
+    def close(self):
+        if not self.parquet:
+            for out in self.files.values():
+                out.close()
+            return
+
+        import pyarrow
+        import pyarrow.parquet
+
+        for kind, columns in COLUMNS.items():
+            table = pyarrow.table({name: [row[i] for row in self.rows[kind]] for i, name in enumerate(columns)})
+            pyarrow.parquet.write_table(table, f"{self.prefix}_{NAMES[kind]}.parquet")
+
+
+def decode_frame(encoded, stats, writer):
+    try:
+        frame = cobs_decode(encoded)
+    except ValueError:
+        stats.bad_frames += 1
+        return
+
+    # log lines from other tasks end up between frames as garbage, the CRC rejects them
+    if len(frame) < 5 or crc16(frame[:-2]) != struct.unpack_from("<H", frame, len(frame) - 2)[0]:
+        stats.bad_frames += 1
+        return
+
+    kind = frame[0]
+    sequence = struct.unpack_from("<H", frame, 1)[0]
+    layout = LAYOUTS.get(kind)
+    if layout is None or len(frame) - 5 != struct.calcsize(layout):
+        stats.bad_frames += 1
+        return
+
+    values = struct.unpack_from(layout, frame, 3)
+    stats.sequence(sequence)
+    stats.frames[kind] += 1
+
+    if kind == SAMPLE:
+        if stats.first_sample_us is None:
+            stats.first_sample_us = values[0]
+        stats.last_sample_us = values[0]
+    elif kind == EVENT:
+        name = EVENT_NAMES[values[1]] if values[1] < len(EVENT_NAMES) else str(values[1])
+        values = (values[0], name, values[2], values[3])
+    elif kind == STATUS:
+        stats.last_status = (sequence,) + values
+        if stats.first_status is None:
+            stats.first_status = stats.last_status
+
+    writer.write(kind, (sequence,) + tuple(values))
+
+
+def run(read, stats, writer, raw, duration):
+    pending = bytearray()
+    started = time.monotonic()
+    while duration is None or time.monotonic() - started < duration:
+        data = read()
+        if data is None:
+            break
+        if raw is not None:
+            raw.write(data)
+
+        pending += data
+        while True:
+            end = pending.find(b"\x00")
+            if end < 0:
+                break
+            if end > 0:
+                decode_frame(bytes(pending[:end]), stats, writer)
+            del pending[:end + 1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port", nargs="?")
+    parser.add_argument("prefix", help="output files are <prefix>_samples, <prefix>_events and <prefix>_status")
+    parser.add_argument("--baudrate", type=int, default=115200)
+    parser.add_argument("--duration", type=float, help="seconds to record, until Ctrl-C if not set")
+    parser.add_argument("--parquet", action="store_true", help="write Parquet instead of CSV")
+    parser.add_argument("--raw", help="also keep the undecoded stream in this file")
+    parser.add_argument("--replay", help="decode a stream saved with --raw instead of reading a port")
+    args = parser.parse_args()
+
+    if args.port is None and args.replay is None:
+        parser.error("either a port or --replay is required")
+
+    stats = Stats()
+    writer = Writer(args.prefix, args.parquet)
+    raw = open(args.raw, "wb") if args.raw else None
+
+    try:
+        if args.replay:
+            with open(args.replay, "rb") as source:
+                run(lambda: source.read(4096) or None, stats, writer, raw, None)
+        else:
+            import serial
+
+            with serial.Serial(args.port, args.baudrate, timeout=0.1) as connection:
+                connection.reset_input_buffer()
+                connection.write(b"telemetry on\n")
+                try:
+                    run(lambda: connection.read(4096), stats, writer, raw, args.duration)
+                except KeyboardInterrupt:
+                    pass
+                finally:
+                    connection.write(b"telemetry off\n")
+    finally:
+        writer.close()
+        if raw is not None:
+            raw.close()
+
+    stats.report(sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Load test the scale's HTTP and WebSocket server from the LAN.
+
+Opens a number of WebSocket clients on /ws, optionally some that read far too slowly, and polls
+/api/state at a fixed rate from others. When the duration is over it prints how many readings
+and events each kind of client received, the spacing of the readings (it should look the same
+with and without load, compare with `health` over serial), the snapshot latency and the
+server's own counters from /api/stats.
+
+Needs `pip install websockets`.
+
+    python tools/webload.py 192.168.1.50
+    python tools/webload.py 192.168.1.50 --clients 6 --slow 2 --pollers 4 --poll-rate 5 --duration 120
+"""
+
+import argparse
+import asyncio
+import json
+import statistics
+import time
+import urllib.request
+
+import websockets
+
+
+def percentile(values, fraction):
+    if not values:
+        return float("nan")
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+
+class ClientStats:
+    def __init__(self):
+        self.samples = 0
+        self.events = 0
+        self.snapshots = 0
+        self.skipped = 0  # readings published by the scale that this client never got
+        self.intervals_ms = []
+        self.last = {}
+        self.errors = 0
+
+
+def fetch(url, timeout):
+    with urllib.request.urlopen(url, timeout=timeout) as response:
+        return json.loads(response.read())
+
+
+async def websocket_client(url, stats, slow_delay, stop):
+    try:
+        # a slow client stops reading from the socket once one message is buffered, so the TCP
+        # window fills up and the scale has to hold back its messages
+        async with websockets.connect(url, max_queue=1 if slow_delay > 0 else None) as socket:
+            while not stop.is_set():
+                try:
+                    message = await asyncio.wait_for(socket.recv(), timeout=1.0)
+                except asyncio.TimeoutError:
+                    continue
+
+                data = json.loads(message)
+                kind = data.get("type")
+                if kind == "sample":
+                    stats.samples += 1
+                    channel = data["ch"]
+                    previous = stats.last.get(channel)
+                    if previous is not None:
+                        stats.skipped += max(0, data["seq"] - previous["seq"] - 1)
+                        if channel == 0:
+                            stats.intervals_ms.append(((data["t"] - previous["t"]) & 0xFFFFFFFF) / 1000.0)
+                    stats.last[channel] = data
+                elif kind == "event":
+                    stats.events += 1
+                else:
+                    stats.snapshots += 1
+
+                if slow_delay > 0:
+                    await asyncio.sleep(slow_delay)
+    except (OSError, websockets.exceptions.WebSocketException):
+        stats.errors += 1
+
+
+async def poller(url, rate, latencies, errors, stop):
+    while not stop.is_set():
+        started = time.monotonic()
+        try:
+            await asyncio.to_thread(fetch, url, 5.0)
+            latencies.append((time.monotonic() - started) * 1000.0)
+        except OSError:
+            errors.append(1)
+        await asyncio.sleep(max(0.0, 1.0 / rate - (time.monotonic() - started)))
+
+
+def summarize(name, clients):
+    if not clients:
+        return
+    samples = sum(c.samples for c in clients)
+    skipped = sum(c.skipped for c in clients)
+    intervals = [i for c in clients for i in c.intervals_ms]
+    print(f"{name}: {len(clients)} clients, {samples} readings ({skipped} skipped), "
+          f"{sum(c.events for c in clients)} events, {sum(c.snapshots for c in clients)} snapshots, "
+          f"{sum(c.errors for c in clients)} disconnects")
+    if intervals:
+        print(f"  reading spacing ms: median {statistics.median(intervals):.1f}, "
+              f"p99 {percentile(intervals, 0.99):.1f}, max {max(intervals):.1f}")
+
+
+async def run(args):
+    base = f"http://{args.host}:{args.port}"
+    socket_url = f"ws://{args.host}:{args.port}/ws"
+    before = await asyncio.to_thread(fetch, f"{base}/api/stats", 5.0)
+
+    stop = asyncio.Event()
+    fast = [ClientStats() for _ in range(args.clients)]
+    slow = [ClientStats() for _ in range(args.slow)]
+    latencies = []
+    errors = []
+
+    tasks = [asyncio.create_task(websocket_client(socket_url, stats, 0.0, stop)) for stats in fast]
+    tasks += [asyncio.create_task(websocket_client(socket_url, stats, args.slow_delay, stop)) for stats in slow]
+    tasks += [asyncio.create_task(poller(f"{base}/api/state", args.poll_rate, latencies, errors, stop))
+              for _ in range(args.pollers)]
+
+    await asyncio.sleep(args.duration)
+    stop.set()
+    await asyncio.gather(*tasks)
+
+    after = await asyncio.to_thread(fetch, f"{base}/api/stats", 5.0)
+
+    summarize("fast", fast)
+    summarize("slow", slow)
+    if args.pollers:
+        print(f"snapshots: {len(latencies)} ok, {len(errors)} failed, latency ms median "
+              f"{percentile(latencies, 0.5):.1f}, p99 {percentile(latencies, 0.99):.1f}")
+    print(f"server: {after['samples_sent'] - before['samples_sent']} readings and "
+          f"{after['events_sent'] - before['events_sent']} events sent, "
+          f"{after['partial_sends'] - before['partial_sends']} missed by a full client queue, "
+          f"free heap {before['free_heap']} -> {after['free_heap']} bytes")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--clients", type=int, default=4, help="WebSocket clients that keep up")
+    parser.add_argument("--slow", type=int, default=1, help="WebSocket clients that read too slowly")
+    parser.add_argument("--slow-delay", type=float, default=0.5, help="seconds a slow client waits per message")
+    parser.add_argument("--pollers", type=int, default=2, help="clients polling /api/state")
+    parser.add_argument("--poll-rate", type=float, default=2.0, help="snapshots per second per poller")
+    parser.add_argument("--duration", type=float, default=60.0)
+    asyncio.run(run(parser.parse_args()))
+
+
+if __name__ == "__main__":
+    main()